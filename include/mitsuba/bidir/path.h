@@ -412,12 +412,59 @@ public:
      *    Denotes whether or not rendering strategies that require a 'light image'
      *    (specifically, those with <tt>t==0</tt> or <tt>t==1</tt>) are included
      *    in the rendering process.
+     * \param cached
+     *    Set this to \c true if partial sums were previously cached on both
+     *    subpaths using \ref cacheMIWeights() (with the same values of
+     *    \c direct and \c lightImage). In this case, only a few vertices
+     *    near the connection edge are visited and the cost of the weight
+     *    computation no longer depends on the path length.
      */
     static Float miWeight(const Scene *scene,
             const Path &emitterSubpath,
             const PathEdge *connectionEdge,
             const Path &sensorSubpath, int s, int t,
-            bool direct, bool lightImage);
+            bool direct, bool lightImage, bool cached = false);
+
+    /**
+     * \brief Cache partial sums of the power heuristic on the vertices
+     * of a subpath
+     *
+     * All terms in the denominator of the MI weight computed by
+     * \ref miWeight() that belong to strategies whose connection edge is
+     * at least two vertices away from the current one only depend on one
+     * of the subpaths. This function sums them up in a single sweep and
+     * stores the results in \ref PathVertex::misPartial, which allows the
+     * weight of each subsequent <tt>(s,t)</tt> connection to be computed
+     * in constant time.
+     *
+     * The cached values become invalid when the subpath is modified.
+     *
+     * \param scene
+     *    Pointer to the underlying scene
+     * \param mode
+     *    Specifies whether this is an emitter (\ref EImportance) or
+     *    sensor (\ref ERadiance) subpath
+     * \param direct
+     *    See \ref miWeight()
+     * \param lightImage
+     *    See \ref miWeight()
+     */
+    void cacheMIWeights(const Scene *scene, ETransportMode mode,
+            bool direct, bool lightImage) const;
+
+    /**
+     * \brief Verify the MI weight computed from cached partial sums
+     *
+     * Compares the result of \ref miWeight() with and without the partial
+     * sums created by \ref cacheMIWeights(). If there is a mismatch, the
+     * function sends debug output to a specified output stream and returns
+     * \c false. The parameters are the same as in \ref miWeight().
+     */
+    static bool verifyMIWeight(const Scene *scene,
+            const Path &emitterSubpath,
+            const PathEdge *connectionEdge,
+            const Path &sensorSubpath, int s, int t,
+            bool direct, bool lightImage, std::ostream &os);
 
     /**
      * \brief Collapse a path into an entire edge that summarizes the aggregate
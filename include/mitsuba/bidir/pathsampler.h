@@ -162,11 +162,20 @@ public:
      *     the granularity of their constituent sampling strategies.
      * \param seeds
      *     A vector of resulting MLT seeds
+     * \param sceneResID
+     *     Resource ID of the scene, if it is already registered with the
+     *     scheduler (otherwise, it is temporarily registered here)
      * \return The average luminance over the image plane
+     *
+     * The luminance samples are taken in parallel using the \ref Scheduler.
+     * They are split into blocks of a fixed size, each of which draws from
+     * its own stream of the underlying \ref ReplayableSampler. The result
+     * therefore only depends on the sampler's seed and not on the number
+     * of workers or the order in which they finish.
      */
     Float generateSeeds(size_t sampleCount, size_t seedCount,
             bool fineGrained, const Bitmap *importanceMap,
-            std::vector<PathSeed> &seeds);
+            std::vector<PathSeed> &seeds, int sceneResID = -1);
 
     /**
      * \brief Compute the average luminance over the image plane
@@ -219,6 +228,7 @@ protected:
  * to generate it cheaply when needed.
  */
 struct PathSeed {
+    size_t streamIndex; ///< Stream of the \ref ReplayableSampler
     size_t sampleIndex; ///< Index into a rewindable random number stream
     Float luminance;    ///< Luminance value of the path (for sanity checks)
     int s;              ///< Number of steps from the luminaire
@@ -226,10 +236,12 @@ struct PathSeed {
 
     inline PathSeed() { }
 
-    inline PathSeed(size_t sampleIndex, Float luminance, int s = 0, int t = 0)
-        : sampleIndex(sampleIndex), luminance(luminance), s(s), t(t) { }
+    inline PathSeed(size_t sampleIndex, Float luminance, int s = 0, int t = 0,
+            size_t streamIndex = 0) : streamIndex(streamIndex),
+            sampleIndex(sampleIndex), luminance(luminance), s(s), t(t) { }
 
     inline PathSeed(Stream *stream) {
+        streamIndex = stream->readSize();
         sampleIndex = stream->readSize();
         luminance = stream->readFloat();
         s = stream->readInt();
@@ -237,6 +249,7 @@ struct PathSeed {
     }
 
     void serialize(Stream *stream) const {
+        stream->writeSize(streamIndex);
         stream->writeSize(sampleIndex);
         stream->writeFloat(luminance);
         stream->writeInt(s);
@@ -246,6 +259,7 @@ struct PathSeed {
     std::string toString() const {
         std::ostringstream oss;
         oss << "PathSeed[" << endl
+            << "  streamIndex = " << streamIndex << "," << endl
             << "  sampleIndex = " << sampleIndex << "," << endl
             << "  luminance = " << luminance << "," << endl
             << "  s = " << s << "," << endl
@@ -33,6 +33,12 @@ MTS_NAMESPACE_BEGIN
  * to store millions of path. Note that `rewinding' is naive -- it just
  * resets & regenerates the whole random number sequence, which might be slow.
  *
+ * To keep rewinds short and to allow several threads or machines to generate
+ * replayable samples concurrently, the sampler provides an arbitrary number
+ * of independent streams (see \ref setStreamIndex()). Stream zero continues
+ * the sequence of the initial random number generator, while all other
+ * streams are deterministically derived from it and the stream index.
+ *
  * \ingroup libbidir
  */
 class MTS_EXPORT_BIDIR ReplayableSampler : public Sampler {
@@ -40,6 +46,12 @@ public:
     /// Construct a new sampler
     ReplayableSampler();
 
+    /**
+     * \brief Construct a new sampler whose streams are derived from
+     * the given seed value instead of the default seed of \ref Random
+     */
+    ReplayableSampler(uint64_t seed);
+
     /// Unserialize a sampler
     ReplayableSampler(Stream *stream, InstanceManager *manager);
 
@@ -55,9 +67,21 @@ public:
     virtual void advance();
     virtual void generate(const Point2i &pos);
 
-    /// Manually set the current sample index
+    /// Manually set the current sample index (within the current stream)
     virtual void setSampleIndex(size_t sampleIndex);
 
+    /**
+     * \brief Switch to another random number stream
+     *
+     * When the stream index differs from the current one, the underlying
+     * random number generator is reset to the start of the requested stream
+     * and the sample index is set to zero.
+     */
+    void setStreamIndex(size_t streamIndex);
+
+    /// Return the index of the current random number stream
+    inline size_t getStreamIndex() const { return m_streamIndex; }
+
     /// Retrieve the next component value from the current sample
     virtual Float next1D();
 
@@ -89,8 +113,12 @@ public:
 protected:
     /// Virtual destructor
     virtual ~ReplayableSampler();
+protected:
+    /// Reset \c m_random to the start of the current stream
+    void resetStream();
 protected:
     ref<Random> m_initial, m_random;
+    size_t m_streamIndex;
 };
 
 MTS_NAMESPACE_END
@@ -199,6 +199,15 @@ struct MTS_EXPORT_BIDIR PathVertex {
     /// \brief Termination weight due to russian roulette (used by BDPT)
     Float rrWeight;
 
+    /**
+     * \brief Partial sum of the power heuristic used to compute MI weights
+     *
+     * Only valid after a call to \ref Path::cacheMIWeights(). A value of
+     * \c -1 (which is what newly sampled vertices start out with)
+     * indicates that no cached sum is available for this vertex.
+     */
+    double misPartial;
+
     /**
      * \brief Auxilary node-depependent data associated with each vertex
      *
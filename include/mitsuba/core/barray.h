@@ -52,11 +52,11 @@ public:
      */
     void alloc(const Vector2i &size) {
         if (m_data && m_owner)
-            delete[] m_data;
+            freeAligned(m_data);
 
         m_xBlocks = (size.x + blockSize - 1) / blockSize;
         m_yBlocks = (size.y + blockSize - 1) / blockSize;
-        m_data = (Value *) allocAligned(m_xBlocks * m_yBlocks
+        m_data = (Value *) allocAlignedLarge(m_xBlocks * m_yBlocks
             * blockSize * blockSize * sizeof(Value));
         m_owner = true; /* We own this pointer */
         m_size = size;
@@ -70,7 +70,7 @@ public:
      */
     void map(void *ptr, const Vector2i &size) {
         if (m_data && m_owner)
-            delete[] m_data;
+            freeAligned(m_data);
 
         m_xBlocks = (size.x + blockSize - 1) / blockSize;
         m_yBlocks = (size.y + blockSize - 1) / blockSize;
@@ -261,10 +261,10 @@ public:
      */
     void alloc(const Vector2i &size) {
         if (m_data && m_owner)
-            delete[] m_data;
+            freeAligned(m_data);
 
         size_t arraySize = (size_t) size.x * (size_t) size.y * sizeof(Value);
-        m_data = (Value *) allocAligned(arraySize);
+        m_data = (Value *) allocAlignedLarge(arraySize);
         m_size = size;
     }
 
@@ -276,7 +276,7 @@ public:
      */
     void map(void *ptr, const Vector2i &size) {
         if (m_data && m_owner)
-            delete[] m_data;
+            freeAligned(m_data);
 
         m_data = (Value *) ptr;
         m_owner = false; /* We do not own this pointer */
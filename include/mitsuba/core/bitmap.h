@@ -764,6 +764,22 @@ public:
         const std::vector<EPixelFormat> &pixelFormats,
         EComponentFormat componentFormat, size_t count);
 
+    /**
+     * \brief Compute the log-average and maximum luminance of the image
+     *
+     * The values are computed after scaling the image by \c multiplier,
+     * and they are consistent with the ones that \ref tonemapReinhard()
+     * determines (see \ref tonemap::getLuminanceStatistics()).
+     *
+     * \remark The implementation assumes that the image has a RGB(A) or
+     * Luminance(Alpha) pixel format and that <tt>gamma=1</tt>.
+     *
+     * \remark In the Python bindings, the signature of this function is:
+     * <tt>(logAvgLuminance, maxLuminance) = getLuminanceStatistics(multiplier)</tt>
+     */
+    void getLuminanceStatistics(Float &logAvgLuminance, Float &maxLuminance,
+            Float multiplier = 1.0f) const;
+
     /**
      * \brief Apply Reinhard et al's tonemapper in chromaticity space
      *
@@ -797,7 +813,8 @@ public:
      * \remark The implementation assumes that the image has a RGB(A), XYZ(A), or Luminance(Alpha)
      * pixel format, that <tt>gamma=1</tt>, and that it uses a EFloat16/EFloat32/EFloat64
      * component format. The conversion process is destructive in the sense that it overwrites
-     * the original image.
+     * the original image. EFloat32 images are processed using the vectorized kernels
+     * in \ref tonemap.
      *
      * \remark In the Python bindings, the signature of this function is:
      * <tt>(logAvgLuminance, maxLuminance) = tonemapReinhard(logAvgLuminance, maxLuminance, key, burn)</tt>
@@ -1016,22 +1033,38 @@ public:
     /**
      * \brief Convolve the image with a (centered) convolution kernel
      *
-     * When compiled with FFTW, Mitsuba will do the convolution
-     * in frequency space using three FFT operations. Otherwise,
-     * it falls back to a brute force method with quadratic
-     * complexity.
+     * The convolution is done in frequency space using the
+     * multithreaded \ref FFT implementation. Half and single precision
+     * images use the single precision real-valued transform
+     * (\ref RealFFT2D), while double precision images are transformed
+     * in double precision. In the latter case, pairs of image channels
+     * share one transform when the kernel has a single channel.
      *
      * The image can have any resolution; the kernel should be
      * square and of odd resolution. Both images must be of the
      * same floating point-valued component format. The kernel can
      * either have one color channel or as many color channels as
      * the image to be convolved.
-     *
-     * The convolution is always performed in double precision.
-     * irrespective of the precision of the underlying data.
      */
     void convolve(const Bitmap *kernel);
 
+    /**
+     * \brief Compute a bloom filter that simulates scattering in the
+     * human eye, for use with \ref convolve()
+     *
+     * Based on "Physically-Based Glare Effects for Digital Images" by
+     * Greg Spencer, Peter Shirley, Kurt Zimmerman and Donald P. Greenberg
+     * (SIGGRAPH 1995). The result is a normalized single precision
+     * luminance image.
+     *
+     * \param size
+     *    Resolution of the (square) filter. Should be odd and at least as
+     *    large as the images to be processed.
+     * \param fov
+     *    Approximate field of view of the images in degrees
+     */
+    static ref<Bitmap> createBloomFilter(int size, Float fov);
+
     /**
      * \brief Perform an arithmetic operation using two images
      *
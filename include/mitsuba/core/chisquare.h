@@ -134,6 +134,27 @@ public:
      */
     inline void setTolerance(Float tolerance) { m_tolerance = tolerance; }
 
+    /**
+     * \brief Specify whether \ref fill() may use OpenMP to evaluate
+     * the reference density in parallel (default: \c true)
+     *
+     * This should be disabled when several tests are already being
+     * run concurrently, e.g. by different workers of the scheduler.
+     */
+    inline void setParallel(bool parallel) { m_parallel = parallel; }
+
+    /// Return the number of samples that are drawn by \ref fill()
+    inline size_t getSampleCount() const { return m_sampleCount; }
+
+    /// Return the time (in seconds) spent drawing samples in the last call to \ref fill()
+    inline Float getSamplingTime() const { return m_samplingTime; }
+
+    /// Return the time (in seconds) spent integrating the reference table in the last call to \ref fill()
+    inline Float getIntegrationTime() const { return m_integrationTime; }
+
+    /// Return the number of density evaluations performed by the last call to \ref fill()
+    inline size_t getEvaluationCount() const { return m_evaluationCount; }
+
     /**
      * \brief Fill the actual and reference bin counts
      *
@@ -169,9 +190,9 @@ protected:
     /// Functor to evaluate the pdf values in parallel using OpenMP
     static void integrand(
         const boost::function<Float (const Vector &, EMeasure)> &pdfFn,
-            size_t nPts, const Float *in, Float *out) {
+            bool parallel, size_t nPts, const Float *in, Float *out) {
         #if defined(MTS_OPENMP)
-        #pragma omp parallel for
+        #pragma omp parallel for if (parallel)
         #endif
         for (int i=0; i<(int) nPts; ++i)
             out[i] = pdfFn(sphericalDirection(in[2*i], in[2*i+1]), ESolidAngle)
@@ -180,6 +201,9 @@ protected:
 private:
     ELogLevel m_logLevel;
     Float m_tolerance;
+    bool m_parallel;
+    Float m_samplingTime, m_integrationTime;
+    size_t m_evaluationCount;
     int m_thetaBins, m_phiBins;
     int m_numTests;
     size_t m_sampleCount;
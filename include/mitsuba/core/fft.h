@@ -0,0 +1,182 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_CORE_FFT_H_)
+#define __MITSUBA_CORE_FFT_H_
+
+#include <mitsuba/mitsuba.h>
+#include <complex>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Self-contained fast Fourier transform
+ *
+ * Computes one-dimensional discrete Fourier transforms of a fixed size
+ * using a mixed-radix (2, 3, 4, 5) Stockham algorithm. The butterflies
+ * use SSE2 when Mitsuba is compiled with \c MTS_SSE. Sizes must only
+ * contain the prime factors 2, 3 and 5 -- use \ref getSmoothSize() to
+ * pad arbitrary sizes accordingly.
+ *
+ * All transforms are unnormalized, i.e. a forward transform followed by
+ * an inverse transform scales the input by the transform size.
+ *
+ * Besides double precision transforms of a single array, a plan can
+ * compute four single precision transforms at once (\ref transformBatch()),
+ * which is what \ref RealFFT2D builds on.
+ *
+ * A plan can be shared by any number of threads. \ref transform2D()
+ * additionally parallelizes two-dimensional transforms over the rows
+ * and columns using OpenMP.
+ *
+ * \ingroup libcore
+ */
+class MTS_EXPORT_CORE FFT : public Object {
+public:
+    typedef std::complex<double> Complex;
+
+    /**
+     * \brief Entries of four independent single precision transforms
+     *
+     * Lane \c i of the real and imaginary parts belongs to the \c i-th
+     * transform. This layout lets the butterflies process all four
+     * transforms using one SSE register per component.
+     */
+    struct ComplexBatch {
+        float re[4];
+        float im[4];
+    };
+
+    /// Prepare a transform of the given size
+    FFT(size_t size);
+
+    /// Return the size of the transform
+    inline size_t getSize() const { return m_size; }
+
+    /**
+     * \brief Transform \c data in place
+     *
+     * \param data
+     *     Array with \ref getSize() entries
+     * \param scratch
+     *     Temporary storage with \ref getSize() entries
+     * \param inverse
+     *     Compute the inverse (positive exponent) transform?
+     */
+    void transform(Complex *data, Complex *scratch, bool inverse = false) const;
+
+    /**
+     * \brief Compute four single precision transforms in place
+     *
+     * \param data
+     *     Array with \ref getSize() entries
+     * \param scratch
+     *     Temporary storage with \ref getSize() entries
+     * \param inverse
+     *     Compute the inverse (positive exponent) transform?
+     */
+    void transformBatch(ComplexBatch *data, ComplexBatch *scratch, bool inverse = false) const;
+
+    /**
+     * \brief Transform a row-major 2D array in place
+     *
+     * Both dimensions must be valid transform sizes.
+     */
+    static void transform2D(Complex *data, size_t width,
+            size_t height, bool inverse = false);
+
+    /// Return the smallest size >= \c n whose only prime factors are 2, 3 and 5
+    static size_t getSmoothSize(size_t n);
+
+    /// Return a human-readable string representation
+    std::string toString() const;
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Virtual destructor
+    virtual ~FFT() { }
+private:
+    size_t m_size;
+    std::vector<int> m_radices;
+    std::vector<Complex> m_twiddles;
+    std::vector<std::complex<float> > m_twiddlesFloat;
+};
+
+/**
+ * \brief Single precision 2D transform of real-valued data
+ *
+ * The spectrum of a real-valued array is conjugate symmetric, hence
+ * only its \c width/2+1 leftmost columns are computed. Furthermore,
+ * pairs of rows are transformed at once by storing them in the real
+ * and imaginary parts of one complex transform. Together, this needs
+ * about a quarter of the work of a complex-valued double precision
+ * transform of the same size. All passes use \ref FFT::transformBatch()
+ * and are parallelized using OpenMP.
+ *
+ * The spectrum is kept in an internal column-major layout with
+ * \ref getSpectrumSize() entries. Apart from multiplying it with the
+ * spectrum of another array of the same size (\ref multiply()), it
+ * should be treated as opaque.
+ *
+ * \ingroup libcore
+ */
+class MTS_EXPORT_CORE RealFFT2D : public Object {
+public:
+    /// Prepare a transform of the given size (see \ref FFT::getSmoothSize())
+    RealFFT2D(size_t width, size_t height);
+
+    /// Return the width of the transform
+    inline size_t getWidth() const { return m_width; }
+
+    /// Return the height of the transform
+    inline size_t getHeight() const { return m_height; }
+
+    /// Return the number of entries of a spectrum
+    inline size_t getSpectrumSize() const { return m_columnBatches * m_height; }
+
+    /// Compute the spectrum of a row-major real-valued array
+    void forward(const float *data, FFT::ComplexBatch *spectrum) const;
+
+    /**
+     * \brief Compute the unnormalized inverse transform of a spectrum
+     *
+     * The spectrum is overwritten in the process.
+     */
+    void inverse(FFT::ComplexBatch *spectrum, float *data) const;
+
+    /// Multiply the spectrum \c a by \c b and a scale factor (in place)
+    static void multiply(FFT::ComplexBatch *a, const FFT::ComplexBatch *b,
+            size_t size, float scale = 1.0f);
+
+    /// Return a human-readable string representation
+    std::string toString() const;
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Virtual destructor
+    virtual ~RealFFT2D() { }
+private:
+    size_t m_width, m_height;
+    size_t m_halfWidth, m_columnBatches;
+    ref<FFT> m_rows, m_cols;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_CORE_FFT_H_ */
@@ -168,8 +168,19 @@ protected:
 
     /// Destruct and unload all plugins
     ~PluginManager();
+
+    /**
+     * \brief Return the plugin with the given name and load
+     * it if necessary. Requires \c m_mutex to be held.
+     */
+    Plugin *getPlugin(const std::string &name);
 private:
     std::map<std::string, Plugin *> m_plugins;
+    /* Most recently requested plugin. Scenes tend to instantiate long
+       runs of objects from the same plugin, for which this avoids
+       repeated lookups in \c m_plugins */
+    std::string m_lastPluginName;
+    Plugin *m_lastPlugin;
     mutable ref<Mutex> m_mutex;
     static ref<PluginManager> m_instance;
 };
@@ -248,7 +248,7 @@ public:
     /// Return a string representation
     std::string toString() const;
 private:
-    std::map<std::string, PropertyElement> *m_elements;
+    std::vector<PropertyElement> *m_elements;
     std::string m_pluginName, m_id;
 };
 
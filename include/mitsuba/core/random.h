@@ -137,6 +137,36 @@ public:
     /// Return a normally distributed value
     Float nextStandardNormal();
 
+    /**
+     * \name Batch generation
+     *
+     * The following functions fill an array with \c count values. They
+     * consume the generator's output in exactly the same way as the
+     * corresponding number of calls to the scalar versions, but copy and
+     * convert whole blocks of the SFMT state (using SSE2 if available).
+     *
+     * \remark These functions are currently not exposed
+     * by the Python bindings
+     * @{
+     */
+
+    /// Fill an array with integers on the [0, 2^64-1]-interval
+    void nextULong(uint64_t *dest, size_t count);
+
+    /// Fill an array with integers on the [0, n)-interval
+    void nextUInt(uint32_t *dest, size_t count, uint32_t n);
+
+    /// Fill an array with floating point values on the [0, 1) interval
+    void nextFloat(Float *dest, size_t count);
+
+    /// Fill an array with single precision values on the [0, 1) interval
+    void nextSingle(float *dest, size_t count);
+
+    /// Fill an array with double precision values on the [0, 1) interval
+    void nextDouble(double *dest, size_t count);
+
+    /// @}
+
     /**
      * \brief Draw a uniformly distributed permutation and permute the
      * given STL container.
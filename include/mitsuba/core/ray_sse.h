@@ -27,6 +27,7 @@
 #include <mitsuba/core/platform.h>
 #include <mitsuba/core/sse.h>
 #include <mitsuba/core/ray.h>
+#include <mitsuba/core/transform.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -87,6 +88,99 @@ struct Intersection4 {
     }
 };
 
+/**
+ * \brief SIMD quad-packed ray differential in SoA layout
+ *
+ * Used by sensors to generate batches of primary rays, see
+ * \ref Sensor::sampleRayDifferentials().
+ */
+struct RayDifferentialPacket4 {
+    QuadVector o, d;
+    QuadVector rxOrigin, ryOrigin;
+    QuadVector rxDirection, ryDirection;
+    SSEVector mint, maxt, time;
+
+    inline RayDifferentialPacket4() {
+    }
+
+    /// Write the first \c count rays of the packet into an array
+    inline void store(RayDifferential *rays, size_t count) const {
+        QuadVector dRcp;
+        for (int axis=0; axis<3; axis++)
+            dRcp[axis].ps = _mm_div_ps(SSEConstants::one.ps, d[axis].ps);
+
+        for (size_t i=0; i<count; i++) {
+            RayDifferential &ray = rays[i];
+            for (int axis=0; axis<3; axis++) {
+                ray.o[axis] = o[axis].f[i];
+                ray.d[axis] = d[axis].f[i];
+                ray.dRcp[axis] = dRcp[axis].f[i];
+                ray.rxOrigin[axis] = rxOrigin[axis].f[i];
+                ray.ryOrigin[axis] = ryOrigin[axis].f[i];
+                ray.rxDirection[axis] = rxDirection[axis].f[i];
+                ray.ryDirection[axis] = ryDirection[axis].f[i];
+            }
+            ray.mint = mint.f[i];
+            ray.maxt = maxt.f[i];
+            ray.time = time.f[i];
+            ray.hasDifferentials = true;
+        }
+    }
+};
+
+/**
+ * \brief Apply a (projective) transformation to four points
+ *
+ * Performs the same operations as \ref Transform::operator()(const Point &)
+ * and thus produces identical results. \c result may alias \c p.
+ */
+inline void transformPoint4(const Matrix4x4 &m, const QuadVector &p, QuadVector &result) {
+    SSEVector tmp[4];
+    for (int i=0; i<4; i++)
+        tmp[i].ps = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_set1_ps(m.m[i][0]), p[0].ps),
+            _mm_mul_ps(_mm_set1_ps(m.m[i][1]), p[1].ps)),
+            _mm_mul_ps(_mm_set1_ps(m.m[i][2]), p[2].ps)),
+            _mm_set1_ps(m.m[i][3]));
+    __m128 invW = _mm_div_ps(SSEConstants::one.ps, tmp[3].ps);
+    for (int i=0; i<3; i++)
+        result[i].ps = _mm_mul_ps(tmp[i].ps, invW);
+}
+
+/// Apply an affine transformation to four points (\c result may alias \c p)
+inline void transformAffine4(const Matrix4x4 &m, const QuadVector &p, QuadVector &result) {
+    SSEVector tmp[3];
+    for (int i=0; i<3; i++)
+        tmp[i].ps = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_set1_ps(m.m[i][0]), p[0].ps),
+            _mm_mul_ps(_mm_set1_ps(m.m[i][1]), p[1].ps)),
+            _mm_mul_ps(_mm_set1_ps(m.m[i][2]), p[2].ps)),
+            _mm_set1_ps(m.m[i][3]));
+    for (int i=0; i<3; i++)
+        result[i] = tmp[i];
+}
+
+/// Apply a transformation to four vectors (\c result may alias \c v)
+inline void transformVector4(const Matrix4x4 &m, const QuadVector &v, QuadVector &result) {
+    SSEVector tmp[3];
+    for (int i=0; i<3; i++)
+        tmp[i].ps = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_set1_ps(m.m[i][0]), v[0].ps),
+            _mm_mul_ps(_mm_set1_ps(m.m[i][1]), v[1].ps)),
+            _mm_mul_ps(_mm_set1_ps(m.m[i][2]), v[2].ps));
+    for (int i=0; i<3; i++)
+        result[i] = tmp[i];
+}
+
+/// Normalize four vectors (matches \ref normalize() exactly)
+inline void normalize4(QuadVector &v) {
+    __m128 invLength = _mm_div_ps(SSEConstants::one.ps, _mm_sqrt_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(v[0].ps, v[0].ps),
+        _mm_mul_ps(v[1].ps, v[1].ps)), _mm_mul_ps(v[2].ps, v[2].ps))));
+    for (int i=0; i<3; i++)
+        v[i].ps = _mm_mul_ps(v[i].ps, invLength);
+}
+
 MTS_NAMESPACE_END
 
 #endif /* __MITSUBA_CORE_RAY_SSE_H_ */
@@ -433,6 +433,30 @@ template <typename Scalar> struct Resampler {
         }
     }
 
+    /// Return the number of source samples that contribute to each target sample
+    inline int getTaps() const { return m_taps; }
+
+    /**
+     * \brief Return the \ref getTaps() normalized filter weights of target sample \c i
+     *
+     * This is useful when the source samples are not available as one
+     * contiguous array (e.g. when resampling a streamed image vertically).
+     *
+     * \param start
+     *     Used to return the index of the source sample associated with
+     *     the first weight. The range may extend beyond the source domain,
+     *     in which case the caller must apply the boundary condition.
+     */
+    inline const Scalar *getWeights(int i, int &start) const {
+        if (m_start) {
+            start = m_start[i];
+            return m_weights + i * m_taps;
+        } else {
+            start = i - m_halfTaps;
+            return m_weights;
+        }
+    }
+
 private:
     FINLINE Scalar lookup(const Scalar *source, int pos, size_t stride, int offset) const {
         if (EXPECT_NOT_TAKEN(pos < 0 || pos >= m_sourceRes)) {
@@ -925,6 +925,63 @@ protected:
     static Spectrum CIE_D65;
 };
 
+/**
+ * \brief Set of wavelengths that is carried along a single light path
+ * (hero wavelength sampling)
+ *
+ * Instead of tracking the full spectrum, a light path can be restricted to
+ * a few wavelengths: one "hero" wavelength is chosen uniformly at random,
+ * and the remaining ones are obtained by rotating it through the visible
+ * range with equidistant offsets (Wilkie et al. 2014). The radiance at
+ * these wavelengths is stored in the components of an ordinary
+ * \ref Spectrum, hence a path costs the same as in the RGB version of the
+ * renderer.
+ *
+ * Spectra provided by the scene (i.e. RGB values or discretized spectra,
+ * depending on the build configuration) are mapped onto the packet using
+ * \ref upsample(). Note that this happens after the scene has evaluated
+ * them, i.e. BSDFs and textures are not evaluated at the packet's
+ * wavelengths. At the end of the path, \ref toSpectrum() turns the
+ * per-wavelength radiance into an unbiased estimate of the spectrum in the
+ * renderer's representation (via CIE XYZ in the RGB case). In the RGB case,
+ * colors outside of the RGB gamut produce estimates with negative
+ * components.
+ *
+ * \ingroup libcore
+ */
+struct MTS_EXPORT_CORE WavelengthPacket {
+    /// Wavelengths (in nanometers) carried by the packet, hero wavelength first
+    Float lambda[SPECTRUM_SAMPLES];
+
+    /// Choose a hero wavelength based on a uniform variate and rotate it
+    void sample(Float sample);
+
+    /**
+     * \brief Evaluate a spectrum at the wavelengths of the packet
+     *
+     * In the RGB build, this uses the same Smits-style upsampling as
+     * \ref Spectrum::fromLinearRGB() in spectral builds, evaluated only at
+     * the packet's wavelengths.
+     */
+    Spectrum upsample(const Spectrum &spec,
+        Spectrum::EConversionIntent intent = Spectrum::EReflectance) const;
+
+    /// Convert radiance values at the packet's wavelengths into a \ref Spectrum
+    Spectrum toSpectrum(const Spectrum &values) const;
+
+    /// Return a string representation
+    std::string toString() const;
+
+#if SPECTRUM_SAMPLES == 3
+private:
+    /// Color matching functions at \c lambda (divided by the sample density)
+    Float m_xyz[3][SPECTRUM_SAMPLES];
+    /// Smits basis spectra at \c lambda (white, cyan, magenta, yellow, red, green, blue)
+    Float m_refl[7][SPECTRUM_SAMPLES];
+    Float m_illum[7][SPECTRUM_SAMPLES];
+#endif
+};
+
 MTS_NAMESPACE_END
 
 #endif /* __MITSUBA_CORE_SPECTRUM_H_ */
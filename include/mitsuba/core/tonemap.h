@@ -0,0 +1,139 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_CORE_TONEMAP_H_)
+#define __MITSUBA_CORE_TONEMAP_H_
+
+#include <mitsuba/core/bitmap.h>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Vectorized tonemapping kernels
+ *
+ * These functions turn linear single precision data into 8-bit display
+ * values: they apply an exposure multiplier or Reinhard et al.'s global
+ * photographic operator, followed by the sRGB transfer curve or a gamma
+ * curve, and quantize the result. They also compute the luminance
+ * statistics needed by the Reinhard operator.
+ *
+ * The kernels process blocks of pixels in SoA form using 4-wide SSE2
+ * vectors when Mitsuba is compiled with \c MTS_SSE, and fall back to
+ * equivalent scalar code otherwise. There are no AVX variants: none of the
+ * build configurations enable AVX, and the vectorized \c log/\c exp
+ * helpers in <tt>mitsuba/core/ssemath.h</tt> only exist for SSE2. The
+ * transfer curves are evaluated using rational and polynomial
+ * approximations whose error is below one 8-bit quantization step. The
+ * data needs no particular alignment.
+ *
+ * Supported pixel formats are \ref Bitmap::ELuminance,
+ * \ref Bitmap::ELuminanceAlpha, \ref Bitmap::ERGB and \ref Bitmap::ERGBA.
+ * In RGB mode (<tt>SPECTRUM_SAMPLES == 3</tt>), the spectral formats are
+ * additionally accepted as sources, which includes the weighted format
+ * used by image blocks.
+ *
+ * \ref Bitmap::convert() and \ref FormatConverter automatically use these
+ * kernels for float32 to uint8 conversions between such formats, and
+ * \ref Bitmap::tonemapReinhard() uses them for float32 images.
+ *
+ * \ingroup libcore
+ */
+namespace tonemap {
+    /// Parameters of \ref tonemap::toDisplay()
+    struct MTS_EXPORT_CORE Parameters {
+        /// Exposure multiplier, which is applied to the color channels
+        Float multiplier;
+
+        /**
+         * \brief Reinhard operator: <tt>key / logAvgLuminance</tt>.
+         * A value <tt><= 0</tt> disables the operator
+         */
+        Float scale;
+
+        /// Reinhard operator: inverse of the squared white point
+        Float invWp2;
+
+        /// Inverse of the display gamma (-1: use the sRGB transfer curve)
+        Float invGamma;
+
+        /// Create a parameter set for a plain sRGB conversion
+        inline Parameters(Float multiplier = 1.0f, Float invGamma = -1.0f)
+            : multiplier(multiplier), scale(0.0f), invWp2(0.0f), invGamma(invGamma) { }
+
+        /**
+         * \brief Enable the Reinhard operator
+         *
+         * The \c key and \c burn parameters have the same meaning as in
+         * \ref Bitmap::tonemapReinhard(). The luminance statistics must
+         * refer to the image after multiplication by \ref multiplier.
+         *
+         * \remark The operator uses the BT.709 luminance weights, like
+         * \ref Spectrum::getLuminance(). The tonemapper that previously
+         * lived in the GUI used the weights 0.358/0.715/0.119 instead,
+         * which overestimated the luminance of red and blue. Reinhard
+         * previews of saturated red and blue colors are therefore somewhat
+         * brighter than before.
+         */
+        void setReinhard(Float key, Float burn,
+            Float logAvgLuminance, Float maxLuminance);
+    };
+
+    /// Can \ref toDisplay() convert between the given pixel formats?
+    extern MTS_EXPORT_CORE bool isSupported(Bitmap::EPixelFormat sourceFormat,
+        Bitmap::EPixelFormat destFormat);
+
+    /**
+     * \brief Tonemap \c count pixels and quantize them to 8 bit
+     *
+     * Luminance is computed from RGB data using the ITU-R Rec. BT.709
+     * weights, and a missing alpha channel is set to one. The alpha
+     * channel is only clamped and quantized.
+     */
+    extern MTS_EXPORT_CORE void toDisplay(const float *source,
+        Bitmap::EPixelFormat sourceFormat, uint8_t *dest,
+        Bitmap::EPixelFormat destFormat, size_t count,
+        const Parameters &params);
+
+    /**
+     * \brief Compute the log-average and maximum luminance of \c count
+     * pixels after scaling them by \c multiplier
+     *
+     * Negative and NaN luminances are counted as zero. The same applies to
+     * the (unscaled) value 1024, which is used by the "rendered by Mitsuba"
+     * banner. The log-average is computed as <tt>exp(mean(log(1e-3 + L)))</tt>.
+     */
+    extern MTS_EXPORT_CORE void getLuminanceStatistics(const float *data,
+        Bitmap::EPixelFormat format, size_t count, Float multiplier,
+        Float &logAvgLuminance, Float &maxLuminance);
+
+    /**
+     * \brief Apply the Reinhard operator to linear data in place
+     *
+     * Since the operator only rescales luminance, this multiplies the
+     * color channels of each pixel by <tt>L'/L</tt>, which is equivalent to
+     * the round trip through xyY. The alpha channel is left untouched.
+     */
+    extern MTS_EXPORT_CORE void applyReinhard(float *data,
+        Bitmap::EPixelFormat format, size_t count,
+        Float scale, Float invWp2);
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_CORE_TONEMAP_H_ */
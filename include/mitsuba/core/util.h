@@ -104,6 +104,67 @@ extern MTS_EXPORT_CORE void * __restrict allocAligned(size_t size);
 /// Free an aligned region of memory
 extern MTS_EXPORT_CORE void freeAligned(void *ptr);
 
+/**
+ * \brief Policies for backing large allocations with huge pages
+ *
+ * Acceleration structures, mesh buffers and MIP maps of very large
+ * scenes can span many gigabytes, in which case the regular 4 KiB pages
+ * lead to frequent TLB misses during traversal. The allocation functions
+ * below can optionally request 2 MiB pages from the operating system.
+ *
+ * \sa setHugePagePolicy(), allocAlignedLarge()
+ */
+enum EHugePagePolicy {
+    /// Only use the regular page size (default)
+    EHugePagesNone = 0,
+
+    /// Request transparent huge pages using \c madvise()
+    EHugePagesTransparent,
+
+    /**
+     * \brief Try to allocate from the pool of explicitly reserved
+     * huge pages (\c MAP_HUGETLB) first. Falls back to transparent huge
+     * pages when the pool is exhausted.
+     */
+    EHugePagesExplicit
+};
+
+/// Set the huge page policy used by \ref allocAlignedLarge()
+extern MTS_EXPORT_CORE void setHugePagePolicy(EHugePagePolicy policy);
+
+/// Return the huge page policy used by \ref allocAlignedLarge()
+extern MTS_EXPORT_CORE EHugePagePolicy getHugePagePolicy();
+
+/**
+ * \brief Parse the name of a huge page policy (\c none,
+ * \c transparent or \c explicit, case-insensitive)
+ *
+ * Throws an exception when the name is not recognized.
+ */
+extern MTS_EXPORT_CORE EHugePagePolicy parseHugePagePolicy(const std::string &name);
+
+/**
+ * \brief Allocate an aligned region of memory that will likely be
+ * large and accessed randomly (e.g. kd-tree nodes)
+ *
+ * Depending on the current \ref EHugePagePolicy, the region is backed
+ * by huge pages. When these are unavailable or the allocation is small,
+ * this function silently behaves like \ref allocAligned(). The returned
+ * memory must be released using \ref freeAligned().
+ */
+extern MTS_EXPORT_CORE void * __restrict allocAlignedLarge(size_t size);
+
+/**
+ * \brief Advise the operating system to back an existing memory
+ * region with huge pages according to the current policy.
+ *
+ * This is meant for buffers that were not allocated using \ref
+ * allocAlignedLarge() (e.g. arrays created using <tt>new[]</tt>).
+ * Only the part of the region that covers complete huge pages is
+ * affected. Does nothing when huge pages are disabled or unsupported.
+ */
+extern MTS_EXPORT_CORE void adviseHugePages(void *ptr, size_t size);
+
 #if defined(WIN32)
 /// Return a string version of GetLastError()
 extern std::string MTS_EXPORT_CORE lastErrorText();
@@ -0,0 +1,148 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_BINSCENE_H_)
+#define __MITSUBA_RENDER_BINSCENE_H_
+
+#include <mitsuba/core/properties.h>
+#include <mitsuba/core/mstream.h>
+
+MTS_NAMESPACE_BEGIN
+
+/// Magic number at the beginning of every binary scene file ("MTSB")
+#define MTS_BINSCENE_MAGIC 0x4253544D
+
+/// Version of the binary scene container format
+#define MTS_BINSCENE_VERSION 1
+
+/**
+ * \brief Writes binary scene files
+ *
+ * A binary scene file is a compact alternative to the XML scene
+ * description, which is meant for very large (typically machine-generated)
+ * scenes. It stores the same object graph that \ref SceneHandler would
+ * construct, but all values are already in their final typed form:
+ * transformations are stored as matrices, colors as discretized spectra,
+ * and references between objects as record indices. Loading such a file
+ * therefore involves no text parsing whatsoever.
+ *
+ * The file consists of a header followed by a sequence of length-prefixed
+ * records (in the order in which the objects must be created, i.e. children
+ * always precede their parents). Each record creates one entry in the
+ * object table. Since the records are self-contained, they can be decoded
+ * in parallel, see \ref BinarySceneLoader.
+ *
+ * Because spectra and transformations are stored in the representation
+ * used by the current build, a file can only be loaded by builds with the
+ * same floating point precision and spectral discretization. Scene
+ * parameters (<tt>$name</tt>) are substituted at conversion time.
+ *
+ * Files are usually created using <tt>mtsutil xml2bin</tt> or
+ * \ref SceneHandler::convertScene().
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER BinarySceneWriter : public Object {
+public:
+    /// Types of records found in a binary scene file
+    enum ERecordType {
+        /// Instantiate a plugin (or the scene) and attach its children
+        EObjectRecord = 0,
+        /// Reference to an earlier object (equivalent to XML's \c ref tag)
+        EReferenceRecord,
+        /// End of the file, specifies the index of the root object
+        EEndRecord
+    };
+
+    /// Flags of an object record
+    enum EObjectFlags {
+        /// Call \ref ConfigurableObject::configure() after construction
+        EConfigure = 0x01
+    };
+
+    /// List of (name, record index) pairs denoting the children of an object
+    typedef std::vector<std::pair<std::string, uint32_t> > ChildList;
+
+    /// Create a new writer and write the file header to \c stream
+    BinarySceneWriter(Stream *stream);
+
+    /**
+     * \brief Append an object record
+     *
+     * \param type
+     *     Base class of the object (e.g. \c Shape), which is verified
+     *     when loading the file. Use \c Scene to create a scene.
+     * \param props
+     *     Plugin name, identifier and parameters of the object
+     * \param children
+     *     Child objects that should be attached to the new object
+     * \param configure
+     *     Should \ref ConfigurableObject::configure() be called?
+     * \return The index of the new record
+     */
+    uint32_t writeObject(const Class *type, const Properties &props,
+        const ChildList &children, bool configure = true);
+
+    /// Append a reference to an earlier record and return its own index
+    uint32_t writeReference(uint32_t index);
+
+    /// Finish the file -- \c root denotes the index of the scene object
+    void finish(uint32_t root);
+
+    /// Return the number of records written so far
+    inline uint32_t getRecordCount() const { return m_recordCount; }
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Virtual destructor
+    virtual ~BinarySceneWriter();
+
+    /// Write the contents of \c m_buffer as a record of the given type
+    void flushRecord(ERecordType type);
+private:
+    ref<Stream> m_stream;
+    ref<MemoryStream> m_buffer;
+    uint32_t m_recordCount;
+};
+
+/**
+ * \brief Loads scenes from the binary format written by
+ * \ref BinarySceneWriter
+ *
+ * The file is memory-mapped and processed in batches of records: each
+ * batch is first decoded into \ref Properties instances using all
+ * available cores, after which its objects are instantiated in file order
+ * on the calling thread, following exactly the same steps as
+ * \ref SceneHandler. Batching keeps the memory used by not yet
+ * instantiated records bounded.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER BinarySceneLoader {
+public:
+    /// Check whether the given file starts with the binary scene header
+    static bool isBinaryScene(const fs::path &filename);
+
+    /// Load a binary scene file
+    static ref<Scene> loadScene(const fs::path &filename);
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_BINSCENE_H_ */
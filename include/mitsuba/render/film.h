@@ -22,6 +22,7 @@
 
 #include <mitsuba/render/sampler.h>
 #include <mitsuba/render/imageblock.h>
+#include <mitsuba/render/imagewriter.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -63,6 +64,19 @@ public:
     /// Develop the film and write the result to the previously specified filename
     virtual void develop(const Scene *scene, Float renderTime) = 0;
 
+    /**
+     * \brief Develop the film and write the result in the background
+     *
+     * This is used for intermediate output while rendering is still in
+     * progress. Films that support it take a snapshot of their contents
+     * and leave the compression and file I/O to an \ref ImageWriter,
+     * so that the caller is not stalled. A subsequent call to
+     * \ref develop() waits until the background write has finished.
+     *
+     * The default implementation simply calls \ref develop().
+     */
+    virtual void developAsync(const Scene *scene, Float renderTime);
+
     /**
      * \brief Develop the contents of a subregion of the film and store
      * it inside the given bitmap
@@ -78,6 +92,19 @@ public:
         const Point2i &targetOffset,
         Bitmap *target) const = 0;
 
+    /**
+     * \brief Write the accumulated contents of the film to a stream
+     *
+     * This is used to save the progress of a render job to a checkpoint
+     * (see \ref Integrator::saveCheckpoint()). The default implementation
+     * raises an exception, which is appropriate for films that do not keep
+     * their contents in memory (e.g. when writing to a tiled EXR image).
+     */
+    virtual void saveState(Stream *stream) const;
+
+    /// Restore the contents of the film from a stream written by \ref saveState()
+    virtual void loadState(Stream *stream);
+
     /// Does the destination file already exist?
     virtual bool destinationExists(const fs::path &basename) const = 0;
 
@@ -126,11 +153,25 @@ protected:
 
     /// Virtual destructor
     virtual ~Film();
+
+    /**
+     * \brief Write a developed bitmap to disk
+     *
+     * When \c async is \c true, the bitmap is handed over to a
+     * background \ref ImageWriter and must not be modified afterwards.
+     * Otherwise, the function waits for pending background writes and
+     * then writes the bitmap on the calling thread.
+     */
+    void writeBitmap(Bitmap *bitmap, Bitmap::EFileFormat format,
+        const fs::path &filename, bool async, int compression = -1);
 protected:
     Point2i m_cropOffset;
     Vector2i m_size, m_cropSize;
     bool m_highQualityEdges;
     ref<ReconstructionFilter> m_filter;
+private:
+    ref<Mutex> m_writerMutex;
+    ref<ImageWriter> m_imageWriter;
 };
 
 MTS_NAMESPACE_END
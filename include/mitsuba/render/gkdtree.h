@@ -138,7 +138,7 @@ public:
             m_minAllocation);
 
         Chunk chunk;
-        chunk.start = (uint8_t *) allocAligned(allocSize);
+        chunk.start = (uint8_t *) allocAlignedLarge(allocSize);
         chunk.cur = chunk.start + size;
         chunk.size = allocSize;
         m_chunks.push_back(chunk);
@@ -750,7 +750,7 @@ public:
      */
     virtual ~GenericKDTree() {
         if (m_indices)
-            delete[] m_indices;
+            freeAligned(m_indices);
         if (m_nodes)
             freeAligned(m_nodes-1); // undo alignment shift
     }
@@ -1110,9 +1110,10 @@ protected:
         m_indexCount = ctx.primIndexCount;
 
         // +1 shift is for alignment purposes (see KDNode::getSibling)
-        m_nodes = static_cast<KDNode *> (allocAligned(
+        m_nodes = static_cast<KDNode *> (allocAlignedLarge(
                 sizeof(KDNode) * (m_nodeCount+1)))+1;
-        m_indices = new IndexType[m_indexCount];
+        m_indices = static_cast<IndexType *> (allocAlignedLarge(
+                sizeof(IndexType) * m_indexCount));
 
         /* The following code rewrites all tree nodes with proper relative
            indices. It also computes the final tree cost and some other
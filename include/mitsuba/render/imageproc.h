@@ -21,6 +21,7 @@
 #define __MITSUBA_RENDER_IMAGEPROC_H_
 
 #include <mitsuba/core/sched.h>
+#include <mitsuba/core/timer.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -30,6 +31,16 @@ MTS_NAMESPACE_BEGIN
  * is independent. For preview purposes, a spiraling pattern of square
  * pixel blocks is generated.
  *
+ * In \a adaptive mode, the process additionally keeps track of how long
+ * each block took and hands out the blocks that are expected to be the most
+ * expensive first. The cost of a block that has not been processed yet is
+ * predicted from its neighbors, since expensive image regions (e.g. caustics
+ * or hair) tend to span several blocks. Blocks that are still being processed
+ * contribute the time spent on them so far. Towards the end, when fewer blocks
+ * are left than there are cores, the remaining blocks are split in half
+ * (down to a quarter of the block size) so that all cores stay busy. This
+ * requires subclasses to call \ref blockFinished() once a block is done.
+ *
  * \ingroup librender
  */
 class MTS_EXPORT_RENDER BlockedImageProcess : public ParallelProcess {
@@ -54,11 +65,43 @@ protected:
      *    Size of the image region to be processed
      * \param blockSize
      *    Size of the generated square pixel blocks
+     * \param adaptive
+     *    Order and split the blocks based on their measured cost?
      */
-    void init(const Point2i &offset, const Vector2i &size, uint32_t blockSize);
+    void init(const Point2i &offset, const Vector2i &size,
+        uint32_t blockSize, bool adaptive = false);
+
+    /**
+     * \brief Notify the process that the work unit covering the given
+     * region has been processed
+     *
+     * In adaptive mode, this updates the cost estimates. Once the entire
+     * image is done, a summary of the core utilization is logged.
+     *
+     * \param renderTime
+     *    Time in seconds that the cores spent on the block. By default,
+     *    the time since the block was handed out is used, which is not
+     *    accurate when several workers shared the block.
+     * \return The number of pixels that have been processed so far
+     */
+    size_t blockFinished(const Point2i &offset, const Vector2i &size,
+        Float renderTime = -1);
+
+    /**
+     * \brief Mark a region as processed before any work has been handed out
+     *
+     * The region is cut out of the pending blocks, e.g. when resuming from
+     * a checkpoint. Must be called after \ref init().
+     *
+     * \return The number of pixels that have been processed so far
+     */
+    size_t skipRegion(const Point2i &offset, const Vector2i &size);
+
+    /// Return the total number of pixels to be processed
+    inline size_t getPixelCount() const { return (size_t) m_size.x * (size_t) m_size.y; }
 
     /// Protected constructor
-    inline BlockedImageProcess() { }
+    inline BlockedImageProcess() : m_adaptive(false), m_unitsPerBlock(1) { }
     /// Virtual destructor
     virtual ~BlockedImageProcess() { }
 protected:
@@ -69,6 +112,50 @@ protected:
         EUp
     };
 
+    /// A pending pixel block
+    struct Block {
+        Point2i offset;
+        Vector2i size;
+        /// Index of the enclosing block on the original grid
+        int cell;
+        /// Position in the spiral (used to break ties)
+        int index;
+        /// Time at which the block was handed out
+        Float issueTime;
+        /// Sort key of the block in the adaptive queues
+        Float key;
+    };
+
+    /// Entry of the adaptive queues, which are sorted by decreasing key
+    struct QueueEntry {
+        Float key;
+        int index;
+        int id;
+
+        inline bool operator<(const QueueEntry &entry) const {
+            if (key != entry.key)
+                return key > entry.key;
+            if (index != entry.index)
+                return index < entry.index;
+            return id < entry.id;
+        }
+    };
+
+    /// Add a pending block to the adaptive queues
+    void enqueue(const Block &block);
+
+    /// Remove the pending block with the given ID from the adaptive queues
+    Block dequeue(int id);
+
+    /// Insert a pending block with a known ID into the appropriate queue
+    void insertQueueEntry(int id);
+
+    /// Remove a pending block with a known ID from its queue
+    void removeQueueEntry(int id);
+
+    /// Propagate a (lower bound on the) cost per pixel to the neighbors of a cell
+    void updateEstimates(int cell, Float costPerPixel);
+
     Point2i m_offset;
     Vector2i m_size, m_numBlocks;
     Point2i m_curBlock;
@@ -76,6 +163,32 @@ protected:
     int m_stepsLeft, m_numBlocksTotal;
     int m_numBlocksGenerated;
     int m_blockSize;
+
+    /* Adaptive block scheduling */
+    bool m_adaptive;
+    /// Pending blocks in spiral order (until the adaptive queues take over)
+    std::vector<Block> m_pending;
+    /**
+     * In adaptive mode, the pending blocks are stored in \c m_blocks and
+     * queued by their cost once the process has started. The cost of a
+     * block without an estimate is the mean cost per pixel times its
+     * area, hence these are kept in a separate queue sorted by area.
+     */
+    std::vector<Block> m_blocks;
+    std::vector<int> m_freeBlocks;
+    std::vector<std::vector<int> > m_cellBlocks;
+    std::set<QueueEntry> m_estimatedQueue, m_unestimatedQueue;
+    double m_estimatedQueueCost;
+    size_t m_unestimatedQueuePixels;
+    std::vector<Float> m_cellCost, m_cellEstimate;
+    std::map<int, Block> m_running;
+    Float m_costSum, m_busyTime, m_lastIssueTime;
+    size_t m_costCount, m_pixelsFinished, m_coreCount;
+    int m_numSplits;
+    /// Number of work units that a subclass makes out of each block
+    size_t m_unitsPerBlock;
+    ref<Timer> m_timer;
+    ref<Mutex> m_mutex;
 };
 
 MTS_NAMESPACE_END
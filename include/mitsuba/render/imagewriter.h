@@ -0,0 +1,95 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_IMAGEWRITER_H_)
+#define __MITSUBA_RENDER_IMAGEWRITER_H_
+
+#include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/lock.h>
+#include <mitsuba/core/thread.h>
+#include <boost/filesystem.hpp>
+#include <deque>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Background thread that compresses and writes bitmaps to disk
+ *
+ * Films use this class to write intermediate images (e.g. the periodic
+ * output requested using <tt>mitsuba -r</tt>) without blocking the
+ * caller while the image is being compressed. The caller hands over a
+ * private snapshot of the image, which must not be modified afterwards.
+ *
+ * When a new request refers to a file that is still waiting in the
+ * queue, the older snapshot is simply replaced -- a slow disk thus never
+ * causes a backlog of stale images.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER ImageWriter : public Thread {
+public:
+    /// Create a new image writer (call \ref start() before use)
+    ImageWriter();
+
+    /**
+     * \brief Queue a bitmap for writing and return immediately
+     *
+     * \param bitmap
+     *     Image to be written. The writer keeps a reference, hence the
+     *     caller must not modify the bitmap after this call.
+     * \param format
+     *     Target file format
+     * \param filename
+     *     Target file name
+     * \param compression
+     *     Compression level, see \ref Bitmap::write()
+     */
+    void write(Bitmap *bitmap, Bitmap::EFileFormat format,
+        const fs::path &filename, int compression = -1);
+
+    /// Block until all queued images have been written
+    void wait();
+
+    /// Write the remaining images and stop the writer thread
+    void quit();
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Virtual destructor
+    virtual ~ImageWriter();
+
+    /// Thread body
+    void run();
+private:
+    struct Request {
+        ref<Bitmap> bitmap;
+        Bitmap::EFileFormat format;
+        fs::path filename;
+        int compression;
+    };
+
+    ref<Mutex> m_mutex;
+    ref<ConditionVariable> m_cond;
+    std::deque<Request> m_queue;
+    bool m_busy, m_quit;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_IMAGEWRITER_H_ */
@@ -21,6 +21,7 @@
 #define __MITSUBA_RENDER_INTEGRATOR_H_
 
 #include <mitsuba/core/netobject.h>
+#include <mitsuba/core/lock.h>
 #include <mitsuba/core/properties.h>
 #include <mitsuba/render/shape.h>
 
@@ -106,6 +107,30 @@ public:
      */
     virtual void configureSampler(const Scene *scene, Sampler *sampler);
 
+    /**
+     * \brief Save the progress of a running render job to a checkpoint
+     *
+     * This function is called periodically from a separate thread while
+     * \ref render() is running (see \ref RenderJob::setCheckpoint()). The
+     * state must be consistent, hence implementations may block until the
+     * rendering process reaches a suitable point. The default implementation
+     * does not write anything.
+     *
+     * \return \c true if a checkpoint was written, or \c false if the
+     * integrator does not support checkpoints or has nothing to save yet
+     */
+    virtual bool saveCheckpoint(Stream *stream);
+
+    /**
+     * \brief Resume from a checkpoint written by \ref saveCheckpoint()
+     *
+     * This function is called between \ref preprocess() and \ref render(),
+     * which then continues where the checkpoint left off. Implementations
+     * may keep a reference to \c stream and read it in \ref render().
+     * The default implementation raises an exception.
+     */
+    virtual void loadCheckpoint(Stream *stream);
+
     /**
      * \brief Return the nested integrator (if any)
      *
@@ -394,6 +419,40 @@ public:
         Sampler *sampler, ImageBlock *block, const bool &stop,
         const std::vector< TPoint2<uint8_t> > &points) const;
 
+    /**
+     * \brief Variant of <tt>renderBlock()</tt>, which only takes the
+     * samples with indices in <tt>[sampleStart, sampleEnd)</tt>
+     *
+     * This is used when several workers render disjoint sample subsets
+     * of the same image block (see \ref BlockedRenderProcess::setSampleSplitting()).
+     * The sampler is positioned using \ref Sampler::setSampleIndex(). The
+     * default implementation of <tt>renderBlock()</tt> calls this function
+     * with the full range of samples.
+     */
+    virtual void renderSampleRange(const Scene *scene, const Sensor *sensor,
+        Sampler *sampler, ImageBlock *block, const bool &stop,
+        const std::vector< TPoint2<uint8_t> > &points,
+        size_t sampleStart, size_t sampleEnd) const;
+
+    /**
+     * \brief Can image blocks be split into sample ranges that are
+     * rendered by different workers?
+     *
+     * This is the case by default. Subclasses which override
+     * <tt>renderBlock()</tt> without providing an equivalent
+     * <tt>renderSampleRange()</tt> must return \c false.
+     */
+    virtual bool supportsSampleRanges() const;
+
+    /**
+     * \brief Save the film contents and the list of finished image regions
+     * of the running \ref BlockedRenderProcess to a checkpoint
+     */
+    virtual bool saveCheckpoint(Stream *stream);
+
+    /// Restore the film and only render the unfinished regions in the next call to \ref render()
+    virtual void loadCheckpoint(Stream *stream);
+
     /**
      * <tt>NetworkedObject</tt> implementation:
      * When a parallel rendering process starts, the integrator is
@@ -433,6 +492,10 @@ protected:
 protected:
     /// Used to temporarily cache a parallel process while it is in operation
     ref<ParallelProcess> m_process;
+    /// Protects \ref m_process, which is also accessed by the checkpoint writer
+    ref<Mutex> m_processMutex;
+    /// Checkpoint that the next call to \ref render() should resume from
+    ref<Stream> m_checkpoint;
 };
 
 /*
@@ -0,0 +1,185 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_PROGRESSIVE_H_)
+#define __MITSUBA_RENDER_PROGRESSIVE_H_
+
+#include <mitsuba/render/scene.h>
+#include <mitsuba/render/renderqueue.h>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Progressive CPU preview of a scene
+ *
+ * Renders a sequence of passes with a sampling integrator on a background
+ * thread, each of which is a \ref BlockedRenderProcess. To keep the latency
+ * of the first frame low, the first passes take one sample per pixel at a
+ * reduced resolution, which is doubled from pass to pass. Once the full
+ * resolution is reached, every further pass renders as many new samples
+ * as all previous ones together (using disjoint ranges of the sample
+ * sequence) and is averaged with them, until the sample count of the
+ * scene's sampler has been reached. Integrators that don't support
+ * sample ranges (see \ref SamplingIntegrator::supportsSampleRanges())
+ * render all samples of a pixel in every pass instead, hence their
+ * preview is only refined in terms of its resolution.
+ *
+ * \ref restart() cancels the pass that is currently running and starts
+ * over, e.g. after the camera was moved. The scene and its kd-tree are
+ * reused; only the sensor, film and sampler are recreated for each pass.
+ * \ref pause() and \ref resume() temporarily stop the preview while
+ * keeping the passes that have already been completed.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER ProgressiveRenderer : public Thread {
+public:
+    /// Create a new progressive renderer (call \ref start() to launch it)
+    ProgressiveRenderer();
+
+    /**
+     * \brief Discard the current image and start over
+     *
+     * The state of the scene's sensor (e.g. its transformation and field
+     * of view) and sampler is captured by this function, hence the caller
+     * may modify them afterwards without affecting the preview.
+     *
+     * \param scene
+     *    Scene to be rendered. Its geometry must not be modified while
+     *    the preview is running.
+     * \param integrator
+     *    Integrator used to render the passes
+     * \param sceneResID
+     *    Resource ID of \c scene, or \c -1 if the scene should be
+     *    registered with the scheduler by this class
+     */
+    void restart(Scene *scene, SamplingIntegrator *integrator,
+        int sceneResID = -1);
+
+    /// Stop rendering and release the scene
+    void reset();
+
+    /**
+     * \brief Pause the preview
+     *
+     * The running pass is cancelled and will be rendered again once
+     * \ref resume() is called.
+     */
+    void pause();
+
+    /// Resume the preview after a call to \ref pause()
+    void resume();
+
+    /// Return whether the preview is paused
+    bool isPaused() const;
+
+    /// Terminate the background thread
+    void quit();
+
+    /**
+     * \brief Copy the most recent frame into the given bitmap
+     *
+     * Frames of passes with a reduced resolution are upsampled to the
+     * size of \c target, which should match the crop size of the film.
+     *
+     * \param target
+     *    A bitmap in the format \ref Bitmap::ERGBA / \ref Bitmap::EFloat32
+     * \param frame
+     *    Index of the frame that was previously retrieved (or \c -1).
+     *    It is updated when a newer frame was copied.
+     * \return \c false when there is no newer frame
+     */
+    bool develop(Bitmap *target, int &frame) const;
+
+    /**
+     * \brief Wait until a frame newer than \c frame is available
+     *
+     * \param timeout
+     *    Timeout in milliseconds (\c -1: wait indefinitely)
+     * \return \c false upon timeout
+     */
+    bool waitForFrame(int frame, int timeout = -1) const;
+
+    /// Return a description of the most recent frame for status displays
+    std::string getStatus() const;
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Everything that is captured by \ref restart()
+    struct State {
+        ref<Scene> scene;
+        ref<SamplingIntegrator> integrator;
+        ref<Sampler> sampler;
+        ref<ReconstructionFilter> filter;
+        ref<Medium> medium;
+        Properties sensorProps;
+        Vector2i filmSize, cropSize;
+        Point2i cropOffset;
+        bool highQualityEdges;
+        int sceneResID;
+        /// Number of passes with a reduced resolution
+        int levels;
+    };
+
+    /// A single pass of the preview
+    struct Pass {
+        /// The resolution is reduced by a factor of <tt>2^level</tt>
+        int level;
+        /// Range of sample indices rendered in this pass
+        size_t sampleStart, sampleEnd;
+    };
+
+    /// Virtual destructor
+    virtual ~ProgressiveRenderer();
+
+    /// Main loop of the background thread
+    virtual void run();
+
+    /// Look up the pass with the given index (\c false if there are no more)
+    static bool getPass(const State &state, int index, Pass &pass);
+
+    /// Create a sensor whose film resolution is reduced by a factor of <tt>2^level</tt>
+    static ref<Sensor> createSensor(State &state, int level, Sampler *sampler);
+
+    /**
+     * \brief Render a single pass
+     *
+     * \return The developed image, or \c NULL if the pass was cancelled
+     */
+    ref<Bitmap> renderPass(State &state, const Pass &pass,
+        int generation, int sceneResID, int integratorResID,
+        bool preprocess);
+private:
+    State m_state;
+    ref<RenderQueue> m_queue;
+    ref<ParallelProcess> m_process;
+    int m_passIndex, m_generation;
+    bool m_quit, m_paused;
+
+    /* Results */
+    ref<Bitmap> m_frame;
+    size_t m_frameSamples, m_targetSamples;
+    int m_frameIndex, m_frameLevel;
+    mutable ref<Mutex> m_mutex;
+    mutable ref<ConditionVariable> m_cond, m_frameCond;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_PROGRESSIVE_H_ */
@@ -27,12 +27,18 @@ MTS_NAMESPACE_BEGIN
 /**
  * \brief Work unit that specifies a rectangular region in an image.
  *
+ * Optionally, the work unit can also be restricted to a range of sample
+ * indices, which allows several workers to render disjoint sample subsets
+ * of the same region (see \ref BlockedRenderProcess::setSampleSplitting()).
+ * By default, all samples are taken.
+ *
  * Used for instance in \ref BlockedImageProcess
  * \ingroup librender
  */
 class MTS_EXPORT_RENDER RectangularWorkUnit : public WorkUnit {
 public:
-    inline RectangularWorkUnit() { }
+    inline RectangularWorkUnit() : m_sampleStart(0),
+        m_sampleEnd(std::numeric_limits<size_t>::max()) { }
 
     /* WorkUnit implementation */
     void set(const WorkUnit *wu);
@@ -45,6 +51,28 @@ public:
     inline void setOffset(const Point2i &offset) { m_offset = offset; }
     inline void setSize(const Vector2i &size) { m_size = size; }
 
+    /// Return the index of the first sample to be taken in each pixel
+    inline size_t getSampleStart() const { return m_sampleStart; }
+
+    /// Return the index one past the last sample to be taken in each pixel
+    inline size_t getSampleEnd() const { return m_sampleEnd; }
+
+    /// Does this work unit only cover a subset of the samples?
+    inline bool hasSampleRange() const {
+        return m_sampleEnd != std::numeric_limits<size_t>::max();
+    }
+
+    /// Restrict the work unit to the sample indices <tt>[start, end)</tt>
+    inline void setSampleRange(size_t start, size_t end) {
+        m_sampleStart = start;
+        m_sampleEnd = end;
+    }
+
+    /// Take all samples (this is the default)
+    inline void clearSampleRange() {
+        setSampleRange(0, std::numeric_limits<size_t>::max());
+    }
+
     std::string toString() const;
 
     MTS_DECLARE_CLASS()
@@ -54,6 +82,7 @@ protected:
 private:
     Point2i m_offset;
     Vector2i m_size;
+    size_t m_sampleStart, m_sampleEnd;
 };
 
 MTS_NAMESPACE_END
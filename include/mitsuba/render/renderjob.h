@@ -78,11 +78,30 @@ public:
     inline void flush() { m_scene->flush(m_queue, this); }
 
     /// Cancel a running render job
-    inline void cancel() { m_scene->cancel(); }
+    inline void cancel() { m_interrupted = true; m_scene->cancel(); }
 
     /// Wait for the job to finish and return whether it was successful
     inline bool wait() { join(); return !m_cancelled; }
 
+    /**
+     * \brief Periodically save the progress of the job to a checkpoint file
+     *
+     * The state of the integrator is captured in memory (see
+     * \ref Integrator::saveCheckpoint()) and written to disk by a background
+     * thread, so that rendering is only briefly held up. The file is replaced
+     * atomically, and it is removed once the job has finished successfully
+     * without being cancelled.
+     * Must be called before the job is started.
+     *
+     * \param filename
+     *     Path of the checkpoint file
+     * \param interval
+     *     Time between two checkpoints in seconds (\c 0: don't write any)
+     * \param resume
+     *     Continue from \c filename if it exists
+     */
+    void setCheckpoint(const fs::path &filename, Float interval, bool resume);
+
     /**
      * \brief Are partial results of the rendering process visible, e.g. in
      * a graphical user interface?
@@ -125,6 +144,10 @@ private:
     bool m_ownsSamplerResource;
     bool m_cancelled;
     bool m_interactive;
+    bool m_interrupted;
+    fs::path m_checkpointFile;
+    Float m_checkpointInterval;
+    bool m_resume;
 };
 
 MTS_NAMESPACE_END
@@ -32,6 +32,12 @@ MTS_NAMESPACE_BEGIN
  * Splits an image into independent rectangular pixel regions, which are
  * then rendered in parallel.
  *
+ * When the sampler is deterministic (see \ref Sampler::isDeterministic()),
+ * the blocks are neither reordered nor split based on their measured cost,
+ * and the finished blocks are written to the film in the order in which
+ * they were handed out. Together with the sampler, this makes the rendered
+ * image independent of the number of cores and of the scheduling.
+ *
  * \sa SamplingIntegrator
  * \ingroup librender
  */
@@ -62,6 +68,57 @@ public:
     void setPixelFormat(Bitmap::EPixelFormat pixelFormat,
         int channelCount = -1, bool warnInvalid = false);
 
+    /**
+     * \brief Allow several workers to render disjoint sample ranges
+     * of the same image block
+     *
+     * When an image consists of only a few blocks compared to the number
+     * of cores (e.g. at low resolutions with very high sample counts),
+     * each block is handed out several times, each time with a different
+     * range of sample indices (see \ref RectangularWorkUnit::setSampleRange()).
+     * The partial results of a block are buffered and accumulated in the
+     * order of their sample ranges before being written to the film, hence
+     * the result does not depend on the order in which the workers finish.
+     *
+     * The work processor must honor the sample range, which is the
+     * case for \ref SamplingIntegrator::renderSampleRange().
+     * Disabled by default.
+     */
+    void setSampleSplitting(bool enabled);
+
+    /**
+     * \brief Only take the samples with indices in <tt>[start, end)</tt>
+     *
+     * This is used to render an image in several passes that refine
+     * each other (e.g. for a progressive preview), in which case every
+     * pass covers a different range of the sampler's sample sequence.
+     * The work processor must honor the sample range, which is only the
+     * case for integrators whose \ref SamplingIntegrator::supportsSampleRanges()
+     * returns \c true. By default, all samples are taken.
+     */
+    void setSampleRange(size_t start, size_t end);
+
+    /**
+     * \brief Write the contents of the film and the list of image regions
+     * that are done to a checkpoint
+     *
+     * Blocks that are still being rendered are not part of the checkpoint.
+     *
+     * \return \c false if the process was cancelled, in which case the
+     * film may contain incomplete blocks
+     */
+    bool saveCheckpoint(Stream *stream);
+
+    /**
+     * \brief Continue from a checkpoint written by \ref saveCheckpoint()
+     *
+     * Restores the film contents and only renders the regions that were
+     * not done yet. Must be called after the resources have been bound and
+     * before the process is scheduled. When the sampler is deterministic,
+     * the result is identical to that of an uninterrupted render.
+     */
+    void loadCheckpoint(Stream *stream);
+
     // ======================================================================
     //! @{ \name Implementation of the ParallelProcess interface
     // ======================================================================
@@ -78,18 +135,75 @@ public:
 protected:
     /// Virtual destructor
     virtual ~BlockedRenderProcess();
+
+    /// Buffered parts of a block that was split into sample ranges
+    struct PartialBlock {
+        /// Partial results ordered by their first sample index
+        std::map<size_t, ref<ImageBlock> > parts;
+        /// Total time spent by the workers on the block
+        Float renderTime;
+
+        inline PartialBlock() : renderTime(0) { }
+    };
+
+    /// Finished block that waits for its predecessors (deterministic mode)
+    struct FinishedBlock {
+        ref<ImageBlock> block;
+        bool cancelled;
+    };
+
+    /**
+     * \brief Accumulate the parts of a block and write the result
+     * to the film (see \ref putBlock())
+     */
+    void flushBlock(PartialBlock &partial, bool cancelled,
+        std::vector<FinishedBlock> &written);
+
+    /**
+     * \brief Write a finished block to the film
+     *
+     * In deterministic mode, the block is held back until all blocks that
+     * were handed out before it have been written (or the rendering was
+     * cancelled). Hence, \c block must not be reused by the caller.
+     * The blocks that were written are appended to \c written.
+     */
+    void putBlock(ImageBlock *block, bool cancelled,
+        std::vector<FinishedBlock> &written);
+
+    /// Deterministic mode: remember the output position of a newly issued block
+    void recordOrder(const Point2i &offset);
+
+    /// Write a block to the film and remember its region for checkpoints
+    void writeBlock(const ImageBlock *block, bool cancelled);
 protected:
     ref<RenderQueue> m_queue;
     ref<Scene> m_scene;
     ref<Film> m_film;
     const RenderJob *m_parent;
-    int m_resultCount;
     ref<Mutex> m_resultMutex;
     ProgressReporter *m_progress;
     int m_borderSize;
     Bitmap::EPixelFormat m_pixelFormat;
     int m_channelCount;
     bool m_warnInvalid;
+
+    /* Splitting of blocks into sample ranges */
+    bool m_sampleSplitting;
+    size_t m_sampleCount, m_sampleStart, m_sampleEnd;
+    int m_sampleParts, m_currentPart;
+    Point2i m_currentOffset;
+    Vector2i m_currentSize;
+    std::map<int, PartialBlock> m_partialBlocks;
+
+    /* Writing the blocks in a fixed order */
+    bool m_deterministic;
+    std::map<int, int> m_blockOrder;
+    std::map<int, FinishedBlock> m_finishedBlocks;
+    int m_blocksIssued, m_blocksWritten;
+
+    /* Regions that have been written to the film (for checkpoints) */
+    std::vector<std::pair<Point2i, Vector2i> > m_writtenRegions;
+    bool m_cancelled;
 };
 
 MTS_NAMESPACE_END
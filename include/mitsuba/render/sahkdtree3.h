@@ -307,6 +307,110 @@ protected:
         return foundIntersection;
     }
 
+    /**
+     * \brief Visit all primitives along a ray segment (Havran variant)
+     *
+     * This is the traversal loop of \ref rayIntersectHavran(), except
+     * that it invokes <tt>visitor(primIdx, maxt)</tt> for the primitives
+     * of every leaf on the segment in front-to-back order instead of
+     * searching for the closest intersection. The visitor may shorten the
+     * segment by decreasing \c maxt, and it can end the traversal by
+     * returning \c false. Primitives that overlap several leaves may be
+     * visited more than once.
+     *
+     * \return \c false if the traversal was ended by the visitor
+     */
+    template<typename Visitor> FINLINE
+            bool rayTraverseHavran(const Ray &ray, Float mint, Float maxt,
+            Visitor &visitor) const {
+        KDStackEntryHavran stack[MTS_KD_MAXDEPTH];
+
+        #if defined(MTS_KD_MAILBOX_ENABLED)
+        HashedMailbox mailbox;
+        #endif
+
+        /* Set up the entry point */
+        uint32_t enPt = 0;
+        stack[enPt].t = mint;
+        stack[enPt].p = ray(mint);
+
+        /* Set up the exit point */
+        uint32_t exPt = 1;
+        stack[exPt].t = maxt;
+        stack[exPt].p = ray(maxt);
+        stack[exPt].node = NULL;
+
+        const KDNode * __restrict currNode = m_nodes;
+        while (currNode != NULL) {
+            while (EXPECT_TAKEN(!currNode->isLeaf())) {
+                const Float splitVal = (Float) currNode->getSplit();
+                const int axis = currNode->getAxis();
+                const KDNode * __restrict farChild;
+
+                if (stack[enPt].p[axis] <= splitVal) {
+                    if (stack[exPt].p[axis] <= splitVal) {
+                        currNode = currNode->getLeft();
+                        continue;
+                    }
+                    if (stack[enPt].p[axis] == splitVal) {
+                        currNode = currNode->getRight();
+                        continue;
+                    }
+                    currNode = currNode->getLeft();
+                    farChild = currNode + 1; // getRight()
+                } else {
+                    if (splitVal < stack[exPt].p[axis]) {
+                        currNode = currNode->getRight();
+                        continue;
+                    }
+                    farChild = currNode->getLeft();
+                    currNode = farChild + 1; // getRight()
+                }
+
+                Float distToSplit = (splitVal - ray.o[axis]) * ray.dRcp[axis];
+
+                const uint32_t tmp = exPt++;
+                if (exPt == enPt)
+                    ++exPt;
+
+                KDAssert(exPt < MTS_KD_MAXDEPTH);
+                stack[exPt].prev = tmp;
+                stack[exPt].t = distToSplit;
+                stack[exPt].node = farChild;
+                stack[exPt].p = ray(distToSplit);
+                stack[exPt].p[axis] = splitVal;
+            }
+
+            /* Reached a leaf node */
+            for (IndexType entry=currNode->getPrimStart(),
+                    last = currNode->getPrimEnd(); entry != last; entry++) {
+                const IndexType primIdx = m_indices[entry];
+
+                #if defined(MTS_KD_MAILBOX_ENABLED)
+                if (mailbox.contains(primIdx))
+                    continue;
+                #endif
+
+                if (!visitor(primIdx, maxt))
+                    return false;
+
+                #if defined(MTS_KD_MAILBOX_ENABLED)
+                mailbox.put(primIdx);
+                #endif
+            }
+
+            if (stack[exPt].t > maxt)
+                break;
+
+            /* Pop from the stack and advance to the next node on the interval */
+            enPt = exPt;
+            currNode = stack[exPt].node;
+            exPt = stack[enPt].prev;
+        }
+
+        return true;
+    }
+
     struct RayStatistics {
         bool foundIntersection;
         uint32_t numTraversals;
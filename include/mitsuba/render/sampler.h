@@ -23,6 +23,7 @@
 #include <mitsuba/mitsuba.h>
 #include <mitsuba/core/random.h>
 #include <mitsuba/core/properties.h>
+#include <mitsuba/core/qmc.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -60,6 +61,16 @@ MTS_NAMESPACE_BEGIN
  * \ref next1DArray() and \ref next2DArray() methods allow to do this.
  * See the file \c direct.cpp for an example.
  *
+ * All samplers accept a \c deterministic parameter. When it is set, the
+ * sample values only depend on the pixel and the sample index, but not
+ * on which clone of the sampler rendered which pixel or on the pixels
+ * that were processed before. Pseudorandom
+ * samplers then seed their per-pixel state from the pixel position in
+ * \ref generate() and draw the values of each sample from a hash of the
+ * sample index (see \ref nextKeyed()). The rendering processes also use
+ * this flag to merge their results in a fixed order, so that renderings
+ * on different numbers of cores or machines are bitwise identical.
+ *
  * \ingroup librender
  * \ingroup libpython
  */
@@ -116,6 +127,20 @@ public:
     /// Retrieve the next two component values from the current sample
     virtual Point2 next2D() = 0;
 
+    /**
+     * \brief Skip the next \c count2D 2D values followed by the next
+     * \c count1D 1D values of the current sample
+     *
+     * Afterwards, \ref next1D() and \ref next2D() continue exactly as if
+     * the skipped values had been retrieved. This is used by
+     * \ref SamplingIntegrator::renderSampleRange(), which draws the sensor
+     * samples of several sample indices up front and then rewinds using
+     * \ref setSampleIndex(). The default implementation retrieves and
+     * discards the values, which is only correct for samplers whose values
+     * are reproduced by \ref setSampleIndex().
+     */
+    virtual void skip(size_t count1D, size_t count2D);
+
     /**
      * \brief Retrieve the next 2D array of values from the current sample.
      *
@@ -158,6 +183,9 @@ public:
     /// Return the current sample index
     inline size_t getSampleIndex() const { return m_sampleIndex; }
 
+    /// Are the sample values independent of the scheduling? (see the class description)
+    inline bool isDeterministic() const { return m_deterministic; }
+
     /// Serialize this sampler to a binary data stream
     virtual void serialize(Stream *stream, InstanceManager *manager) const;
 
@@ -171,6 +199,20 @@ protected:
 
     /// Virtual destructor
     virtual ~Sampler();
+
+    /// Deterministic mode: derive the key of the pixel at \c offset
+    void setPixelKey(const Point2i &offset);
+
+    /// Deterministic mode: start the values of sample \ref m_sampleIndex
+    inline void setSampleKey() {
+        m_sampleKey = (uint32_t) sampleTEA(m_pixelKey, (uint32_t) m_sampleIndex, 8);
+        m_keyCounter = 0;
+    }
+
+    /// Deterministic mode: return the next pseudorandom value of the current sample
+    inline Float nextKeyed() {
+        return sampleTEAFloat(m_sampleKey, m_keyCounter++, 8);
+    }
 protected:
     size_t m_sampleCount;
     size_t m_sampleIndex;
@@ -178,6 +220,8 @@ protected:
     std::vector<Float *> m_sampleArrays1D;
     std::vector<Point2 *> m_sampleArrays2D;
     size_t m_dimension1DArray, m_dimension2DArray;
+    bool m_deterministic;
+    uint32_t m_pixelKey, m_sampleKey, m_keyCounter;
 };
 
 MTS_NAMESPACE_END
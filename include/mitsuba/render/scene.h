@@ -140,7 +140,7 @@ public:
     void postprocess(RenderQueue *queue, const RenderJob *job,
         int sceneResID, int sensorResID, int samplerResID);
 
-    /// Write out the current (partially rendered) image
+    /// Write out the current (partially rendered) image in the background
     void flush(RenderQueue *queue, const RenderJob *job);
 
     /**
@@ -1143,6 +1143,22 @@ protected:
     /// Add a shape to the scene
     void addShape(Shape *shape);
     /// \endcond
+
+    /**
+     * \brief Implementation of \ref evalTransmittance() and
+     * \ref evalTransmittanceAll()
+     *
+     * The surfaces along the segment are found using
+     * \ref ShapeKDTree::rayIntersectMulti(), which usually requires only
+     * a single kd-tree traversal regardless of how many index-matched or
+     * \ref BSDF::ENull surfaces are crossed.
+     *
+     * \param specialShapes
+     *    Also intersect the shapes that are kept outside of the kd-tree?
+     */
+    Spectrum evalTransmittanceImpl(const Point &p1, bool p1OnSurface,
+        const Point &p2, bool p2OnSurface, Float time, const Medium *medium,
+        int &interactions, Sampler *sampler, bool specialShapes) const;
 private:
     ref<ShapeKDTree> m_kdtree;
     ref<Sensor> m_sensor;
@@ -25,6 +25,7 @@
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/properties.h>
 #include <mitsuba/core/version.h>
+#include <mitsuba/render/binscene.h>
 #include <boost/unordered_map.hpp>
 #include <stack>
 #include <map>
@@ -71,6 +72,9 @@ private:
 /// Push a cleanup handler to be executed after loading the scene is done
 extern MTS_EXPORT_RENDER void pushSceneCleanupHandler(void (*cleanup)());
 
+/// Execute (and remove) all cleanup handlers registered by the current thread
+extern MTS_EXPORT_RENDER void runSceneCleanupHandlers();
+
 /**
  * \brief XML parser for Mitsuba scene files. To be used with the
  * SAX interface of Xerces-C++.
@@ -84,6 +88,7 @@ class MTS_EXPORT_RENDER SceneHandler : public xercesc::HandlerBase {
 public:
     typedef std::map<std::string, ConfigurableObject *> NamedObjectMap;
     typedef std::map<std::string, std::string, SimpleStringOrdering> ParameterMap;
+    typedef std::vector<std::pair<std::string, ConfigurableObject *> > ChildList;
 
     SceneHandler(const ParameterMap &params, NamedObjectMap *objects = NULL,
             bool isIncludedFile = false);
@@ -97,6 +102,34 @@ public:
     static ref<Scene> loadSceneFromString(const std::string &string,
         const ParameterMap &params= ParameterMap());
 
+    /**
+     * \brief Convert an XML scene description into the binary
+     * scene format (see \ref BinarySceneWriter)
+     *
+     * The conversion only parses the XML file and does not load any
+     * plugins. Included files are inlined into the output.
+     */
+    static void convertScene(const fs::path &xmlFile,
+        const fs::path &binaryFile, const ParameterMap &params= ParameterMap());
+
+    /**
+     * \brief Instantiate a scene object from its parsed description
+     *
+     * This function is shared by the XML and binary scene loaders. It
+     * creates an instance of a plugin with base class \c type (or a
+     * \ref Scene), attaches the given children (releasing the
+     * references held by \c children), optionally calls
+     * \ref ConfigurableObject::configure(), and expands textures.
+     */
+    static ref<ConfigurableObject> createObject(const Class *type,
+        Properties &props, ChildList &children, bool configure = true);
+
+    /**
+     * \brief Record the scene into a binary scene file instead of
+     * instantiating its objects
+     */
+    inline void setBinarySceneWriter(BinarySceneWriter *writer) { m_writer = writer; }
+
     /// Initialize Xerces-C++ (needs to be called once at program startup)
     static void staticInitialization();
 
@@ -133,6 +166,9 @@ protected:
 
     void clear();
 
+    /// Write the current element to the binary scene file
+    ref<ConfigurableObject> recordObject(const Class *type, bool configure);
+
 private:
     /**
      * Enumeration of all possible tags that can be encountered in a
@@ -159,7 +195,7 @@ private:
         ETag tag;
         Properties properties;
         std::map<std::string, std::string> attributes;
-        std::vector<std::pair<std::string, ConfigurableObject *> > children;
+        ChildList children;
     };
 
 
@@ -177,6 +213,8 @@ private:
     Transform m_transform;
     ref<AnimatedTransform> m_animatedTransform;
     bool m_isIncludedFile;
+    ref<BinarySceneWriter> m_writer;
+    ref<ConfigurableObject> m_recordedScene;
 };
 
 MTS_NAMESPACE_END
@@ -197,6 +197,50 @@ public:
         const Point2 &apertureSample,
         Float timeSample) const;
 
+    /**
+     * \brief Sample a batch of rays with differentials
+     *
+     * This function is equivalent to calling \ref sampleRayDifferential()
+     * once for each entry of the given sample arrays. It is used to generate
+     * the primary rays of an image block and avoids one virtual function
+     * call per ray. The perspective, thin lens and orthographic sensors
+     * additionally process the batch in packets of four rays using SSE
+     * when their transformation is not animated.
+     *
+     * The default implementation simply calls
+     * \ref sampleRayDifferential() for each ray.
+     *
+     * \param count
+     *    Number of rays to be generated
+     *
+     * \param samplePositions
+     *    Sample positions in fractional pixel coordinates relative
+     *    to the crop window of the underlying film
+     *
+     * \param apertureSamples
+     *    Uniformly distributed 2D vectors used to sample positions on
+     *    the aperture. May be \c NULL when \ref needsApertureSample()
+     *    == \c false, in which case <tt>(0.5, 0.5)</tt> is used.
+     *
+     * \param timeSamples
+     *    Uniformly distributed 1D values used to sample the time of
+     *    each ray. May be \c NULL when \ref needsTimeSample() == \c false,
+     *    in which case \c 0.5 is used.
+     *
+     * \param rays
+     *    Output array of \c count ray differentials
+     *
+     * \param weights
+     *    Output array of \c count importance weights (see
+     *    \ref sampleRayDifferential())
+     */
+    virtual void sampleRayDifferentials(size_t count,
+        const Point2 *samplePositions,
+        const Point2 *apertureSamples,
+        const Float *timeSamples,
+        RayDifferential *rays,
+        Spectrum *weights) const;
+
     /// Importance sample the temporal part of the sensor response function
     inline Float sampleTime(Float sample) const {
         return m_shutterOpen + m_shutterOpenTime * sample;
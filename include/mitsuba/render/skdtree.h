@@ -37,6 +37,9 @@
 #define MTS_KD_INTERSECTION_TEMP 128
 #endif
 
+/// Maximum number of surfaces reported by \ref ShapeKDTree::rayIntersectMulti()
+#define MTS_KD_MAX_HITS 16
+
 MTS_NAMESPACE_BEGIN
 
 typedef const Shape * ConstShapePtr;
@@ -175,6 +178,62 @@ public:
      */
     bool rayIntersect(const Ray &ray) const;
 
+    /// Surface intersection found by \ref rayIntersectMulti()
+    struct SurfaceHit {
+        /// Distance along the ray
+        Float t;
+        /// Primitive index within the kd-tree
+        IndexType primIdx;
+        /// Temporary data of the intersection test
+        uint8_t temp[MTS_KD_INTERSECTION_TEMP];
+    };
+
+    /**
+     * \brief Find the surfaces along a ray segment using a single
+     * traversal of the kd-tree
+     *
+     * This query is used to compute the transmittance through
+     * index-matched medium boundaries and surfaces with a
+     * \ref BSDF::ENull component. It stops at the first shape whose BSDF
+     * has no such component (an occluder), which is reported as the last
+     * hit: the caller may still skip it when it lies within the ray
+     * epsilon of a preceding surface, as a new ray traced from that
+     * surface would do.
+     *
+     * At most \ref MTS_KD_MAX_HITS of the closest intersections are
+     * reported. Shapes other than triangle meshes (e.g. spheres or
+     * instances) may be intersected multiple times, hence the query
+     * ends at the first intersection with such a shape. In all of these
+     * cases, \c complete is set to \c false, and the caller should
+     * continue with a new query that starts at the last reported hit.
+     *
+     * \param ray
+     *    A 3-dimensional ray data structure with minimum/maximum
+     *    extent information, as well as a time (which applies when
+     *    the shapes are animated)
+     * \param hits
+     *    Storage for \ref MTS_KD_MAX_HITS hits, which will be
+     *    sorted by distance
+     * \param hitCount
+     *    Returns the number of reported hits
+     * \param complete
+     *    Returns whether all surfaces on the segment were reported
+     * \return \c false if the segment is blocked by an occluder
+     *    in front of all other surfaces
+     */
+    bool rayIntersectMulti(const Ray &ray, SurfaceHit *hits,
+        int &hitCount, bool &complete) const;
+
+    /// Is the shape of a hit found by \ref rayIntersectMulti() an occluder?
+    bool isOccluder(const SurfaceHit &hit) const;
+
+    /**
+     * \brief Return the shape, geometric normal and UV coordinates
+     * of a hit found by \ref rayIntersectMulti()
+     */
+    void getSurfaceHitInfo(const Ray &ray, const SurfaceHit &hit,
+        ConstShapePtr &shape, Normal &n, Point2 &uv) const;
+
 #if defined(MTS_HAS_COHERENT_RT)
     /**
      * \brief Intersect four rays with the stored triangle meshes while making
@@ -457,9 +516,15 @@ protected:
         return false;
     }
 
+    /// Compute the shape, normal and UV coordinates from an intersection cache
+    void getIntersectionInfo(const Ray &ray, Float t, const void *temp,
+        ConstShapePtr &shape, Normal &n, Point2 &uv) const;
+
     /// Virtual destructor
     virtual ~ShapeKDTree();
 private:
+    struct SurfaceHitCollector;
+
     std::vector<const Shape *> m_shapes;
     std::vector<bool> m_triangleFlag;
     std::vector<IndexType> m_shapeMap;
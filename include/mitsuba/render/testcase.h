@@ -65,6 +65,26 @@ public:
     /// Return the number of successfully executed testcases
     inline int getSucceeded() const { return m_succeeded; }
 
+    /**
+     * \brief Set the directory where testcases write their output
+     * files (reports, tables of failed tests, etc.)
+     *
+     * This is specified using the '-o' parameter of 'mtsutil'. The
+     * default is a subdirectory named 'testoutput' of the current
+     * working directory.
+     */
+    static void setOutputDirectory(const fs::path &path);
+
+    /// Return the directory where testcases write their output files
+    static const fs::path &getOutputDirectory();
+
+    /**
+     * \brief Return the path of an output file with the given name
+     *
+     * The output directory is created if it does not exist yet
+     */
+    static fs::path getOutputPath(const std::string &filename);
+
     MTS_DECLARE_CLASS()
 protected:
     /// Virtual destructor
@@ -119,6 +139,7 @@ protected:
     void succeed();
 protected:
     int m_executed, m_succeeded;
+    static fs::path m_outputDirectory;
 };
 
 MTS_NAMESPACE_END
@@ -30,6 +30,9 @@
 #include <mitsuba/core/fresolver.h>
 #include <mitsuba/core/fstream.h>
 #include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/mstream.h>
+#include <mitsuba/core/pmf.h>
+#include <mitsuba/core/timer.h>
 #include "irawan.h"
 #include <mitsuba/render/scene.h>
 
@@ -42,6 +45,18 @@ MTS_NAMESPACE_BEGIN
  *     \parameter{repeatU, repeatV}{\Float}{Specifies the number
  *         of weave pattern repetitions over a $[0,1]^2$ region of the UV
  *         parameterization}
+ *     \parameter{tabulated}{\Boolean}{
+ *         When set to \code{true}, the specular component is looked up from
+ *         a table that is precomputed when the scene is loaded, and
+ *         directions are importance sampled using the same table.
+ *         See the discussion below. \default{\code{false}}
+ *     }
+ *     \parameter{tableResolution}{\Integer}{
+ *         Resolution of the table used by the tabulated mode. Outgoing
+ *         directions are discretized into \code{tableResolution}$^2$ cells, and
+ *         incident directions into a grid of half this resolution.
+ *         \default{\code{16}}
+ *     }
  *     \parameter{(\emph{Additional parameters})}{\Spectrum\Or\Float}{
  *         Weave pattern files may define their own custom parameters; this is
  *         useful for instance to support changing the color of a weave
@@ -78,7 +93,168 @@ MTS_NAMESPACE_BEGIN
  *     \unframedmedrendering{Silk shantung}{bsdf_irawan_shantung}
  *     \unframedmedrendering{Cotton twill}{bsdf_irawan_twill}
  * }
+ *
+ * \subsubsection*{Tabulated mode}
+ * The full model is expensive to evaluate, and since it can only be
+ * sampled using cosine-weighted directions, many of the evaluated samples
+ * contribute little. The \code{tabulated} mode trades accuracy for speed:
+ * for every yarn of the weave pattern, it precomputes the specular
+ * response averaged over the yarn segment for a grid of incident and
+ * outgoing directions. Lookups into this table replace the full
+ * evaluation, and the table also serves as a density for sampling the
+ * specular component. The fine-scale highlight structure within each yarn
+ * segment is averaged out in this mode (the per-yarn colors, the
+ * \code{fineness} intensity variation and the
+ * anisotropic shape of the highlights are preserved), so it is best
+ * suited for fabrics that are seen from a moderate distance. The
+ * \code{period}-based variation of the inclination angle is also ignored.
+ *
+ * The tables are built in parallel when the scene is loaded and shared
+ * between all instances that use an identical weave pattern.
+ */
+/**
+ * \brief Tabulated specular component of the Irawan & Marschner model
+ *
+ * For every yarn type of a weave pattern (i.e. every distinct yarn
+ * geometry), this stores the specular integrand averaged over the yarn
+ * segment. Directions are parameterized using the
+ * inverse of the cosine-weighted hemisphere warp, which maps the
+ * hemisphere to the unit square. Outgoing directions use a grid of
+ * <tt>res x res</tt> cells, and incident directions a coarser one. For
+ * each incident cell, the row of outgoing values doubles as a piecewise
+ * constant sampling density.
  */
+class IrawanTable : public Object {
+public:
+    /**
+     * \param yarnTypes
+     *    Maps each yarn of the pattern to its yarn type
+     * \param resolution
+     *    Resolution of the grid of outgoing directions
+     */
+    IrawanTable(const std::vector<int> &yarnTypes, int resolution)
+        : m_yarnTypes(yarnTypes), m_resO(resolution), m_resI(std::max(resolution / 2, 1)) {
+        m_typeCount = 0;
+        for (size_t i=0; i<yarnTypes.size(); ++i)
+            m_typeCount = std::max(m_typeCount, yarnTypes[i] + 1);
+        size_t rows = m_typeCount * m_resI * m_resI;
+        m_values.resize(rows * m_resO * m_resO);
+        m_distributions.resize(rows);
+        m_albedo.resize(rows);
+    }
+
+    /// Return the number of distinct yarn types
+    inline int getYarnTypeCount() const { return m_typeCount; }
+
+    /// Return the number of cells used to discretize incident directions
+    inline int getIncidentCellCount() const { return m_resI * m_resI; }
+
+    /// Return the number of cells used to discretize outgoing directions
+    inline int getOutgoingCellCount() const { return m_resO * m_resO; }
+
+    /// Return the direction at a position within an incident cell
+    inline Vector getIncidentDirection(int cell, const Point2 &offset) const {
+        return cellToDirection(cell, m_resI, offset);
+    }
+
+    /// Return the direction at a position within an outgoing cell
+    inline Vector getOutgoingDirection(int cell, const Point2 &offset) const {
+        return cellToDirection(cell, m_resO, offset);
+    }
+
+    /// Return the values of a yarn type for a given incident cell
+    inline Float *getRow(int type, int cellI) {
+        return &m_values[(type * (size_t) getIncidentCellCount() + cellI)
+            * getOutgoingCellCount()];
+    }
+
+    /// Create the sampling density after \ref getRow() has been filled
+    void finalizeRow(int type, int cellI) {
+        size_t row = type * (size_t) getIncidentCellCount() + cellI;
+        const Float *values = getRow(type, cellI);
+        DiscreteDistribution &distr = m_distributions[row];
+        distr.reserve(getOutgoingCellCount());
+        for (int i=0; i<getOutgoingCellCount(); ++i)
+            distr.append(values[i]);
+        /* Cosine-weighted integral over the hemisphere */
+        m_albedo[row] = distr.normalize() * M_PI / getOutgoingCellCount();
+    }
+
+    /// Look up the averaged specular integrand (bilinear in \c wo)
+    Float eval(int yarn, const Vector &wi, const Vector &wo) const {
+        const Float *values = getRow(yarn, wi);
+        Point2 p = toSquare(wo);
+        Float x = p.x * m_resO - 0.5f, y = p.y * m_resO - 0.5f;
+        int x0 = math::clamp(math::floorToInt(x), 0, std::max(m_resO - 2, 0)),
+            y0 = math::clamp(math::floorToInt(y), 0, std::max(m_resO - 2, 0));
+        int x1 = std::min(x0 + 1, m_resO - 1), y1 = std::min(y0 + 1, m_resO - 1);
+        Float fx = math::clamp(x - x0, (Float) 0, (Float) 1),
+              fy = math::clamp(y - y0, (Float) 0, (Float) 1);
+
+        return (1 - fy) * ((1 - fx) * values[x0 + y0 * m_resO] + fx * values[x1 + y0 * m_resO])
+             +      fy  * ((1 - fx) * values[x0 + y1 * m_resO] + fx * values[x1 + y1 * m_resO]);
+    }
+
+    /// Return the cosine-weighted integral of the tabulated integrand
+    inline Float getAlbedo(int yarn, const Vector &wi) const {
+        return m_albedo[m_yarnTypes[yarn] * (size_t) getIncidentCellCount()
+            + directionToCell(wi, m_resI)];
+    }
+
+    /// Sample an outgoing direction proportional to the tabulated integrand
+    Vector sample(int yarn, const Vector &wi, Point2 sample) const {
+        const DiscreteDistribution &distr = getDistribution(yarn, wi);
+        if (!distr.isNormalized())
+            return Vector(0.0f);
+        int cell = (int) distr.sampleReuse(sample.x);
+        return cellToDirection(cell, m_resO, sample);
+    }
+
+    /// Density of \ref sample() with respect to solid angles
+    Float pdf(int yarn, const Vector &wi, const Vector &wo) const {
+        const DiscreteDistribution &distr = getDistribution(yarn, wi);
+        if (!distr.isNormalized())
+            return 0.0f;
+        return distr[directionToCell(wo, m_resO)] * getOutgoingCellCount()
+            * warp::squareToCosineHemispherePdf(wo);
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~IrawanTable() { }
+
+    static inline Point2 toSquare(const Vector &d) {
+        return warp::uniformDiskToSquareConcentric(Point2(d.x, d.y));
+    }
+
+    static inline int directionToCell(const Vector &d, int res) {
+        Point2 p = toSquare(d);
+        return math::clamp((int) (p.x * res), 0, res - 1)
+            + math::clamp((int) (p.y * res), 0, res - 1) * res;
+    }
+
+    static inline Vector cellToDirection(int cell, int res, const Point2 &offset) {
+        return warp::squareToCosineHemisphere(Point2(
+            ((cell % res) + offset.x) / res, ((cell / res) + offset.y) / res));
+    }
+
+    inline const Float *getRow(int yarn, const Vector &wi) const {
+        return &m_values[(m_yarnTypes[yarn] * (size_t) getIncidentCellCount()
+            + directionToCell(wi, m_resI)) * getOutgoingCellCount()];
+    }
+
+    inline const DiscreteDistribution &getDistribution(int yarn, const Vector &wi) const {
+        return m_distributions[m_yarnTypes[yarn] * (size_t) getIncidentCellCount()
+            + directionToCell(wi, m_resI)];
+    }
+private:
+    std::vector<int> m_yarnTypes;
+    int m_typeCount, m_resO, m_resI;
+    std::vector<Float> m_values;
+    std::vector<DiscreteDistribution> m_distributions;
+    std::vector<Float> m_albedo;
+};
+
 class IrawanClothBRDF : public BSDF {
 public:
     IrawanClothBRDF(const Properties &props)
@@ -112,6 +288,11 @@ public:
         m_repeatU = props.getFloat("repeatU");
         m_repeatV = props.getFloat("repeatV");
 
+        m_tabulated = props.getBoolean("tabulated", false);
+        m_tableResolution = props.getInteger("tableResolution", 16);
+        if (m_tableResolution < 2)
+            Log(EError, "The 'tableResolution' parameter must be at least 2!");
+
         if (props.hasProperty("ksMultiplier") || props.hasProperty("kdMultiplier"))
             Log(EError, "The 'ksMultiplier' and 'kdMultiplier' parameters were "
                 "replaced by a normalization scheme. Please remove them and "
@@ -124,6 +305,8 @@ public:
         m_repeatU = stream->readFloat();
         m_repeatV = stream->readFloat();
         m_specularNormalization = stream->readFloat();
+        m_tabulated = stream->readBool();
+        m_tableResolution = stream->readInt();
         configure();
     }
 
@@ -134,6 +317,8 @@ public:
         stream->writeFloat(m_repeatU);
         stream->writeFloat(m_repeatV);
         stream->writeFloat(m_specularNormalization);
+        stream->writeBool(m_tabulated);
+        stream->writeInt(m_tableResolution);
     }
 
     void configure() {
@@ -145,7 +330,8 @@ public:
 
         /* Estimate the average reflectance under diffuse
            illumination and use it to normalize the specular
-           component */
+           component. This always uses the full model, so that
+           both modes produce the same overall brightness */
         ref<Random> random = new Random();
         size_t nSamples = 10000;
 
@@ -169,20 +355,164 @@ public:
                 m_specularNormalization = nSamples / (result.max() * M_PI);
         }
 
+        if (m_tabulated && !m_table.get())
+            m_table = getTable();
+
         BSDF::configure();
     }
 
     Spectrum getDiffuseReflectance(const Intersection &its) const {
-        Point2 uv = Point2(its.uv.x * m_repeatU,
-            (1 - its.uv.y) * m_repeatV);
+        return m_pattern.yarns.at(getYarnID(its.uv)).kd;
+    }
+
+    /// Return the index of the yarn at a given surface position
+    inline int getYarnID(const Point2 &surfaceUV) const {
+        Point2 uv = Point2(surfaceUV.x * m_repeatU,
+            (1 - surfaceUV.y) * m_repeatV);
         Point2 xy(uv.x * m_pattern.tileWidth, uv.y * m_pattern.tileHeight);
         Point2i lookup(
             math::modulo((int) xy.x, m_pattern.tileWidth),
             math::modulo((int) xy.y, m_pattern.tileHeight));
-        int yarnID = m_pattern.pattern[lookup.x + lookup.y * m_pattern.tileWidth] - 1;
-        const Yarn &yarn = m_pattern.yarns.at(yarnID);
+        return m_pattern.pattern[lookup.x + lookup.y * m_pattern.tileWidth] - 1;
+    }
+
+    /// Return the relative area compensation factor of a yarn
+    inline Float getAreaFactor(const Yarn &yarn) const {
+        if (yarn.type == Yarn::EWarp)
+            return (m_pattern.warpArea + m_pattern.weftArea) / m_pattern.warpArea;
+        else
+            return (m_pattern.warpArea + m_pattern.weftArea) / m_pattern.weftArea;
+    }
+
+    /**
+     * \brief Evaluate the specular integrand of a yarn at the yarn-local
+     * position (u, v) without any noise (used to build the table)
+     */
+    Float evalIntegrand(const Yarn &yarn, Float u, Float v,
+            Vector om_i, Vector om_r) const {
+        if (yarn.type == Yarn::EWeft) {
+            /* Rotate the directions pi/2 radian about z-axis (see eval()) */
+            om_i = Vector(-om_i.y, om_i.x, om_i.z);
+            om_r = Vector(-om_r.y, om_r.x, om_r.z);
+        }
+
+        if (yarn.psi != 0.0f)
+            return evalStapleIntegrand(u, v, om_i, om_r, m_pattern.alpha,
+                    m_pattern.beta, yarn.psi, yarn.umax, yarn.kappa,
+                    yarn.width, yarn.length);
+        else
+            return evalFilamentIntegrand(u, v, om_i, om_r, m_pattern.alpha,
+                    m_pattern.beta, m_pattern.ss, yarn.umax, yarn.kappa,
+                    yarn.width, yarn.length);
+    }
 
-        return yarn.kd;
+    /// Build the table used by the tabulated mode
+    ref<IrawanTable> buildTable() const {
+        ref<Timer> timer = new Timer();
+
+        /* The integrand only depends on the geometry of a yarn, hence
+           yarns that only differ in color or position share their data */
+        std::vector<int> yarnTypes(m_pattern.yarns.size());
+        std::vector<const Yarn *> representatives;
+        for (size_t i=0; i<m_pattern.yarns.size(); ++i) {
+            const Yarn &yarn = m_pattern.yarns[i];
+            size_t j = 0;
+            for (; j<representatives.size(); ++j) {
+                const Yarn &r = *representatives[j];
+                if (r.type == yarn.type && r.psi == yarn.psi && r.umax == yarn.umax
+                    && r.kappa == yarn.kappa && r.width == yarn.width
+                    && r.length == yarn.length)
+                    break;
+            }
+            if (j == representatives.size())
+                representatives.push_back(&yarn);
+            yarnTypes[i] = (int) j;
+        }
+
+        ref<IrawanTable> table = new IrawanTable(yarnTypes, m_tableResolution);
+        int typeCount = table->getYarnTypeCount(),
+            cellsI = table->getIncidentCellCount(),
+            cellsO = table->getOutgoingCellCount();
+
+        /* Stratified positions within the yarn segment, with more strata
+           along the yarn where the highlights are narrow. The integrand
+           has sharp peaks, hence the directions are also jittered within
+           their cells using a low-discrepancy sequence */
+        const int strataU = 24, strataV = 6;
+
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for schedule(dynamic)
+        #endif
+        for (int row=0; row<typeCount * cellsI; ++row) {
+            int type = row / cellsI, cellI = row % cellsI;
+            const Yarn &yarn = *representatives[type];
+            Float *values = table->getRow(type, cellI);
+
+            for (int cellO=0; cellO<cellsO; ++cellO) {
+                Float sum = 0;
+                for (int i=0; i<strataU; ++i) {
+                    Float u = ((i + 0.5f) / strataU * 2 - 1) * yarn.umax;
+                    for (int j=0; j<strataV; ++j) {
+                        Float v = ((j + 0.5f) / strataV - 0.5f) * M_PI;
+                        size_t index = (size_t) (i * strataV + j);
+                        Vector wi = table->getIncidentDirection(cellI,
+                            Point2(radicalInverse(5, index), radicalInverse(7, index)));
+                        Vector wo = table->getOutgoingDirection(cellO,
+                            Point2(radicalInverse(2, index), radicalInverse(3, index)));
+                        sum += evalIntegrand(yarn, u, v, wi, wo);
+                    }
+                }
+                values[cellO] = sum / (strataU * strataV);
+            }
+            table->finalizeRow(type, cellI);
+        }
+
+        Log(EInfo, "Tabulated the weave pattern \"%s\" (%i yarn types, %ix%i cells) in %i ms",
+            m_pattern.name.c_str(), typeCount, cellsI, cellsO, timer->getMilliseconds());
+        return table;
+    }
+
+    /// Fetch the table for this weave pattern from the cache or build it
+    ref<IrawanTable> getTable() const {
+        static ref<Mutex> mutex = new Mutex();
+        static std::map<std::string, ref<IrawanTable> > cache;
+
+        /* Instances with the same pattern and resolution share their table */
+        ref<MemoryStream> mstream = new MemoryStream();
+        m_pattern.serialize(mstream);
+        mstream->writeInt(m_tableResolution);
+        std::string key((const char *) mstream->getData(), mstream->getSize());
+
+        LockGuard lock(mutex);
+        for (std::map<std::string, ref<IrawanTable> >::iterator it = cache.begin();
+                it != cache.end();) {
+            /* Drop tables that are no longer referenced by any instance */
+            if (it->second->getRefCount() == 1)
+                cache.erase(it++);
+            else
+                ++it;
+        }
+
+        ref<IrawanTable> &table = cache[key];
+        if (!table)
+            table = buildTable();
+        return table;
+    }
+
+    /// Probability of sampling the specular component in the tabulated mode
+    inline Float getSpecularSamplingWeight(int yarnID, const Vector &wi,
+            bool hasSpecular, bool hasDiffuse) const {
+        if (!hasSpecular)
+            return 0.0f;
+        const Yarn &yarn = m_pattern.yarns[yarnID];
+        Float specular = m_table->getAlbedo(yarnID, wi) * yarn.ks.average()
+            * m_specularNormalization * getAreaFactor(yarn);
+        Float diffuse = hasDiffuse ? yarn.kd.average() : (Float) 0;
+
+        /* Always keep some cosine-weighted samples for robustness */
+        if (specular + diffuse <= 0)
+            return 0.0f;
+        return std::min(specular / (specular + diffuse), (Float) 0.9f);
     }
 
 
@@ -260,7 +590,7 @@ public:
            quality of the pseudorandom floats) */
         const int teaIterations = 8;
 
-        if (m_pattern.period > 0.0f) {
+        if (m_pattern.period > 0.0f && !m_table.get()) {
             // generate 1 seed per yarn segment
             Point2u pos(center);
 
@@ -282,7 +612,9 @@ public:
         Spectrum result(0.0f);
         if (hasSpecular) {
             Float integrand;
-            if (psi != 0.0f)
+            if (m_table.get())
+                integrand = m_table->eval(yarnID, bRec.wi, bRec.wo);
+            else if (psi != 0.0f)
                 integrand = evalStapleIntegrand(u, v, om_i, om_r, m_pattern.alpha,
                         m_pattern.beta, psi, umax, kappa, w, l);
             else
@@ -306,10 +638,7 @@ public:
             else
                 result = Spectrum(intensityVariation * integrand);
 
-            if (type == Yarn::EWarp)
-                result *= (m_pattern.warpArea + m_pattern.weftArea) / m_pattern.warpArea;
-            else
-                result *= (m_pattern.warpArea + m_pattern.weftArea) / m_pattern.weftArea;
+            result *= getAreaFactor(yarn);
         }
 
         if (hasDiffuse && !m_initialization)
@@ -330,10 +659,23 @@ public:
             measure != ESolidAngle)
             return 0.0f;
 
-        return warp::squareToCosineHemispherePdf(bRec.wo);
+        Float pdf = warp::squareToCosineHemispherePdf(bRec.wo);
+        if (m_table.get()) {
+            int yarnID = getYarnID(bRec.its.uv);
+            Float weight = getSpecularSamplingWeight(yarnID,
+                bRec.wi, hasSpecular, hasDiffuse);
+            pdf = (1 - weight) * pdf
+                + weight * m_table->pdf(yarnID, bRec.wi, bRec.wo);
+        }
+        return pdf;
     }
 
     Spectrum sample(BSDFSamplingRecord &bRec, const Point2 &sample) const {
+        Float pdf;
+        return this->sample(bRec, pdf, sample);
+    }
+
+    Spectrum sample(BSDFSamplingRecord &bRec, Float &pdf, const Point2 &_sample) const {
         bool hasSpecular = (bRec.typeMask & EGlossyReflection) &&
             (bRec.component == -1 || bRec.component == 0);
         bool hasDiffuse = (bRec.typeMask & EDiffuseReflection) &&
@@ -343,30 +685,38 @@ public:
             (!hasDiffuse && !hasSpecular))
             return Spectrum(0.0f);
 
-        /* Lacking a better sampling method, generate cosine-weighted directions */
-        bRec.wo = warp::squareToCosineHemisphere(sample);
         bRec.eta = 1.0f;
         bRec.sampledComponent = 0;
         bRec.sampledType = EGlossyReflection;
-        return eval(bRec, ESolidAngle) * M_PI / Frame::cosTheta(bRec.wo);
-    }
 
-    Spectrum sample(BSDFSamplingRecord &bRec, Float &pdf, const Point2 &sample) const {
-        bool hasSpecular = (bRec.typeMask & EGlossyReflection) &&
-            (bRec.component == -1 || bRec.component == 0);
-        bool hasDiffuse = (bRec.typeMask & EDiffuseReflection) &&
-            (bRec.component == -1 || bRec.component == 1);
+        if (!m_table.get()) {
+            /* Lacking a better sampling method, generate cosine-weighted directions */
+            bRec.wo = warp::squareToCosineHemisphere(_sample);
+            pdf = warp::squareToCosineHemispherePdf(bRec.wo);
+            return eval(bRec, ESolidAngle) / pdf;
+        }
 
-        if (Frame::cosTheta(bRec.wi) <= 0 ||
-            (!hasDiffuse && !hasSpecular))
-            return Spectrum(0.0f);
+        /* Tabulated mode: mixture of the tabulated specular
+           density and cosine-weighted sampling */
+        Point2 sample(_sample);
+        int yarnID = getYarnID(bRec.its.uv);
+        Float weight = getSpecularSamplingWeight(yarnID,
+            bRec.wi, hasSpecular, hasDiffuse);
+
+        if (sample.x < weight) {
+            sample.x /= weight;
+            bRec.wo = m_table->sample(yarnID, bRec.wi, sample);
+            if (Frame::cosTheta(bRec.wo) <= 0)
+                return Spectrum(0.0f);
+        } else {
+            sample.x = (sample.x - weight) / (1 - weight);
+            bRec.wo = warp::squareToCosineHemisphere(sample);
+        }
 
-        /* Lacking a better sampling method, generate cosine-weighted directions */
-        bRec.wo = warp::squareToCosineHemisphere(sample);
-        bRec.eta = 1.0f;
-        bRec.sampledComponent = 0;
-        bRec.sampledType = EGlossyReflection;
-        pdf = warp::squareToCosineHemispherePdf(bRec.wo);
+        pdf = (1 - weight) * warp::squareToCosineHemispherePdf(bRec.wo)
+            + weight * m_table->pdf(yarnID, bRec.wi, bRec.wo);
+        if (pdf == 0)
+            return Spectrum(0.0f);
         return eval(bRec, ESolidAngle) / pdf;
     }
 
@@ -626,7 +976,8 @@ public:
             << "  id = \"" << getID() << "\"," << endl
             << "  weavePattern = " << indent(m_pattern.toString()) << "," << endl
             << "  repeatU = " << m_repeatU << "," << endl
-            << "  repeatV = " << m_repeatV << endl
+            << "  repeatV = " << m_repeatV << "," << endl
+            << "  tabulated = " << m_tabulated << endl
             << "]";
         return oss.str();
     }
@@ -639,6 +990,9 @@ private:
     Float m_repeatU, m_repeatV;
     Float m_specularNormalization;
     bool m_initialization;
+    bool m_tabulated;
+    int m_tableResolution;
+    ref<IrawanTable> m_table;
 };
 
 // ================ Hardware shader implementation ================
@@ -690,6 +1044,7 @@ Shader *IrawanClothBRDF::createShader(Renderer *renderer) const {
 }
 
 
+MTS_IMPLEMENT_CLASS(IrawanTable, false, Object)
 MTS_IMPLEMENT_CLASS(IrawanShader, false, Shader)
 MTS_IMPLEMENT_CLASS_S(IrawanClothBRDF, false, BSDF)
 MTS_EXPORT_PLUGIN(IrawanClothBRDF, "Irawan & Marschner woven cloth BRDF")
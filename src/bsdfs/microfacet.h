@@ -23,6 +23,13 @@
 #include <mitsuba/core/frame.h>
 #include <mitsuba/core/properties.h>
 #include <boost/algorithm/string.hpp>
+#if defined(MTS_SSE) && defined(SINGLE_PRECISION)
+#include <mitsuba/core/ssemath.h>
+#define MTS_MICROFACET_SSE 1
+#endif
+
+/// Number of entries processed per chunk by the composite batch functions
+#define MTS_MICROFACET_BATCH_SIZE 64
 
 MTS_NAMESPACE_BEGIN
 
@@ -41,6 +48,12 @@ MTS_NAMESPACE_BEGIN
  *    by Eric Heitz and Eugene D'Eon
  *
  *  The visible normal sampling code was provided by Eric Heitz and Eugene D'Eon.
+ *
+ * All functions exist in two versions: a generic one that dispatches on the
+ * distribution type of the instance, and a version that is specialized at
+ * compile time (e.g. <tt>eval<MicrofacetDistribution::EGGX>(m)</tt>) for
+ * callers that already know the type. In addition, there is a batch
+ * interface that processes arrays of directions.
  */
 class MicrofacetDistribution {
 public:
@@ -189,6 +202,18 @@ public:
      *     The microfacet normal
      */
     inline Float eval(const Vector &m) const {
+        switch (m_type) {
+            case EBeckmann: return eval<EBeckmann>(m);
+            case EGGX: return eval<EGGX>(m);
+            case EPhong: return eval<EPhong>(m);
+            default:
+                SLog(EError, "Invalid distribution type!");
+                return -1;
+        }
+    }
+
+    /// Evaluate the microfacet distribution function (specialized version)
+    template <EType Type> inline Float eval(const Vector &m) const {
         if (Frame::cosTheta(m) <= 0)
             return 0.0f;
 
@@ -197,33 +222,19 @@ public:
                 + (m.y*m.y) / (m_alphaV * m_alphaV)) / cosTheta2;
 
         Float result;
-        switch (m_type) {
-            case EBeckmann: {
-                    /* Beckmann distribution function for Gaussian random surfaces - [Walter 2005] evaluation */
-                    result = math::fastexp(-beckmannExponent) /
-                        (M_PI * m_alphaU * m_alphaV * cosTheta2 * cosTheta2);
-                }
-                break;
-
-            case EGGX: {
-                    /* GGX / Trowbridge-Reitz distribution function for rough surfaces */
-                    Float root = ((Float) 1 + beckmannExponent) * cosTheta2;
-                    result = (Float) 1 / (M_PI * m_alphaU * m_alphaV * root * root);
-                }
-                break;
-
-            case EPhong: {
-                    /* Isotropic case: Phong distribution. Anisotropic case: Ashikhmin-Shirley distribution */
-                    Float exponent = interpolatePhongExponent(m);
-                    result = std::sqrt((m_exponentU + 2) * (m_exponentV + 2))
-                        * INV_TWOPI * std::pow(Frame::cosTheta(m), exponent);
-                }
-                break;
-
-
-            default:
-                SLog(EError, "Invalid distribution type!");
-                return -1;
+        if (Type == EBeckmann) {
+            /* Beckmann distribution function for Gaussian random surfaces - [Walter 2005] evaluation */
+            result = math::fastexp(-beckmannExponent) /
+                (M_PI * m_alphaU * m_alphaV * cosTheta2 * cosTheta2);
+        } else if (Type == EGGX) {
+            /* GGX / Trowbridge-Reitz distribution function for rough surfaces */
+            Float root = ((Float) 1 + beckmannExponent) * cosTheta2;
+            result = (Float) 1 / (M_PI * m_alphaU * m_alphaV * root * root);
+        } else {
+            /* Isotropic case: Phong distribution. Anisotropic case: Ashikhmin-Shirley distribution */
+            Float exponent = interpolatePhongExponent(m);
+            result = std::sqrt((m_exponentU + 2) * (m_exponentV + 2))
+                * INV_TWOPI * std::pow(Frame::cosTheta(m), exponent);
         }
 
         /* Prevent potential numerical issues in other stages of the model */
@@ -238,12 +249,26 @@ public:
      * depending on the parameters of this class
      */
     inline Normal sample(const Vector &wi, const Point2 &sample, Float &pdf) const {
+        switch (m_type) {
+            case EBeckmann: return this->sample<EBeckmann>(wi, sample, pdf);
+            case EGGX: return this->sample<EGGX>(wi, sample, pdf);
+            case EPhong: return this->sample<EPhong>(wi, sample, pdf);
+            default:
+                SLog(EError, "Invalid distribution type!");
+                pdf = -1;
+                return Vector(-1);
+        }
+    }
+
+    /// Sample a microfacet normal (specialized version)
+    template <EType Type> inline Normal sample(const Vector &wi,
+            const Point2 &sample, Float &pdf) const {
         Normal m;
         if (m_sampleVisible) {
-            m = sampleVisible(wi, sample);
-            pdf = pdfVisible(wi, m);
+            m = sampleVisible<Type>(wi, sample);
+            pdf = pdfVisible<Type>(wi, m);
         } else {
-            m = sampleAll(sample, pdf);
+            m = sampleAll<Type>(sample, pdf);
         }
         return m;
     }
@@ -268,10 +293,22 @@ public:
      * depending on the parameters of this class
      */
     inline Float pdf(const Vector &wi, const Vector &m) const {
+        switch (m_type) {
+            case EBeckmann: return pdf<EBeckmann>(wi, m);
+            case EGGX: return pdf<EGGX>(wi, m);
+            case EPhong: return pdf<EPhong>(wi, m);
+            default:
+                SLog(EError, "Invalid distribution type!");
+                return -1;
+        }
+    }
+
+    /// Density of \ref sample() (specialized version)
+    template <EType Type> inline Float pdf(const Vector &wi, const Vector &m) const {
         if (m_sampleVisible)
-            return pdfVisible(wi, m);
+            return pdfVisible<Type>(wi, m);
         else
-            return pdfAll(m);
+            return pdfAll<Type>(m);
     }
 
     /**
@@ -285,99 +322,98 @@ public:
      *    The probability density wrt. solid angles
      */
     inline Normal sampleAll(const Point2 &sample, Float &pdf) const {
+        switch (m_type) {
+            case EBeckmann: return sampleAll<EBeckmann>(sample, pdf);
+            case EGGX: return sampleAll<EGGX>(sample, pdf);
+            case EPhong: return sampleAll<EPhong>(sample, pdf);
+            default:
+                SLog(EError, "Invalid distribution type!");
+                pdf = -1;
+                return Vector(-1);
+        }
+    }
+
+    /// Sample all normals (specialized version)
+    template <EType Type> inline Normal sampleAll(const Point2 &sample, Float &pdf) const {
         /* The azimuthal component is always selected
            uniformly regardless of the distribution */
         Float cosThetaM = 0.0f;
         Float sinPhiM, cosPhiM;
         Float alphaSqr;
 
-        switch (m_type) {
-            case EBeckmann: {
-                    /* Beckmann distribution function for Gaussian random surfaces */
-                    if (isIsotropic()) {
-                        /* Sample phi component (isotropic case) */
-                        math::sincos((2.0f * M_PI) * sample.y, &sinPhiM, &cosPhiM);
-
-                        alphaSqr = m_alphaU * m_alphaU;
-                    } else {
-                        /* Sample phi component (anisotropic case) */
-                        Float phiM = std::atan(m_alphaV / m_alphaU *
-                            std::tan(M_PI + 2*M_PI*sample.y)) + M_PI * std::floor(2*sample.y + 0.5f);
-                        math::sincos(phiM, &sinPhiM, &cosPhiM);
-
-                        Float cosSc = cosPhiM / m_alphaU, sinSc = sinPhiM / m_alphaV;
-                        alphaSqr = 1.0f / (cosSc*cosSc + sinSc*sinSc);
-                    }
-
-                    /* Sample theta component */
-                    Float tanThetaMSqr = alphaSqr * -math::fastlog(1.0f - sample.x);
-                    cosThetaM = 1.0f / std::sqrt(1.0f + tanThetaMSqr);
-
-                    /* Compute probability density of the sampled position */
-                    pdf = (1.0f - sample.x) / (M_PI*m_alphaU*m_alphaV*cosThetaM*cosThetaM*cosThetaM);
-                }
-                break;
-
-            case EGGX: {
-                    /* GGX / Trowbridge-Reitz distribution function for rough surfaces */
-                    if (isIsotropic()) {
-                        /* Sample phi component (isotropic case) */
-                        math::sincos((2.0f * M_PI) * sample.y, &sinPhiM, &cosPhiM);
-
-                        /* Sample theta component */
-                        alphaSqr = m_alphaU*m_alphaU;
-                    } else {
-                        /* Sample phi component (anisotropic case) */
-                        Float phiM = std::atan(m_alphaV / m_alphaU *
-                            std::tan(M_PI + 2*M_PI*sample.y)) + M_PI * std::floor(2*sample.y + 0.5f);
-                        math::sincos(phiM, &sinPhiM, &cosPhiM);
-
-                        Float cosSc = cosPhiM / m_alphaU, sinSc = sinPhiM / m_alphaV;
-                        alphaSqr = 1.0f / (cosSc*cosSc + sinSc*sinSc);
-                    }
-
-                    /* Sample theta component */
-                    Float tanThetaMSqr = alphaSqr * sample.x / (1.0f - sample.x);
-                    cosThetaM = 1.0f / std::sqrt(1.0f + tanThetaMSqr);
-
-                    /* Compute probability density of the sampled position */
-                    Float temp = 1+tanThetaMSqr/alphaSqr;
-                    pdf = INV_PI / (m_alphaU*m_alphaV*cosThetaM*cosThetaM*cosThetaM*temp*temp);
-                }
-                break;
-
-            case EPhong: {
-                    Float phiM;
-                    Float exponent;
-                    if (isIsotropic()) {
-                        phiM = (2.0f * M_PI) * sample.y;
-                        exponent = m_exponentU;
-                    } else {
-                        /* Sampling method based on code from PBRT */
-                        if (sample.y < 0.25f) {
-                            sampleFirstQuadrant(4 * sample.y, phiM, exponent);
-                        } else if (sample.y < 0.5f) {
-                            sampleFirstQuadrant(4 * (0.5f - sample.y), phiM, exponent);
-                            phiM = M_PI - phiM;
-                        } else if (sample.y < 0.75f) {
-                            sampleFirstQuadrant(4 * (sample.y - 0.5f), phiM, exponent);
-                            phiM += M_PI;
-                        } else {
-                            sampleFirstQuadrant(4 * (1 - sample.y), phiM, exponent);
-                            phiM = 2 * M_PI - phiM;
-                        }
-                    }
-                    math::sincos(phiM, &sinPhiM, &cosPhiM);
-                    cosThetaM = std::pow(sample.x, 1.0f / (exponent + 2.0f));
-                    pdf = std::sqrt((m_exponentU + 2.0f) * (m_exponentV + 2.0f))
-                        * INV_TWOPI * std::pow(cosThetaM, exponent + 1.0f);
+        if (Type == EBeckmann) {
+            /* Beckmann distribution function for Gaussian random surfaces */
+            if (isIsotropic()) {
+                /* Sample phi component (isotropic case) */
+                math::sincos((2.0f * M_PI) * sample.y, &sinPhiM, &cosPhiM);
+
+                alphaSqr = m_alphaU * m_alphaU;
+            } else {
+                /* Sample phi component (anisotropic case) */
+                Float phiM = std::atan(m_alphaV / m_alphaU *
+                    std::tan(M_PI + 2*M_PI*sample.y)) + M_PI * std::floor(2*sample.y + 0.5f);
+                math::sincos(phiM, &sinPhiM, &cosPhiM);
+
+                Float cosSc = cosPhiM / m_alphaU, sinSc = sinPhiM / m_alphaV;
+                alphaSqr = 1.0f / (cosSc*cosSc + sinSc*sinSc);
+            }
+
+            /* Sample theta component */
+            Float tanThetaMSqr = alphaSqr * -math::fastlog(1.0f - sample.x);
+            cosThetaM = 1.0f / std::sqrt(1.0f + tanThetaMSqr);
+
+            /* Compute probability density of the sampled position */
+            pdf = (1.0f - sample.x) / (M_PI*m_alphaU*m_alphaV*cosThetaM*cosThetaM*cosThetaM);
+        } else if (Type == EGGX) {
+            /* GGX / Trowbridge-Reitz distribution function for rough surfaces */
+            if (isIsotropic()) {
+                /* Sample phi component (isotropic case) */
+                math::sincos((2.0f * M_PI) * sample.y, &sinPhiM, &cosPhiM);
+
+                /* Sample theta component */
+                alphaSqr = m_alphaU*m_alphaU;
+            } else {
+                /* Sample phi component (anisotropic case) */
+                Float phiM = std::atan(m_alphaV / m_alphaU *
+                    std::tan(M_PI + 2*M_PI*sample.y)) + M_PI * std::floor(2*sample.y + 0.5f);
+                math::sincos(phiM, &sinPhiM, &cosPhiM);
+
+                Float cosSc = cosPhiM / m_alphaU, sinSc = sinPhiM / m_alphaV;
+                alphaSqr = 1.0f / (cosSc*cosSc + sinSc*sinSc);
+            }
+
+            /* Sample theta component */
+            Float tanThetaMSqr = alphaSqr * sample.x / (1.0f - sample.x);
+            cosThetaM = 1.0f / std::sqrt(1.0f + tanThetaMSqr);
+
+            /* Compute probability density of the sampled position */
+            Float temp = 1+tanThetaMSqr/alphaSqr;
+            pdf = INV_PI / (m_alphaU*m_alphaV*cosThetaM*cosThetaM*cosThetaM*temp*temp);
+        } else {
+            Float phiM;
+            Float exponent;
+            if (isIsotropic()) {
+                phiM = (2.0f * M_PI) * sample.y;
+                exponent = m_exponentU;
+            } else {
+                /* Sampling method based on code from PBRT */
+                if (sample.y < 0.25f) {
+                    sampleFirstQuadrant(4 * sample.y, phiM, exponent);
+                } else if (sample.y < 0.5f) {
+                    sampleFirstQuadrant(4 * (0.5f - sample.y), phiM, exponent);
+                    phiM = M_PI - phiM;
+                } else if (sample.y < 0.75f) {
+                    sampleFirstQuadrant(4 * (sample.y - 0.5f), phiM, exponent);
+                    phiM += M_PI;
+                } else {
+                    sampleFirstQuadrant(4 * (1 - sample.y), phiM, exponent);
+                    phiM = 2 * M_PI - phiM;
                 }
-                break;
-
-            default:
-                SLog(EError, "Invalid distribution type!");
-                pdf = -1;
-                return Vector(-1);
+            }
+            math::sincos(phiM, &sinPhiM, &cosPhiM);
+            cosThetaM = std::pow(sample.x, 1.0f / (exponent + 2.0f));
+            pdf = std::sqrt((m_exponentU + 2.0f) * (m_exponentV + 2.0f))
+                * INV_TWOPI * std::pow(cosThetaM, exponent + 1.0f);
         }
 
         /* Prevent potential numerical issues in other stages of the model */
@@ -406,6 +442,11 @@ public:
         return eval(m) * Frame::cosTheta(m);
     }
 
+    /// Density of \ref sampleAll() (specialized version)
+    template <EType Type> inline Float pdfAll(const Vector &m) const {
+        return eval<Type>(m) * Frame::cosTheta(m);
+    }
+
 
     /**
      * \brief Draw a sample from the distribution of visible normals
@@ -418,7 +459,19 @@ public:
      * \param pdf
      *    The probability density wrt. solid angles
      */
-    inline Normal sampleVisible(const Vector &_wi, const Point2 &sample) const {
+    inline Normal sampleVisible(const Vector &wi, const Point2 &sample) const {
+        switch (m_type) {
+            case EBeckmann: return sampleVisible<EBeckmann>(wi, sample);
+            case EGGX: return sampleVisible<EGGX>(wi, sample);
+            default:
+                SLog(EError, "Visible normal sampling is not supported "
+                    "by the %s distribution!", distributionName(m_type).c_str());
+                return Vector(-1);
+        }
+    }
+
+    /// Sample visible normals (specialized version)
+    template <EType Type> inline Normal sampleVisible(const Vector &_wi, const Point2 &sample) const {
         /* Step 1: stretch wi */
         Vector wi = normalize(Vector(
             m_alphaU * _wi.x,
@@ -426,17 +479,22 @@ public:
             _wi.z
         ));
 
-        /* Get polar coordinates */
-        Float theta = 0, phi = 0;
+        /* Get polar coordinates (the azimuth is only needed in
+           the form of its sine and cosine, which avoids atan2/sincos) */
+        Float theta = 0, tanTheta = 0, sinPhi = 0, cosPhi = 1;
         if (wi.z < (Float) 0.99999) {
+            Float sinTheta = std::sqrt(wi.x*wi.x + wi.y*wi.y);
             theta = std::acos(wi.z);
-            phi = std::atan2(wi.y, wi.x);
+            tanTheta = sinTheta / wi.z;
+            if (sinTheta > 0) {
+                Float invSinTheta = 1 / sinTheta;
+                cosPhi = wi.x * invSinTheta;
+                sinPhi = wi.y * invSinTheta;
+            }
         }
-        Float sinPhi, cosPhi;
-        math::sincos(phi, &sinPhi, &cosPhi);
 
         /* Step 2: simulate P22_{wi}(slope.x, slope.y, 1, 1) */
-        Vector2 slope = sampleVisible11(theta, sample);
+        Vector2 slope = sampleVisible11<Type>(theta, tanTheta, sample);
 
         /* Step 3: rotate */
         slope = Vector2(
@@ -459,10 +517,22 @@ public:
     }
 
     /// Implements the probability density of the function \ref sampleVisible()
-    Float pdfVisible(const Vector &wi, const Vector &m) const {
+    inline Float pdfVisible(const Vector &wi, const Vector &m) const {
+        switch (m_type) {
+            case EBeckmann: return pdfVisible<EBeckmann>(wi, m);
+            case EGGX: return pdfVisible<EGGX>(wi, m);
+            case EPhong: return pdfVisible<EPhong>(wi, m);
+            default:
+                SLog(EError, "Invalid distribution type!");
+                return -1;
+        }
+    }
+
+    /// Density of \ref sampleVisible() (specialized version)
+    template <EType Type> inline Float pdfVisible(const Vector &wi, const Vector &m) const {
         if (Frame::cosTheta(wi) == 0)
             return 0.0f;
-        return smithG1(wi, m) * absDot(wi, m) * eval(m) / std::abs(Frame::cosTheta(wi));
+        return smithG1<Type>(wi, m) * absDot(wi, m) * eval<Type>(m) / std::abs(Frame::cosTheta(wi));
     }
 
     /**
@@ -474,7 +544,19 @@ public:
      * \param m
      *     The microfacet normal
      */
-    Float smithG1(const Vector &v, const Vector &m) const {
+    inline Float smithG1(const Vector &v, const Vector &m) const {
+        switch (m_type) {
+            case EPhong:
+            case EBeckmann: return smithG1<EBeckmann>(v, m);
+            case EGGX: return smithG1<EGGX>(v, m);
+            default:
+                SLog(EError, "Invalid distribution type!");
+                return -1.0f;
+        }
+    }
+
+    /// Smith's shadowing-masking function G1 (specialized version)
+    template <EType Type> inline Float smithG1(const Vector &v, const Vector &m) const {
         /* Ensure consistent orientation (can't see the back
            of the microfacet from the front and vice versa) */
         if (dot(v, m) * Frame::cosTheta(v) <= 0)
@@ -486,41 +568,129 @@ public:
             return 1.0f;
 
         Float alpha = projectRoughness(v);
+        if (Type == EGGX) {
+            Float root = alpha * tanTheta;
+            return 2.0f / (1.0f + math::hypot2((Float) 1.0f, root));
+        } else {
+            /* Phong uses the Beckmann shadowing-masking function */
+            Float a = 1.0f / (alpha * tanTheta);
+            if (a >= 1.6f)
+                return 1.0f;
+
+            /* Use a fast and accurate (<0.35% rel. error) rational
+               approximation to the shadowing-masking function */
+            Float aSqr = a*a;
+            return (3.535f * a + 2.181f * aSqr)
+                 / (1.0f + 2.276f * a + 2.577f * aSqr);
+        }
+    }
+
+    /**
+     * \brief Separable shadow-masking function based on Smith's
+     * one-dimensional masking model
+     */
+    inline Float G(const Vector &wi, const Vector &wo, const Vector &m) const {
         switch (m_type) {
             case EPhong:
-            case EBeckmann: {
-                    Float a = 1.0f / (alpha * tanTheta);
-                    if (a >= 1.6f)
-                        return 1.0f;
-
-                    /* Use a fast and accurate (<0.35% rel. error) rational
-                       approximation to the shadowing-masking function */
-                    Float aSqr = a*a;
-                    return (3.535f * a + 2.181f * aSqr)
-                         / (1.0f + 2.276f * a + 2.577f * aSqr);
-                }
-                break;
-
-            case EGGX: {
-                    Float root = alpha * tanTheta;
-                    return 2.0f / (1.0f + math::hypot2((Float) 1.0f, root));
-                }
-                break;
-
+            case EBeckmann: return G<EBeckmann>(wi, wo, m);
+            case EGGX: return G<EGGX>(wi, wo, m);
             default:
                 SLog(EError, "Invalid distribution type!");
                 return -1.0f;
         }
     }
 
+    /// Separable shadow-masking function (specialized version)
+    template <EType Type> inline Float G(const Vector &wi, const Vector &wo, const Vector &m) const {
+        return smithG1<Type>(wi, m) * smithG1<Type>(wo, m);
+    }
+
+    /// \name Batch interface
+    /// \{
+
     /**
-     * \brief Separable shadow-masking function based on Smith's
-     * one-dimensional masking model
+     * \brief Evaluate the microfacet distribution function for
+     * \c count normals at once
+     *
+     * The distribution type is only dispatched once per call. When
+     * compiled with SSE support in single precision, the Beckmann and
+     * GGX distributions are evaluated four normals at a time.
      */
-    inline Float G(const Vector &wi, const Vector &wo, const Vector &m) const {
-        return smithG1(wi, m) * smithG1(wo, m);
+    void eval(const Vector *m, Float *result, size_t count) const {
+        switch (m_type) {
+            case EBeckmann: evalBatch<EBeckmann>(m, result, count); break;
+            case EGGX: evalBatch<EGGX>(m, result, count); break;
+            case EPhong: evalBatch<EPhong>(m, result, count); break;
+            default: SLog(EError, "Invalid distribution type!");
+        }
+    }
+
+    /**
+     * \brief Evaluate Smith's shadowing-masking function G1 for
+     * \c count pairs of directions and microfacet normals
+     */
+    void smithG1(const Vector *v, const Vector *m, Float *result, size_t count) const {
+        switch (m_type) {
+            case EPhong:
+            case EBeckmann: smithG1Batch<EBeckmann>(v, m, result, count); break;
+            case EGGX: smithG1Batch<EGGX>(v, m, result, count); break;
+            default: SLog(EError, "Invalid distribution type!");
+        }
+    }
+
+    /// Evaluate the shadowing-masking function \ref G() for \c count triples
+    void G(const Vector *wi, const Vector *wo, const Vector *m,
+            Float *result, size_t count) const {
+        Float temp[MTS_MICROFACET_BATCH_SIZE];
+        for (size_t i=0; i<count; i += MTS_MICROFACET_BATCH_SIZE) {
+            size_t n = std::min(count - i, (size_t) MTS_MICROFACET_BATCH_SIZE);
+            smithG1(wi + i, m + i, result + i, n);
+            smithG1(wo + i, m + i, temp, n);
+            for (size_t j=0; j<n; ++j)
+                result[i+j] *= temp[j];
+        }
+    }
+
+    /// Evaluate \ref pdf() for \c count pairs of directions and normals
+    void pdf(const Vector *wi, const Vector *m, Float *result, size_t count) const {
+        Float temp[MTS_MICROFACET_BATCH_SIZE];
+        for (size_t i=0; i<count; i += MTS_MICROFACET_BATCH_SIZE) {
+            size_t n = std::min(count - i, (size_t) MTS_MICROFACET_BATCH_SIZE);
+            eval(m + i, result + i, n);
+            if (m_sampleVisible) {
+                smithG1(wi + i, m + i, temp, n);
+                for (size_t j=0; j<n; ++j) {
+                    Float cosThetaI = Frame::cosTheta(wi[i+j]);
+                    result[i+j] = cosThetaI == 0 ? (Float) 0 : (result[i+j] * temp[j]
+                        * absDot(wi[i+j], m[i+j]) / std::abs(cosThetaI));
+                }
+            } else {
+                for (size_t j=0; j<n; ++j)
+                    result[i+j] *= Frame::cosTheta(m[i+j]);
+            }
+        }
     }
 
+    /**
+     * \brief Draw \c count samples using \ref sample() and store
+     * the microfacet normals and their densities
+     *
+     * Sampling involves branchy numerical inversions, hence this only
+     * dispatches the distribution type once and then runs the
+     * specialized scalar code.
+     */
+    void sample(const Vector *wi, const Point2 *sample, Normal *m,
+            Float *pdf, size_t count) const {
+        switch (m_type) {
+            case EBeckmann: sampleBatch<EBeckmann>(wi, sample, m, pdf, count); break;
+            case EGGX: sampleBatch<EGGX>(wi, sample, m, pdf, count); break;
+            case EPhong: sampleBatch<EPhong>(wi, sample, m, pdf, count); break;
+            default: SLog(EError, "Invalid distribution type!");
+        }
+    }
+
+    /// \}
+
     /// Return a string representation of the name of a distribution
     inline static std::string distributionName(EType type) {
         switch (type) {
@@ -570,133 +740,243 @@ protected:
      * Source: supplemental material of "Importance Sampling
      * Microfacet-Based BSDFs using the Distribution of Visible Normals"
      */
-    Vector2 sampleVisible11(Float thetaI, Point2 sample) const {
+    template <EType Type> Vector2 sampleVisible11(Float thetaI, Float tanThetaI, Point2 sample) const {
         const Float SQRT_PI_INV = 1 / std::sqrt(M_PI);
         Vector2 slope;
 
-        switch (m_type) {
-            case EBeckmann: {
-                    /* Special case (normal incidence) */
-                    if (thetaI < 1e-4f) {
-                        Float sinPhi, cosPhi;
-                        Float r = std::sqrt(-math::fastlog(1.0f-sample.x));
-                        math::sincos(2 * M_PI * sample.y, &sinPhi, &cosPhi);
-                        return Vector2(r * cosPhi, r * sinPhi);
-                    }
-
-                    /* The original inversion routine from the paper contained
-                       discontinuities, which causes issues for QMC integration
-                       and techniques like Kelemen-style MLT. The following code
-                       performs a numerical inversion with better behavior */
-                    Float tanThetaI = std::tan(thetaI);
-                    Float cotThetaI = 1 / tanThetaI;
-
-                    /* Search interval -- everything is parameterized
-                       in the erf() domain */
-                    Float a = -1, c = math::erf(cotThetaI);
-                    Float sample_x = std::max(sample.x, (Float) 1e-6f);
-
-                    /* Start with a good initial guess */
-                    //Float b = (1-sample_x) * a + sample_x * c;
-
-                    /* We can do better (inverse of an approximation computed in Mathematica) */
-                    Float fit = 1 + thetaI*(-0.876f + thetaI * (0.4265f - 0.0594f*thetaI));
-                    Float b = c - (1+c) * std::pow(1-sample_x, fit);
-
-                    /* Normalization factor for the CDF */
-                    Float normalization = 1 / (1 + c + SQRT_PI_INV*
-                        tanThetaI*std::exp(-cotThetaI*cotThetaI));
-
-                    int it = 0;
-                    while (++it < 10) {
-                        /* Bisection criterion -- the oddly-looking
-                           boolean expression are intentional to check
-                           for NaNs at little additional cost */
-                        if (!(b >= a && b <= c))
-                            b = 0.5f * (a + c);
-
-                        /* Evaluate the CDF and its derivative
-                           (i.e. the density function) */
-                        Float invErf = math::erfinv(b);
-                        Float value = normalization*(1 + b + SQRT_PI_INV*
-                            tanThetaI*std::exp(-invErf*invErf)) - sample_x;
-                        Float derivative = normalization * (1
-                            - invErf*tanThetaI);
-
-                        if (std::abs(value) < 1e-5f)
-                            break;
-
-                        /* Update bisection intervals */
-                        if (value > 0)
-                            c = b;
-                        else
-                            a = b;
-
-                        b -= value / derivative;
-                    }
-
-                    /* Now convert back into a slope value */
-                    slope.x = math::erfinv(b);
-
-                    /* Simulate Y component */
-                    slope.y = math::erfinv(2.0f*std::max(sample.y, (Float) 1e-6f) - 1.0f);
-                };
-                break;
-
-            case EGGX: {
-                    /* Special case (normal incidence) */
-                    if (thetaI < 1e-4f) {
-                        Float sinPhi, cosPhi;
-                        Float r = math::safe_sqrt(sample.x / (1 - sample.x));
-                        math::sincos(2 * M_PI * sample.y, &sinPhi, &cosPhi);
-                        return Vector2(r * cosPhi, r * sinPhi);
-                    }
-
-                    /* Precomputations */
-                    Float tanThetaI = std::tan(thetaI);
-                    Float a = 1 / tanThetaI;
-                    Float G1 = 2.0f / (1.0f + math::safe_sqrt(1.0f + 1.0f / (a*a)));
-
-                    /* Simulate X component */
-                    Float A = 2.0f * sample.x / G1 - 1.0f;
-                    if (std::abs(A) == 1)
-                        A -= math::signum(A)*Epsilon;
-                    Float tmp = 1.0f / (A*A - 1.0f);
-                    Float B = tanThetaI;
-                    Float D = math::safe_sqrt(B*B*tmp*tmp - (A*A - B*B) * tmp);
-                    Float slope_x_1 = B * tmp - D;
-                    Float slope_x_2 = B * tmp + D;
-                    slope.x = (A < 0.0f || slope_x_2 > 1.0f / tanThetaI) ? slope_x_1 : slope_x_2;
-
-                    /* Simulate Y component */
-                    Float S;
-                    if (sample.y > 0.5f) {
-                        S = 1.0f;
-                        sample.y = 2.0f * (sample.y - 0.5f);
-                    } else {
-                        S = -1.0f;
-                        sample.y = 2.0f * (0.5f - sample.y);
-                    }
-
-                    /* Improved fit */
-                    Float z =
-                        (sample.y * (sample.y * (sample.y * (-(Float) 0.365728915865723) + (Float) 0.790235037209296) -
-                            (Float) 0.424965825137544) + (Float) 0.000152998850436920) /
-                        (sample.y * (sample.y * (sample.y * (sample.y * (Float) 0.169507819808272 - (Float) 0.397203533833404) -
-                            (Float) 0.232500544458471) + (Float) 1) - (Float) 0.539825872510702);
-
-                    slope.y = S * z * std::sqrt(1.0f + slope.x*slope.x);
-                };
-                break;
-
-            default:
-                SLog(EError, "Invalid distribution type!");
-                return Vector2(-1);
-        };
+        if (Type == EBeckmann) {
+            /* Special case (normal incidence) */
+            if (thetaI < 1e-4f) {
+                Float sinPhi, cosPhi;
+                Float r = std::sqrt(-math::fastlog(1.0f-sample.x));
+                math::sincos(2 * M_PI * sample.y, &sinPhi, &cosPhi);
+                return Vector2(r * cosPhi, r * sinPhi);
+            }
+
+            /* The original inversion routine from the paper contained
+               discontinuities, which causes issues for QMC integration
+               and techniques like Kelemen-style MLT. The following code
+               performs a numerical inversion with better behavior */
+            Float cotThetaI = 1 / tanThetaI;
+
+            /* Search interval -- everything is parameterized
+               in the erf() domain */
+            Float a = -1, c = math::erf(cotThetaI);
+            Float sample_x = std::max(sample.x, (Float) 1e-6f);
+
+            /* Start with a good initial guess */
+            //Float b = (1-sample_x) * a + sample_x * c;
+
+            /* We can do better (inverse of an approximation computed in Mathematica) */
+            Float fit = 1 + thetaI*(-0.876f + thetaI * (0.4265f - 0.0594f*thetaI));
+            Float b = c - (1+c) * std::pow(1-sample_x, fit);
+
+            /* Normalization factor for the CDF */
+            Float normalization = 1 / (1 + c + SQRT_PI_INV*
+                tanThetaI*std::exp(-cotThetaI*cotThetaI));
+
+            int it = 0;
+            while (++it < 10) {
+                /* Bisection criterion -- the oddly-looking
+                   boolean expression are intentional to check
+                   for NaNs at little additional cost */
+                if (!(b >= a && b <= c))
+                    b = 0.5f * (a + c);
+
+                /* Evaluate the CDF and its derivative
+                   (i.e. the density function) */
+                Float invErf = math::erfinv(b);
+                Float value = normalization*(1 + b + SQRT_PI_INV*
+                    tanThetaI*std::exp(-invErf*invErf)) - sample_x;
+                Float derivative = normalization * (1
+                    - invErf*tanThetaI);
+
+                if (std::abs(value) < 1e-5f)
+                    break;
+
+                /* Update bisection intervals */
+                if (value > 0)
+                    c = b;
+                else
+                    a = b;
+
+                b -= value / derivative;
+            }
+
+            /* Now convert back into a slope value */
+            slope.x = math::erfinv(b);
+
+            /* Simulate Y component */
+            slope.y = math::erfinv(2.0f*std::max(sample.y, (Float) 1e-6f) - 1.0f);
+        } else if (Type == EGGX) {
+            /* Special case (normal incidence) */
+            if (thetaI < 1e-4f) {
+                Float sinPhi, cosPhi;
+                Float r = math::safe_sqrt(sample.x / (1 - sample.x));
+                math::sincos(2 * M_PI * sample.y, &sinPhi, &cosPhi);
+                return Vector2(r * cosPhi, r * sinPhi);
+            }
+
+            /* Precomputations */
+            Float a = 1 / tanThetaI;
+            Float G1 = 2.0f / (1.0f + math::safe_sqrt(1.0f + 1.0f / (a*a)));
+
+            /* Simulate X component */
+            Float A = 2.0f * sample.x / G1 - 1.0f;
+            if (std::abs(A) == 1)
+                A -= math::signum(A)*Epsilon;
+            Float tmp = 1.0f / (A*A - 1.0f);
+            Float B = tanThetaI;
+            Float D = math::safe_sqrt(B*B*tmp*tmp - (A*A - B*B) * tmp);
+            Float slope_x_1 = B * tmp - D;
+            Float slope_x_2 = B * tmp + D;
+            slope.x = (A < 0.0f || slope_x_2 > 1.0f / tanThetaI) ? slope_x_1 : slope_x_2;
+
+            /* Simulate Y component */
+            Float S;
+            if (sample.y > 0.5f) {
+                S = 1.0f;
+                sample.y = 2.0f * (sample.y - 0.5f);
+            } else {
+                S = -1.0f;
+                sample.y = 2.0f * (0.5f - sample.y);
+            }
+
+            /* Improved fit */
+            Float z =
+                (sample.y * (sample.y * (sample.y * (-(Float) 0.365728915865723) + (Float) 0.790235037209296) -
+                    (Float) 0.424965825137544) + (Float) 0.000152998850436920) /
+                (sample.y * (sample.y * (sample.y * (sample.y * (Float) 0.169507819808272 - (Float) 0.397203533833404) -
+                    (Float) 0.232500544458471) + (Float) 1) - (Float) 0.539825872510702);
+
+            slope.y = S * z * std::sqrt(1.0f + slope.x*slope.x);
+        } else {
+            SLog(EError, "Invalid distribution type!");
+            return Vector2(-1);
+        }
         return slope;
     }
 
 
+    /// Batch version of \ref eval() (specialized version)
+    template <EType Type> void evalBatch(const Vector *m, Float *result, size_t count) const {
+        size_t i = 0;
+#if defined(MTS_MICROFACET_SSE)
+        if (Type != EPhong) {
+            const __m128
+                zero = _mm_setzero_ps(),
+                one = _mm_set1_ps(1.0f),
+                threshold = _mm_set1_ps(1e-20f),
+                invAlphaU2 = _mm_set1_ps(1.0f / (m_alphaU * m_alphaU)),
+                invAlphaV2 = _mm_set1_ps(1.0f / (m_alphaV * m_alphaV)),
+                normalization = _mm_set1_ps(1.0f / ((Float) M_PI * m_alphaU * m_alphaV));
+
+            for (; i + 4 <= count; i += 4) {
+                const Vector *v = m + i;
+                __m128 x = _mm_setr_ps(v[0].x, v[1].x, v[2].x, v[3].x),
+                       y = _mm_setr_ps(v[0].y, v[1].y, v[2].y, v[3].y),
+                       z = _mm_setr_ps(v[0].z, v[1].z, v[2].z, v[3].z);
+
+                __m128 cosTheta2 = _mm_mul_ps(z, z);
+                __m128 beckmannExponent = _mm_div_ps(_mm_add_ps(
+                    _mm_mul_ps(_mm_mul_ps(x, x), invAlphaU2),
+                    _mm_mul_ps(_mm_mul_ps(y, y), invAlphaV2)), cosTheta2);
+
+                __m128 value;
+                if (Type == EBeckmann) {
+                    value = _mm_div_ps(
+                        _mm_mul_ps(math::exp_ps(_mm_sub_ps(zero, beckmannExponent)), normalization),
+                        _mm_mul_ps(cosTheta2, cosTheta2));
+                } else {
+                    __m128 root = _mm_mul_ps(_mm_add_ps(one, beckmannExponent), cosTheta2);
+                    value = _mm_div_ps(normalization, _mm_mul_ps(root, root));
+                }
+
+                /* Same masking as in the scalar version (which also removes NaNs) */
+                __m128 mask = _mm_and_ps(_mm_cmpgt_ps(z, zero),
+                    _mm_cmpge_ps(_mm_mul_ps(value, z), threshold));
+                _mm_storeu_ps(result + i, _mm_and_ps(value, mask));
+            }
+        }
+#endif
+        for (; i<count; ++i)
+            result[i] = eval<Type>(m[i]);
+    }
+
+    /// Batch version of \ref smithG1() (specialized version)
+    template <EType Type> void smithG1Batch(const Vector *v, const Vector *m,
+            Float *result, size_t count) const {
+        size_t i = 0;
+#if defined(MTS_MICROFACET_SSE)
+        const __m128
+            zero = _mm_setzero_ps(),
+            one = _mm_set1_ps(1.0f),
+            two = _mm_set1_ps(2.0f),
+            signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)),
+            alphaU2 = _mm_set1_ps(m_alphaU * m_alphaU),
+            alphaV2 = _mm_set1_ps(m_alphaV * m_alphaV);
+        const bool isotropic = isIsotropic();
+
+        for (; i + 4 <= count; i += 4) {
+            const Vector *a = v + i, *b = m + i;
+            __m128 x = _mm_setr_ps(a[0].x, a[1].x, a[2].x, a[3].x),
+                   y = _mm_setr_ps(a[0].y, a[1].y, a[2].y, a[3].y),
+                   z = _mm_setr_ps(a[0].z, a[1].z, a[2].z, a[3].z),
+                   d = _mm_setr_ps(dot(a[0], b[0]), dot(a[1], b[1]),
+                                   dot(a[2], b[2]), dot(a[3], b[3]));
+
+            /* Ensure consistent orientation */
+            __m128 valid = _mm_cmpgt_ps(_mm_mul_ps(d, z), zero);
+
+            /* tan(theta), where perpendicular incidence causes no shadowing/masking */
+            __m128 sinTheta2 = _mm_sub_ps(one, _mm_mul_ps(z, z));
+            __m128 perpendicular = _mm_cmple_ps(sinTheta2, zero);
+            __m128 tanTheta = _mm_div_ps(_mm_sqrt_ps(_mm_max_ps(sinTheta2, zero)),
+                _mm_and_ps(z, signMask));
+
+            /* Project the roughness onto v */
+            __m128 alpha;
+            if (isotropic)
+                alpha = _mm_set1_ps(m_alphaU);
+            else
+                alpha = _mm_sqrt_ps(_mm_div_ps(_mm_add_ps(
+                    _mm_mul_ps(_mm_mul_ps(x, x), alphaU2),
+                    _mm_mul_ps(_mm_mul_ps(y, y), alphaV2)), sinTheta2));
+
+            __m128 value;
+            if (Type == EGGX) {
+                __m128 root = _mm_mul_ps(alpha, tanTheta);
+                value = _mm_div_ps(two, _mm_add_ps(one,
+                    _mm_sqrt_ps(_mm_add_ps(one, _mm_mul_ps(root, root)))));
+            } else {
+                __m128 a = _mm_div_ps(one, _mm_mul_ps(alpha, tanTheta));
+                __m128 aSqr = _mm_mul_ps(a, a);
+                value = _mm_div_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(3.535f), a),
+                               _mm_mul_ps(_mm_set1_ps(2.181f), aSqr)),
+                    _mm_add_ps(_mm_add_ps(one, _mm_mul_ps(_mm_set1_ps(2.276f), a)),
+                               _mm_mul_ps(_mm_set1_ps(2.577f), aSqr)));
+                __m128 saturated = _mm_cmpge_ps(a, _mm_set1_ps(1.6f));
+                value = _mm_or_ps(_mm_and_ps(saturated, one),
+                    _mm_andnot_ps(saturated, value));
+            }
+
+            value = _mm_or_ps(_mm_and_ps(perpendicular, one),
+                _mm_andnot_ps(perpendicular, value));
+            _mm_storeu_ps(result + i, _mm_and_ps(valid, value));
+        }
+#endif
+        for (; i<count; ++i)
+            result[i] = smithG1<Type>(v[i], m[i]);
+    }
+
+    /// Batch version of \ref sample() (specialized version)
+    template <EType Type> void sampleBatch(const Vector *wi, const Point2 *sample,
+            Normal *m, Float *pdf, size_t count) const {
+        for (size_t i=0; i<count; ++i)
+            m[i] = this->sample<Type>(wi[i], sample[i], pdf[i]);
+    }
+
     /// Helper routine: convert from Beckmann-style roughness values to Phong exponents (Walter et al.)
     void computePhongExponent() {
         m_exponentU = std::max(2.0f / (m_alphaU * m_alphaU) - 2.0f, (Float) 0.0f);
@@ -354,6 +354,7 @@ public:
             m_storage = new ImageBlock(Bitmap::EMultiSpectrumAlphaWeight, m_cropSize,
                 NULL, (int) (SPECTRUM_SAMPLES * m_pixelFormats.size() + 2));
         }
+        m_mutex = new Mutex();
     }
 
     HDRFilm(Stream *stream, InstanceManager *manager)
@@ -368,6 +369,7 @@ public:
         for (size_t i=0; i<m_channelNames.size(); ++i)
             m_channelNames[i] = stream->readString();
         m_componentFormat = (Bitmap::EComponentFormat) stream->readUInt();
+        m_mutex = new Mutex();
     }
 
     void serialize(Stream *stream, InstanceManager *manager) const {
@@ -385,14 +387,30 @@ public:
     }
 
     void clear() {
+        LockGuard lock(m_mutex);
         m_storage->clear();
     }
 
     void put(const ImageBlock *block) {
+        LockGuard lock(m_mutex);
         m_storage->put(block);
     }
 
+    void saveState(Stream *stream) const {
+        LockGuard lock(m_mutex);
+        stream->writeInt(m_storage->getChannelCount());
+        m_storage->save(stream);
+    }
+
+    void loadState(Stream *stream) {
+        LockGuard lock(m_mutex);
+        if (stream->readInt() != m_storage->getChannelCount())
+            Log(EError, "loadState(): the stored image does not match the film configuration!");
+        m_storage->load(stream);
+    }
+
     void setBitmap(const Bitmap *bitmap, Float multiplier) {
+        LockGuard lock(m_mutex);
         bitmap->convert(m_storage->getBitmap(), multiplier);
     }
 
@@ -410,6 +428,7 @@ public:
             Log(EError, "addBitmap(): Unsupported bitmap format!");
         }
 
+        LockGuard lock(m_mutex);
         size_t nPixels = (size_t) size.x * (size_t) size.y;
         const Float *source = bitmap->getFloatData();
         Float *target = m_storage->getBitmap()->getFloatData();
@@ -426,6 +445,7 @@ public:
 
     bool develop(const Point2i &sourceOffset, const Vector2i &size,
             const Point2i &targetOffset, Bitmap *target) const {
+        LockGuard lock(m_mutex);
         const Bitmap *source = m_storage->getBitmap();
         const FormatConverter *cvt = FormatConverter::getInstance(
             std::make_pair(Bitmap::EFloat, target->getComponentFormat())
@@ -479,19 +499,32 @@ public:
     }
 
     void develop(const Scene *scene, Float renderTime) {
+        writeImage(scene, renderTime, false);
+    }
+
+    void developAsync(const Scene *scene, Float renderTime) {
+        writeImage(scene, renderTime, true);
+    }
+
+    void writeImage(const Scene *scene, Float renderTime, bool async) {
         if (m_destFile.empty())
             return;
 
         Log(EDebug, "Developing film ..");
 
+        /* Take a snapshot of the film contents. Everything below
+           operates on this private copy and doesn't hold the lock */
         ref<Bitmap> bitmap;
-        if (m_pixelFormats.size() == 1) {
-            bitmap = m_storage->getBitmap()->convert(m_pixelFormats[0], m_componentFormat);
-            bitmap->setChannelNames(m_channelNames);
-        } else {
-            bitmap = m_storage->getBitmap()->convertMultiSpectrumAlphaWeight(m_pixelFormats,
-                    m_componentFormat, m_channelNames);
+        {
+            LockGuard lock(m_mutex);
+            if (m_pixelFormats.size() == 1)
+                bitmap = m_storage->getBitmap()->convert(m_pixelFormats[0], m_componentFormat);
+            else
+                bitmap = m_storage->getBitmap()->convertMultiSpectrumAlphaWeight(m_pixelFormats,
+                        m_componentFormat, m_channelNames);
         }
+        if (m_pixelFormats.size() == 1)
+            bitmap->setChannelNames(m_channelNames);
 
         if (m_banner && m_cropSize.x > bannerWidth+5 && m_cropSize.y > bannerHeight + 5 && m_pixelFormats.size() == 1) {
             int xoffs = m_cropSize.x - bannerWidth - 5,
@@ -519,7 +552,6 @@ public:
             filename.replace_extension(properExtension);
 
         Log(EInfo, "Writing image to \"%s\" ..", filename.string().c_str());
-        ref<FileStream> stream = new FileStream(filename, FileStream::ETruncWrite);
 
         if (m_pixelFormats.size() == 1)
             annotate(scene, m_properties, bitmap, renderTime, 1.0f);
@@ -533,7 +565,7 @@ public:
             bitmap->setMetadataString("log", log);
         }
 
-        bitmap->write(m_fileFormat, stream);
+        writeBitmap(bitmap, m_fileFormat, filename, async);
     }
 
     bool hasAlpha() const {
@@ -594,6 +626,7 @@ protected:
     bool m_attachLog;
     fs::path m_destFile;
     ref<ImageBlock> m_storage;
+    mutable ref<Mutex> m_mutex;
 };
 
 MTS_IMPLEMENT_CLASS_S(HDRFilm, false, Film)
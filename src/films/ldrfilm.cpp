@@ -73,6 +73,12 @@ MTS_NAMESPACE_BEGIN
  *       When \code{reinhard} tonemapping is active, this parameter in $[0,1]$ specifies how much
  *       highlights can burn out. \default{0, i.e. map all luminance values into the displayable range}
  *     }
+ *     \parameter{bloomFov}{\Float}{
+ *       When set to a value in $(0, 180)$, the image is convolved with a bloom filter
+ *       that simulates scattering in the human eye before it is tonemapped. The parameter
+ *       specifies the approximate field of view of the image in degrees, which determines
+ *       the shape of the filter. \default{0, i.e. no bloom}
+ *     }
  *     \parameter{banner}{\Boolean}{Include a banner in the
  *         output image?\default{\code{true}}
  *     }
@@ -108,6 +114,10 @@ MTS_NAMESPACE_BEGIN
  * preferable to use the photographic tonemapping technique by Reinhard et al.
  * \cite{Reinhard2002Photographic}, which can be activated by setting \code{tonemapMethod=reinhard}.
  *
+ * The optional bloom filter is the same one that is used by the batch tonemapper (\code{-B}).
+ * The convolution is done in frequency space; note that it is repeated every time the film
+ * is developed, including the intermediate images of progressive renderings.
+ *
  * Note that the interactive tonemapper that is available in the graphical user interface \code{mtsgui}
  * interoperates with this plugin. In particular, when saving the scene
  * (\emph{File}$\to$\emph{Save}), the currently active tonemapper
@@ -181,6 +191,10 @@ public:
         m_exposure = props.getFloat("exposure", 0.0f);
         m_reinhardKey = props.getFloat("key", 0.18f);
         m_reinhardBurn = props.getFloat("burn", 0.0);
+        m_bloomFov = props.getFloat("bloomFov", 0.0f);
+
+        if (m_bloomFov != 0 && (m_bloomFov <= 0 || m_bloomFov >= 180))
+            Log(EError, "The \"bloomFov\" parameter must be in the range (0, 180)!");
 
         std::vector<std::string> keys = props.getPropertyNames();
         for (size_t i=0; i<keys.size(); ++i) {
@@ -193,6 +207,8 @@ public:
         }
 
         m_storage = new ImageBlock(Bitmap::ESpectrumAlphaWeight, m_cropSize);
+        m_mutex = new Mutex();
+        configureBloom();
     }
 
     LDRFilm(Stream *stream, InstanceManager *manager)
@@ -205,6 +221,20 @@ public:
         m_exposure = stream->readFloat();
         m_reinhardKey = stream->readFloat();
         m_reinhardBurn = stream->readFloat();
+        m_bloomFov = stream->readFloat();
+        m_mutex = new Mutex();
+        configureBloom();
+    }
+
+    /// Precompute the bloom filter (if requested)
+    void configureBloom() {
+        if (m_bloomFov == 0)
+            return;
+        /* The filter must cover the whole image and have an odd size */
+        int size = std::max(m_cropSize.x, m_cropSize.y);
+        if (size % 2 == 0)
+            ++size;
+        m_bloomFilter = Bitmap::createBloomFilter(size, m_bloomFov);
     }
 
     void serialize(Stream *stream, InstanceManager *manager) const {
@@ -217,17 +247,34 @@ public:
         stream->writeFloat(m_exposure);
         stream->writeFloat(m_reinhardKey);
         stream->writeFloat(m_reinhardBurn);
+        stream->writeFloat(m_bloomFov);
     }
 
     void clear() {
+        LockGuard lock(m_mutex);
         m_storage->clear();
     }
 
     void put(const ImageBlock *block) {
+        LockGuard lock(m_mutex);
         m_storage->put(block);
     }
 
+    void saveState(Stream *stream) const {
+        LockGuard lock(m_mutex);
+        stream->writeInt(m_storage->getChannelCount());
+        m_storage->save(stream);
+    }
+
+    void loadState(Stream *stream) {
+        LockGuard lock(m_mutex);
+        if (stream->readInt() != m_storage->getChannelCount())
+            Log(EError, "loadState(): the stored image does not match the film configuration!");
+        m_storage->load(stream);
+    }
+
     void setBitmap(const Bitmap *bitmap, Float multiplier) {
+        LockGuard lock(m_mutex);
         bitmap->convert(m_storage->getBitmap(), multiplier);
     }
 
@@ -244,6 +291,7 @@ public:
             Log(EError, "addBitmap(): Unsupported bitmap format!");
         }
 
+        LockGuard lock(m_mutex);
         size_t nPixels = (size_t) size.x * (size_t) size.y;
         const Float *source = bitmap->getFloatData();
         Float *target = m_storage->getBitmap()->getFloatData();
@@ -260,6 +308,7 @@ public:
 
     bool develop(const Point2i &sourceOffset, const Vector2i &size,
             const Point2i &targetOffset, Bitmap *target) const {
+        LockGuard lock(m_mutex);
         const Bitmap *source = m_storage->getBitmap();
         const FormatConverter *cvt = FormatConverter::getInstance(
             std::make_pair(Bitmap::EFloat, target->getComponentFormat())
@@ -298,28 +347,52 @@ public:
     }
 
     void develop(const Scene *scene, Float renderTime) {
+        writeImage(scene, renderTime, false);
+    }
+
+    void developAsync(const Scene *scene, Float renderTime) {
+        writeImage(scene, renderTime, true);
+    }
+
+    void writeImage(const Scene *scene, Float renderTime, bool async) {
         if (m_destFile.empty())
             return;
 
         Log(EDebug, "Developing film ..");
 
-        ref<Bitmap> bitmap = m_storage->getBitmap();
+        ref<Bitmap> bitmap;
         Float multiplier = 1.0f;
 
-        if (m_tonemapMethod == EReinhard) {
-            bitmap = bitmap->convert(m_pixelFormat, Bitmap::EFloat);
+        if (m_tonemapMethod == EReinhard || m_bloomFilter) {
+            {
+                /* Take a snapshot of the film contents (single precision
+                   lets Bitmap::convolve() use its faster transform) */
+                LockGuard lock(m_mutex);
+                bitmap = m_storage->getBitmap()->convert(m_pixelFormat,
+                    m_bloomFilter ? Bitmap::EFloat32 : Bitmap::EFloat);
+            }
 
-            Float logAvgLuminance = 0, maxLuminance = 0; /* Unused */
-            bitmap->tonemapReinhard(logAvgLuminance, maxLuminance,
-                m_reinhardKey, m_reinhardBurn);
-            Log(EInfo, "Tonemapping finished (log-avg luminance=%f, max luminance=%f)",
-                logAvgLuminance, maxLuminance);
+            if (m_bloomFilter) {
+                Log(EDebug, "Convolving image with bloom filter ..");
+                bitmap->convolve(m_bloomFilter);
+            }
+
+            if (m_tonemapMethod == EReinhard) {
+                Float logAvgLuminance = 0, maxLuminance = 0; /* Unused */
+                bitmap->tonemapReinhard(logAvgLuminance, maxLuminance,
+                    m_reinhardKey, m_reinhardBurn);
+                Log(EInfo, "Tonemapping finished (log-avg luminance=%f, max luminance=%f)",
+                    logAvgLuminance, maxLuminance);
+            } else {
+                multiplier = std::pow((Float) 2, (Float) m_exposure);
+            }
+            bitmap = bitmap->convert(m_pixelFormat, Bitmap::EUInt8, m_gamma, multiplier);
         } else {
             multiplier = std::pow((Float) 2, (Float) m_exposure);
+            LockGuard lock(m_mutex);
+            bitmap = m_storage->getBitmap()->convert(m_pixelFormat, Bitmap::EUInt8, m_gamma, multiplier);
         }
 
-        bitmap = bitmap->convert(m_pixelFormat, Bitmap::EUInt8, m_gamma, multiplier);
-
         if (m_hasBanner && m_cropSize.x > bannerWidth+5 && m_cropSize.y > bannerHeight + 5) {
             int xoffs = m_cropSize.x - bannerWidth - 5,
                 yoffs = m_cropSize.y - bannerHeight - 5;
@@ -345,11 +418,14 @@ public:
             filename.replace_extension(expectedExtension);
 
         Log(EInfo, "Writing image to \"%s\" ..", filename.string().c_str());
-        ref<FileStream> stream = new FileStream(filename, FileStream::ETruncWrite);
 
         annotate(scene, m_properties, bitmap, renderTime, m_gamma);
 
-        bitmap->write(m_fileFormat, stream);
+        /* libpng filters and deflates the rows sequentially. Intermediate
+           images are overwritten shortly afterwards, hence use the fastest
+           compression level to keep the background writer from falling behind */
+        int compression = (async && m_fileFormat == Bitmap::EPNG) ? 1 : -1;
+        writeBitmap(bitmap, m_fileFormat, filename, async, compression);
     }
 
     bool hasAlpha() const {
@@ -387,6 +463,7 @@ public:
             << "  exposure = " << m_exposure << "," << endl
             << "  reinhardKey = " << m_reinhardKey << "," << endl
             << "  reinhardBurn = " << m_reinhardBurn << "," << endl
+            << "  bloomFov = " << m_bloomFov << "," << endl
             << "  filter = " << indent(m_filter->toString()) << endl
             << "]";
         return oss.str();
@@ -400,8 +477,11 @@ protected:
     fs::path m_destFile;
     Float m_gamma;
     ref<ImageBlock> m_storage;
+    mutable ref<Mutex> m_mutex;
     ETonemapMethod m_tonemapMethod;
     Float m_exposure, m_reinhardKey, m_reinhardBurn;
+    Float m_bloomFov;
+    ref<Bitmap> m_bloomFilter;
 };
 
 MTS_IMPLEMENT_CLASS_S(LDRFilm, false, Film)
@@ -172,6 +172,17 @@ public:
         m_storage->put(block);
     }
 
+    void saveState(Stream *stream) const {
+        stream->writeInt(m_storage->getChannelCount());
+        m_storage->save(stream);
+    }
+
+    void loadState(Stream *stream) {
+        if (stream->readInt() != m_storage->getChannelCount())
+            Log(EError, "loadState(): the stored image does not match the film configuration!");
+        m_storage->load(stream);
+    }
+
     void setBitmap(const Bitmap *bitmap, Float multiplier) {
         bitmap->convert(m_storage->getBitmap(), multiplier);
     }
@@ -156,6 +156,13 @@ public:
                 sensorSubpath.vertex(i-1)->rrWeight *
                 sensorSubpath.edge(i-1)->weight[ERadiance];
 
+        /* Cache partial sums of the MI weights along both subpaths. This
+           makes the cost of each connection independent of the path length */
+        emitterSubpath.cacheMIWeights(scene, EImportance,
+            m_config.sampleDirect, m_config.lightImage);
+        sensorSubpath.cacheMIWeights(scene, ERadiance,
+            m_config.sampleDirect, m_config.lightImage);
+
         Spectrum sampleValue(0.0f);
         for (int s = (int) emitterSubpath.vertexCount()-1; s >= 0; --s) {
             /* Determine the range of sensor vertices to be traversed,
@@ -280,7 +287,15 @@ public:
 
                 /* Compute the multiple importance sampling weight */
                 Float miWeight = Path::miWeight(scene, emitterSubpath, &connectionEdge,
-                    sensorSubpath, s, t, m_config.sampleDirect, m_config.lightImage);
+                    sensorSubpath, s, t, m_config.sampleDirect, m_config.lightImage, true);
+
+                #if defined(MTS_BD_DEBUG_HEAVY)
+                    std::ostringstream oss;
+                    if (!Path::verifyMIWeight(scene, emitterSubpath, &connectionEdge,
+                            sensorSubpath, s, t, m_config.sampleDirect,
+                            m_config.lightImage, oss))
+                        Log(EWarn, "%s", oss.str().c_str());
+                #endif
 
                 if (sampleDirect) {
                     /* Now undo the previous change */
@@ -360,7 +375,7 @@ void BDPTProcess::processResult(const WorkResult *wr, bool cancelled) {
     const BDPTWorkResult *result = static_cast<const BDPTWorkResult *>(wr);
     ImageBlock *block = const_cast<ImageBlock *>(result->getImageBlock());
     LockGuard lock(m_resultMutex);
-    m_progress->update(++m_resultCount);
+    m_progress->update(blockFinished(block->getOffset(), block->getSize()));
     if (m_config.lightImage) {
         const ImageBlock *lightImage = m_result->getLightImage();
         m_result->put(result);
@@ -363,7 +363,7 @@ void ERPTProcess::develop() {
 void ERPTProcess::processResult(const WorkResult *wr, bool cancelled) {
     const ERPTWorkResult *result = static_cast<const ERPTWorkResult *>(wr);
     UniqueLock lock(m_resultMutex);
-    m_progress->update(++m_resultCount);
+    m_progress->update(blockFinished(result->origOffset, result->origSize));
     m_accum->put(result);
     develop();
     lock.unlock();
@@ -165,6 +165,11 @@ public:
         return true;
     }
 
+    /// The stopping criterion needs all samples of a pixel
+    bool supportsSampleRanges() const {
+        return false;
+    }
+
     void renderBlock(const Scene *scene, const Sensor *sensor,
             Sampler *sampler, ImageBlock *block, const bool &stop,
             const std::vector< TPoint2<uint8_t> > &points) const {
@@ -151,16 +151,29 @@ public:
         proc->bindResource("sampler", samplerResID);
         scene->bindUsedResources(proc);
         bindUsedResources(proc);
+        if (m_checkpoint) {
+            proc->loadCheckpoint(m_checkpoint);
+            m_checkpoint = NULL;
+        }
         sched->schedule(proc);
 
+        m_processMutex->lock();
         m_process = proc;
+        m_processMutex->unlock();
         sched->wait(proc);
+        m_processMutex->lock();
         m_process = NULL;
+        m_processMutex->unlock();
         sched->unregisterResource(integratorResID);
 
         return proc->getReturnStatus() == ParallelProcess::ESuccess;
     }
 
+    /// renderBlock() writes the channels of all sub-integrators at once
+    bool supportsSampleRanges() const {
+        return false;
+    }
+
     void renderBlock(const Scene *scene,
             const Sensor *sensor, Sampler *sampler, ImageBlock *block,
             const bool &stop, const std::vector< TPoint2<uint8_t> > &points) const {
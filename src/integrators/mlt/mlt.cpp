@@ -303,7 +303,7 @@ public:
                 m_config, directImage, pathSeeds);
 
         m_config.luminance = pathSampler->generateSeeds(luminanceSamples,
-            m_config.workUnits, true, m_config.importanceMap, pathSeeds);
+            m_config.workUnits, true, m_config.importanceMap, pathSeeds, sceneResID);
 
         if (!nested)
             m_config.dump();
@@ -44,6 +44,11 @@ static StatsCounter avgPathLength("Path tracer", "Average path length", EAverage
  *        See page~\pageref{sec:hideemitters} for details.
  *        \default{no, i.e. \code{false}}
  *     }
+ *     \parameter{heroWavelength}{\Boolean}{Trace each path at a randomly
+ *        chosen set of wavelengths to obtain spectral results without
+ *        rebuilding Mitsuba? See the description below for details.
+ *        \default{no, i.e. \code{false}}
+ *     }
  * }
  *
  * This integrator implements a basic path tracer and is a \emph{good default choice}
@@ -100,6 +105,22 @@ static StatsCounter avgPathLength("Path tracer", "Average path length", EAverage
  * implicitly have \code{strictNormals} set to \code{true}. Hence, another use of this parameter
  * is to match renderings created by these methods.
  *
+ * \paragraph{Hero wavelength sampling:}
+ * Spectral rendering normally requires a build with a larger number of
+ * \code{SPECTRUM\_SAMPLES}, which makes every spectral computation
+ * correspondingly more expensive. When \code{heroWavelength} is set to
+ * \code{true}, each path instead carries as many randomly chosen wavelengths
+ * as a spectrum has entries (i.e. three in the RGB build). BSDFs, textures
+ * and emitters are still evaluated in the build's color representation;
+ * their values are upsampled to spectra and only looked up at these
+ * wavelengths. The result of each path is converted to the film's color
+ * space via CIE XYZ. The cost per path is thus close to that of an RGB
+ * rendering, and the image accounts for the spectral shape of repeated
+ * interreflections between colored surfaces. Wavelength-dependent effects
+ * of the BSDFs themselves (e.g. dispersion) are not captured. The mode
+ * also adds some color noise, and out-of-gamut colors lead to samples with
+ * negative components, which are accumulated as they are.
+ *
  * \remarks{
  *    \item This integrator does not handle participating media
  *    \item This integrator has poor convergence properties when rendering
@@ -110,11 +131,35 @@ static StatsCounter avgPathLength("Path tracer", "Average path length", EAverage
 class MIPathTracer : public MonteCarloIntegrator {
 public:
     MIPathTracer(const Properties &props)
-        : MonteCarloIntegrator(props) { }
+        : MonteCarloIntegrator(props) {
+        m_heroWavelength = props.getBoolean("heroWavelength", false);
+    }
 
     /// Unserialize from a binary data stream
     MIPathTracer(Stream *stream, InstanceManager *manager)
-        : MonteCarloIntegrator(stream, manager) { }
+        : MonteCarloIntegrator(stream, manager) {
+        m_heroWavelength = stream->readBool();
+    }
+
+    void configureSampler(const Scene *scene, Sampler *sampler) {
+        MonteCarloIntegrator::configureSampler(scene, sampler);
+        /* The wavelengths get a dimension of their own, so that all other
+           dimensions are used the same way as in RGB mode */
+        if (m_heroWavelength)
+            sampler->request1DArray(1);
+    }
+
+    void renderSampleRange(const Scene *scene, const Sensor *sensor,
+            Sampler *sampler, ImageBlock *block, const bool &stop,
+            const std::vector< TPoint2<uint8_t> > &points,
+            size_t sampleStart, size_t sampleEnd) const {
+        /* Out-of-gamut colors have negative components, which must not be
+           discarded as invalid samples (Li() checks the spectral values) */
+        if (m_heroWavelength)
+            block->setWarn(false);
+        MonteCarloIntegrator::renderSampleRange(scene, sensor, sampler,
+            block, stop, points, sampleStart, sampleEnd);
+    }
 
     Spectrum Li(const RayDifferential &r, RadianceQueryRecord &rRec) const {
         /* Some aliases and local variables */
@@ -132,13 +177,27 @@ public:
         Spectrum throughput(1.0f);
         Float eta = 1.0f;
 
+        /* In hero wavelength mode, all spectra below refer to the
+           wavelengths of this packet */
+        WavelengthPacket wavelengths;
+        const WavelengthPacket *packet = NULL;
+        if (m_heroWavelength) {
+            /* Nested queries (e.g. by an irradiance cache) can't use the
+               dimension that was requested in configureSampler() */
+            if (rRec.depth == 1 && !(rRec.extra & RadianceQueryRecord::ECacheQuery))
+                wavelengths.sample(rRec.sampler->next1DArray(1)[0]);
+            else
+                wavelengths.sample(rRec.nextSample1D());
+            packet = &wavelengths;
+        }
+
         while (rRec.depth <= m_maxDepth || m_maxDepth < 0) {
             if (!its.isValid()) {
                 /* If no intersection could be found, potentially return
                    radiance from a environment luminaire if it exists */
                 if ((rRec.type & RadianceQueryRecord::EEmittedRadiance)
                     && (!m_hideEmitters || scattered))
-                    Li += throughput * scene->evalEnvironment(ray);
+                    Li += throughput * light(scene->evalEnvironment(ray), packet);
                 break;
             }
 
@@ -147,11 +206,11 @@ public:
             /* Possibly include emitted radiance if requested */
             if (its.isEmitter() && (rRec.type & RadianceQueryRecord::EEmittedRadiance)
                 && (!m_hideEmitters || scattered))
-                Li += throughput * its.Le(-ray.d);
+                Li += throughput * light(its.Le(-ray.d), packet);
 
             /* Include radiance from a subsurface scattering model if requested */
             if (its.hasSubsurface() && (rRec.type & RadianceQueryRecord::ESubsurfaceRadiance))
-                Li += throughput * its.LoSub(scene, rRec.sampler, -ray.d, rRec.depth);
+                Li += throughput * light(its.LoSub(scene, rRec.sampler, -ray.d, rRec.depth), packet);
 
             if ((rRec.depth >= m_maxDepth && m_maxDepth > 0)
                 || (m_strictNormals && dot(ray.d, its.geoFrame.n)
@@ -194,7 +253,8 @@ public:
 
                         /* Weight using the power heuristic */
                         Float weight = miWeight(dRec.pdf, bsdfPdf);
-                        Li += throughput * value * bsdfVal * weight;
+                        Li += throughput * light(value, packet)
+                            * refl(bsdfVal, packet) * weight;
                     }
                 }
             }
@@ -249,7 +309,7 @@ public:
 
             /* Keep track of the throughput and relative
                refractive index along the path */
-            throughput *= bsdfWeight;
+            throughput *= refl(bsdfWeight, packet);
             eta *= bRec.eta;
 
             /* If a luminaire was hit, estimate the local illumination and
@@ -260,7 +320,7 @@ public:
                    implemented direct illumination sampling technique */
                 const Float lumPdf = (!(bRec.sampledType & BSDF::EDelta)) ?
                     scene->pdfEmitterDirect(dRec) : 0;
-                Li += throughput * value * miWeight(bsdfPdf, lumPdf);
+                Li += throughput * light(value, packet) * miWeight(bsdfPdf, lumPdf);
             }
 
             /* ==================================================================== */
@@ -290,7 +350,25 @@ public:
         avgPathLength.incrementBase();
         avgPathLength += rRec.depth;
 
-        return Li;
+        if (!packet)
+            return Li;
+
+        if (EXPECT_NOT_TAKEN(!Li.isValid())) {
+            Log(EWarn, "Invalid spectral sample value: %s", Li.toString().c_str());
+            return Spectrum(0.0f);
+        }
+
+        return packet->toSpectrum(Li);
+    }
+
+    /// Map a reflectance-type quantity onto the hero wavelengths (if any)
+    inline Spectrum refl(const Spectrum &value, const WavelengthPacket *packet) const {
+        return packet ? packet->upsample(value, Spectrum::EReflectance) : value;
+    }
+
+    /// Map an emitted radiance-type quantity onto the hero wavelengths (if any)
+    inline Spectrum light(const Spectrum &value, const WavelengthPacket *packet) const {
+        return packet ? packet->upsample(value, Spectrum::EIlluminant) : value;
     }
 
     inline Float miWeight(Float pdfA, Float pdfB) const {
@@ -301,6 +379,7 @@ public:
 
     void serialize(Stream *stream, InstanceManager *manager) const {
         MonteCarloIntegrator::serialize(stream, manager);
+        stream->writeBool(m_heroWavelength);
     }
 
     std::string toString() const {
@@ -308,12 +387,15 @@ public:
         oss << "MIPathTracer[" << endl
             << "  maxDepth = " << m_maxDepth << "," << endl
             << "  rrDepth = " << m_rrDepth << "," << endl
-            << "  strictNormals = " << m_strictNormals << endl
+            << "  strictNormals = " << m_strictNormals << "," << endl
+            << "  heroWavelength = " << m_heroWavelength << endl
             << "]";
         return oss.str();
     }
 
     MTS_DECLARE_CLASS()
+private:
+    bool m_heroWavelength;
 };
 
 MTS_IMPLEMENT_CLASS_S(MIPathTracer, false, MonteCarloIntegrator)
@@ -140,6 +140,12 @@ public:
             int sceneResID, int sensorResID, int samplerResID) {
         Integrator::preprocess(scene, queue, job, sceneResID, sensorResID, samplerResID);
 
+        /* The photon passes are not reproducible: their photon count depends
+           on the scheduling, and their samplers aren't keyed by the pass */
+        if (scene->getSampler()->isDeterministic())
+            Log(EError, "Deterministic rendering is not supported by the "
+                "progressive photon mapping integrators!");
+
         if (m_initialRadius == 0) {
             /* Guess an initial radius if not provided
               (scene width / horizontal or vertical pixel count) * 5 */
@@ -106,6 +106,9 @@ public:
         /* Maximum number of passes to render. -1 renders until the process is stopped. */
         m_maxPasses = props.getInteger("maxPasses", -1);
         m_mutex = new Mutex();
+        m_cond = new ConditionVariable(m_mutex);
+        m_checkpointStream = NULL;
+        m_rendering = false;
         if (m_maxDepth <= 1 && m_maxDepth != -1)
             Log(EError, "Maximum depth must be set to \"2\" or higher!");
         if (m_maxPasses <= 0 && m_maxPasses != -1)
@@ -124,11 +127,34 @@ public:
         m_running = false;
     }
 
+    bool saveCheckpoint(Stream *stream) {
+        /* Wait until the current pass is done */
+        LockGuard lock(m_mutex);
+        if (!m_rendering)
+            return false;
+        m_checkpointStream = stream;
+        while (m_checkpointStream != NULL && m_rendering)
+            m_cond->wait();
+        bool saved = m_checkpointStream == NULL;
+        m_checkpointStream = NULL;
+        return saved;
+    }
+
+    void loadCheckpoint(Stream *stream) {
+        m_checkpoint = stream;
+    }
+
 
     bool preprocess(const Scene *scene, RenderQueue *queue, const RenderJob *job,
             int sceneResID, int sensorResID, int samplerResID) {
         Integrator::preprocess(scene, queue, job, sceneResID, sensorResID, samplerResID);
 
+        /* The photon passes are not reproducible: their photon count depends
+           on the scheduling, and their samplers aren't keyed by the pass */
+        if (scene->getSampler()->isDeterministic())
+            Log(EError, "Deterministic rendering is not supported by the "
+                "progressive photon mapping integrators!");
+
         if (m_initialRadius == 0) {
             /* Guess an initial radius if not provided
               (use scene width / horizontal or vertical pixel count) * 5 */
@@ -179,10 +205,22 @@ public:
             }
         }
 
-        /* Create a sampler instance for every core */
+        /* Continue from a checkpoint, which also restores the state of the samplers */
+        int it = 0;
+        ref_vector<Sampler> restoredSamplers;
+        if (m_checkpoint) {
+            it = loadState(m_checkpoint, restoredSamplers);
+            m_checkpoint = NULL;
+            sampler = restoredSamplers.back();
+        }
+
+        /* Create a sampler instance for every core. They are used by both
+           the gather point and the photon passes, hence the checkpoint
+           covers the random state of the entire rendering */
         std::vector<SerializableObject *> samplers(sched->getCoreCount());
         for (size_t i=0; i<sched->getCoreCount(); ++i) {
-            ref<Sampler> clonedSampler = sampler->clone();
+            ref<Sampler> clonedSampler = i < restoredSamplers.size()
+                ? restoredSamplers[i] : sampler->clone();
             clonedSampler->incRef();
             samplers[i] = clonedSampler.get();
         }
@@ -197,13 +235,29 @@ public:
         Thread::initializeOpenMP(nCores);
 #endif
 
-        int it = 0;
+        m_mutex->lock();
+        m_rendering = true;
+        m_mutex->unlock();
+
         while (m_running && (m_maxPasses == -1 || it < m_maxPasses)) {
             distributedRTPass(scene, samplers);
             photonMapPass(++it, queue, job, film, sceneResID,
                     sensorResID, samplerResID);
+
+            /* Checkpoints are taken in between two passes */
+            LockGuard lock(m_mutex);
+            if (m_checkpointStream) {
+                saveState(m_checkpointStream, it, samplers);
+                m_checkpointStream = NULL;
+                m_cond->broadcast();
+            }
         }
 
+        m_mutex->lock();
+        m_rendering = false;
+        m_cond->broadcast();
+        m_mutex->unlock();
+
 #ifdef MTS_DEBUG_FP
         disableFPExceptions();
 #endif
@@ -215,6 +269,59 @@ public:
         return true;
     }
 
+    /// Write the gather point statistics and the per-core sampler states after pass \c it
+    void saveState(Stream *stream, int it,
+            const std::vector<SerializableObject *> &samplers) const {
+        stream->writeInt(it);
+        stream->writeSize(m_totalEmitted);
+        stream->writeSize(m_totalPhotons);
+        stream->writeSize(m_gatherBlocks.size());
+        for (size_t i=0; i<m_gatherBlocks.size(); ++i) {
+            const std::vector<GatherPoint> &gatherPoints = m_gatherBlocks[i];
+            stream->writeSize(gatherPoints.size());
+            for (size_t j=0; j<gatherPoints.size(); ++j) {
+                const GatherPoint &gp = gatherPoints[j];
+                stream->writeFloat(gp.radius);
+                stream->writeFloat(gp.N);
+                gp.flux.serialize(stream);
+            }
+        }
+
+        ref<InstanceManager> manager = new InstanceManager();
+        stream->writeSize(samplers.size());
+        for (size_t i=0; i<samplers.size(); ++i)
+            manager->serialize(stream, samplers[i]);
+    }
+
+    /// Restore the state written by \ref saveState() and return the number of finished passes
+    int loadState(Stream *stream, ref_vector<Sampler> &samplers) {
+        int it = stream->readInt();
+        m_totalEmitted = stream->readSize();
+        m_totalPhotons = stream->readSize();
+        if (stream->readSize() != m_gatherBlocks.size())
+            Log(EError, "The checkpoint does not match the image layout!");
+        for (size_t i=0; i<m_gatherBlocks.size(); ++i) {
+            std::vector<GatherPoint> &gatherPoints = m_gatherBlocks[i];
+            if (stream->readSize() != gatherPoints.size())
+                Log(EError, "The checkpoint does not match the image layout!");
+            for (size_t j=0; j<gatherPoints.size(); ++j) {
+                GatherPoint &gp = gatherPoints[j];
+                gp.radius = stream->readFloat();
+                gp.N = stream->readFloat();
+                gp.flux = Spectrum(stream);
+            }
+        }
+
+        ref<InstanceManager> manager = new InstanceManager();
+        size_t samplerCount = stream->readSize();
+        for (size_t i=0; i<samplerCount; ++i)
+            samplers.push_back(static_cast<Sampler *>(manager->getInstance(stream)));
+
+        Log(EInfo, "Resuming after pass %i (" SIZE_T_FMT " photons so far)",
+            it, m_totalPhotons);
+        return it;
+    }
+
     void distributedRTPass(Scene *scene, std::vector<SerializableObject *> &samplers) {
         ref<Sensor> sensor = scene->getSensor();
         bool needsApertureSample = sensor->needsApertureSample();
@@ -399,6 +506,7 @@ private:
     std::vector<std::vector<GatherPoint> > m_gatherBlocks;
     std::vector<Point2i> m_offset;
     ref<Mutex> m_mutex;
+    ref<ConditionVariable> m_cond;
     ref<Bitmap> m_bitmap;
     Float m_initialRadius, m_alpha;
     int m_photonCount, m_granularity;
@@ -407,6 +515,11 @@ private:
     bool m_running;
     bool m_autoCancelGathering;
     int m_maxPasses;
+
+    /* Checkpoints */
+    Stream *m_checkpointStream;
+    ref<Stream> m_checkpoint;
+    bool m_rendering;
 };
 
 MTS_IMPLEMENT_CLASS_S(SPPMIntegrator, false, Integrator)
@@ -244,12 +244,16 @@ public:
 
         /* Stop MLT after X seconds -- useful for equal-time comparisons */
         m_config.timeout = props.getInteger("timeout", 0);
+        m_generation = 0;
+        m_processMutex = new Mutex();
     }
 
     /// Unserialize from a binary data stream
     PSSMLT(Stream *stream, InstanceManager *manager)
      : Integrator(stream, manager) {
         m_config = PSSMLTConfiguration(stream);
+        m_generation = 0;
+        m_processMutex = new Mutex();
         configure();
     }
 
@@ -281,7 +285,28 @@ public:
         ref<RenderJob> nested = m_nestedJob;
         if (nested)
             nested->cancel();
-        Scheduler::getInstance()->cancel(m_process);
+        m_processMutex->lock();
+        ref<ParallelProcess> process = m_process;
+        m_processMutex->unlock();
+        if (process)
+            Scheduler::getInstance()->cancel(process);
+    }
+
+    bool saveCheckpoint(Stream *stream) {
+        /* The checkpoint writer runs on a separate thread */
+        m_processMutex->lock();
+        ref<ParallelProcess> process = m_process;
+        m_processMutex->unlock();
+        if (!process)
+            return false;
+        stream->writeUInt(m_generation);
+        stream->writeFloat(m_config.luminance);
+        stream->writeInt(m_config.workUnits);
+        return static_cast<PSSMLTProcess *>(process.get())->saveCheckpoint(stream);
+    }
+
+    void loadCheckpoint(Stream *stream) {
+        m_checkpoint = stream;
     }
 
     bool render(Scene *scene, RenderQueue *queue, const RenderJob *job,
@@ -294,6 +319,17 @@ public:
         size_t sampleCount = sampler->getSampleCount();
         m_config.importanceMap = NULL;
 
+        /* The chains that remain after resuming from a checkpoint must
+           use different random numbers than those of the previous runs */
+        m_generation = 0;
+        Float luminance = 0;
+        int workUnits = 0;
+        if (m_checkpoint) {
+            m_generation = m_checkpoint->readUInt() + 1;
+            luminance = m_checkpoint->readFloat();
+            workUnits = m_checkpoint->readInt();
+        }
+
         if (m_config.twoStage && !m_config.firstStage) {
             Log(EInfo, "Executing first MLT stage");
             ref<Timer> timer = new Timer();
@@ -328,6 +364,9 @@ public:
             m_config.workUnits = (int) std::max(workUnits, (size_t) 1);
         }
 
+        if (m_checkpoint && workUnits != m_config.workUnits)
+            Log(EError, "The checkpoint was written with a different number of work units!");
+
         size_t luminanceSamples = m_config.luminanceSamples;
         if (luminanceSamples < (size_t) m_config.workUnits * 10) {
             luminanceSamples = (size_t) m_config.workUnits * 10;
@@ -347,7 +386,8 @@ public:
         }
 
         std::vector<PathSeed> pathSeeds;
-        ref<ReplayableSampler> rplSampler = new ReplayableSampler();
+        ref<ReplayableSampler> rplSampler = m_generation == 0
+            ? new ReplayableSampler() : new ReplayableSampler(m_generation);
         ref<PathSampler> pathSampler = new PathSampler(m_config.technique, scene,
             rplSampler, rplSampler, rplSampler, m_config.maxDepth, m_config.rrDepth,
             m_config.separateDirect, m_config.directSampling);
@@ -356,13 +396,19 @@ public:
                 m_config, directImage, pathSeeds);
 
         m_config.luminance = pathSampler->generateSeeds(luminanceSamples,
-            m_config.workUnits, false, m_config.importanceMap, pathSeeds);
+            m_config.workUnits, false, m_config.importanceMap, pathSeeds, sceneResID);
+
+        /* Keep the normalization of the chains that are already done */
+        if (m_checkpoint)
+            m_config.luminance = luminance;
 
         if (!nested)
             m_config.dump();
 
         /* Create a sampler instance for each worker */
         ref<PSSMLTSampler> mltSampler = new PSSMLTSampler(m_config);
+        if (m_generation > 0)
+            mltSampler->getRandom()->seed((uint64_t) m_generation);
         std::vector<SerializableObject *> mltSamplers(scheduler->getCoreCount());
         for (size_t i=0; i<mltSamplers.size(); ++i) {
             ref<Sampler> clonedSampler = mltSampler->clone();
@@ -378,11 +424,19 @@ public:
         process->bindResource("sensor", sensorResID);
         process->bindResource("sampler", mltSamplerResID);
         process->bindResource("rplSampler", rplSamplerResID);
+        if (m_checkpoint) {
+            process->loadCheckpoint(m_checkpoint);
+            m_checkpoint = NULL;
+        }
 
+        m_processMutex->lock();
         m_process = process;
+        m_processMutex->unlock();
         scheduler->schedule(process);
         scheduler->wait(process);
+        m_processMutex->lock();
         m_process = NULL;
+        m_processMutex->unlock();
         scheduler->unregisterResource(rplSamplerResID);
         process->develop();
 
@@ -392,8 +446,11 @@ public:
     MTS_DECLARE_CLASS()
 private:
     ref<ParallelProcess> m_process;
+    ref<Mutex> m_processMutex;
     ref<RenderJob> m_nestedJob;
     PSSMLTConfiguration m_config;
+    ref<Stream> m_checkpoint;
+    uint32_t m_generation;
 };
 
 MTS_IMPLEMENT_CLASS_S(PSSMLT, false, Integrator)
@@ -94,13 +94,14 @@ public:
         m_emitterSampler->reset();
         m_sensorSampler->reset();
         m_directSampler->reset();
-        m_sensorSampler->setRandom(m_rplSampler->getRandom());
-        m_emitterSampler->setRandom(m_rplSampler->getRandom());
-        m_directSampler->setRandom(m_rplSampler->getRandom());
+        m_sensorSampler->setRandom(m_rplSampler->getRandom(), true);
+        m_emitterSampler->setRandom(m_rplSampler->getRandom(), true);
+        m_directSampler->setRandom(m_rplSampler->getRandom(), true);
 
         /* Generate the initial sample by replaying the seeding random
            number stream at the appropriate position. Afterwards, revert
            back to this worker's own source of random numbers */
+        m_rplSampler->setStreamIndex(seed.streamIndex);
         m_rplSampler->setSampleIndex(seed.sampleIndex);
 
         m_pathSampler->sampleSplats(Point2i(-1), *current);
@@ -264,6 +265,7 @@ PSSMLTProcess::PSSMLTProcess(const RenderJob *parent, RenderQueue *queue,
     m_resultMutex = new Mutex();
     m_resultCounter = 0;
     m_workCounter = 0;
+    m_cancelled = false;
     m_refreshTimeout = 1;
 }
 
@@ -314,6 +316,7 @@ void PSSMLTProcess::processResult(const WorkResult *wr, bool cancelled) {
     const ImageBlock *result = static_cast<const ImageBlock *>(wr);
     m_accum->put(result);
     m_progress->update(++m_resultCounter);
+    m_cancelled |= cancelled;
     m_refreshTimeout = std::min(2000U, m_refreshTimeout * 2);
 
     /* Re-develop the entire image every two seconds if partial results are
@@ -322,6 +325,24 @@ void PSSMLTProcess::processResult(const WorkResult *wr, bool cancelled) {
         develop();
 }
 
+bool PSSMLTProcess::saveCheckpoint(Stream *stream) {
+    LockGuard lock(m_resultMutex);
+    if (m_cancelled)
+        return false;
+    stream->writeInt(m_resultCounter);
+    m_accum->save(stream);
+    return true;
+}
+
+void PSSMLTProcess::loadCheckpoint(Stream *stream) {
+    LockGuard lock(m_resultMutex);
+    m_resultCounter = m_workCounter = stream->readInt();
+    m_accum->load(stream);
+    m_progress->update(m_resultCounter);
+    Log(EInfo, "Resuming with %i of %i Markov chains done",
+        m_resultCounter, m_config.workUnits);
+}
+
 ParallelProcess::EStatus PSSMLTProcess::generateWork(WorkUnit *unit, int worker) {
     int timeout = 0;
     if (m_config.timeout > 0) {
@@ -39,6 +39,23 @@ public:
 
     void develop();
 
+    /**
+     * \brief Write the accumulated image and the number of finished
+     * chains to a checkpoint
+     *
+     * Chains that are still running are not part of the checkpoint.
+     * \return \c false if the process was cancelled
+     */
+    bool saveCheckpoint(Stream *stream);
+
+    /**
+     * \brief Continue from a checkpoint written by \ref saveCheckpoint()
+     *
+     * Only the remaining chains are started, using the seeds at the end
+     * of the seed list. Must be called after the resources have been bound.
+     */
+    void loadCheckpoint(Stream *stream);
+
     /* ParallelProcess impl. */
     void processResult(const WorkResult *wr, bool cancelled);
     ref<WorkProcessor> createWorkProcessor() const;
@@ -61,6 +78,7 @@ private:
     ref<Mutex> m_resultMutex;
     ref<Film> m_film;
     int m_resultCounter, m_workCounter;
+    bool m_cancelled;
     unsigned int m_refreshTimeout;
     ref<Timer> m_timeoutTimer, m_refreshTimer;
 };
@@ -56,6 +56,8 @@ void PSSMLTSampler::configure() {
     m_largeStep = false;
     m_sampleIndex = 0;
     m_sampleCount = 0;
+    m_cacheIndex = MTS_PSSMLT_CACHE_SIZE;
+    m_replay = false;
 }
 
 PSSMLTSampler::~PSSMLTSampler() { }
@@ -82,17 +84,17 @@ void PSSMLTSampler::reject() {
 
 Float PSSMLTSampler::primarySample(size_t i) {
     while (i >= m_u.size())
-        m_u.push_back(SampleStruct(m_random->nextFloat()));
+        m_u.push_back(SampleStruct(nextUniform()));
 
     if (m_u[i].modify < m_time) {
         if (m_largeStep) {
             m_backup.push_back(std::pair<size_t, SampleStruct>(i, m_u[i]));
             m_u[i].modify = m_time;
-            m_u[i].value = m_random->nextFloat();
+            m_u[i].value = nextUniform();
         } else {
             if (m_u[i].modify < m_largeStepTime) {
                 m_u[i].modify = m_largeStepTime;
-                m_u[i].value = m_random->nextFloat();
+                m_u[i].value = nextUniform();
             }
 
             while (m_u[i].modify + 1 < m_time) {
@@ -24,6 +24,9 @@
 #include <mitsuba/core/random.h>
 #include "pssmlt.h"
 
+/// Number of uniform variates that are generated at a time
+#define MTS_PSSMLT_CACHE_SIZE 64
+
 MTS_NAMESPACE_BEGIN
 
 /**
@@ -69,7 +72,7 @@ public:
     /// 1D mutation routine
     inline Float mutate(Float value) {
         #if KELEMEN_STYLE_MUTATIONS == 1
-            Float sample = m_random->nextFloat();
+            Float sample = nextUniform();
             bool add;
 
             if (sample < 0.5f) {
@@ -91,8 +94,8 @@ public:
                     value += 1;
             }
         #else
-            Float tmp1 = std::sqrt(-2 * std::log(1-m_random->nextFloat()));
-            Float dv = tmp1 * std::cos(2*M_PI*m_random->nextFloat());
+            Float tmp1 = std::sqrt(-2 * std::log(1-nextUniform()));
+            Float dv = tmp1 * std::cos(2*M_PI*nextUniform());
             value = modulo(value + 1e-2f * dv, 1.0f);
         #endif
 
@@ -111,8 +114,20 @@ public:
     /// Reject a mutation
     void reject();
 
-    /// Replace the underlying random number generator
-    inline void setRandom(Random *random) { m_random = random; }
+    /**
+     * \brief Replace the underlying random number generator
+     *
+     * \param replay
+     *    Draw the values one at a time instead of in blocks? This is
+     *    needed when several samplers share a generator that replays the
+     *    stream of a seed path, since the values must then be consumed in
+     *    exactly the same order as during the seeding pass.
+     */
+    inline void setRandom(Random *random, bool replay = false) {
+        m_random = random;
+        m_replay = replay;
+        m_cacheIndex = MTS_PSSMLT_CACHE_SIZE;
+    }
 
     /// Return the underlying random number generator
     inline Random *getRandom() { return m_random; }
@@ -132,6 +147,20 @@ protected:
     /// Virtual destructor
     virtual ~PSSMLTSampler();
 protected:
+    /**
+     * \brief Return a uniform variate from a block of values that is
+     * refilled using the batch interface of \ref Random
+     */
+    inline Float nextUniform() {
+        if (m_replay)
+            return m_random->nextFloat();
+        if (EXPECT_NOT_TAKEN(m_cacheIndex == MTS_PSSMLT_CACHE_SIZE)) {
+            m_random->nextFloat(m_cache, MTS_PSSMLT_CACHE_SIZE);
+            m_cacheIndex = 0;
+        }
+        return m_cache[m_cacheIndex++];
+    }
+
     struct SampleStruct {
         Float value;
         size_t modify;
@@ -146,6 +175,9 @@ protected:
     std::vector<SampleStruct> m_u;
     size_t m_time, m_largeStepTime;
     Float m_probLargeStep;
+    Float m_cache[MTS_PSSMLT_CACHE_SIZE];
+    size_t m_cacheIndex;
+    bool m_replay;
 };
 
 MTS_NAMESPACE_END
@@ -35,9 +35,11 @@ MTS_NAMESPACE_BEGIN
  *     }
  *     \parameter{granularity}{\Integer}{
  *        Specifies the work unit granularity used to parallize the particle
- *        tracing task. This should be set high enough so that accumulating
- *        partially exposed images (and potentially sending them over the network)
- *        is not the bottleneck.
+ *        tracing task. Each work unit produces a list of the sensor splats
+ *        created by its particles, hence this parameter also bounds the
+ *        memory used by a work result (which does not depend on the film
+ *        resolution). It should be set high enough so that the scheduling
+ *        and network overhead per work unit is not the bottleneck.
  *        \default{200K particles per work unit, i.e. \code{200000}}
  *     }
  *     \parameter{bruteForce}{\Boolean}{
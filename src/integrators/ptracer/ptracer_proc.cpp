@@ -25,19 +25,29 @@ MTS_NAMESPACE_BEGIN
 /* ==================================================================== */
 
 void CaptureParticleWorkResult::load(Stream *stream) {
-    size_t nEntries = (size_t) m_size.x * (size_t) m_size.y;
-    stream->readFloatArray(reinterpret_cast<Float *>(m_bitmap->getFloatData()),
-        nEntries * SPECTRUM_SAMPLES);
+    size_t splatCount = stream->readSize();
+    m_splats.resize(splatCount * SplatStride);
+    if (splatCount > 0)
+        stream->readFloatArray(&m_splats[0], m_splats.size());
     m_range->load(stream);
 }
 
 void CaptureParticleWorkResult::save(Stream *stream) const {
-    size_t nEntries = (size_t) m_size.x * (size_t) m_size.y;
-    stream->writeFloatArray(reinterpret_cast<const Float *>(m_bitmap->getFloatData()),
-        nEntries * SPECTRUM_SAMPLES);
+    stream->writeSize(getSplatCount());
+    if (!m_splats.empty())
+        stream->writeFloatArray(&m_splats[0], m_splats.size());
     m_range->save(stream);
 }
 
+std::string CaptureParticleWorkResult::toString() const {
+    std::ostringstream oss;
+    oss << "CaptureParticleWorkResult[" << endl
+        << "  range = " << indent(m_range->toString()) << "," << endl
+        << "  splatCount = " << getSplatCount() << endl
+        << "]";
+    return oss.str();
+}
+
 /* ==================================================================== */
 /*                         Work processor impl.                         */
 /* ==================================================================== */
@@ -57,7 +67,6 @@ void CaptureParticleWorker::serialize(Stream *stream, InstanceManager *manager)
 void CaptureParticleWorker::prepare() {
     ParticleTracer::prepare();
     m_sensor = static_cast<Sensor *>(getResource("sensor"));
-    m_rfilter = m_sensor->getFilm()->getReconstructionFilter();
 }
 
 ref<WorkProcessor> CaptureParticleWorker::clone() const {
@@ -66,8 +75,7 @@ ref<WorkProcessor> CaptureParticleWorker::clone() const {
 }
 
 ref<WorkResult> CaptureParticleWorker::createWorkResult() const {
-    const Film *film = m_sensor->getFilm();
-    return new CaptureParticleWorkResult(film->getCropSize(), m_rfilter.get());
+    return new CaptureParticleWorkResult();
 }
 
 void CaptureParticleWorker::process(const WorkUnit *workUnit, WorkResult *workResult,
@@ -102,8 +110,8 @@ void CaptureParticleWorker::handleEmission(const PositionSamplingRecord &pRec,
     const Emitter *emitter = static_cast<const Emitter *>(pRec.object);
     value *= emitter->evalDirection(DirectionSamplingRecord(dRec.d), pRec);
 
-    /* Splat onto the accumulation buffer */
-    m_workResult->put(dRec.uv, (Float *) &value[0]);
+    /* Record a splat for the accumulation buffer */
+    m_workResult->put(dRec.uv, value);
 }
 
 void CaptureParticleWorker::handleSurfaceInteraction(int depth, int nullInteractions,
@@ -124,7 +132,7 @@ void CaptureParticleWorker::handleSurfaceInteraction(int depth, int nullInteract
         if (value.isZero())
             return;
 
-        m_workResult->put(uv, (Float *) &value[0]);
+        m_workResult->put(uv, value);
         return;
     }
 
@@ -160,8 +168,8 @@ void CaptureParticleWorker::handleSurfaceInteraction(int depth, int nullInteract
         (Frame::cosTheta(bRec.wo) * wiDotGeoN));
     value *= bsdf->eval(bRec) * correction;
 
-    /* Splat onto the accumulation buffer */
-    m_workResult->put(dRec.uv, (Float *) &value[0]);
+    /* Record a splat for the accumulation buffer */
+    m_workResult->put(dRec.uv, value);
 }
 
 void CaptureParticleWorker::handleMediumInteraction(int depth, int nullInteractions, bool caustic,
@@ -189,8 +197,8 @@ void CaptureParticleWorker::handleMediumInteraction(int depth, int nullInteracti
     if (value.isZero())
         return;
 
-    /* Splat onto the accumulation buffer */
-    m_workResult->put(dRec.uv, (Float *) &value[0]);
+    /* Record a splat for the accumulation buffer */
+    m_workResult->put(dRec.uv, value);
 }
 
 /* ==================================================================== */
@@ -198,6 +206,13 @@ void CaptureParticleWorker::handleMediumInteraction(int depth, int nullInteracti
 /* ==================================================================== */
 
 void CaptureParticleProcess::develop() {
+    /* Assemble the film from the shards (including their borders) */
+    m_accum->clear();
+    for (size_t i=0; i<m_shards.size(); ++i) {
+        LockGuard lock(m_shardMutexes[i]);
+        m_accum->put(m_shards[i]);
+    }
+
     Float weight = (m_accum->getWidth() * m_accum->getHeight())
         / (Float) m_receivedResultCount;
     m_film->setBitmap(m_accum->getBitmap(), weight);
@@ -211,9 +226,36 @@ void CaptureParticleProcess::processResult(const WorkResult *wr, bool cancelled)
     if (cancelled)
         return;
 
+    /* Sort the splats by the shard containing their center (counting sort) */
+    size_t splatCount = result->getSplatCount(),
+           shardCount = m_shards.size();
+    int height = m_accum->getHeight();
+    std::vector<size_t> start(shardCount + 1, 0), order(splatCount);
+    std::vector<uint32_t> shardIndex(splatCount);
+    for (size_t i=0; i<splatCount; ++i) {
+        int y = math::clamp((int) std::floor(result->getPosition(i).y), 0, height - 1);
+        shardIndex[i] = (uint32_t) (y / m_shardHeight);
+        start[shardIndex[i] + 1]++;
+    }
+    for (size_t i=0; i<shardCount; ++i)
+        start[i+1] += start[i];
+    std::vector<size_t> pos(start.begin(), start.end() - 1);
+    for (size_t i=0; i<splatCount; ++i)
+        order[pos[shardIndex[i]]++] = i;
+
+    /* Rasterize into the shards, which may concurrently
+       receive splats from other work results */
+    for (size_t i=0; i<shardCount; ++i) {
+        if (start[i] == start[i+1])
+            continue;
+        LockGuard lock(m_shardMutexes[i]);
+        ImageBlock *shard = m_shards[i];
+        for (size_t j=start[i]; j<start[i+1]; ++j)
+            shard->put(result->getPosition(order[j]), result->getValue(order[j]));
+    }
+
     LockGuard lock(m_resultMutex);
     increaseResultCount(range->getSize());
-    m_accum->put(result);
     if (m_job->isInteractive() || m_receivedResultCount == m_workCount)
         develop();
 }
@@ -222,8 +264,26 @@ void CaptureParticleProcess::bindResource(const std::string &name, int id) {
     if (name == "sensor") {
         Sensor *sensor = static_cast<Sensor *>(Scheduler::getInstance()->getResource(id));
         m_film = sensor->getFilm();
-        m_accum = new ImageBlock(Bitmap::ESpectrum, m_film->getCropSize(), NULL);
+        Vector2i cropSize = m_film->getCropSize();
+        m_accum = new ImageBlock(Bitmap::ESpectrum, cropSize, NULL);
         m_accum->clear();
+
+        /* Use a few shards per core to keep lock contention low */
+        int shardCount = (int) std::min((size_t) cropSize.y,
+            4 * Scheduler::getInstance()->getCoreCount());
+        m_shardHeight = (cropSize.y + shardCount - 1) / shardCount;
+        m_shards.clear();
+        m_shardMutexes.clear();
+        for (int y=0; y<cropSize.y; y += m_shardHeight) {
+            Vector2i size(cropSize.x, std::min(m_shardHeight, cropSize.y - y));
+            ref<ImageBlock> shard = new ImageBlock(Bitmap::ESpectrum, size,
+                m_film->getReconstructionFilter());
+            shard->setOffset(Point2i(0, y));
+            shard->setSize(size);
+            shard->clear();
+            m_shards.push_back(shard);
+            m_shardMutexes.push_back(new Mutex());
+        }
     }
     ParticleProcess::bindResource(name, id);
 }
@@ -234,7 +294,7 @@ ref<WorkProcessor> CaptureParticleProcess::createWorkProcessor() const {
 }
 
 MTS_IMPLEMENT_CLASS(CaptureParticleProcess, false, ParticleProcess)
-MTS_IMPLEMENT_CLASS(CaptureParticleWorkResult, false, ImageBlock)
+MTS_IMPLEMENT_CLASS(CaptureParticleWorkResult, false, WorkResult)
 MTS_IMPLEMENT_CLASS_S(CaptureParticleWorker, false, ParticleTracer)
 MTS_NAMESPACE_END
 
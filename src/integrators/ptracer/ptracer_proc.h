@@ -32,14 +32,20 @@ MTS_NAMESPACE_BEGIN
 
 /**
  * \brief Packages the result of a particle tracing work unit. Contains
- * the range of traced particles plus a snapshot of the sensor film.
+ * the range of traced particles plus a list of the sensor splats that
+ * were generated while tracing them.
+ *
+ * The splats are stored unfiltered, hence the size of a work result only
+ * depends on the number of particles in the work unit and not on the film
+ * resolution. They are rasterized when the result is merged by
+ * \ref CaptureParticleProcess.
  */
-class CaptureParticleWorkResult : public ImageBlock {
+class CaptureParticleWorkResult : public WorkResult {
 public:
-    inline CaptureParticleWorkResult(const Vector2i &res, const ReconstructionFilter *filter)
-     : ImageBlock(Bitmap::ESpectrum, res, filter) {
-        setOffset(Point2i(0, 0));
-        setSize(res);
+    /// Number of \c Float values per splat (position and spectrum)
+    static const int SplatStride = 2 + SPECTRUM_SAMPLES;
+
+    inline CaptureParticleWorkResult() {
         m_range = new RangeWorkUnit();
     }
 
@@ -51,9 +57,36 @@ public:
         m_range->set(range);
     }
 
+    /// Append a splat at the given fractional pixel position
+    inline void put(const Point2 &pos, const Spectrum &value) {
+        m_splats.push_back(pos.x);
+        m_splats.push_back(pos.y);
+        for (int i=0; i<SPECTRUM_SAMPLES; ++i)
+            m_splats.push_back(value[i]);
+    }
+
+    /// Return the number of stored splats
+    inline size_t getSplatCount() const {
+        return m_splats.size() / SplatStride;
+    }
+
+    /// Return the position of the i-th splat
+    inline Point2 getPosition(size_t i) const {
+        return Point2(m_splats[i*SplatStride], m_splats[i*SplatStride+1]);
+    }
+
+    /// Return a pointer to the spectral value of the i-th splat
+    inline const Float *getValue(size_t i) const {
+        return &m_splats[i*SplatStride + 2];
+    }
+
+    /// Remove all splats (the allocated memory is kept for reuse)
+    inline void clear() { m_splats.clear(); }
+
     /* Work unit implementation */
     void load(Stream *stream);
     void save(Stream *stream) const;
+    std::string toString() const;
 
     MTS_DECLARE_CLASS()
 protected:
@@ -61,6 +94,7 @@ protected:
     virtual ~CaptureParticleWorkResult() { }
 protected:
     ref<RangeWorkUnit> m_range;
+    std::vector<Float> m_splats;
 };
 
 
@@ -123,7 +157,6 @@ protected:
     virtual ~CaptureParticleWorker() { }
 private:
     ref<const Sensor> m_sensor;
-    ref<const ReconstructionFilter> m_rfilter;
     ref<CaptureParticleWorkResult> m_workResult;
     int m_maxPathDepth;
     bool m_bruteForce;
@@ -135,6 +168,12 @@ private:
 /**
  * Parallel particle tracing process - used to run this over
  * a group of machines
+ *
+ * Incoming splat lists are rasterized into a set of horizontal film
+ * shards, each of which is protected by its own lock. Results arriving
+ * concurrently from different workers can therefore be merged in parallel,
+ * and only a single copy of the film is kept regardless of the number of
+ * cores. The shards are assembled in \ref develop().
  */
 class CaptureParticleProcess : public ParticleProcess {
 public:
@@ -163,6 +202,9 @@ private:
     ref<RenderQueue> m_queue;
     ref<Film> m_film;
     ref<ImageBlock> m_accum;
+    ref_vector<ImageBlock> m_shards;
+    ref_vector<Mutex> m_shardMutexes;
+    int m_shardHeight;
     int m_maxDepth;
     int m_maxPathDepth;
     int m_rrDepth;
@@ -263,9 +263,23 @@ bool Path::operator==(const Path &path) const {
     return true;
 }
 
+/// Inverse geometric term, used to convert area densities to projected solid angles
+static inline Float invGeometricTerm(const PathVertex *cur,
+        const PathVertex *succ, const PathEdge *edge) {
+    return edge->length * edge->length / std::abs(
+        (succ->isOnSurface() ? dot(edge->d, succ->getGeometricNormal()) : 1) *
+        (cur->isOnSurface()  ? dot(edge->d, cur->getGeometricNormal())  : 1));
+}
+
+/// Can the endpoint sample 'v' be connected to when direct sampling is used?
+static inline bool isDirectConnectable(const PathVertex *v, bool endpoint) {
+    EMeasure measure = v->getAbstractEmitter()->getDirectMeasure();
+    return measure != EInvalidMeasure && (!endpoint || measure != EDiscrete);
+}
+
 Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
         const PathEdge *connectionEdge, const Path &sensorSubpath,
-        int s, int t, bool sampleDirect, bool lightImage) {
+        int s, int t, bool sampleDirect, bool lightImage, bool cached) {
     int k = s+t+1, n = k+1;
 
     const PathVertex
@@ -274,6 +288,40 @@ Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
             *vs = emitterSubpath.vertex(s),
             *vt = sensorSubpath.vertex(t);
 
+    /* The vertices with indices in [lo, hi] are processed explicitly. When
+       partial sums were cached by cacheMIWeights(), the remaining terms
+       are accounted for by 'emitterTail' and 'sensorTail' */
+    int lo = 0, hi = k;
+    double emitterTail = 0, sensorTail = 0;
+
+    if (cached) {
+        BDAssert(s < 3 || emitterSubpath.vertex(s-2)->misPartial == -1
+            || emitterSubpath.vertex(s-2)->misPartial >= 0);
+        BDAssert(t < 3 || sensorSubpath.vertex(t-2)->misPartial == -1
+            || sensorSubpath.vertex(t-2)->misPartial >= 0);
+
+        if (s >= 3 && emitterSubpath.vertex(s-2)->misPartial >= 0) {
+            lo = s-2;
+            emitterTail = emitterSubpath.vertex(s-2)->misPartial;
+        }
+        if (t >= 3 && sensorSubpath.vertex(t-2)->misPartial >= 0) {
+            hi = s+3;
+            sensorTail = sensorSubpath.vertex(t-2)->misPartial;
+        }
+
+        /* Fall back to the full computation if there are ENull vertices */
+        for (int i=lo; i<=hi; ++i) {
+            const PathVertex *v = i <= s ? emitterSubpath.vertex(i) : sensorSubpath.vertex(k-i);
+            if (v->isNullInteraction() && !v->isConnectable()) {
+                lo = 0; hi = k;
+                emitterTail = sensorTail = 0;
+                break;
+            }
+        }
+    }
+
+    bool windowed = lo != 0 || hi != k;
+
     /* pdfImp[i] and pdfRad[i] store the area/volume density of vertex
        'i' when sampled from the adjacent vertex in the emitter
        and sensor direction, respectively. */
@@ -284,20 +332,18 @@ Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
     bool  *connectable = (bool *)  alloca(n * sizeof(bool)),
           *isNull      = (bool *)  alloca(n * sizeof(bool));
 
-    /* Keep track of which vertices are connectable / null interactions */
-    int pos = 0;
-    for (int i=0; i<=s; ++i) {
-        const PathVertex *v = emitterSubpath.vertex(i);
-        connectable[pos] = v->isConnectable();
-        isNull[pos] = v->isNullInteraction() && !connectable[pos];
-        pos++;
-    }
-
-    for (int i=t; i>=0; --i) {
-        const PathVertex *v = sensorSubpath.vertex(i);
-        connectable[pos] = v->isConnectable();
-        isNull[pos] = v->isNullInteraction() && !connectable[pos];
-        pos++;
+    /* Keep track of which vertices are connectable / null interactions.
+       The vertices next to the path endpoints are needed in any case
+       (for the direct sampling strategies) */
+    for (int i=0; i<=k; ++i) {
+        if (i > 2 && i < lo)
+            i = lo;
+        else if (i > hi && i < k-2)
+            i = k-2;
+
+        const PathVertex *v = i <= s ? emitterSubpath.vertex(i) : sensorSubpath.vertex(k-i);
+        connectable[i] = v->isConnectable();
+        isNull[i] = v->isNullInteraction() && !connectable[i];
     }
 
     if (k <= 3)
@@ -308,65 +354,67 @@ Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
         /* When direct sampling is enabled, we may be able to create certain
            connections that otherwise would have failed (e.g. to an
            orthographic camera or a directional light source) */
-        const AbstractEmitter *emitter = (s > 0 ? emitterSubpath.vertex(1) : vt)->getAbstractEmitter();
-        const AbstractEmitter *sensor = (t > 0 ? sensorSubpath.vertex(1) : vs)->getAbstractEmitter();
+        const PathVertex *emitterSample = s > 0 ? emitterSubpath.vertex(1) : vt;
+        const PathVertex *sensorSample = t > 0 ? sensorSubpath.vertex(1) : vs;
 
-        EMeasure emitterDirectMeasure = emitter->getDirectMeasure();
-        EMeasure sensorDirectMeasure  = sensor->getDirectMeasure();
-
-        connectable[0]   = emitterDirectMeasure != EDiscrete && emitterDirectMeasure != EInvalidMeasure;
-        connectable[1]   = emitterDirectMeasure != EInvalidMeasure;
-        connectable[k-1] = sensorDirectMeasure != EInvalidMeasure;
-        connectable[k]   = sensorDirectMeasure != EDiscrete && sensorDirectMeasure != EInvalidMeasure;
+        connectable[0]   = isDirectConnectable(emitterSample, true);
+        connectable[1]   = isDirectConnectable(emitterSample, false);
+        connectable[k-1] = isDirectConnectable(sensorSample, false);
+        connectable[k]   = isDirectConnectable(sensorSample, true);
 
         /* The following is needed to handle orthographic cameras &
            directional light sources together with direct sampling */
         if (t == 1)
-            vtMeasure = sensor->needsDirectionSample() ? EArea : EDiscrete;
+            vtMeasure = sensorSample->getAbstractEmitter()->needsDirectionSample() ? EArea : EDiscrete;
         else if (s == 1)
-            vsMeasure = emitter->needsDirectionSample() ? EArea : EDiscrete;
+            vsMeasure = emitterSample->getAbstractEmitter()->needsDirectionSample() ? EArea : EDiscrete;
     }
 
     /* Collect importance transfer area/volume densities from vertices */
-    pos = 0;
-    pdfImp[pos++] = 1.0;
+    pdfImp[0] = 1.0;
 
-    for (int i=0; i<s; ++i)
-        pdfImp[pos++] = emitterSubpath.vertex(i)->pdf[EImportance]
-            * emitterSubpath.edge(i)->pdf[EImportance];
+    for (int i=std::max(lo, 1); i<=std::min(hi, s); ++i)
+        pdfImp[i] = emitterSubpath.vertex(i-1)->pdf[EImportance]
+            * emitterSubpath.edge(i-1)->pdf[EImportance];
 
-    pdfImp[pos++] = vs->evalPdf(scene, vsPred, vt, EImportance, vsMeasure)
+    pdfImp[s+1] = vs->evalPdf(scene, vsPred, vt, EImportance, vsMeasure)
         * connectionEdge->pdf[EImportance];
 
     if (t > 0) {
-        pdfImp[pos++] = vt->evalPdf(scene, vs, vtPred, EImportance, vtMeasure)
+        pdfImp[s+2] = vt->evalPdf(scene, vs, vtPred, EImportance, vtMeasure)
             * sensorSubpath.edge(t-1)->pdf[EImportance];
 
-        for (int i=t-1; i>0; --i)
-            pdfImp[pos++] = sensorSubpath.vertex(i)->pdf[EImportance]
-                * sensorSubpath.edge(i-1)->pdf[EImportance];
+        for (int i=s+3; i<=hi; ++i)
+            pdfImp[i] = sensorSubpath.vertex(k+1-i)->pdf[EImportance]
+                * sensorSubpath.edge(k-i)->pdf[EImportance];
     }
 
+    if (lo > 1)
+        pdfImp[1] = emitterSubpath.vertex(0)->pdf[EImportance]
+            * emitterSubpath.edge(0)->pdf[EImportance];
+
     /* Collect radiance transfer area/volume densities from vertices */
-    pos = 0;
     if (s > 0) {
-        for (int i=0; i<s-1; ++i)
-            pdfRad[pos++] = emitterSubpath.vertex(i+1)->pdf[ERadiance]
+        for (int i=lo; i<=std::min(hi, s-2); ++i)
+            pdfRad[i] = emitterSubpath.vertex(i+1)->pdf[ERadiance]
                 * emitterSubpath.edge(i)->pdf[ERadiance];
 
-        pdfRad[pos++] = vs->evalPdf(scene, vt, vsPred, ERadiance, vsMeasure)
+        pdfRad[s-1] = vs->evalPdf(scene, vt, vsPred, ERadiance, vsMeasure)
             * emitterSubpath.edge(s-1)->pdf[ERadiance];
     }
 
-    pdfRad[pos++] = vt->evalPdf(scene, vtPred, vs, ERadiance, vtMeasure)
+    pdfRad[s] = vt->evalPdf(scene, vtPred, vs, ERadiance, vtMeasure)
         * connectionEdge->pdf[ERadiance];
 
-    for (int i=t; i>0; --i)
-        pdfRad[pos++] = sensorSubpath.vertex(i-1)->pdf[ERadiance]
-            * sensorSubpath.edge(i-1)->pdf[ERadiance];
+    for (int i=s+1; i<=std::min(hi, k-1); ++i)
+        pdfRad[i] = sensorSubpath.vertex(k-i-1)->pdf[ERadiance]
+            * sensorSubpath.edge(k-i-1)->pdf[ERadiance];
 
-    pdfRad[pos++] = 1.0;
+    pdfRad[k] = 1.0;
 
+    if (hi < k-1)
+        pdfRad[k-1] = sensorSubpath.vertex(0)->pdf[ERadiance]
+            * sensorSubpath.edge(0)->pdf[ERadiance];
 
     /* When the path contains specular surface interactions, it is possible
        to compute the correct MI weights even without going through all the
@@ -375,7 +423,7 @@ Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
        all cancel out. But to make sure that that's actually true, we need to
        convert some of the area densities in the 'pdfRad' and 'pdfImp' arrays
        into the projected solid angle measure */
-    for (int i=1; i <= k-3; ++i) {
+    for (int i=std::max(lo, 1); i <= std::min(hi-1, k-3); ++i) {
         if (i == s || !(connectable[i] && !connectable[i+1]))
             continue;
 
@@ -383,12 +431,10 @@ Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
         const PathVertex *succ = i+1 <= s ? emitterSubpath.vertex(i+1) : sensorSubpath.vertex(k-i-1);
         const PathEdge *edge = i < s ? emitterSubpath.edge(i) : sensorSubpath.edge(k-i-1);
 
-        pdfImp[i+1] *= edge->length * edge->length / std::abs(
-            (succ->isOnSurface() ? dot(edge->d, succ->getGeometricNormal()) : 1) *
-            (cur->isOnSurface()  ? dot(edge->d, cur->getGeometricNormal())  : 1));
+        pdfImp[i+1] *= invGeometricTerm(cur, succ, edge);
     }
 
-    for (int i=k-1; i >= 3; --i) {
+    for (int i=std::min(hi, k-1); i >= std::max(lo+1, 3); --i) {
         if (i-1 == s || !(connectable[i] && !connectable[i-1]))
             continue;
 
@@ -396,9 +442,7 @@ Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
         const PathVertex *succ = i-1 <= s ? emitterSubpath.vertex(i-1) : sensorSubpath.vertex(k-i+1);
         const PathEdge *edge = i <= s ? emitterSubpath.edge(i-1) : sensorSubpath.edge(k-i);
 
-        pdfRad[i-1] *= edge->length * edge->length / std::abs(
-            (succ->isOnSurface() ? dot(edge->d, succ->getGeometricNormal()) : 1) *
-            (cur->isOnSurface()  ? dot(edge->d, cur->getGeometricNormal())  : 1));
+        pdfRad[i-1] *= invGeometricTerm(cur, succ, edge);
     }
 
     int emitterRefIndirection = 2, sensorRefIndirection = k-2;
@@ -406,8 +450,9 @@ Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
     /* One more array sweep before the actual useful work starts -- phew! :)
        "Collapse" edges/vertices that were caused by BSDF::ENull interactions.
        The BDPT implementation is smart enough to connect straight through those,
-       so they shouldn't be treated as Dirac delta events in what follows */
-    for (int i=1; i <= k-3; ++i) {
+       so they shouldn't be treated as Dirac delta events in what follows.
+       (A windowed evaluation never contains such vertices) */
+    for (int i=1; i <= k-3 && !windowed; ++i) {
         if (!connectable[i] || !isNull[i+1])
             continue;
 
@@ -486,7 +531,7 @@ Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
        an incremental scheme can be used that only finds the densities relative
        to the (s,t) strategy, which can be done using a linear sweep. For
        details, refer to the Veach thesis, p.306. */
-    for (int i=s+1; i<k; ++i) {
+    for (int i=s+1; i<hi; ++i) {
         double next = pdf * (double) pdfImp[i] / (double) pdfRad[i],
                value = next;
 
@@ -505,10 +550,13 @@ Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
         pdf = next;
     }
 
+    /* Strategies that are further away along the sensor subpath */
+    weight += pdf*pdf*sensorTail;
+
     /* As above, but now compute pdf[i] with i<s (this is done by
        evaluating the inverse of the previous expressions). */
     pdf = initial;
-    for (int i=s-1; i>=0; --i) {
+    for (int i=s-1; i>=lo; --i) {
         double next = pdf * (double) pdfRad[i+1] / (double) pdfImp[i+1],
                value = next;
 
@@ -526,9 +574,79 @@ Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
         pdf = next;
     }
 
+    /* Strategies that are further away along the emitter subpath */
+    weight += pdf*pdf*emitterTail;
+
     return (Float) (1.0 / weight);
 }
 
+void Path::cacheMIWeights(const Scene *scene, ETransportMode mode,
+        bool sampleDirect, bool lightImage) const {
+    int n = (int) m_vertices.size();
+    if (n < 2)
+        return;
+
+    /* This is the sweep over i<s from miWeight() expressed in the vertex
+       order of this subpath (for sensor subpaths, everything is mirrored).
+       The partial sum at vertex 'j' includes all strategies whose
+       connection edge ends at a vertex with an index smaller than 'j' */
+    ETransportMode other = (ETransportMode) (1-mode);
+    bool *connectable = (bool *) alloca(n * sizeof(bool));
+
+    bool valid = true;
+    for (int i=0; i<n; ++i) {
+        const PathVertex *v = m_vertices[i];
+        connectable[i] = v->isConnectable();
+        valid &= !(v->isNullInteraction() && !connectable[i]);
+    }
+
+    /* The cached sums are only used for sufficiently long paths, for
+       which direct sampling strategies are always enabled */
+    double ratioDirect = 0.0;
+    if (sampleDirect) {
+        connectable[0] = isDirectConnectable(m_vertices[1], true);
+        connectable[1] = isDirectConnectable(m_vertices[1], false);
+
+        if (n > 2 && connectable[1] && connectable[2]) {
+            EMeasure measure = m_vertices[1]->getAbstractEmitter()->getDirectMeasure();
+            ratioDirect = m_vertices[2]->evalPdfDirect(scene, m_vertices[1], mode,
+                measure == ESolidAngle ? EArea : measure)
+                / (m_vertices[0]->pdf[mode] * m_edges[0]->pdf[mode]);
+        }
+    }
+
+    /* ENull vertices need special treatment in miWeight(); in
+       that case, mark the partial sums as unavailable */
+    double sum = 0;
+    m_vertices[0]->misPartial = valid ? 0 : -1;
+    for (int j=1; j<n-1; ++j) {
+        /* Density of vertex j when sampled from j+1 and j-1, respectively */
+        Float pdfOther = m_vertices[j+1]->pdf[other] * m_edges[j]->pdf[other],
+              pdfMode  = m_vertices[j-1]->pdf[mode] * m_edges[j-1]->pdf[mode];
+
+        if (j >= 2 && connectable[j+1] && !connectable[j])
+            pdfOther *= invGeometricTerm(m_vertices[j+1], m_vertices[j], m_edges[j]);
+        if (j >= 2 && connectable[j-1] && !connectable[j])
+            pdfMode *= invGeometricTerm(m_vertices[j-1], m_vertices[j], m_edges[j-1]);
+
+        /* Term of the strategy whose connection edge ends at vertex j-1 */
+        double value = 1.0;
+        if (sampleDirect && j-1 == 1)
+            value = ratioDirect;
+
+        int i = j-1;
+        if (connectable[i] && connectable[i+1] &&
+            (mode == EImportance || lightImage || i > 1))
+            sum += value*value;
+
+        double ratio = (double) pdfOther / (double) pdfMode;
+        sum *= ratio*ratio;
+
+        m_vertices[j]->misPartial = valid ? sum : -1;
+    }
+    m_vertices[n-1]->misPartial = -1;
+}
+
 void Path::collapseTo(PathEdge &target) const {
     BDAssert(m_edges.size() > 0);
 
@@ -21,6 +21,8 @@
 #include <mitsuba/bidir/util.h>
 #include <mitsuba/core/bitmap.h>
 #include <mitsuba/core/plugin.h>
+#include <mitsuba/core/sched.h>
+#include <mitsuba/render/range.h>
 #include <boost/bind.hpp>
 
 MTS_NAMESPACE_BEGIN
@@ -102,6 +104,9 @@ void PathSampler::sampleSplats(const Point2i &offset, SplatList &list) {
                         m_sensorSubpath.vertex(i-1)->rrWeight *
                         m_sensorSubpath.edge(i-1)->weight[ERadiance];
 
+                m_emitterSubpath.cacheMIWeights(m_scene, EImportance, m_sampleDirect, m_lightImage);
+                m_sensorSubpath.cacheMIWeights(m_scene, ERadiance, m_sampleDirect, m_lightImage);
+
                 if (m_sensorSubpath.vertexCount() > 2) {
                     Point2 samplePos(0.0f);
                     m_sensorSubpath.vertex(1)->getSamplePosition(m_sensorSubpath.vertex(2), samplePos);
@@ -242,7 +247,7 @@ void PathSampler::sampleSplats(const Point2i &offset, SplatList &list) {
 
                         /* Compute the multiple importance sampling weight */
                         value *= Path::miWeight(m_scene, m_emitterSubpath, &connectionEdge,
-                            m_sensorSubpath, s, t, m_sampleDirect, m_lightImage);
+                            m_sensorSubpath, s, t, m_sampleDirect, m_lightImage, true);
 
                         if (sampleDirect) {
                             /* Now undo the previous change */
@@ -352,6 +357,9 @@ void PathSampler::samplePaths(const Point2i &offset, PathCallback &callback) {
             m_sensorSubpath.vertex(i-1)->rrWeight *
             m_sensorSubpath.edge(i-1)->weight[ERadiance];
 
+    m_emitterSubpath.cacheMIWeights(m_scene, EImportance, m_sampleDirect, m_lightImage);
+    m_sensorSubpath.cacheMIWeights(m_scene, ERadiance, m_sampleDirect, m_lightImage);
+
     PathVertex tempEndpoint, tempSample, vsTemp, vtTemp;
     PathEdge tempEdge, connectionEdge;
     Point2 samplePos(0.0f);
@@ -494,7 +502,7 @@ void PathSampler::samplePaths(const Point2i &offset, PathCallback &callback) {
 
             /* Compute the multiple importance sampling weight */
             value *= Path::miWeight(m_scene, m_emitterSubpath, &connectionEdge,
-                m_sensorSubpath, s, t, m_sampleDirect, m_lightImage);
+                m_sensorSubpath, s, t, m_sampleDirect, m_lightImage, true);
 
             if (!value.isZero()) {
                 int k = (int) m_connectionSubpath.vertexCount();
@@ -539,10 +547,12 @@ void PathSampler::samplePaths(const Point2i &offset, PathCallback &callback) {
 
 /**
  * \brief Sort predicate used to order \ref PathSeed instances by
- * their index into the underlying random number stream
+ * their random number stream and their index into it
  */
 struct PathSeedSortPredicate {
     bool operator()(const PathSeed &left, const PathSeed &right) {
+        if (left.streamIndex != right.streamIndex)
+            return left.streamIndex < right.streamIndex;
         return left.sampleIndex < right.sampleIndex;
     }
 };
@@ -597,8 +607,304 @@ static void seedCallback(std::vector<PathSeed> &output, const Bitmap *importance
     output.push_back(PathSeed(0, weight, s, t));
 }
 
+/// Number of luminance samples per work unit of \ref SeedGenerationProcess
+#define MTS_SEED_BLOCK_SIZE 1024
+
+/**
+ * \brief Stores the seed candidates and luminance statistics of one
+ * block of luminance samples
+ */
+class SeedWorkResult : public WorkResult {
+public:
+    SeedWorkResult() : blockIndex(0), sampleCount(0), mean(0.0f), variance(0.0f) { }
+
+    void load(Stream *stream) {
+        blockIndex = stream->readSize();
+        sampleCount = stream->readSize();
+        mean = stream->readFloat();
+        variance = stream->readFloat();
+        size_t seedCount = stream->readSize();
+        seeds.clear();
+        seeds.reserve(seedCount);
+        for (size_t i=0; i<seedCount; ++i)
+            seeds.push_back(PathSeed(stream));
+    }
+
+    void save(Stream *stream) const {
+        stream->writeSize(blockIndex);
+        stream->writeSize(sampleCount);
+        stream->writeFloat(mean);
+        stream->writeFloat(variance);
+        stream->writeSize(seeds.size());
+        for (size_t i=0; i<seeds.size(); ++i)
+            seeds[i].serialize(stream);
+    }
+
+    std::string toString() const {
+        std::ostringstream oss;
+        oss << "SeedWorkResult[blockIndex=" << blockIndex
+            << ", sampleCount=" << sampleCount
+            << ", seeds=" << seeds.size() << "]";
+        return oss.str();
+    }
+
+    size_t blockIndex;
+    size_t sampleCount;
+    Float mean;
+    /// Sum of squared deviations from the mean
+    Float variance;
+    std::vector<PathSeed> seeds;
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~SeedWorkResult() { }
+};
+
+/**
+ * \brief Takes the luminance samples of \ref PathSampler::generateSeeds()
+ *
+ * Every work unit covers one block of samples, which draws from its own
+ * stream of the replayable sampler (block \c i uses stream <tt>i+1</tt>).
+ */
+class SeedGenerationProcessor : public WorkProcessor {
+public:
+    SeedGenerationProcessor(PathSampler::ETechnique technique, int maxDepth,
+            int rrDepth, bool excludeDirectIllum, bool sampleDirect, bool lightImage,
+            bool fineGrained, const Bitmap *importanceMap)
+        : m_technique(technique), m_maxDepth(maxDepth), m_rrDepth(rrDepth),
+          m_excludeDirectIllum(excludeDirectIllum), m_sampleDirect(sampleDirect),
+          m_lightImage(lightImage), m_fineGrained(fineGrained),
+          m_importanceMap(importanceMap) { }
+
+    SeedGenerationProcessor(Stream *stream, InstanceManager *manager)
+        : WorkProcessor(stream, manager) {
+        m_technique = (PathSampler::ETechnique) stream->readUInt();
+        m_maxDepth = stream->readInt();
+        m_rrDepth = stream->readInt();
+        m_excludeDirectIllum = stream->readBool();
+        m_sampleDirect = stream->readBool();
+        m_lightImage = stream->readBool();
+        m_fineGrained = stream->readBool();
+        Vector2i size(stream);
+        if (size != Vector2i(0)) {
+            ref<Bitmap> importanceMap = new Bitmap(Bitmap::ELuminance, Bitmap::EFloat, size);
+            stream->readFloatArray(importanceMap->getFloatData(),
+                (size_t) size.x * (size_t) size.y);
+            m_importanceMap = importanceMap;
+        }
+    }
+
+    void serialize(Stream *stream, InstanceManager *manager) const {
+        stream->writeUInt((uint32_t) m_technique);
+        stream->writeInt(m_maxDepth);
+        stream->writeInt(m_rrDepth);
+        stream->writeBool(m_excludeDirectIllum);
+        stream->writeBool(m_sampleDirect);
+        stream->writeBool(m_lightImage);
+        stream->writeBool(m_fineGrained);
+        if (m_importanceMap.get()) {
+            m_importanceMap->getSize().serialize(stream);
+            stream->writeFloatArray(m_importanceMap->getFloatData(),
+                (size_t) m_importanceMap->getWidth() * (size_t) m_importanceMap->getHeight());
+        } else {
+            Vector2i(0, 0).serialize(stream);
+        }
+    }
+
+    ref<WorkUnit> createWorkUnit() const {
+        return new RangeWorkUnit();
+    }
+
+    ref<WorkResult> createWorkResult() const {
+        return new SeedWorkResult();
+    }
+
+    void prepare() {
+        Scene *scene = static_cast<Scene *>(getResource("scene"));
+        m_scene = new Scene(scene);
+        m_scene->wakeup(NULL, m_resources);
+        m_scene->initializeBidirectional();
+
+        m_sampler = static_cast<ReplayableSampler *>(
+            static_cast<Sampler *>(getResource("rplSampler"))->clone().get());
+
+        m_pathSampler = new PathSampler(m_technique, m_scene, m_sampler,
+            m_sampler, m_sampler, m_maxDepth, m_rrDepth, m_excludeDirectIllum,
+            m_sampleDirect, m_lightImage);
+    }
+
+    void process(const WorkUnit *workUnit, WorkResult *workResult, const bool &stop) {
+        const RangeWorkUnit *range = static_cast<const RangeWorkUnit *>(workUnit);
+        SeedWorkResult *result = static_cast<SeedWorkResult *>(workResult);
+        std::vector<PathSeed> &seeds = result->seeds;
+
+        result->blockIndex = range->getRangeStart() / MTS_SEED_BLOCK_SIZE;
+        result->sampleCount = 0;
+        result->mean = result->variance = 0.0f;
+        seeds.clear();
+
+        m_sampler->setStreamIndex(result->blockIndex + 1);
+        m_sampler->setSampleIndex(0);
+
+        SplatList splatList;
+        Float luminance;
+        PathSampler::PathCallback callback = boost::bind(&seedCallback,
+            boost::ref(seeds), m_importanceMap.get(), boost::ref(luminance),
+            _1, _2, _3, _4);
+
+        for (size_t i=range->getRangeStart(); i<=range->getRangeEnd() && !stop; ++i) {
+            size_t seedIndex = seeds.size();
+            size_t sampleIndex = m_sampler->getSampleIndex();
+            luminance = 0.0f;
+
+            if (m_fineGrained) {
+                m_pathSampler->samplePaths(Point2i(-1), callback);
+
+                /* Fine seed granularity (e.g. for Veach-MLT).
+                   Set the correct the sample index value */
+                for (size_t j = seedIndex; j<seeds.size(); ++j) {
+                    seeds[j].sampleIndex = sampleIndex;
+                    seeds[j].streamIndex = m_sampler->getStreamIndex();
+                }
+            } else {
+                /* Run the path sampling strategy */
+                m_pathSampler->sampleSplats(Point2i(-1), splatList);
+                luminance = splatList.luminance;
+                splatList.normalize(m_importanceMap);
+
+                /* Coarse seed granularity (e.g. for PSSMLT) */
+                if (luminance != 0)
+                    seeds.push_back(PathSeed(sampleIndex, luminance,
+                        0, 0, m_sampler->getStreamIndex()));
+            }
+
+            /* Numerically robust online variance estimation using an
+               algorithm proposed by Donald Knuth (TAOCP vol.2, 3rd ed., p.232) */
+            Float delta = luminance - result->mean;
+            result->mean += delta / (Float) (++result->sampleCount);
+            result->variance += delta * (luminance - result->mean);
+        }
+        BDAssert(m_pathSampler->getMemoryPool().unused());
+    }
+
+    ref<WorkProcessor> clone() const {
+        return new SeedGenerationProcessor(m_technique, m_maxDepth, m_rrDepth,
+            m_excludeDirectIllum, m_sampleDirect, m_lightImage, m_fineGrained,
+            m_importanceMap.get());
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Virtual destructor
+    virtual ~SeedGenerationProcessor() { }
+private:
+    PathSampler::ETechnique m_technique;
+    int m_maxDepth, m_rrDepth;
+    bool m_excludeDirectIllum, m_sampleDirect;
+    bool m_lightImage, m_fineGrained;
+    ref<const Bitmap> m_importanceMap;
+    ref<Scene> m_scene;
+    ref<ReplayableSampler> m_sampler;
+    ref<PathSampler> m_pathSampler;
+};
+
+/**
+ * \brief Parallel process that runs the luminance sampling phase of
+ * \ref PathSampler::generateSeeds()
+ *
+ * The results of the individual blocks are stored by block index, so that
+ * \ref merge() can combine them in a fixed order.
+ */
+class SeedGenerationProcess : public ParallelProcess {
+public:
+    SeedGenerationProcess(size_t sampleCount, SeedGenerationProcessor *processor)
+        : m_sampleCount(sampleCount), m_numGenerated(0), m_processor(processor) {
+        size_t blockCount = (sampleCount + MTS_SEED_BLOCK_SIZE - 1) / MTS_SEED_BLOCK_SIZE;
+        m_blocks.resize(blockCount);
+        m_resultMutex = new Mutex();
+    }
+
+    ref<WorkProcessor> createWorkProcessor() const {
+        return m_processor->clone();
+    }
+
+    EStatus generateWork(WorkUnit *unit, int worker) {
+        if (m_numGenerated == m_sampleCount)
+            return EFailure; // There is no more work
+
+        size_t workUnitSize = std::min((size_t) MTS_SEED_BLOCK_SIZE,
+            m_sampleCount - m_numGenerated);
+        static_cast<RangeWorkUnit *>(unit)->setRange(m_numGenerated,
+            m_numGenerated + workUnitSize - 1);
+        m_numGenerated += workUnitSize;
+
+        return ESuccess;
+    }
+
+    void processResult(const WorkResult *workResult, bool cancelled) {
+        if (cancelled)
+            return;
+
+        const SeedWorkResult *result = static_cast<const SeedWorkResult *>(workResult);
+        LockGuard lock(m_resultMutex);
+        Block &block = m_blocks.at(result->blockIndex);
+        block.sampleCount = result->sampleCount;
+        block.mean = result->mean;
+        block.variance = result->variance;
+        block.seeds = result->seeds;
+    }
+
+    /**
+     * \brief Concatenate the seed candidates of all blocks and combine
+     * their luminance statistics (Chan et al.'s parallel variant of the
+     * online variance algorithm)
+     */
+    void merge(std::vector<PathSeed> &seeds, Float &mean, Float &variance) const {
+        size_t seedCount = 0, sampleCount = 0;
+        for (size_t i=0; i<m_blocks.size(); ++i)
+            seedCount += m_blocks[i].seeds.size();
+
+        seeds.clear();
+        seeds.reserve(seedCount);
+        mean = variance = 0.0f;
+
+        for (size_t i=0; i<m_blocks.size(); ++i) {
+            const Block &block = m_blocks[i];
+            seeds.insert(seeds.end(), block.seeds.begin(), block.seeds.end());
+            if (block.sampleCount == 0)
+                continue;
+
+            size_t total = sampleCount + block.sampleCount;
+            Float delta = block.mean - mean,
+                  weight = (Float) block.sampleCount / (Float) total;
+            mean += delta * weight;
+            variance += block.variance + delta * delta * sampleCount * weight;
+            sampleCount = total;
+        }
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    /// Virtual destructor
+    virtual ~SeedGenerationProcess() { }
+private:
+    struct Block {
+        size_t sampleCount;
+        Float mean, variance;
+        std::vector<PathSeed> seeds;
+
+        inline Block() : sampleCount(0), mean(0.0f), variance(0.0f) { }
+    };
+
+    size_t m_sampleCount, m_numGenerated;
+    ref<SeedGenerationProcessor> m_processor;
+    std::vector<Block> m_blocks;
+    ref<Mutex> m_resultMutex;
+};
+
 Float PathSampler::generateSeeds(size_t sampleCount, size_t seedCount,
-        bool fineGrained, const Bitmap *importanceMap, std::vector<PathSeed> &seeds) {
+        bool fineGrained, const Bitmap *importanceMap, std::vector<PathSeed> &seeds,
+        int sceneResID) {
     Log(EInfo, "Integrating luminance values over the image plane ("
             SIZE_T_FMT " samples)..", sampleCount);
 
@@ -606,46 +912,32 @@ Float PathSampler::generateSeeds(size_t sampleCount, size_t seedCount,
     BDAssert(m_sensorSampler->getClass()->derivesFrom(MTS_CLASS(ReplayableSampler)));
 
     ref<Timer> timer = new Timer();
-    std::vector<PathSeed> tempSeeds;
-    tempSeeds.reserve(sampleCount);
+    ref<Scheduler> scheduler = Scheduler::getInstance();
 
-    SplatList splatList;
-    Float luminance;
-    PathCallback callback = boost::bind(&seedCallback,
-        boost::ref(tempSeeds), importanceMap, boost::ref(luminance),
-        _1, _2, _3, _4);
+    bool registerScene = sceneResID == -1;
+    if (registerScene)
+        sceneResID = scheduler->registerResource(const_cast<Scene *>(m_scene.get()));
+    int samplerResID = scheduler->registerResource(m_sensorSampler);
 
-    Float mean = 0.0f, variance = 0.0f;
-    for (size_t i=0; i<sampleCount; ++i) {
-        size_t seedIndex = tempSeeds.size();
-        size_t sampleIndex = m_sensorSampler->getSampleIndex();
-        luminance = 0.0f;
+    ref<SeedGenerationProcess> process = new SeedGenerationProcess(sampleCount,
+        new SeedGenerationProcessor(m_technique, m_maxDepth, m_rrDepth,
+            m_excludeDirectIllum, m_sampleDirect, m_lightImage, fineGrained,
+            importanceMap));
+    process->bindResource("scene", sceneResID);
+    process->bindResource("rplSampler", samplerResID);
+    scheduler->schedule(process);
+    scheduler->wait(process);
 
-        if (fineGrained) {
-            samplePaths(Point2i(-1), callback);
+    scheduler->unregisterResource(samplerResID);
+    if (registerScene)
+        scheduler->unregisterResource(sceneResID);
 
-            /* Fine seed granularity (e.g. for Veach-MLT).
-               Set the correct the sample index value */
-            for (size_t j = seedIndex; j<tempSeeds.size(); ++j)
-                tempSeeds[j].sampleIndex = sampleIndex;
-        } else {
-            /* Run the path sampling strategy */
-            sampleSplats(Point2i(-1), splatList);
-            luminance = splatList.luminance;
-            splatList.normalize(importanceMap);
-
-            /* Coarse seed granularity (e.g. for PSSMLT) */
-            if (luminance != 0)
-                tempSeeds.push_back(PathSeed(sampleIndex, luminance));
-        }
+    if (process->getReturnStatus() != ParallelProcess::ESuccess)
+        Log(EError, "The luminance sampling process did not finish successfully!");
 
-        /* Numerically robust online variance estimation using an
-           algorithm proposed by Donald Knuth (TAOCP vol.2, 3rd ed., p.232) */
-        Float delta = luminance - mean;
-        mean += delta / (Float) (i+1);
-        variance += delta * (luminance - mean);
-    }
-    BDAssert(m_pool.unused());
+    std::vector<PathSeed> tempSeeds;
+    Float mean, variance;
+    process->merge(tempSeeds, mean, variance);
     Float stddev = std::sqrt(variance / (sampleCount-1));
 
     Log(EInfo, "Done -- average luminance value = %f, stddev = %f (took %i ms)",
@@ -701,6 +993,7 @@ void PathSampler::reconstructPath(const PathSeed &seed, const Bitmap *importance
 
     /* Generate the initial sample by replaying the seeding random
        number stream at the appropriate position. */
+    rplSampler->setStreamIndex(seed.streamIndex);
     rplSampler->setSampleIndex(seed.sampleIndex);
 
     PathCallback callback = boost::bind(&reconstructCallback,
@@ -761,4 +1054,7 @@ std::string SplatList::toString() const {
 
 MTS_IMPLEMENT_CLASS(PathSampler, false, Object)
 MTS_IMPLEMENT_CLASS(SeedWorkUnit, false, WorkUnit)
+MTS_IMPLEMENT_CLASS(SeedWorkResult, false, WorkResult)
+MTS_IMPLEMENT_CLASS_S(SeedGenerationProcessor, false, WorkProcessor)
+MTS_IMPLEMENT_CLASS(SeedGenerationProcess, false, ParallelProcess)
 MTS_NAMESPACE_END
@@ -26,6 +26,16 @@ ReplayableSampler::ReplayableSampler() : Sampler(Properties()) {
     m_random->set(m_initial);
     m_sampleCount = 0;
     m_sampleIndex = 0;
+    m_streamIndex = 0;
+}
+
+ReplayableSampler::ReplayableSampler(uint64_t seed) : Sampler(Properties()) {
+    m_initial = new Random(seed);
+    m_random = new Random();
+    m_random->set(m_initial);
+    m_sampleCount = 0;
+    m_sampleIndex = 0;
+    m_streamIndex = 0;
 }
 
 ReplayableSampler::ReplayableSampler(Stream *stream, InstanceManager *manager)
@@ -35,6 +45,7 @@ ReplayableSampler::ReplayableSampler(Stream *stream, InstanceManager *manager)
     m_random->set(m_initial);
     m_sampleCount = 0;
     m_sampleIndex = 0;
+    m_streamIndex = 0;
 }
 
 ReplayableSampler::~ReplayableSampler() {
@@ -49,6 +60,7 @@ ref<Sampler> ReplayableSampler::clone() {
     ref<ReplayableSampler> sampler = new ReplayableSampler();
     sampler->m_sampleCount = m_sampleCount;
     sampler->m_sampleIndex = m_sampleIndex;
+    sampler->m_streamIndex = m_streamIndex;
     sampler->m_initial->set(m_initial);
     sampler->m_random->set(m_random);
     return sampler.get();
@@ -65,11 +77,27 @@ void ReplayableSampler::request2DArray(size_t size) {
 void ReplayableSampler::generate(const Point2i &) { }
 void ReplayableSampler::advance() { }
 
-void ReplayableSampler::setSampleIndex(size_t sampleIndex) {
-    if (sampleIndex < m_sampleIndex) {
-        m_sampleIndex = 0;
-        m_random->set(m_initial);
+void ReplayableSampler::resetStream() {
+    m_random->set(m_initial);
+    m_sampleIndex = 0;
+
+    if (m_streamIndex != 0) {
+        /* Derive the stream from the initial generator state */
+        uint64_t key[2] = { m_random->nextULong(), (uint64_t) m_streamIndex };
+        m_random->seed(key, 2);
     }
+}
+
+void ReplayableSampler::setStreamIndex(size_t streamIndex) {
+    if (streamIndex == m_streamIndex)
+        return;
+    m_streamIndex = streamIndex;
+    resetStream();
+}
+
+void ReplayableSampler::setSampleIndex(size_t sampleIndex) {
+    if (sampleIndex < m_sampleIndex)
+        resetStream();
 
     while (m_sampleIndex != sampleIndex) {
         m_random->nextFloat();
@@ -93,7 +121,8 @@ Point2 ReplayableSampler::next2D() {
 std::string ReplayableSampler::toString() const {
     std::ostringstream oss;
     oss << "ReplayableSampler[" << endl
-        << "  sampleCount = " << m_sampleCount << endl
+        << "  sampleCount = " << m_sampleCount << "," << endl
+        << "  streamIndex = " << m_streamIndex << endl
         << "]";
     return oss.str();
 }
@@ -212,4 +212,25 @@ bool Path::verify(const Scene *scene, ETransportMode mode, std::ostream &os) con
     return valid;
 }
 
+bool Path::verifyMIWeight(const Scene *scene, const Path &emitterSubpath,
+        const PathEdge *connectionEdge, const Path &sensorSubpath,
+        int s, int t, bool sampleDirect, bool lightImage, std::ostream &os) {
+    Float weight = miWeight(scene, emitterSubpath, connectionEdge,
+        sensorSubpath, s, t, sampleDirect, lightImage, false);
+    Float cached = miWeight(scene, emitterSubpath, connectionEdge,
+        sensorSubpath, s, t, sampleDirect, lightImage, true);
+
+    std::ostringstream oss;
+    if (!validateValue("miWeight", weight, cached, oss)) {
+        os << "Detected an inconsistency in the MI weight of the (s="
+           << s << ", t=" << t << ") strategy" << endl;
+        os << "Emitter subpath: " << emitterSubpath.toString() << endl;
+        os << "Sensor subpath: " << sensorSubpath.toString() << endl;
+        os << "Inconsistency list:" << endl;
+        os << oss.str() << endl;
+        return false;
+    }
+    return true;
+}
+
 MTS_NAMESPACE_END
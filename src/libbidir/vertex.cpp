@@ -26,6 +26,7 @@ static StatsCounter mediumInconsistencies("Bidirectional layer",
 
 void PathVertex::makeEndpoint(const Scene *scene, Float time, ETransportMode mode) {
     memset(this, 0, sizeof(PathVertex));
+    misPartial = -1;
     type = (mode == EImportance) ? EEmitterSupernode : ESensorSupernode;
     getEndpointRecord() = EndpointRecord(time);
     degenerate = (mode == EImportance)
@@ -40,6 +41,7 @@ bool PathVertex::sampleNext(const Scene *scene, Sampler *sampler,
 
     memset(succEdge, 0, sizeof(PathEdge));
     memset(succ, 0, sizeof(PathVertex));
+    succ->misPartial = -1;
 
     succEdge->medium = (predEdge == NULL) ? NULL : predEdge->medium;
     rrWeight = 1.0f;
@@ -318,6 +320,7 @@ int PathVertex::sampleSensor(const Scene *scene, Sampler *sampler,
 
     memset(e0, 0, sizeof(PathEdge));
     memset(v1, 0, sizeof(PathVertex));
+    v1->misPartial = -1;
 
     Point2 pixelSample = sampler->next2D(),
            apertureSample = sensor->needsApertureSample() ? sampler->next2D() : Point2(0.5f);
@@ -351,6 +354,7 @@ int PathVertex::sampleSensor(const Scene *scene, Sampler *sampler,
 
     memset(e1, 0, sizeof(PathEdge));
     memset(v2, 0, sizeof(PathVertex));
+    v2->misPartial = -1;
 
     v1->weight[EImportance] = result * dRec.pdf * (
         sensor->isOnSurface() ? 1.0f / absDot(dRec.d, pRec.n) : 1.0f);
@@ -491,6 +495,7 @@ bool PathVertex::perturbDirection(const Scene *scene, const PathVertex *pred,
 
     memset(succEdge, 0, sizeof(PathEdge));
     memset(succ, 0, sizeof(PathVertex));
+    succ->misPartial = -1;
 
     succ->measure = EInvalidMeasure;
     succEdge->medium = (predEdge == NULL) ? NULL : predEdge->medium;
@@ -689,6 +694,7 @@ bool PathVertex::propagatePerturbation(const Scene *scene, const PathVertex *pre
 
     memset(succEdge, 0, sizeof(PathEdge));
     memset(succ, 0, sizeof(PathVertex));
+    succ->misPartial = -1;
 
     Vector wi = normalize(pred->getPosition() - its.p);
 
@@ -1027,7 +1033,9 @@ Spectrum PathVertex::sampleDirect(const Scene *scene, Sampler *sampler,
 
     memset(edge, 0, sizeof(PathEdge));
     memset(endpoint, 0, sizeof(PathVertex));
+    endpoint->misPartial = -1;
     memset(sample, 0, sizeof(PathVertex));
+    sample->misPartial = -1;
 
     bool emitter = (mode == EImportance);
     DirectSamplingRecord dRec;
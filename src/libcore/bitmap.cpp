@@ -20,9 +20,10 @@
 #include <mitsuba/core/version.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/fstream.h>
+#include <mitsuba/core/fft.h>
+#include <mitsuba/core/tonemap.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/scoped_array.hpp>
-#include <boost/thread/mutex.hpp>
 #include <set>
 
 #if defined(__WINDOWS__)
@@ -61,11 +62,6 @@ extern "C" {
 };
 #endif
 
-#if defined(MTS_HAS_FFTW)
-#include <complex>
-#include <fftw3.h>
-#endif
-
 MTS_NAMESPACE_BEGIN
 
 namespace
@@ -758,9 +754,78 @@ Spectrum Bitmap::average() const {
     return result;
 }
 
-#if defined(MTS_HAS_FFTW)
-static boost::mutex __fftw_lock;
-#endif
+namespace {
+    /* Accessors for the real-valued and complex-valued convolution buffers */
+    inline void convolveSet(FFT::Complex &target, double value, bool imag) {
+        if (imag)
+            target.imag(value);
+        else
+            target.real(value);
+    }
+
+    inline void convolveSet(float &target, double value, bool) { target = (float) value; }
+
+    inline double convolveGet(const FFT::Complex &source, bool imag) {
+        return imag ? source.imag() : source.real();
+    }
+
+    inline double convolveGet(float source, bool) { return (double) source; }
+
+    /// Zero a padded buffer
+    template <typename Target> void convolveClear(Target *target, size_t paddedWidth, size_t paddedHeight) {
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for
+        #endif
+        for (int y=0; y<(int) paddedHeight; ++y)
+            std::fill(target + y*paddedWidth, target + (y+1)*paddedWidth, Target(0));
+    }
+
+    /// Copy one channel of an image into (the real or imaginary part of) a zero-padded buffer
+    template <typename T, typename Target> void convolveLoad(const T *source, size_t width, size_t height,
+            int channelCount, int channel, Target *target, size_t paddedWidth, bool imag) {
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for
+        #endif
+        for (int y=0; y<(int) height; ++y) {
+            const T *src = source + y*width*channelCount + channel;
+            Target *dst = target + y*paddedWidth;
+            for (size_t x=0; x<width; ++x)
+                convolveSet(dst[x], (double) src[x*channelCount], imag);
+        }
+    }
+
+    /// Copy the flipped convolution kernel into a zero-padded buffer in a wraparound fashion
+    template <typename T, typename Target> void convolveLoadKernel(const T *source, size_t kernelSize,
+            int channelCount, int channel, Target *target, size_t paddedWidth, size_t paddedHeight) {
+        ssize_t hKernelSize = (ssize_t) kernelSize / 2;
+        /* Kernel rows only map to distinct buffer rows if the kernel fits */
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for if (kernelSize <= paddedHeight)
+        #endif
+        for (int y=0; y<(int) kernelSize; ++y) {
+            ssize_t wrappedY = math::modulo(hKernelSize - (ssize_t) y, (ssize_t) paddedHeight);
+            for (size_t x=0; x<kernelSize; ++x) {
+                ssize_t wrappedX = math::modulo(hKernelSize - (ssize_t) x, (ssize_t) paddedWidth);
+                convolveSet(target[wrappedX+wrappedY*paddedWidth],
+                    (double) source[(x+y*kernelSize)*channelCount+channel], false);
+            }
+        }
+    }
+
+    /// Write (the real or imaginary part of) a padded buffer back into one channel of an image
+    template <typename T, typename Source> void convolveStore(const Source *source, size_t paddedWidth,
+            size_t width, size_t height, int channelCount, int channel, T *target, bool imag) {
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for
+        #endif
+        for (int y=0; y<(int) height; ++y) {
+            const Source *src = source + y*paddedWidth;
+            T *dst = target + y*width*channelCount + channel;
+            for (size_t x=0; x<width; ++x)
+                dst[x*channelCount] = (T) convolveGet(src[x], imag);
+        }
+    }
+}
 
 void Bitmap::convolve(const Bitmap *_kernel) {
     if (_kernel->getWidth() != _kernel->getHeight())
@@ -774,6 +839,8 @@ void Bitmap::convolve(const Bitmap *_kernel) {
     if (m_componentFormat != EFloat16 && m_componentFormat != EFloat32 && m_componentFormat != EFloat64)
         Log(EError, "Bitmap::convolve(): unsupported component format! (must be float16/float32/float64)");
 
+    typedef FFT::Complex Complex;
+
     int channelCountKernel = _kernel->getChannelCount();
 
     size_t kernelSize   = (size_t) _kernel->getWidth(),
@@ -781,221 +848,154 @@ void Bitmap::convolve(const Bitmap *_kernel) {
            width        = (size_t) m_size.x,
            height       = (size_t) m_size.y;
 
-#if defined(MTS_HAS_FFTW)
-    typedef std::complex<double> complex;
-
-    size_t paddedWidth  = width + hKernelSize,
-           paddedHeight = height + hKernelSize,
+    /* Only output pixels inside the image are needed, hence padding by half
+       the kernel size suffices to prevent wraparound artifacts */
+    size_t paddedWidth  = FFT::getSmoothSize(width + hKernelSize),
+           paddedHeight = FFT::getSmoothSize(height + hKernelSize),
            paddedSize   = paddedWidth*paddedHeight;
 
-    __fftw_lock.lock();
-    complex *kernel  = (complex *) fftw_malloc(sizeof(complex) * paddedSize),
-            *kernelS = (complex *) fftw_malloc(sizeof(complex) * paddedSize),
-            *data    = (complex *) fftw_malloc(sizeof(complex) * paddedSize),
-            *dataS   = (complex *) fftw_malloc(sizeof(complex) * paddedSize);
-
-    if (!kernel || !kernelS || !data || !dataS) {
-        __fftw_lock.unlock();
-        SLog(EError, "Bitmap::convolve(): Unable to allocate temporary memory!");
-    }
-
-    /* Create a FFTW plan for a 2D DFT of this size */
-    fftw_plan p = fftw_plan_dft_2d((int) paddedHeight, (int) paddedWidth,
-        (fftw_complex *) kernel, (fftw_complex *) kernelS, FFTW_FORWARD, FFTW_ESTIMATE);
-    __fftw_lock.unlock();
+    bool sharedKernel = channelCountKernel == 1;
 
-    memset(kernel, 0, sizeof(complex)*paddedSize);
+    if (m_componentFormat != EFloat64) {
+        /* Half and single precision images use a single precision transform
+           that exploits that both the image and the kernel are real-valued */
+        ref<RealFFT2D> fft = new RealFFT2D(paddedWidth, paddedHeight);
+        size_t spectrumSize = fft->getSpectrumSize();
 
-    for (int ch=0; ch<m_channelCount; ++ch) {
-        memset(data, 0, sizeof(complex)*paddedSize);
-        switch (m_componentFormat) {
-            case EFloat16:
-                /* Copy and zero-pad the convolution kernel in a wraparound fashion */
-                if (ch < channelCountKernel) {
-                    for (size_t y=0; y<kernelSize; ++y) {
-                        ssize_t wrappedY = math::modulo(hKernelSize - (ssize_t) y, (ssize_t) paddedHeight);
-                        for (size_t x=0; x<kernelSize; ++x) {
-                            ssize_t wrappedX = math::modulo(hKernelSize - (ssize_t) x, (ssize_t) paddedWidth);
-                            kernel[wrappedX+wrappedY*paddedWidth] = _kernel->getFloat16Data()[(x+y*kernelSize)*channelCountKernel+ch];
-                        }
-                    }
-                }
+        std::vector<float> buffer;
+        std::vector<FFT::ComplexBatch> kernel, data;
+        try {
+            buffer.resize(paddedSize);
+            kernel.resize(spectrumSize);
+            data.resize(spectrumSize);
+        } catch (const std::bad_alloc &) {
+            Log(EError, "Bitmap::convolve(): Unable to allocate temporary memory!");
+        }
 
-                /* Copy and zero-pad the input data */
-                for (size_t y=0; y<height; ++y)
-                    for (size_t x=0; x<width; ++x)
-                        data[x+y*paddedWidth] = getFloat16Data()[(x+y*width)*m_channelCount + ch];
-                break;
+        for (int ch=0; ch<m_channelCount; ++ch) {
+            if (ch == 0 || !sharedKernel) {
+                convolveClear(&buffer[0], paddedWidth, paddedHeight);
+                if (m_componentFormat == EFloat16)
+                    convolveLoadKernel(_kernel->getFloat16Data(), kernelSize, channelCountKernel,
+                        sharedKernel ? 0 : ch, &buffer[0], paddedWidth, paddedHeight);
+                else
+                    convolveLoadKernel(_kernel->getFloat32Data(), kernelSize, channelCountKernel,
+                        sharedKernel ? 0 : ch, &buffer[0], paddedWidth, paddedHeight);
+                fft->forward(&buffer[0], &kernel[0]);
+            }
 
-            case EFloat32:
-                /* Copy and zero-pad the convolution kernel in a wraparound fashion */
-                if (ch < channelCountKernel) {
-                    for (size_t y=0; y<kernelSize; ++y) {
-                        ssize_t wrappedY = math::modulo(hKernelSize - (ssize_t) y, (ssize_t) paddedHeight);
-                        for (size_t x=0; x<kernelSize; ++x) {
-                            ssize_t wrappedX = math::modulo(hKernelSize - (ssize_t) x, (ssize_t) paddedWidth);
-                            kernel[wrappedX+wrappedY*paddedWidth] = _kernel->getFloat32Data()[(x+y*kernelSize)*channelCountKernel+ch];
-                        }
-                    }
-                }
+            convolveClear(&buffer[0], paddedWidth, paddedHeight);
+            if (m_componentFormat == EFloat16)
+                convolveLoad(getFloat16Data(), width, height, m_channelCount,
+                    ch, &buffer[0], paddedWidth, false);
+            else
+                convolveLoad(getFloat32Data(), width, height, m_channelCount,
+                    ch, &buffer[0], paddedWidth, false);
+
+            /* Multiply in frequency space and transform back */
+            fft->forward(&buffer[0], &data[0]);
+            RealFFT2D::multiply(&data[0], &kernel[0], spectrumSize, 1.0f / paddedSize);
+            fft->inverse(&data[0], &buffer[0]);
+
+            if (m_componentFormat == EFloat16)
+                convolveStore(&buffer[0], paddedWidth, width, height,
+                    m_channelCount, ch, getFloat16Data(), false);
+            else
+                convolveStore(&buffer[0], paddedWidth, width, height,
+                    m_channelCount, ch, getFloat32Data(), false);
+        }
+        return;
+    }
 
-                /* Copy and zero-pad the input data */
-                for (size_t y=0; y<height; ++y)
-                    for (size_t x=0; x<width; ++x)
-                        data[x+y*paddedWidth] = getFloat32Data()[(x+y*width)*m_channelCount + ch];
-                break;
+    std::vector<Complex> kernel, data;
+    try {
+        kernel.resize(paddedSize);
+        data.resize(paddedSize);
+    } catch (const std::bad_alloc &) {
+        Log(EError, "Bitmap::convolve(): Unable to allocate temporary memory!");
+    }
 
-            case EFloat64:
-                /* Copy and zero-pad the convolution kernel in a wraparound fashion */
-                if (ch < channelCountKernel) {
-                    for (size_t y=0; y<kernelSize; ++y) {
-                        ssize_t wrappedY = math::modulo(hKernelSize - (ssize_t) y, (ssize_t) paddedHeight);
-                        for (size_t x=0; x<kernelSize; ++x) {
-                            ssize_t wrappedX = math::modulo(hKernelSize - (ssize_t) x, (ssize_t) paddedWidth);
-                            kernel[wrappedX+wrappedY*paddedWidth] = _kernel->getFloat64Data()[(x+y*kernelSize)*channelCountKernel+ch];
-                        }
-                    }
-                }
+    /* The kernel is real-valued. When it is shared by all channels, two
+       channels are thus convolved at once by storing them in the real
+       and imaginary part of the same buffer */
+    int channelsPerPass = sharedKernel ? 2 : 1;
 
-                /* Copy and zero-pad the input data */
-                for (size_t y=0; y<height; ++y)
-                    for (size_t x=0; x<width; ++x)
-                        data[x+y*paddedWidth] = getFloat64Data()[(x+y*width)*m_channelCount + ch];
-                break;
+    for (int ch=0; ch<m_channelCount; ch += channelsPerPass) {
+        int passChannels = std::min(channelsPerPass, m_channelCount - ch);
 
-            default:
-                Log(EError, "Unsupported component format!");
+        if (ch == 0 || !sharedKernel) {
+            convolveClear(&kernel[0], paddedWidth, paddedHeight);
+            convolveLoadKernel(_kernel->getFloat64Data(), kernelSize, channelCountKernel,
+                sharedKernel ? 0 : ch, &kernel[0], paddedWidth, paddedHeight);
+            FFT::transform2D(&kernel[0], paddedWidth, paddedHeight);
         }
 
-        /* FFT the kernel */
-        if (ch < channelCountKernel)
-            fftw_execute(p);
+        convolveClear(&data[0], paddedWidth, paddedHeight);
+        for (int i=0; i<passChannels; ++i)
+            convolveLoad(getFloat64Data(), width, height, m_channelCount,
+                ch+i, &data[0], paddedWidth, i == 1);
+
+        /* Multiply in frequency space and transform back */
+        FFT::transform2D(&data[0], paddedWidth, paddedHeight);
+        double factor = (double) 1 / paddedSize;
 
-        /* FFT the image */
-        fftw_execute_dft(p, (fftw_complex *) data, (fftw_complex *) dataS);
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for
+        #endif
+        for (int y=0; y<(int) paddedHeight; ++y) {
+            Complex *d = &data[y*paddedWidth];
+            const Complex *k = &kernel[y*paddedWidth];
+            for (size_t x=0; x<paddedWidth; ++x) {
+                double re = d[x].real()*k[x].real() - d[x].imag()*k[x].imag(),
+                       im = d[x].real()*k[x].imag() + d[x].imag()*k[x].real();
+                d[x] = Complex(re * factor, im * factor);
+            }
+        }
 
-        /* Multiply in frequency space -- also conjugate and scale to use the computed FFT plan backwards */
-        double factor = (double) 1 / (paddedWidth*paddedHeight);
-        for (size_t i=0; i<paddedSize; ++i)
-            dataS[i] = factor * std::conj(dataS[i] * kernelS[i]);
+        FFT::transform2D(&data[0], paddedWidth, paddedHeight, true);
 
-        /* "IFFT" */
-        fftw_execute_dft(p, (fftw_complex *) dataS, (fftw_complex *) data);
+        for (int i=0; i<passChannels; ++i)
+            convolveStore(&data[0], paddedWidth, width, height, m_channelCount,
+                ch+i, getFloat64Data(), i == 1);
+    }
+}
 
-        switch (m_componentFormat) {
-            case EFloat16:
-                for (size_t y=0; y<height; ++y)
-                    for (size_t x=0; x<width; ++x)
-                        getFloat16Data()[(x+y*width)*m_channelCount+ch] = half((float) std::real(data[x+y*paddedWidth]));
-                break;
+ref<Bitmap> Bitmap::createBloomFilter(int size, Float fov) {
+    /* Single precision suffices and lets convolve() use its faster transform */
+    ref<Bitmap> bitmap = new Bitmap(ELuminance, EFloat32, Vector2i(size));
 
-            case EFloat32:
-                for (size_t y=0; y<height; ++y)
-                    for (size_t x=0; x<width; ++x)
-                        getFloat32Data()[(x+y*width)*m_channelCount+ch] = (float) std::real(data[x+y*paddedWidth]);
-                break;
+    Float scale       = 2.f / (size - 1),
+          halfLength  = std::tan(.5f * degToRad(fov));
 
-            case EFloat64:
-                for (size_t y=0; y<height; ++y)
-                    for (size_t x=0; x<width; ++x)
-                        getFloat64Data()[(x+y*width)*m_channelCount+ch] = (double) std::real(data[x+y*paddedWidth]);
-                break;
+    float *data = bitmap->getFloat32Data();
+    double sum = 0;
 
-            default:
-                Log(EError, "Unsupported component format!");
+    #if defined(MTS_OPENMP)
+        #pragma omp parallel for reduction(+:sum)
+    #endif
+    for (int y=0; y<size; ++y) {
+        float *ptr = data + (size_t) y * size;
+        for (int x=0; x<size; ++x) {
+            Float xf = x*scale - 1,
+                  yf = y*scale - 1,
+                  r = std::sqrt(xf*xf+yf*yf),
+                  angle = radToDeg(std::atan(r * halfLength)),
+                  tmp   = angle + 0.02f,
+                  f0 = 2.61e6f * math::fastexp(-2500*angle*angle),
+                  f1 = 20.91f / (tmp*tmp*tmp),
+                  f2 = 72.37f / (tmp*tmp),
+                  f  = 0.384f*f0 + 0.478f*f1 + 0.138f*f2;
+
+            *ptr++ = (float) f;
+            sum += f;
         }
     }
-    __fftw_lock.lock();
-    fftw_destroy_plan(p);
-    fftw_free(kernel);
-    fftw_free(kernelS);
-    fftw_free(data);
-    fftw_free(dataS);
-    __fftw_lock.unlock();
-#else
-    /* Brute force fallback version */
-    uint8_t *output_ = static_cast<uint8_t *>(allocAligned(getBufferSize()));
-    for (int ch=0; ch<m_channelCount; ++ch) {
-        int chKernel = channelCountKernel > 1 ? ch : 0;
 
-        switch (m_componentFormat) {
-            case EFloat16: {
-                    const half *input = getFloat16Data();
-                    const half *kernel = _kernel->getFloat16Data();
-                    half *output = (half *) output_;
-
-                    for (size_t y=0; y<height; ++y) {
-                        for (size_t x=0; x<width; ++x) {
-                            double result = 0;
-                            for (size_t ky=0; ky<kernelSize; ++ky) {
-                                for (size_t kx=0; kx<kernelSize; ++kx) {
-                                    ssize_t xs = x + kx - (ssize_t) hKernelSize,
-                                            ys = y + ky - (ssize_t) hKernelSize;
-                                    if (xs >= 0 && ys >= 0 && xs < (ssize_t) width && ys < (ssize_t) height)
-                                        result += (double) kernel[(kx+ky*kernelSize)*channelCountKernel+chKernel]
-                                            * (double) input[(xs+ys*width)*m_channelCount+ch];
-                                }
-                            }
-                            output[(x+y*width)*m_channelCount+ch] = safe_cast<half>(result);
-                        }
-                    }
-                }
-                break;
-
-            case EFloat32: {
-                    const float *input = getFloat32Data();
-                    const float *kernel = _kernel->getFloat32Data();
-                    float *output = (float *) output_;
-
-                    for (size_t y=0; y<height; ++y) {
-                        for (size_t x=0; x<width; ++x) {
-                            double result = 0;
-                            for (size_t ky=0; ky<kernelSize; ++ky) {
-                                for (size_t kx=0; kx<kernelSize; ++kx) {
-                                    ssize_t xs = x + kx - (ssize_t) hKernelSize,
-                                            ys = y + ky - (ssize_t) hKernelSize;
-                                    if (xs >= 0 && ys >= 0 && xs < (ssize_t) width && ys < (ssize_t) height)
-                                        result += kernel[(kx+ky*kernelSize)*channelCountKernel+chKernel]
-                                            * input[(xs+ys*width)*m_channelCount+ch];
-                                }
-                            }
-                            output[(x+y*width)*m_channelCount+ch] = (float) result;
-                        }
-                    }
-                }
-                break;
+    float normalization = (float) (1/sum);
+    for (size_t i=0; i<(size_t) size*size; ++i)
+        data[i] *= normalization;
 
-            case EFloat64: {
-                    const double *input = getFloat64Data();
-                    const double *kernel = _kernel->getFloat64Data();
-                    double *output = (double *) output_;
-
-                    for (size_t y=0; y<height; ++y) {
-                        for (size_t x=0; x<width; ++x) {
-                            double result = 0;
-                            for (size_t ky=0; ky<kernelSize; ++ky) {
-                                for (size_t kx=0; kx<kernelSize; ++kx) {
-                                    ssize_t xs = x + kx - (ssize_t) hKernelSize,
-                                            ys = y + ky - (ssize_t) hKernelSize;
-                                    if (xs >= 0 && ys >= 0 && xs < (ssize_t) width && ys < (ssize_t) height)
-                                        result += kernel[(kx+ky*kernelSize)*channelCountKernel+chKernel]
-                                            * input[(xs+ys*width)*m_channelCount+ch];
-                                }
-                            }
-                            output[(x+y*width)*m_channelCount+ch] = result;
-                        }
-                    }
-                }
-                break;
-            default:
-                Log(EError, "Unsupported component format!");
-        }
-    }
-    if (m_ownsData)
-        freeAligned(m_data);
-    m_data = output_;
-    m_ownsData = true;
-#endif
+    return bitmap;
 }
 
 void Bitmap::scale(Float value) {
@@ -1853,6 +1853,23 @@ template <typename T> void tonemapReinhard(T *data, size_t pixels, Bitmap::EPixe
     }
 }
 
+void Bitmap::getLuminanceStatistics(Float &logAvgLuminance, Float &maxLuminance,
+        Float multiplier) const {
+    Assert(m_pixelFormat == ERGB || m_pixelFormat == ERGBA ||
+           m_pixelFormat == ELuminance || m_pixelFormat == ELuminanceAlpha);
+    Assert(m_gamma == 1);
+
+    ref<const Bitmap> bitmap = this;
+    if (m_componentFormat != EFloat32) {
+        ref<Bitmap> temp = new Bitmap(m_pixelFormat, EFloat32, m_size);
+        convert(temp);
+        bitmap = temp;
+    }
+
+    tonemap::getLuminanceStatistics(bitmap->getFloat32Data(), m_pixelFormat,
+        getPixelCount(), multiplier, logAvgLuminance, maxLuminance);
+}
+
 void Bitmap::tonemapReinhard(Float &logAvgLuminance, Float &maxLuminance, Float key, Float burn) {
     Assert(m_pixelFormat == ERGB || m_pixelFormat == ERGBA ||
            m_pixelFormat == ELuminance || m_pixelFormat == ELuminanceAlpha);
@@ -1861,12 +1878,22 @@ void Bitmap::tonemapReinhard(Float &logAvgLuminance, Float &maxLuminance, Float
     size_t pixels = (size_t) m_size.x * (size_t) m_size.y;
 
     switch (m_componentFormat) {
+        case EFloat32: {
+                if (logAvgLuminance <= 0 || maxLuminance <= 0)
+                    getLuminanceStatistics(logAvgLuminance, maxLuminance);
+
+                if (maxLuminance == 0) /* This is a black image -- stop now */
+                    break;
+
+                tonemap::Parameters params;
+                params.setReinhard(key, burn, logAvgLuminance, maxLuminance);
+                tonemap::applyReinhard(getFloat32Data(), m_pixelFormat, pixels,
+                    params.scale, params.invWp2);
+            }
+            break;
         case EFloat16:
             mitsuba::tonemapReinhard(getFloat16Data(), pixels, m_pixelFormat, logAvgLuminance, maxLuminance, key, burn);
             break;
-        case EFloat32:
-            mitsuba::tonemapReinhard(getFloat32Data(), pixels, m_pixelFormat, logAvgLuminance, maxLuminance, key, burn);
-            break;
         case EFloat64:
             mitsuba::tonemapReinhard(getFloat64Data(), pixels, m_pixelFormat, logAvgLuminance, maxLuminance, key, burn);
             break;
@@ -3913,20 +3940,10 @@ void Bitmap::staticInitialization() {
 
     /* Initialize the Bitmap format conversion */
     FormatConverter::staticInitialization();
-
-#if defined(MTS_HAS_FFTW)
-    /* Initialize FFTW if enabled */
-    fftw_init_threads();
-    fftw_plan_with_nthreads(getCoreCount());
-#endif
 }
 
 void Bitmap::staticShutdown() {
     FormatConverter::staticShutdown();
-
-#if defined(MTS_HAS_FFTW)
-    fftw_cleanup_threads();
-#endif
 }
 
 ref<Bitmap> Bitmap::expand() {
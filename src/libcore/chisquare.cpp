@@ -44,7 +44,8 @@ struct VectorOrder {
 };
 
 ChiSquare::ChiSquare(int thetaBins, int phiBins, int numTests,
-        size_t sampleCount) : m_logLevel(EInfo), m_thetaBins(thetaBins),
+        size_t sampleCount) : m_logLevel(EInfo), m_parallel(true),
+          m_samplingTime(0), m_integrationTime(0), m_evaluationCount(0), m_thetaBins(thetaBins),
           m_phiBins(phiBins), m_numTests(numTests), m_sampleCount(sampleCount) {
     if (m_phiBins == 0)
         m_phiBins = 2*m_thetaBins;
@@ -133,33 +134,47 @@ void ChiSquare::fill(
 
     factor = Point2(M_PI / m_thetaBins, (2*M_PI) / m_phiBins);
 
+    m_samplingTime = timer->getSeconds();
     Log(m_logLevel, "Done, took %i ms. Integrating reference "
         "contingency table ..", timer->getMilliseconds());
     timer->reset();
+    m_evaluationCount = 0;
     Float min[2], max[2];
     size_t idx = 0;
 
-    NDIntegrator integrator(1, 2, 100000, 0, 1e-6f);
+    /* Each cell is integrated as a grid of subregions. Otherwise, the
+       initial cubature points could miss narrow peaks (e.g. those of
+       fiber-like distributions) entirely, and the adaptive refinement
+       would never see them */
+    const int subdivs = 8;
+    NDIntegrator integrator(1, 2, 100000 / subdivs, 0, 1e-6f);
     Float maxError = 0, integral = 0;
     for (int i=0; i<m_thetaBins; ++i) {
-        min[0] = i * factor.x;
-        max[0] = (i+1) * factor.x;
         for (int j=0; j<m_phiBins; ++j) {
-            min[1] = j * factor.y;
-            max[1] = (j+1) * factor.y;
-            Float result, error;
-
-            integrator.integrateVectorized(
-                boost::bind(&ChiSquare::integrand, pdfFn, _1, _2, _3),
-                min, max, &result, &error
-            );
-
-            integral += result;
-            m_refTable[idx++] += result * m_sampleCount;
-            maxError = std::max(maxError, error);
+            Float cellResult = 0;
+            for (int k=0; k<subdivs*subdivs; ++k) {
+                min[0] = (i + (k / subdivs) / (Float) subdivs) * factor.x;
+                max[0] = (i + (k / subdivs + 1) / (Float) subdivs) * factor.x;
+                min[1] = (j + (k % subdivs) / (Float) subdivs) * factor.y;
+                max[1] = (j + (k % subdivs + 1) / (Float) subdivs) * factor.y;
+                Float result, error;
+                size_t evals = 0;
+
+                integrator.integrateVectorized(
+                    boost::bind(&ChiSquare::integrand, pdfFn, m_parallel, _1, _2, _3),
+                    min, max, &result, &error, &evals
+                );
+                m_evaluationCount += evals;
+                cellResult += result;
+                maxError = std::max(maxError, error);
+            }
+
+            integral += cellResult;
+            m_refTable[idx++] += cellResult * m_sampleCount;
         }
     }
 
+    m_integrationTime = timer->getSeconds();
     Log(m_logLevel, "Done, took %i ms (max error = %f, integral=%f).",
             timer->getMilliseconds(), maxError, integral);
 }
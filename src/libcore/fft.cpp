@@ -0,0 +1,581 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/fft.h>
+#include <mitsuba/core/sse.h>
+
+#if defined(MTS_OPENMP)
+# include <omp.h>
+#endif
+
+/// Number of columns that are transformed together by FFT::transform2D()
+#define MTS_FFT_PANEL_SIZE 8
+
+MTS_NAMESPACE_BEGIN
+
+namespace {
+#if defined(MTS_SSE)
+    /* A double precision complex number in one SSE2 register */
+    struct cvec {
+        typedef FFT::Complex Element;
+        typedef FFT::Complex Twiddle;
+
+        __m128d v;
+
+        inline cvec() { }
+        inline cvec(__m128d v) : v(v) { }
+        inline explicit cvec(const FFT::Complex &c) : v(_mm_loadu_pd((const double *) &c)) { }
+
+        static inline cvec twiddle(const FFT::Complex &tw, bool conj) {
+            return cvec(conj ? std::conj(tw) : tw);
+        }
+
+        inline void store(FFT::Complex &c) const { _mm_storeu_pd((double *) &c, v); }
+
+        inline cvec operator+(const cvec &c) const { return _mm_add_pd(v, c.v); }
+        inline cvec operator-(const cvec &c) const { return _mm_sub_pd(v, c.v); }
+        inline cvec operator*(double f) const { return _mm_mul_pd(v, _mm_set1_pd(f)); }
+
+        inline cvec operator*(const cvec &c) const {
+            const __m128d signLo = _mm_set_pd(0.0, -0.0);
+            __m128d re = _mm_unpacklo_pd(c.v, c.v),
+                    im = _mm_unpackhi_pd(c.v, c.v),
+                    sw = _mm_shuffle_pd(v, v, 1);
+            return _mm_add_pd(_mm_mul_pd(v, re),
+                _mm_xor_pd(_mm_mul_pd(sw, im), signLo));
+        }
+
+        /// Multiply by +i
+        inline cvec mulI() const {
+            const __m128d signLo = _mm_set_pd(0.0, -0.0);
+            return _mm_xor_pd(_mm_shuffle_pd(v, v, 1), signLo);
+        }
+
+        /// Multiply by -i
+        inline cvec mulNegI() const {
+            const __m128d signHi = _mm_set_pd(-0.0, 0.0);
+            return _mm_xor_pd(_mm_shuffle_pd(v, v, 1), signHi);
+        }
+    };
+
+    /* Four single precision complex numbers from independent transforms,
+       with the real and imaginary parts in separate SSE registers */
+    struct cbatch {
+        typedef FFT::ComplexBatch Element;
+        typedef std::complex<float> Twiddle;
+
+        __m128 re, im;
+
+        inline cbatch() { }
+        inline cbatch(__m128 re, __m128 im) : re(re), im(im) { }
+        inline explicit cbatch(const FFT::ComplexBatch &c)
+            : re(_mm_loadu_ps(c.re)), im(_mm_loadu_ps(c.im)) { }
+
+        static inline cbatch twiddle(const std::complex<float> &tw, bool conj) {
+            return cbatch(_mm_set1_ps(tw.real()), _mm_set1_ps(conj ? -tw.imag() : tw.imag()));
+        }
+
+        inline void store(FFT::ComplexBatch &c) const {
+            _mm_storeu_ps(c.re, re);
+            _mm_storeu_ps(c.im, im);
+        }
+
+        inline cbatch operator+(const cbatch &c) const {
+            return cbatch(_mm_add_ps(re, c.re), _mm_add_ps(im, c.im));
+        }
+        inline cbatch operator-(const cbatch &c) const {
+            return cbatch(_mm_sub_ps(re, c.re), _mm_sub_ps(im, c.im));
+        }
+        inline cbatch operator*(double f) const {
+            __m128 s = _mm_set1_ps((float) f);
+            return cbatch(_mm_mul_ps(re, s), _mm_mul_ps(im, s));
+        }
+        inline cbatch operator*(const cbatch &c) const {
+            return cbatch(_mm_sub_ps(_mm_mul_ps(re, c.re), _mm_mul_ps(im, c.im)),
+                          _mm_add_ps(_mm_mul_ps(re, c.im), _mm_mul_ps(im, c.re)));
+        }
+
+        /// Multiply by +i
+        inline cbatch mulI() const {
+            return cbatch(_mm_xor_ps(im, _mm_set1_ps(-0.0f)), re);
+        }
+
+        /// Multiply by -i
+        inline cbatch mulNegI() const {
+            return cbatch(im, _mm_xor_ps(re, _mm_set1_ps(-0.0f)));
+        }
+    };
+#else
+    /* Scalar fallbacks with the same interface. This also avoids the slow
+       NaN-aware complex multiplication of std::complex */
+    struct cvec {
+        typedef FFT::Complex Element;
+        typedef FFT::Complex Twiddle;
+
+        double re, im;
+
+        inline cvec() { }
+        inline cvec(double re, double im) : re(re), im(im) { }
+        inline explicit cvec(const FFT::Complex &c) : re(c.real()), im(c.imag()) { }
+
+        static inline cvec twiddle(const FFT::Complex &tw, bool conj) {
+            return cvec(conj ? std::conj(tw) : tw);
+        }
+
+        inline void store(FFT::Complex &c) const { c = FFT::Complex(re, im); }
+
+        inline cvec operator+(const cvec &c) const { return cvec(re + c.re, im + c.im); }
+        inline cvec operator-(const cvec &c) const { return cvec(re - c.re, im - c.im); }
+        inline cvec operator*(double f) const { return cvec(re * f, im * f); }
+        inline cvec operator*(const cvec &c) const {
+            return cvec(re*c.re - im*c.im, re*c.im + im*c.re);
+        }
+
+        inline cvec mulI() const { return cvec(-im, re); }
+        inline cvec mulNegI() const { return cvec(im, -re); }
+    };
+
+    struct cbatch {
+        typedef FFT::ComplexBatch Element;
+        typedef std::complex<float> Twiddle;
+
+        float re[4], im[4];
+
+        inline cbatch() { }
+        inline explicit cbatch(const FFT::ComplexBatch &c) {
+            for (int i=0; i<4; ++i) { re[i] = c.re[i]; im[i] = c.im[i]; }
+        }
+
+        static inline cbatch twiddle(const std::complex<float> &tw, bool conj) {
+            cbatch result;
+            for (int i=0; i<4; ++i) { result.re[i] = tw.real(); result.im[i] = conj ? -tw.imag() : tw.imag(); }
+            return result;
+        }
+
+        inline void store(FFT::ComplexBatch &c) const {
+            for (int i=0; i<4; ++i) { c.re[i] = re[i]; c.im[i] = im[i]; }
+        }
+
+        inline cbatch operator+(const cbatch &c) const {
+            cbatch result;
+            for (int i=0; i<4; ++i) { result.re[i] = re[i] + c.re[i]; result.im[i] = im[i] + c.im[i]; }
+            return result;
+        }
+        inline cbatch operator-(const cbatch &c) const {
+            cbatch result;
+            for (int i=0; i<4; ++i) { result.re[i] = re[i] - c.re[i]; result.im[i] = im[i] - c.im[i]; }
+            return result;
+        }
+        inline cbatch operator*(double f) const {
+            cbatch result;
+            for (int i=0; i<4; ++i) { result.re[i] = re[i] * (float) f; result.im[i] = im[i] * (float) f; }
+            return result;
+        }
+        inline cbatch operator*(const cbatch &c) const {
+            cbatch result;
+            for (int i=0; i<4; ++i) {
+                result.re[i] = re[i]*c.re[i] - im[i]*c.im[i];
+                result.im[i] = re[i]*c.im[i] + im[i]*c.re[i];
+            }
+            return result;
+        }
+
+        inline cbatch mulI() const {
+            cbatch result;
+            for (int i=0; i<4; ++i) { result.re[i] = -im[i]; result.im[i] = re[i]; }
+            return result;
+        }
+        inline cbatch mulNegI() const {
+            cbatch result;
+            for (int i=0; i<4; ++i) { result.re[i] = im[i]; result.im[i] = -re[i]; }
+            return result;
+        }
+    };
+#endif
+
+    /// Multiply by -i (forward transform) or +i (inverse transform)
+    template <bool Inverse, typename V> inline V rotate(const V &c) {
+        return Inverse ? c.mulI() : c.mulNegI();
+    }
+
+    /* Size-R DFTs of the values in 'v' (in place) */
+    template <typename V, int R, bool Inverse> struct Butterfly;
+
+    template <typename V, bool Inverse> struct Butterfly<V, 2, Inverse> {
+        static inline void apply(V *v) {
+            V t = v[0] - v[1];
+            v[0] = v[0] + v[1];
+            v[1] = t;
+        }
+    };
+
+    template <typename V, bool Inverse> struct Butterfly<V, 3, Inverse> {
+        static inline void apply(V *v) {
+            const double c = -0.5, s = 0.86602540378443864676;
+            V t1 = v[1] + v[2],
+                 t2 = rotate<Inverse>(v[1] - v[2]) * s,
+                 m  = v[0] + t1 * c;
+            v[0] = v[0] + t1;
+            v[1] = m + t2;
+            v[2] = m - t2;
+        }
+    };
+
+    template <typename V, bool Inverse> struct Butterfly<V, 4, Inverse> {
+        static inline void apply(V *v) {
+            V t0 = v[0] + v[2], t1 = v[0] - v[2],
+                 t2 = v[1] + v[3], t3 = rotate<Inverse>(v[1] - v[3]);
+            v[0] = t0 + t2;
+            v[2] = t0 - t2;
+            v[1] = t1 + t3;
+            v[3] = t1 - t3;
+        }
+    };
+
+    template <typename V, bool Inverse> struct Butterfly<V, 5, Inverse> {
+        static inline void apply(V *v) {
+            const double c1 =  0.30901699437494742410, /* cos(2pi/5) */
+                         c2 = -0.80901699437494742410, /* cos(4pi/5) */
+                         s1 =  0.95105651629515357212, /* sin(2pi/5) */
+                         s2 =  0.58778525229247312917; /* sin(4pi/5) */
+            V t1 = v[1] + v[4], t2 = v[2] + v[3],
+                 t3 = v[1] - v[4], t4 = v[2] - v[3];
+            V a1 = v[0] + t1 * c1 + t2 * c2,
+                 a2 = v[0] + t1 * c2 + t2 * c1,
+                 b1 = rotate<Inverse>(t3 * s1 + t4 * s2),
+                 b2 = rotate<Inverse>(t3 * s2 - t4 * s1);
+            v[0] = v[0] + t1 + t2;
+            v[1] = a1 + b1;
+            v[4] = a1 - b1;
+            v[2] = a2 + b2;
+            v[3] = a2 - b2;
+        }
+    };
+
+    /**
+     * One radix-R pass of the Stockham algorithm: reads 'x', writes the
+     * partially transformed (and already reordered) result to 'y'.
+     * 'ns' is the product of the radices of all previous passes.
+     */
+    template <typename V, int R, bool Inverse> void fftPass(const typename V::Element *x,
+            typename V::Element *y, size_t n, size_t ns, const typename V::Twiddle *twiddles) {
+        typedef typename V::Element Element;
+        const size_t m = n / R, groups = m / ns, twStride = n / (ns * R);
+        V v[R];
+
+        for (size_t k=0; k<groups; ++k) {
+            const Element *src = x + k * ns;
+            Element *dst = y + k * ns * R;
+
+            /* The first butterfly of each group has unit twiddle factors */
+            for (int r=0; r<R; ++r)
+                v[r] = V(src[r*m]);
+            Butterfly<V, R, Inverse>::apply(v);
+            for (int r=0; r<R; ++r)
+                v[r].store(dst[r*ns]);
+
+            for (size_t j=1; j<ns; ++j) {
+                v[0] = V(src[j]);
+                for (int r=1; r<R; ++r)
+                    v[r] = V(src[j + r*m]) * V::twiddle(twiddles[r*j*twStride], Inverse);
+                Butterfly<V, R, Inverse>::apply(v);
+                for (int r=0; r<R; ++r)
+                    v[r].store(dst[j + r*ns]);
+            }
+        }
+    }
+
+    template <typename V, bool Inverse> void fftTransform(typename V::Element *data,
+            typename V::Element *scratch, size_t n, const std::vector<int> &radices,
+            const typename V::Twiddle *twiddles) {
+        typename V::Element *x = data, *y = scratch;
+        size_t ns = 1;
+
+        for (size_t i=0; i<radices.size(); ++i) {
+            switch (radices[i]) {
+                case 2: fftPass<V, 2, Inverse>(x, y, n, ns, twiddles); break;
+                case 3: fftPass<V, 3, Inverse>(x, y, n, ns, twiddles); break;
+                case 4: fftPass<V, 4, Inverse>(x, y, n, ns, twiddles); break;
+                case 5: fftPass<V, 5, Inverse>(x, y, n, ns, twiddles); break;
+                default: SLog(EError, "Internal error: unsupported radix!");
+            }
+            ns *= radices[i];
+            std::swap(x, y);
+        }
+
+        if (x != data)
+            memcpy(data, x, sizeof(typename V::Element) * n);
+    }
+}
+
+FFT::FFT(size_t size) : m_size(size) {
+    if (size == 0)
+        Log(EError, "FFT: the transform size must be positive!");
+
+    /* Factor the size, preferring radix-4 passes */
+    while (size % 4 == 0) { m_radices.push_back(4); size /= 4; }
+    while (size % 2 == 0) { m_radices.push_back(2); size /= 2; }
+    while (size % 3 == 0) { m_radices.push_back(3); size /= 3; }
+    while (size % 5 == 0) { m_radices.push_back(5); size /= 5; }
+    if (size != 1)
+        Log(EError, "FFT: unsupported transform size " SIZE_T_FMT " (the only "
+            "permitted prime factors are 2, 3 and 5)!", m_size);
+
+    m_twiddles.resize(m_size);
+    m_twiddlesFloat.resize(m_size);
+    for (size_t i=0; i<m_size; ++i) {
+        double angle = -2 * M_PI_DBL * (double) i / (double) m_size;
+        m_twiddles[i] = Complex(std::cos(angle), std::sin(angle));
+        m_twiddlesFloat[i] = std::complex<float>(m_twiddles[i]);
+    }
+}
+
+void FFT::transform(Complex *data, Complex *scratch, bool inverse) const {
+    if (inverse)
+        fftTransform<cvec, true>(data, scratch, m_size, m_radices, &m_twiddles[0]);
+    else
+        fftTransform<cvec, false>(data, scratch, m_size, m_radices, &m_twiddles[0]);
+}
+
+void FFT::transformBatch(ComplexBatch *data, ComplexBatch *scratch, bool inverse) const {
+    if (inverse)
+        fftTransform<cbatch, true>(data, scratch, m_size, m_radices, &m_twiddlesFloat[0]);
+    else
+        fftTransform<cbatch, false>(data, scratch, m_size, m_radices, &m_twiddlesFloat[0]);
+}
+
+void FFT::transform2D(Complex *data, size_t width, size_t height, bool inverse) {
+    ref<FFT> rowPlan = new FFT(width), colPlan = rowPlan;
+    if (height != width)
+        colPlan = new FFT(height);
+    const FFT *rows = rowPlan.get(), *cols = colPlan.get();
+    int panelCount = (int) ((width + MTS_FFT_PANEL_SIZE - 1) / MTS_FFT_PANEL_SIZE);
+
+    #if defined(MTS_OPENMP)
+        #pragma omp parallel
+    #endif
+    {
+        std::vector<Complex> scratch(std::max(width, height)),
+                             panel(height * MTS_FFT_PANEL_SIZE);
+
+        #if defined(MTS_OPENMP)
+            #pragma omp for schedule(dynamic, 16)
+        #endif
+        for (int y=0; y<(int) height; ++y)
+            rows->transform(data + y * width, &scratch[0], inverse);
+
+        /* Columns are copied into a contiguous buffer in small
+           panels, which keeps the strided accesses cache-friendly */
+        #if defined(MTS_OPENMP)
+            #pragma omp for schedule(dynamic)
+        #endif
+        for (int p=0; p<panelCount; ++p) {
+            size_t x0 = (size_t) p * MTS_FFT_PANEL_SIZE,
+                   count = std::min((size_t) MTS_FFT_PANEL_SIZE, width - x0);
+
+            for (size_t y=0; y<height; ++y) {
+                const Complex *src = data + y * width + x0;
+                for (size_t c=0; c<count; ++c)
+                    panel[c * height + y] = src[c];
+            }
+
+            for (size_t c=0; c<count; ++c)
+                cols->transform(&panel[c * height], &scratch[0], inverse);
+
+            for (size_t y=0; y<height; ++y) {
+                Complex *dst = data + y * width + x0;
+                for (size_t c=0; c<count; ++c)
+                    dst[c] = panel[c * height + y];
+            }
+        }
+    }
+}
+
+size_t FFT::getSmoothSize(size_t n) {
+    /* Such numbers are dense enough for a linear search */
+    for (n = std::max(n, (size_t) 1); ; ++n) {
+        size_t m = n;
+        while (m % 2 == 0) m /= 2;
+        while (m % 3 == 0) m /= 3;
+        while (m % 5 == 0) m /= 5;
+        if (m == 1)
+            return n;
+    }
+}
+
+std::string FFT::toString() const {
+    std::ostringstream oss;
+    oss << "FFT[size=" << m_size << ", radices={";
+    for (size_t i=0; i<m_radices.size(); ++i)
+        oss << m_radices[i] << (i+1 < m_radices.size() ? ", " : "");
+    oss << "}]";
+    return oss.str();
+}
+
+RealFFT2D::RealFFT2D(size_t width, size_t height)
+        : m_width(width), m_height(height) {
+    m_halfWidth = width / 2 + 1;
+    m_columnBatches = (m_halfWidth + 3) / 4;
+    m_rows = new FFT(width);
+    m_cols = m_rows;
+    if (height != width)
+        m_cols = new FFT(height);
+}
+
+/* The row passes process groups of eight rows: lane 'j' of a batch holds
+   rows 2j and 2j+1 of the group in its real and imaginary parts. The
+   spectrum stores column 'k' in lane k%4 of the contiguous column batch
+   k/4, so that the column passes can transform it in place. */
+
+void RealFFT2D::forward(const float *data, FFT::ComplexBatch *spectrum) const {
+    const size_t width = m_width, height = m_height;
+    const int groupCount = (int) ((height + 7) / 8);
+
+    #if defined(MTS_OPENMP)
+        #pragma omp parallel
+    #endif
+    {
+        std::vector<FFT::ComplexBatch> row(width),
+            scratch(std::max(width, height));
+
+        #if defined(MTS_OPENMP)
+            #pragma omp for schedule(dynamic)
+        #endif
+        for (int g=0; g<groupCount; ++g) {
+            size_t y0 = (size_t) g * 8, rowCount = std::min((size_t) 8, height - y0);
+
+            if (rowCount < 8)
+                memset(&row[0], 0, sizeof(FFT::ComplexBatch) * width);
+            for (size_t i=0; i<rowCount; ++i) {
+                const float *src = data + (y0 + i) * width;
+                for (size_t x=0; x<width; ++x)
+                    (i % 2 == 0 ? row[x].re : row[x].im)[i / 2] = src[x];
+            }
+
+            m_rows->transformBatch(&row[0], &scratch[0]);
+
+            /* Separate the spectra of the two rows using their conjugate
+               symmetry: A[k] = (Z[k] + Z*[n-k]) / 2, B[k] = (Z[k] - Z*[n-k]) / 2i */
+            for (size_t k=0; k<m_halfWidth; ++k) {
+                FFT::ComplexBatch *dst = spectrum + (k / 4) * height + y0;
+                const FFT::ComplexBatch &z = row[k], &zm = row[k == 0 ? 0 : width - k];
+                const size_t lane = k % 4;
+
+                for (size_t i=0; i<rowCount; ++i) {
+                    size_t j = i / 2;
+                    if (i % 2 == 0) {
+                        dst[i].re[lane] = 0.5f * (z.re[j] + zm.re[j]);
+                        dst[i].im[lane] = 0.5f * (z.im[j] - zm.im[j]);
+                    } else {
+                        dst[i].re[lane] = 0.5f * (z.im[j] + zm.im[j]);
+                        dst[i].im[lane] = 0.5f * (zm.re[j] - z.re[j]);
+                    }
+                }
+            }
+
+            /* Clear the unused lanes of the last column batch */
+            for (size_t k=m_halfWidth; k<m_columnBatches*4; ++k) {
+                FFT::ComplexBatch *dst = spectrum + (k / 4) * height + y0;
+                for (size_t i=0; i<rowCount; ++i)
+                    dst[i].re[k % 4] = dst[i].im[k % 4] = 0.0f;
+            }
+        }
+
+        #if defined(MTS_OPENMP)
+            #pragma omp for schedule(dynamic)
+        #endif
+        for (int b=0; b<(int) m_columnBatches; ++b)
+            m_cols->transformBatch(spectrum + b * height, &scratch[0]);
+    }
+}
+
+void RealFFT2D::inverse(FFT::ComplexBatch *spectrum, float *data) const {
+    const size_t width = m_width, height = m_height;
+    const int groupCount = (int) ((height + 7) / 8);
+
+    #if defined(MTS_OPENMP)
+        #pragma omp parallel
+    #endif
+    {
+        std::vector<FFT::ComplexBatch> row(width),
+            scratch(std::max(width, height));
+
+        #if defined(MTS_OPENMP)
+            #pragma omp for schedule(dynamic)
+        #endif
+        for (int b=0; b<(int) m_columnBatches; ++b)
+            m_cols->transformBatch(spectrum + b * height, &scratch[0], true);
+
+        #if defined(MTS_OPENMP)
+            #pragma omp for schedule(dynamic)
+        #endif
+        for (int g=0; g<groupCount; ++g) {
+            size_t y0 = (size_t) g * 8, rowCount = std::min((size_t) 8, height - y0);
+
+            if (rowCount < 8)
+                memset(&row[0], 0, sizeof(FFT::ComplexBatch) * width);
+
+            /* Recombine the two row spectra into Z[k] = A[k] + i B[k], where
+               the right half follows from A[n-k] = A*[k] and B[n-k] = B*[k] */
+            for (size_t x=0; x<width; ++x) {
+                bool mirror = x >= m_halfWidth;
+                size_t k = mirror ? width - x : x;
+                const FFT::ComplexBatch *src = spectrum + (k / 4) * height + y0;
+                const size_t lane = k % 4;
+                const float sign = mirror ? -1.0f : 1.0f;
+
+                for (size_t i=0; i<rowCount; i += 2) {
+                    float aRe = src[i].re[lane], aIm = sign * src[i].im[lane], bRe = 0, bIm = 0;
+                    if (i + 1 < rowCount) {
+                        bRe = src[i+1].re[lane];
+                        bIm = sign * src[i+1].im[lane];
+                    }
+                    row[x].re[i / 2] = aRe - bIm;
+                    row[x].im[i / 2] = aIm + bRe;
+                }
+            }
+
+            m_rows->transformBatch(&row[0], &scratch[0], true);
+
+            for (size_t i=0; i<rowCount; ++i) {
+                float *dst = data + (y0 + i) * width;
+                for (size_t x=0; x<width; ++x)
+                    dst[x] = (i % 2 == 0 ? row[x].re : row[x].im)[i / 2];
+            }
+        }
+    }
+}
+
+void RealFFT2D::multiply(FFT::ComplexBatch *a, const FFT::ComplexBatch *b,
+        size_t size, float scale) {
+    #if defined(MTS_OPENMP)
+        #pragma omp parallel for
+    #endif
+    for (ssize_t i=0; i<(ssize_t) size; ++i)
+        ((cbatch(a[i]) * cbatch(b[i])) * scale).store(a[i]);
+}
+
+std::string RealFFT2D::toString() const {
+    std::ostringstream oss;
+    oss << "RealFFT2D[width=" << m_width << ", height=" << m_height << "]";
+    return oss.str();
+}
+
+MTS_IMPLEMENT_CLASS(FFT, false, Object)
+MTS_IMPLEMENT_CLASS(RealFFT2D, false, Object)
+MTS_NAMESPACE_END
@@ -20,6 +20,7 @@
 #define BOOST_MPL_LIMIT_VECTOR_SIZE 40
 
 #include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/tonemap.h>
 #include <boost/mpl/vector.hpp>
 #include <boost/mpl/for_each.hpp>
 #include <boost/mpl/fold.hpp>
@@ -39,7 +40,9 @@ namespace mpl = boost::mpl;
 /*  it produces code for each possible pair                                 */
 /****************************************************************************/
 /*  Note that some cases in this file really scream for SSE optimization    */
-/*  (in case they ever become a bottleneck, that is..)                      */
+/*  (in case they ever become a bottleneck, that is..). The most common one */
+/*  -- float32 to uint8 for display -- is handed to the kernels in          */
+/*  mitsuba/core/tonemap.h                                                  */
 /****************************************************************************/
 
 namespace detail {
@@ -143,9 +146,19 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
             return;
         }
 
+        const Float invDestGamma = 1.0f / destGamma;
+
+        /* Use the vectorized kernels when converting linear float32 data to uint8 */
+        if (boost::is_same<SourceFormat, float>::value && boost::is_same<DestFormat, uint8_t>::value
+                && sourceGamma == 1 && tonemap::isSupported(sourceFormat, destFormat)) {
+            tonemap::toDisplay(reinterpret_cast<const float *>(_source), sourceFormat,
+                reinterpret_cast<uint8_t *>(_dest), destFormat, count,
+                tonemap::Parameters(multiplier, invDestGamma));
+            return;
+        }
+
         const SourceFormat *source = reinterpret_cast<const SourceFormat *>(_source);
         DestFormat *dest = reinterpret_cast<DestFormat *>(_dest);
-        const Float invDestGamma = 1.0f / destGamma;
         const size_t maxValue = (size_t) std::numeric_limits<SourceFormat>::max();
 
         DestFormat *precomp = NULL;
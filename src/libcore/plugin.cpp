@@ -165,7 +165,7 @@ Plugin::~Plugin() {
 
 ref<PluginManager> PluginManager::m_instance = NULL;
 
-PluginManager::PluginManager() {
+PluginManager::PluginManager() : m_lastPlugin(NULL) {
     m_mutex = new Mutex();
 }
 
@@ -183,8 +183,7 @@ ConfigurableObject *PluginManager::createObject(const Class *classType,
 
     {
         LockGuard lock(m_mutex);
-        ensurePluginLoaded(props.getPluginName());
-        object = m_plugins[props.getPluginName()]->createInstance(props);
+        object = getPlugin(props.getPluginName())->createInstance(props);
     }
     if (!object->getClass()->derivesFrom(classType))
         Log(EError, "Type mismatch when loading plugin \"%s\": Expected "
@@ -200,8 +199,7 @@ ConfigurableObject *PluginManager::createObject(const Properties &props) {
 
     {
         LockGuard lock(m_mutex);
-        ensurePluginLoaded(props.getPluginName());
-        object = m_plugins[props.getPluginName()]->createInstance(props);
+        object = getPlugin(props.getPluginName())->createInstance(props);
     }
     if (object->getClass()->isAbstract())
         Log(EError, "Error when loading plugin \"%s\": Identifies itself as an abstract class",
@@ -220,9 +218,21 @@ std::vector<std::string> PluginManager::getLoadedPlugins() const {
 }
 
 void PluginManager::ensurePluginLoaded(const std::string &name) {
+    LockGuard lock(m_mutex);
+    getPlugin(name);
+}
+
+Plugin *PluginManager::getPlugin(const std::string &name) {
+    if (m_lastPlugin && name == m_lastPluginName)
+        return m_lastPlugin;
+
     /* Plugin already loaded? */
-    if (m_plugins[name] != NULL)
-        return;
+    std::map<std::string, Plugin *>::const_iterator it = m_plugins.find(name);
+    if (it != m_plugins.end()) {
+        m_lastPluginName = name;
+        m_lastPlugin = it->second;
+        return it->second;
+    }
 
     /* Build the full plugin file name */
     fs::path shortName = fs::path("plugins") / name;
@@ -239,12 +249,16 @@ void PluginManager::ensurePluginLoaded(const std::string &name) {
 
     if (fs::exists(path)) {
         Log(EInfo, "Loading plugin \"%s\" ..", shortName.string().c_str());
-        m_plugins[name] = new Plugin(shortName.string(), path);
-        return;
+        Plugin *plugin = new Plugin(shortName.string(), path);
+        m_plugins[name] = plugin;
+        m_lastPluginName = name;
+        m_lastPlugin = plugin;
+        return plugin;
     }
 
     /* Plugin not found! */
     Log(EError, "Plugin \"%s\" not found!", name.c_str());
+    return NULL;
 }
 
 void PluginManager::staticInitialization() {
@@ -23,6 +23,9 @@
 /* Keep the boost::variant includes outside of properties.h,
    since they noticeably add to the overall compile times */
 #include <boost/variant.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/mutex.hpp>
 
 MTS_NAMESPACE_BEGIN
 
@@ -31,39 +34,132 @@ typedef boost::variant<
     Spectrum, std::string, Properties::Data> ElementData;
 
 struct PropertyElement {
+    /// Interned property name (shared by all \ref Properties instances)
+    const std::string *name;
+    /// Cached hash of \c name for quick rejection during lookups
+    size_t hash;
     ElementData data;
     mutable bool queried;
 };
 
+typedef std::vector<PropertyElement> ElementList;
+
+namespace {
+    /* Initial capacity of the element list. Most plugins are
+       configured using a handful of parameters, hence this avoids
+       reallocations in the common case */
+    const size_t initialElementCapacity = 8;
+
+    inline size_t hashName(const std::string &name) {
+        return boost::hash<std::string>()(name);
+    }
+
+    /**
+     * Property names are interned, so that the potentially millions of
+     * Properties instances created while loading a large scene share
+     * a single copy of each name. Copying a Properties instance then
+     * only copies pointers. The table is intentionally never freed.
+     */
+    const std::string *internName(const std::string &name) {
+        typedef boost::unordered_set<std::string> NameTable;
+        static NameTable *table = new NameTable();
+        static boost::mutex *mutex = new boost::mutex();
+
+        boost::mutex::scoped_lock lock(*mutex);
+        return &(*table->insert(name).first);
+    }
+
+    /* Linear search -- faster than a tree or hash table lookup
+       for the small number of entries found in practice */
+    inline const PropertyElement *findElement(const ElementList &elements,
+            const std::string &name, size_t hash) {
+        for (ElementList::const_iterator it = elements.begin();
+                it != elements.end(); ++it) {
+            if (it->hash == hash && *it->name == name)
+                return &(*it);
+        }
+        return NULL;
+    }
+
+    inline const PropertyElement *findElement(const ElementList &elements,
+            const std::string &name) {
+        return findElement(elements, name, hashName(name));
+    }
+
+    inline PropertyElement *findElement(ElementList &elements, const std::string &name) {
+        return const_cast<PropertyElement *>(findElement(
+            const_cast<const ElementList &>(elements), name));
+    }
+
+    inline void incRef(const PropertyElement &element) {
+        AnimatedTransform * const *trafo = boost::get<AnimatedTransform *>(&element.data);
+        if (trafo)
+            (*trafo)->incRef();
+    }
+
+    inline void decRef(const PropertyElement &element) {
+        AnimatedTransform * const *trafo = boost::get<AnimatedTransform *>(&element.data);
+        if (trafo)
+            (*trafo)->decRef();
+    }
+
+    /// Look up an element or create it if it does not exist yet
+    PropertyElement &lookupOrCreate(ElementList &elements, const std::string &name,
+            bool warnDuplicates) {
+        size_t hash = hashName(name);
+        PropertyElement *element = const_cast<PropertyElement *>(
+            findElement(const_cast<const ElementList &>(elements), name, hash));
+        if (element) {
+            if (warnDuplicates)
+                SLog(EWarn, "Property \"%s\" was specified multiple times!", name.c_str());
+            decRef(*element);
+            return *element;
+        }
+        elements.push_back(PropertyElement());
+        PropertyElement &result = elements.back();
+        result.name = internName(name);
+        result.hash = hash;
+        return result;
+    }
+
+    /// Copy the contents of an element, keeping track of reference counts
+    void assign(ElementList &elements, const std::string &name,
+            const PropertyElement &source) {
+        incRef(source);
+        PropertyElement &target = lookupOrCreate(elements, name, false);
+        target.data = source.data;
+        target.queried = source.queried;
+    }
+};
+
 #define DEFINE_PROPERTY_ACCESSOR(Type, BaseType, TypeName, ReadableName) \
     void Properties::set##TypeName(const std::string &name, const Type &value, bool warnDuplicates) { \
-        if (hasProperty(name) && warnDuplicates) \
-            SLog(EWarn, "Property \"%s\" was specified multiple times!", name.c_str()); \
-        (*m_elements)[name].data = (BaseType) value; \
-        (*m_elements)[name].queried = false; \
+        PropertyElement &element = lookupOrCreate(*m_elements, name, warnDuplicates); \
+        element.data = (BaseType) value; \
+        element.queried = false; \
     } \
     \
     Type Properties::get##TypeName(const std::string &name) const { \
-        std::map<std::string, PropertyElement>::const_iterator it = m_elements->find(name); \
-        if (it == m_elements->end()) \
+        const PropertyElement *element = findElement(*m_elements, name); \
+        if (!element) \
             SLog(EError, "Property \"%s\" has not been specified!", name.c_str()); \
-        const BaseType *result = boost::get<BaseType>(&it->second.data); \
+        const BaseType *result = boost::get<BaseType>(&element->data); \
         if (!result) \
             SLog(EError, "The property \"%s\" has the wrong type (expected <" #ReadableName ">). The " \
                     "complete property record is :\n%s", name.c_str(), toString().c_str()); \
-        it->second.queried = true; \
+        element->queried = true; \
         return (Type) *result; \
     } \
     \
     Type Properties::get##TypeName(const std::string &name, const Type &defVal) const { \
-        std::map<std::string, PropertyElement>::const_iterator it = m_elements->find(name); \
-        if (it == m_elements->end()) \
+        const PropertyElement *element = findElement(*m_elements, name); \
+        if (!element) \
             return defVal; \
-        const BaseType *result = boost::get<BaseType>(&it->second.data); \
+        const BaseType *result = boost::get<BaseType>(&element->data); \
         if (!result) \
             SLog(EError, "The property \"%s\" has the wrong type (expected <" #ReadableName ">). The " \
                     "complete property record is :\n%s", name.c_str(), toString().c_str()); \
-        it->second.queried = true; \
+        element->queried = true; \
         return (Type) *result; \
     }
 
@@ -80,29 +176,23 @@ DEFINE_PROPERTY_ACCESSOR(std::string, std::string, String, string)
 DEFINE_PROPERTY_ACCESSOR(Properties::Data, Properties::Data, Data, data)
 
 void Properties::setAnimatedTransform(const std::string &name, const AnimatedTransform *value, bool warnDuplicates) {
-    if (hasProperty(name)) {
-        AnimatedTransform **old = boost::get<AnimatedTransform *>(&((*m_elements)[name].data));
-        if (old)
-            (*old)->decRef();
-        if (warnDuplicates)
-            SLog(EWarn, "Property \"%s\" was specified multiple times!", name.c_str());
-    }
-    (*m_elements)[name].data = (AnimatedTransform *) value;
-    (*m_elements)[name].queried = false;
     value->incRef();
+    PropertyElement &element = lookupOrCreate(*m_elements, name, warnDuplicates);
+    element.data = (AnimatedTransform *) value;
+    element.queried = false;
 }
 
 ref<const AnimatedTransform> Properties::getAnimatedTransform(const std::string &name) const {
-    std::map<std::string, PropertyElement>::const_iterator it = m_elements->find(name);
-    if (it == m_elements->end())
+    const PropertyElement *element = findElement(*m_elements, name);
+    if (!element)
         SLog(EError, "Property \"%s\" missing", name.c_str());
-    const AnimatedTransform * const * result1 = boost::get<AnimatedTransform *>(&it->second.data);
-    const Transform *result2 = boost::get<Transform>(&it->second.data);
+    const AnimatedTransform * const * result1 = boost::get<AnimatedTransform *>(&element->data);
+    const Transform *result2 = boost::get<Transform>(&element->data);
 
     if (!result1 && !result2)
         SLog(EError, "The property \"%s\" has the wrong type (expected <animation> or <transform>). The "
                 "complete property record is :\n%s", name.c_str(), toString().c_str());
-    it->second.queried = true;
+    element->queried = true;
 
     if (result1)
         return *result1;
@@ -111,17 +201,17 @@ ref<const AnimatedTransform> Properties::getAnimatedTransform(const std::string
 }
 
 ref<const AnimatedTransform> Properties::getAnimatedTransform(const std::string &name, const AnimatedTransform *defVal) const {
-    std::map<std::string, PropertyElement>::const_iterator it = m_elements->find(name);
-    if (it == m_elements->end())
+    const PropertyElement *element = findElement(*m_elements, name);
+    if (!element)
         return defVal;
-    AnimatedTransform * const * result1 = boost::get<AnimatedTransform *>(&it->second.data);
-    const Transform *result2 = boost::get<Transform>(&it->second.data);
+    AnimatedTransform * const * result1 = boost::get<AnimatedTransform *>(&element->data);
+    const Transform *result2 = boost::get<Transform>(&element->data);
 
     if (!result1 && !result2)
         SLog(EError, "The property \"%s\" has the wrong type (expected <animation> or <transform>). The "
                 "complete property record is :\n%s", name.c_str(), toString().c_str());
 
-    it->second.queried = true;
+    element->queried = true;
 
     if (result1)
         return *result1;
@@ -130,17 +220,17 @@ ref<const AnimatedTransform> Properties::getAnimatedTransform(const std::string
 }
 
 ref<const AnimatedTransform> Properties::getAnimatedTransform(const std::string &name, const Transform &defVal) const {
-    std::map<std::string, PropertyElement>::const_iterator it = m_elements->find(name);
-    if (it == m_elements->end())
+    const PropertyElement *element = findElement(*m_elements, name);
+    if (!element)
         return new AnimatedTransform(defVal);
 
-    AnimatedTransform * const * result1 = boost::get<AnimatedTransform *>(&it->second.data);
-    const Transform *result2 = boost::get<Transform>(&it->second.data);
+    AnimatedTransform * const * result1 = boost::get<AnimatedTransform *>(&element->data);
+    const Transform *result2 = boost::get<Transform>(&element->data);
 
     if (!result1 && !result2)
         SLog(EError, "The property \"%s\" has the wrong type (expected <animation> or <transform>). The "
                 "complete property record is :\n%s", name.c_str(), toString().c_str());
-    it->second.queried = true;
+    element->queried = true;
 
     if (result1)
         return *result1;
@@ -203,113 +293,101 @@ namespace {
 
 Properties::Properties()
 : m_id("unnamed") {
-    m_elements = new std::map<std::string, PropertyElement>();
+    m_elements = new ElementList();
+    m_elements->reserve(initialElementCapacity);
 }
 
 Properties::Properties(const std::string &pluginName)
 : m_pluginName(pluginName), m_id("unnamed") {
-    m_elements = new std::map<std::string, PropertyElement>();
+    m_elements = new ElementList();
+    m_elements->reserve(initialElementCapacity);
 }
 
 Properties::Properties(const Properties &props)
 : m_pluginName(props.m_pluginName), m_id(props.m_id) {
-    m_elements = new std::map<std::string, PropertyElement>(*props.m_elements);
+    m_elements = new ElementList(*props.m_elements);
 
-    for (std::map<std::string, PropertyElement>::iterator it = m_elements->begin();
-            it != m_elements->end(); ++it) {
-        AnimatedTransform **trafo = boost::get<AnimatedTransform *>(&(*it).second.data);
-        if (trafo)
-            (*trafo)->incRef();
-    }
+    for (ElementList::const_iterator it = m_elements->begin();
+            it != m_elements->end(); ++it)
+        incRef(*it);
 }
 
 Properties::~Properties() {
-    for (std::map<std::string, PropertyElement>::iterator it = m_elements->begin();
-            it != m_elements->end(); ++it) {
-        AnimatedTransform **trafo = boost::get<AnimatedTransform *>(&(*it).second.data);
-        if (trafo)
-            (*trafo)->decRef();
-    }
+    for (ElementList::const_iterator it = m_elements->begin();
+            it != m_elements->end(); ++it)
+        decRef(*it);
 
     delete m_elements;
 }
 
 void Properties::operator=(const Properties &props) {
-    for (std::map<std::string, PropertyElement>::iterator it = m_elements->begin();
-            it != m_elements->end(); ++it) {
-        AnimatedTransform **trafo = boost::get<AnimatedTransform *>(&(*it).second.data);
-        if (trafo)
-            (*trafo)->decRef();
-    }
+    for (ElementList::const_iterator it = props.m_elements->begin();
+            it != props.m_elements->end(); ++it)
+        incRef(*it);
+
+    for (ElementList::const_iterator it = m_elements->begin();
+            it != m_elements->end(); ++it)
+        decRef(*it);
 
     m_pluginName = props.m_pluginName;
     m_id = props.m_id;
     *m_elements = *props.m_elements;
-
-    for (std::map<std::string, PropertyElement>::iterator it = m_elements->begin();
-            it != m_elements->end(); ++it) {
-        AnimatedTransform **trafo = boost::get<AnimatedTransform *>(&(*it).second.data);
-        if (trafo)
-            (*trafo)->incRef();
-    }
 }
 
 bool Properties::hasProperty(const std::string &name) const {
-    return m_elements->find(name) != m_elements->end();
+    return findElement(*m_elements, name) != NULL;
 }
 
 bool Properties::removeProperty(const std::string &name) {
-    std::map<std::string, PropertyElement>::iterator it = m_elements->find(name);
-    if (it == m_elements->end())
+    PropertyElement *element = findElement(*m_elements, name);
+    if (!element)
         return false;
-    AnimatedTransform **trafo = boost::get<AnimatedTransform *>(&(*it).second.data);
-    if (trafo)
-        (*trafo)->decRef();
-    m_elements->erase(it);
+    decRef(*element);
+    m_elements->erase(m_elements->begin() + (element - &(*m_elements)[0]));
     return true;
 }
 
 std::vector<std::string> Properties::getUnqueried() const {
-    std::map<std::string, PropertyElement>::const_iterator it = m_elements->begin();
     std::vector<std::string> result;
 
-    for (; it != m_elements->end(); ++it) {
-        if (!(*it).second.queried)
-            result.push_back((*it).first);
+    for (ElementList::const_iterator it = m_elements->begin();
+            it != m_elements->end(); ++it) {
+        if (!it->queried)
+            result.push_back(*it->name);
     }
 
     return result;
 }
 
 Properties::EPropertyType Properties::getType(const std::string &name) const {
-    std::map<std::string, PropertyElement>::const_iterator it = m_elements->find(name);
-    if (it == m_elements->end())
+    const PropertyElement *element = findElement(*m_elements, name);
+    if (!element)
         SLog(EError, "Property \"%s\" has not been specified!", name.c_str());
 
-    return boost::apply_visitor(TypeVisitor(), it->second.data);
+    return boost::apply_visitor(TypeVisitor(), element->data);
 }
 
 std::string Properties::getAsString(const std::string &name, const std::string &defVal) const {
-    if (m_elements->find(name) == m_elements->end())
+    if (!findElement(*m_elements, name))
         return defVal;
     return getAsString(name);
 }
 
 std::string Properties::getAsString(const std::string &name) const {
-    std::map<std::string, PropertyElement>::const_iterator it = m_elements->find(name);
-    if (it == m_elements->end())
+    const PropertyElement *element = findElement(*m_elements, name);
+    if (!element)
         SLog(EError, "Property \"%s\" has not been specified!", name.c_str());
 
     std::ostringstream oss;
     StringVisitor strVisitor(oss, false);
-    boost::apply_visitor(strVisitor, it->second.data);
-    it->second.queried = true;
+    boost::apply_visitor(strVisitor, element->data);
+    element->queried = true;
 
     return oss.str();
 }
 
 std::string Properties::toString() const {
-    std::map<std::string, PropertyElement>::const_iterator it = m_elements->begin();
+    ElementList::const_iterator it = m_elements->begin();
     std::ostringstream oss;
     StringVisitor strVisitor(oss, true);
 
@@ -318,9 +396,8 @@ std::string Properties::toString() const {
         << "  id = \"" << m_id << "\"," << endl
         << "  elements = {" << endl;
     while (it != m_elements->end()) {
-        oss << "    \"" << (*it).first << "\" -> ";
-        const ElementData &data = (*it).second.data;
-        boost::apply_visitor(strVisitor, data);
+        oss << "    \"" << *it->name << "\" -> ";
+        boost::apply_visitor(strVisitor, it->data);
         if (++it != m_elements->end())
             oss << ",";
         oss << endl;
@@ -331,43 +408,45 @@ std::string Properties::toString() const {
 }
 
 void Properties::markQueried(const std::string &name) const {
-    std::map<std::string, PropertyElement>::const_iterator it = m_elements->find(name);
-    if (it == m_elements->end())
+    const PropertyElement *element = findElement(*m_elements, name);
+    if (!element)
         return;
-    it->second.queried = true;
+    element->queried = true;
 }
 
 bool Properties::wasQueried(const std::string &name) const {
-    std::map<std::string, PropertyElement>::const_iterator it = m_elements->find(name);
-    if (it == m_elements->end())
+    const PropertyElement *element = findElement(*m_elements, name);
+    if (!element)
         SLog(EError, "Could not find parameter \"%s\"!", name.c_str());
-    return it->second.queried;
+    return element->queried;
 }
 
 void Properties::putPropertyNames(std::vector<std::string> &results) const {
-    for (std::map<std::string, PropertyElement>::const_iterator it = m_elements->begin();
+    for (ElementList::const_iterator it = m_elements->begin();
             it != m_elements->end(); ++it)
-        results.push_back((*it).first);
+        results.push_back(*it->name);
 }
 
 void Properties::copyAttribute(const Properties &properties,
     const std::string &sourceName, const std::string &targetName) {
-    std::map<std::string, PropertyElement>::const_iterator it = properties.m_elements->find(sourceName);
-    if (it == properties.m_elements->end())
+    const PropertyElement *element = findElement(*properties.m_elements, sourceName);
+    if (!element)
         SLog(EError, "copyAttribute(): Could not find parameter \"%s\"!", sourceName.c_str());
-    m_elements->operator[](targetName) = it->second;
+    /* Copy, since 'element' may be invalidated when both refer to the same instance */
+    PropertyElement source = *element;
+    assign(*m_elements, targetName, source);
 }
 
 bool Properties::operator==(const Properties &p) const {
     if (m_pluginName != p.m_pluginName || m_id != p.m_id || m_elements->size() != p.m_elements->size())
         return false;
 
-    std::map<std::string, PropertyElement>::const_iterator it = m_elements->begin();
-    for (; it != m_elements->end(); ++it) {
-        const PropertyElement &first = it->second;
-        const PropertyElement &second = (*p.m_elements)[it->first];
+    for (ElementList::const_iterator it = m_elements->begin();
+            it != m_elements->end(); ++it) {
+        const PropertyElement &first = *it;
+        const PropertyElement *second = findElement(*p.m_elements, *it->name, it->hash);
 
-        if (!boost::apply_visitor(EqualityVisitor(&first.data), second.data))
+        if (!second || !boost::apply_visitor(EqualityVisitor(&first.data), second->data))
             return false;
     }
 
@@ -375,9 +454,11 @@ bool Properties::operator==(const Properties &p) const {
 }
 
 void Properties::merge(const Properties &p) {
-    std::map<std::string, PropertyElement>::const_iterator it = p.m_elements->begin();
-    for (; it != p.m_elements->end(); ++it)
-        (*m_elements)[it->first] = it->second;
+    if (&p == this)
+        return;
+    for (ElementList::const_iterator it = p.m_elements->begin();
+            it != p.m_elements->end(); ++it)
+        assign(*m_elements, *it->name, *it);
 }
 
 ConfigurableObject::ConfigurableObject(Stream *stream, InstanceManager *manager)
@@ -296,6 +296,25 @@ struct Random::State {
         return r;
     }
 
+    /**
+     * Pass the next \c count 64-bit pseudorandom numbers to \c op, which
+     * is invoked with contiguous chunks of the internal state array. The
+     * numbers are the same that \c count calls to gen_rand64 would return.
+     */
+    template <typename Functor> FINLINE void gen_rand64_block(size_t count, Functor &op) {
+        while (count > 0) {
+            if (idx >= N32) {
+                gen_rand_all();
+                idx = 0;
+            }
+
+            size_t size = std::min((size_t) (N32 - idx) / 2, count);
+            op(&psfmt64[idx / 2], size);
+            idx += 2 * (int) size;
+            count -= size;
+        }
+    }
+
 private:
 
     /**
@@ -639,6 +658,108 @@ Float Random::nextFloat() {
 }
 #endif
 
+namespace {
+    /* Converters from 64-bit SFMT outputs, used by the batch functions.
+       They match the scalar conversions in nextFloat() */
+    struct ULongCopier {
+        uint64_t *dest;
+        inline void operator()(const uint64_t *src, size_t count) {
+            memcpy(dest, src, count * sizeof(uint64_t));
+            dest += count;
+        }
+    };
+
+    struct SingleConverter {
+        float *dest;
+        inline void operator()(const uint64_t *src, size_t count) {
+            size_t i = 0;
+        #if MTS_SFMT_SSE
+            const __m128i exponent = _mm_set1_epi32(0x3f800000);
+            const __m128 one = _mm_set1_ps(1.0f);
+            for (; i + 4 <= count; i += 4) {
+                /* Keep the lower 32 bits of four 64-bit values */
+                __m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+                __m128i b = _mm_loadu_si128((const __m128i *) (src + i + 2));
+                a = _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 0, 2, 0));
+                b = _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 0, 2, 0));
+                __m128i bits = _mm_or_si128(_mm_srli_epi32(
+                    _mm_unpacklo_epi64(a, b), 9), exponent);
+                _mm_storeu_ps(dest + i, _mm_sub_ps(_mm_castsi128_ps(bits), one));
+            }
+        #endif
+            for (; i < count; ++i) {
+                union {
+                    uint32_t u;
+                    float f;
+                } x;
+                x.u = ((src[i] & 0xFFFFFFFF) >> 9) | 0x3f800000UL;
+                dest[i] = x.f - 1.0f;
+            }
+            dest += count;
+        }
+    };
+
+    struct DoubleConverter {
+        double *dest;
+        inline void operator()(const uint64_t *src, size_t count) {
+            size_t i = 0;
+        #if MTS_SFMT_SSE
+            const __m128i exponent = _mm_set_epi32(0x3ff00000, 0, 0x3ff00000, 0);
+            const __m128d one = _mm_set1_pd(1.0);
+            for (; i + 2 <= count; i += 2) {
+                __m128i bits = _mm_or_si128(_mm_srli_epi64(
+                    _mm_loadu_si128((const __m128i *) (src + i)), 12), exponent);
+                _mm_storeu_pd(dest + i, _mm_sub_pd(_mm_castsi128_pd(bits), one));
+            }
+        #endif
+            for (; i < count; ++i) {
+                union {
+                    uint64_t u;
+                    double d;
+                } x;
+                x.u = (src[i] >> 12) | 0x3ff0000000000000ULL;
+                dest[i] = x.d - 1.0;
+            }
+            dest += count;
+        }
+    };
+} // namespace
+
+void Random::nextULong(uint64_t *dest, size_t count) {
+    ULongCopier op = { dest };
+    mt->gen_rand64_block(count, op);
+}
+
+void Random::nextUInt(uint32_t *dest, size_t count, uint32_t n) {
+    /* Rejection sampling consumes a variable amount of
+       numbers, hence draw them directly from the state */
+    const uint32_t bitmask = makeBitmask(n);
+    for (size_t i=0; i<count; ++i) {
+        uint32_t result;
+        while ((result = (uint32_t) (mt->gen_rand64() & bitmask)) >= n)
+            ;
+        dest[i] = result;
+    }
+}
+
+void Random::nextSingle(float *dest, size_t count) {
+    SingleConverter op = { dest };
+    mt->gen_rand64_block(count, op);
+}
+
+void Random::nextDouble(double *dest, size_t count) {
+    DoubleConverter op = { dest };
+    mt->gen_rand64_block(count, op);
+}
+
+void Random::nextFloat(Float *dest, size_t count) {
+#if defined(DOUBLE_PRECISION)
+    nextDouble(dest, count);
+#else
+    nextSingle(dest, count);
+#endif
+}
+
 Float Random::nextStandardNormal() {
     /* Marsaglia polar method for generating two standard
        normal variates. One is subsequently thrown away */
@@ -98,7 +98,59 @@ Float Spectrum::m_wavelengths[SPECTRUM_SAMPLES + 1];
 /// Pre-integrated D65 illuminant
 Spectrum Spectrum::CIE_D65;
 
+/**
+ * Values needed by \ref WavelengthPacket, tabulated in 1 nm steps over the
+ * range of the CIE data: the normalized XYZ matching functions, followed by
+ * the seven Smits reflectance and the seven illuminant basis spectra.
+ * The basis spectra are scaled so that an RGB value of (1, 1, 1) has unit
+ * luminance (this takes the place of the constant factors used by
+ * Spectrum::fromLinearRGB(), which were tuned for binned spectra).
+ */
+static const int WavelengthTable_entries = 17;
+static Float WavelengthTable[CIE_samples][WavelengthTable_entries];
+
+static void initializeWavelengthTable() {
+    const Float *basis[14] = {
+        RGBRefl2SpecWhite_entries, RGBRefl2SpecCyan_entries,
+        RGBRefl2SpecMagenta_entries, RGBRefl2SpecYellow_entries,
+        RGBRefl2SpecRed_entries, RGBRefl2SpecGreen_entries,
+        RGBRefl2SpecBlue_entries, RGBIllum2SpecWhite_entries,
+        RGBIllum2SpecCyan_entries, RGBIllum2SpecMagenta_entries,
+        RGBIllum2SpecYellow_entries, RGBIllum2SpecRed_entries,
+        RGBIllum2SpecGreen_entries, RGBIllum2SpecBlue_entries
+    };
+
+    Float integralY = 0.0f;
+    for (int i=0; i<CIE_samples; ++i)
+        integralY += CIE_Y_entries[i];
+
+    Float luminance[2] = { 0.0f, 0.0f };
+    for (int j=0; j<14; ++j) {
+        InterpolatedSpectrum spec(RGB2Spec_wavelengths, basis[j], RGB2Spec_samples);
+        for (int i=0; i<CIE_samples; ++i) {
+            Float value = spec.eval(CIE_wavelengths[i]);
+            WavelengthTable[i][3+j] = value;
+            if (j % 7 == 0)
+                luminance[j / 7] += value * CIE_Y_entries[i];
+        }
+    }
+
+    for (int j=0; j<14; ++j) {
+        Float scale = integralY / luminance[j / 7];
+        for (int i=0; i<CIE_samples; ++i)
+            WavelengthTable[i][3+j] *= scale;
+    }
+
+    for (int i=0; i<CIE_samples; ++i) {
+        WavelengthTable[i][0] = CIE_X_entries[i] / integralY;
+        WavelengthTable[i][1] = CIE_Y_entries[i] / integralY;
+        WavelengthTable[i][2] = CIE_Z_entries[i] / integralY;
+    }
+}
+
 void Spectrum::staticInitialization() {
+    initializeWavelengthTable();
+
 #if SPECTRUM_SAMPLES != 3
     std::ostringstream oss;
     oss << std::fixed;
@@ -452,6 +504,104 @@ void Spectrum::fromRGBE(const uint8_t rgbe[4], EConversionIntent intent) {
     }
 }
 
+void WavelengthPacket::sample(Float sample) {
+    for (int i=0; i<SPECTRUM_SAMPLES; ++i) {
+        Float offset = sample + i / (Float) SPECTRUM_SAMPLES;
+        if (offset >= 1)
+            offset -= 1;
+        lambda[i] = SPECTRUM_MIN_WAVELENGTH + offset * SPECTRUM_RANGE;
+    }
+
+#if SPECTRUM_SAMPLES == 3
+    /* Fetch the tabulated data; the factor accounts for the uniform
+       density of each of the SPECTRUM_SAMPLES wavelengths */
+    const Float densityFactor = (Float) SPECTRUM_RANGE / (Float) SPECTRUM_SAMPLES;
+    for (int i=0; i<SPECTRUM_SAMPLES; ++i) {
+        Float pos = lambda[i] - CIE_wavelengths[0];
+        int index = std::min(std::max(math::floorToInt(pos), 0), CIE_samples - 2);
+        Float t = pos - index, *v0 = WavelengthTable[index], *v1 = WavelengthTable[index+1];
+
+        for (int j=0; j<3; ++j)
+            m_xyz[j][i] = ((1-t) * v0[j] + t * v1[j]) * densityFactor;
+        for (int j=0; j<7; ++j) {
+            m_refl[j][i]  = (1-t) * v0[3+j]  + t * v1[3+j];
+            m_illum[j][i] = (1-t) * v0[10+j] + t * v1[10+j];
+        }
+    }
+#endif
+}
+
+Spectrum WavelengthPacket::upsample(const Spectrum &spec,
+        Spectrum::EConversionIntent intent) const {
+    Spectrum result;
+#if SPECTRUM_SAMPLES == 3
+    /* Smits-style upsampling (see Spectrum::fromLinearRGB()) evaluated
+       at the packet's wavelengths. Basis order: white, cyan, magenta,
+       yellow, red, green, blue */
+    Float r = spec[0], g = spec[1], b = spec[2], white, c1, c2;
+    int b1, b2;
+
+    if (r <= g && r <= b) {
+        white = r; b1 = 1; c1 = std::min(g, b) - r;
+        if (g <= b) { b2 = 6; c2 = b - g; }
+        else        { b2 = 5; c2 = g - b; }
+    } else if (g <= r && g <= b) {
+        white = g; b1 = 2; c1 = std::min(r, b) - g;
+        if (r <= b) { b2 = 6; c2 = b - r; }
+        else        { b2 = 4; c2 = r - b; }
+    } else {
+        white = b; b1 = 3; c1 = std::min(r, g) - b;
+        if (r <= g) { b2 = 5; c2 = g - r; }
+        else        { b2 = 4; c2 = r - g; }
+    }
+
+    const Float (*basis)[SPECTRUM_SAMPLES] =
+        intent == Spectrum::EReflectance ? m_refl : m_illum;
+
+    for (int i=0; i<SPECTRUM_SAMPLES; ++i)
+        result[i] = std::max((Float) 0, white * basis[0][i]
+            + c1 * basis[b1][i] + c2 * basis[b2][i]);
+#else
+    for (int i=0; i<SPECTRUM_SAMPLES; ++i)
+        result[i] = spec.eval(lambda[i]);
+#endif
+    return result;
+}
+
+Spectrum WavelengthPacket::toSpectrum(const Spectrum &values) const {
+    Spectrum result(0.0f);
+#if SPECTRUM_SAMPLES == 3
+    Float x = 0, y = 0, z = 0;
+    for (int i=0; i<SPECTRUM_SAMPLES; ++i) {
+        x += values[i] * m_xyz[0][i];
+        y += values[i] * m_xyz[1][i];
+        z += values[i] * m_xyz[2][i];
+    }
+    result.fromXYZ(x, y, z);
+#else
+    /* Each wavelength lands in a given bin with probability 1/SPECTRUM_SAMPLES,
+       and there are SPECTRUM_SAMPLES of them -- hence the weights cancel */
+    for (int i=0; i<SPECTRUM_SAMPLES; ++i) {
+        int index = math::floorToInt((lambda[i] - SPECTRUM_MIN_WAVELENGTH) *
+            ((Float) SPECTRUM_SAMPLES / (Float) SPECTRUM_RANGE));
+        result[std::min(std::max(index, 0), SPECTRUM_SAMPLES-1)] += values[i];
+    }
+#endif
+    return result;
+}
+
+std::string WavelengthPacket::toString() const {
+    std::ostringstream oss;
+    oss << "WavelengthPacket[";
+    for (int i=0; i<SPECTRUM_SAMPLES; i++) {
+        oss << lambda[i] << "nm";
+        if (i < SPECTRUM_SAMPLES - 1)
+            oss << ", ";
+    }
+    oss << "]";
+    return oss.str();
+}
+
 std::string Spectrum::toString() const {
     std::ostringstream oss;
     oss << "[";
@@ -0,0 +1,490 @@
+/*============================================================================
+  HDRITools - High Dynamic Range Image Tools
+  Copyright 2008-2012 Program of Computer Graphics, Cornell University
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+ -----------------------------------------------------------------------------
+ Primary author:
+     Edgar Velazquez-Armendariz <cs#cornell#edu - eva5>
+============================================================================*/
+
+#include <mitsuba/core/tonemap.h>
+#include <mitsuba/core/sse.h>
+
+#if defined(MTS_SSE)
+# include <mitsuba/core/ssemath.h>
+# include <mitsuba/core/ssevector.h>
+#endif
+
+/// Number of pixels that are converted to SoA form and processed together
+#define MTS_TONEMAP_BLOCK_SIZE 512
+
+MTS_NAMESPACE_BEGIN
+
+namespace tonemap {
+namespace {
+    /// Channel layout of a pixel format supported by the kernels
+    struct Layout {
+        /// Total number of channels
+        int channels;
+        /// Number of color channels (1 or 3)
+        int colors;
+        /// Index of the alpha channel (or -1)
+        int alpha;
+        /// Index of the weight channel (or -1)
+        int weight;
+    };
+
+    bool getLayout(Bitmap::EPixelFormat format, bool isSource, Layout &layout) {
+        layout.alpha = layout.weight = -1;
+        switch (format) {
+            case Bitmap::ELuminance:
+                layout.channels = layout.colors = 1;
+                break;
+            case Bitmap::ELuminanceAlpha:
+                layout.channels = 2; layout.colors = 1; layout.alpha = 1;
+                break;
+            case Bitmap::ERGB:
+                layout.channels = layout.colors = 3;
+                break;
+            case Bitmap::ERGBA:
+                layout.channels = 4; layout.colors = 3; layout.alpha = 3;
+                break;
+#if SPECTRUM_SAMPLES == 3
+            /* In RGB mode, spectra are simply linear RGB triplets */
+            case Bitmap::ESpectrum:
+                layout.channels = layout.colors = 3;
+                return isSource;
+            case Bitmap::ESpectrumAlpha:
+                layout.channels = 4; layout.colors = 3; layout.alpha = 3;
+                return isSource;
+            case Bitmap::ESpectrumAlphaWeight:
+                layout.channels = 5; layout.colors = 3; layout.alpha = 3; layout.weight = 4;
+                return isSource;
+#endif
+            default:
+                return false;
+        }
+        return true;
+    }
+
+    inline float luminance(float r, float g, float b) {
+        return r * 0.212671f + g * 0.715160f + b * 0.072169f;
+    }
+
+    /// A block of pixels in SoA form
+    struct Block {
+        MM_ALIGN16 float data[4][MTS_TONEMAP_BLOCK_SIZE];
+
+        inline float *plane(int i) { return data[i]; }
+    };
+
+    /**
+     * Load \c count pixels into SoA form. When \c toLuminance is set or the
+     * source is monochromatic, only the first color plane is filled. The
+     * planes are zero-padded to a multiple of four pixels.
+     */
+    int load(const float *source, const Layout &layout, bool toLuminance,
+            Block &block, size_t count) {
+        float *r = block.plane(0), *g = block.plane(1),
+              *b = block.plane(2), *a = block.plane(3);
+        int planes = (toLuminance || layout.colors == 1) ? 1 : 3;
+
+        if (layout.weight == -1 && layout.colors == 3 && !toLuminance) {
+            if (layout.alpha == -1) {
+                for (size_t i=0; i<count; ++i, source += layout.channels) {
+                    r[i] = source[0]; g[i] = source[1]; b[i] = source[2]; a[i] = 1.0f;
+                }
+            } else {
+                for (size_t i=0; i<count; ++i, source += layout.channels) {
+                    r[i] = source[0]; g[i] = source[1]; b[i] = source[2];
+                    a[i] = source[layout.alpha];
+                }
+            }
+        } else {
+            for (size_t i=0; i<count; ++i, source += layout.channels) {
+                float invWeight = 1.0f;
+                if (layout.weight != -1) {
+                    float weight = source[layout.weight];
+                    invWeight = (weight != 0) ? 1.0f / weight : 0.0f;
+                }
+
+                if (layout.colors == 1) {
+                    r[i] = source[0] * invWeight;
+                } else if (toLuminance) {
+                    r[i] = luminance(source[0], source[1], source[2]) * invWeight;
+                } else {
+                    r[i] = source[0] * invWeight;
+                    g[i] = source[1] * invWeight;
+                    b[i] = source[2] * invWeight;
+                }
+                a[i] = layout.alpha != -1 ? source[layout.alpha] * invWeight : 1.0f;
+            }
+        }
+
+        for (size_t i=count; i<((count + 3) & ~(size_t) 3); ++i)
+            r[i] = g[i] = b[i] = a[i] = 0.0f;
+
+        return planes;
+    }
+
+#if defined(MTS_SSE)
+    typedef math::SSEVector4f V4f;
+    typedef math::SSEVector4i V4i;
+
+    /// Clamp to [0, 1] while mapping NaNs to zero
+    inline V4f clamp01(const V4f &x) {
+        return max(min(V4f(1.0f), x), V4f::zero());
+    }
+
+    /* Fast sRGB curve calculation using a rational approximation for the
+    non-linear term. Assumes the input in in the range [0,1]
+
+    Mathematica input:
+    -------------------------------------------------------------------------------
+    << FunctionApproximations`
+    MiniMaxApproximation[-(11/200) + (211 x^(5/12))/
+      200, {x, {0.0031308, 1}, 4, 3}]
+    CForm[HornerForm[%[[2, 1]]]]
+    -------------------------------------------------------------------------------
+    Result:
+    (-0.016036752726326525 + x*(23.24653363361083 +
+           x*(1832.6027368173256 + x*(10602.877994753313 + 2764.157524016198*x))))/
+     (1. + x*(255.72605859770067 + x*(5415.6856291461045 + 9542.777488625074*x)))
+
+    Maximum relative error: -0.000504731
+    */
+    inline V4f sRGB_Remez43(const V4f &x) {
+        const V4f P0(    -0.016036752726326525f );
+        const V4f P1(    23.24653363361083f );
+        const V4f P2(  1832.6027368173256f );
+        const V4f P3( 10602.877994753313f );
+        const V4f P4(  2764.157524016198f );
+
+        const V4f Q0(     1.f );
+        const V4f Q1(   255.72605859770067f );
+        const V4f Q2( 5415.6856291461045f  );
+        const V4f Q3( 9542.777488625074f  );
+
+        const V4f CUTOFF(0.0031308f);
+        const V4f LINEAR_FACTOR(12.92f);
+
+        const V4f num = (P0 + x*(P1 + x*(P2 + x*(P3 + x*P4))));
+        const V4f den = (Q0 + x*(Q1 + x*(Q2 + x*Q3)));
+
+        return select(x <= CUTOFF, x*LINEAR_FACTOR, num * rcp_nr(den));
+    }
+
+    /* Applies the global Reinhard-2002 TMO. Since TMO(Y) == k*Y, the
+       canonical round trip through xyY simply reduces to k*[r,g,b] with
+
+                 (scale * (1 + invWp2 * Lp)
+            k == ----------------------------,  Lp == scale * Y
+                         1 + Lp
+    */
+    void scale(Block &block, size_t count, int planes, const Parameters &params) {
+        V4f *r = (V4f *) block.plane(0), *g = (V4f *) block.plane(1),
+            *b = (V4f *) block.plane(2);
+        const size_t groups = (count + 3) / 4;
+        const V4f multiplier((float) params.multiplier);
+
+        if (params.scale > 0) {
+            const V4f one(1.0f), scale((float) params.scale),
+                invWp2((float) params.invWp2),
+                L0(0.212671f), L1(0.715160f), L2(0.072169f);
+
+            for (size_t i=0; i<groups; ++i) {
+                V4f Y = planes == 3 ? (L0*r[i] + L1*g[i] + L2*b[i]) : r[i];
+                V4f Lp = scale * multiplier * Y;
+                V4f k = multiplier * scale * (one + invWp2*Lp) * rcp_nr(one + Lp);
+                r[i] *= k;
+                if (planes == 3) {
+                    g[i] *= k;
+                    b[i] *= k;
+                }
+            }
+        } else if (params.multiplier != 1) {
+            for (int p=0; p<planes; ++p) {
+                V4f *plane = (V4f *) block.plane(p);
+                for (size_t i=0; i<groups; ++i)
+                    plane[i] *= multiplier;
+            }
+        }
+    }
+
+    /// Apply the transfer curve and quantize (in place, as 32 bit integers)
+    void quantize(Block &block, size_t count, int planes, bool alpha, const Parameters &params) {
+        const size_t groups = (count + 3) / 4;
+        const V4f invGamma((float) params.invGamma), const255(255.0f);
+
+        for (int p=0; p<planes; ++p) {
+            V4f *plane = (V4f *) block.plane(p);
+            if (params.invGamma == -1) {
+                for (size_t i=0; i<groups; ++i)
+                    plane[i] = castAsFloat(roundToInt(const255 * sRGB_Remez43(clamp01(plane[i]))));
+            } else if (params.invGamma != 1) {
+                for (size_t i=0; i<groups; ++i)
+                    plane[i] = castAsFloat(roundToInt(const255 *
+                        V4f(math::fastpow_ps(clamp01(plane[i]), invGamma))));
+            } else {
+                for (size_t i=0; i<groups; ++i)
+                    plane[i] = castAsFloat(roundToInt(const255 * clamp01(plane[i])));
+            }
+        }
+
+        if (alpha) {
+            V4f *plane = (V4f *) block.plane(3);
+            for (size_t i=0; i<groups; ++i)
+                plane[i] = castAsFloat(roundToInt(const255 * clamp01(plane[i])));
+        }
+    }
+#else
+    inline float clamp01(float x) {
+        return x > 0 ? std::min(x, 1.0f) : 0.0f;
+    }
+
+    void scale(Block &block, size_t count, int planes, const Parameters &params) {
+        float *r = block.plane(0), *g = block.plane(1), *b = block.plane(2);
+        const float multiplier = (float) params.multiplier;
+
+        if (params.scale > 0) {
+            const float scale = (float) params.scale, invWp2 = (float) params.invWp2;
+            for (size_t i=0; i<count; ++i) {
+                float Y = planes == 3 ? luminance(r[i], g[i], b[i]) : r[i];
+                float Lp = scale * multiplier * Y;
+                float k = multiplier * scale * (1.0f + invWp2*Lp) / (1.0f + Lp);
+                r[i] *= k;
+                if (planes == 3) {
+                    g[i] *= k;
+                    b[i] *= k;
+                }
+            }
+        } else if (multiplier != 1) {
+            for (int p=0; p<planes; ++p) {
+                float *plane = block.plane(p);
+                for (size_t i=0; i<count; ++i)
+                    plane[i] *= multiplier;
+            }
+        }
+    }
+
+    void quantize(Block &block, size_t count, int planes, bool alpha, const Parameters &params) {
+        const float invGamma = (float) params.invGamma;
+
+        for (int p=0; p<4; ++p) {
+            if (p >= planes && !(p == 3 && alpha))
+                continue;
+            float *plane = block.plane(p);
+            int32_t *result = reinterpret_cast<int32_t *>(plane);
+            for (size_t i=0; i<count; ++i) {
+                float value = clamp01(plane[i]);
+                if (p != 3) {
+                    if (invGamma == -1)
+                        value = (value <= 0.0031308f) ? (12.92f * value)
+                            : (1.055f * std::pow(value, 1.0f/2.4f) - 0.055f);
+                    else if (invGamma != 1)
+                        value = std::pow(value, invGamma);
+                }
+                result[i] = (int32_t) (value * 255.0f + 0.5f);
+            }
+        }
+    }
+#endif
+
+    /// Interleave the quantized planes into the destination buffer
+    void store(Block &block, size_t count, int planes, uint8_t *dest,
+            const Layout &layout) {
+        const int32_t *r = reinterpret_cast<const int32_t *>(block.plane(0)),
+                      *g = reinterpret_cast<const int32_t *>(block.plane(planes == 3 ? 1 : 0)),
+                      *b = reinterpret_cast<const int32_t *>(block.plane(planes == 3 ? 2 : 0)),
+                      *a = reinterpret_cast<const int32_t *>(block.plane(3));
+        size_t i = 0;
+
+#if defined(MTS_SSE)
+        if (layout.channels == 4 && planes == 3) {
+            /* Pack four RGBA8 pixels at a time */
+            for (; i+4 <= count; i += 4, dest += 16) {
+                V4i pixel = V4i(_mm_load_si128((const __m128i *) (r + i)))
+                    | sll(V4i(_mm_load_si128((const __m128i *) (g + i))), 8)
+                    | sll(V4i(_mm_load_si128((const __m128i *) (b + i))), 16)
+                    | sll(V4i(_mm_load_si128((const __m128i *) (a + i))), 24);
+                _mm_storeu_si128((__m128i *) dest, pixel);
+            }
+        }
+#endif
+
+        switch (layout.channels) {
+            case 1:
+                for (; i<count; ++i)
+                    *dest++ = (uint8_t) r[i];
+                break;
+            case 2:
+                for (; i<count; ++i) {
+                    *dest++ = (uint8_t) r[i];
+                    *dest++ = (uint8_t) a[i];
+                }
+                break;
+            case 3:
+                for (; i<count; ++i) {
+                    *dest++ = (uint8_t) r[i];
+                    *dest++ = (uint8_t) g[i];
+                    *dest++ = (uint8_t) b[i];
+                }
+                break;
+            case 4:
+                for (; i<count; ++i) {
+                    *dest++ = (uint8_t) r[i];
+                    *dest++ = (uint8_t) g[i];
+                    *dest++ = (uint8_t) b[i];
+                    *dest++ = (uint8_t) a[i];
+                }
+                break;
+        }
+    }
+}
+
+void Parameters::setReinhard(Float key, Float burn,
+        Float logAvgLuminance, Float maxLuminance) {
+    burn = std::min((Float) 1, std::max((Float) 1e-8f, 1-burn));
+
+    Float Lwhite = maxLuminance * key / logAvgLuminance;
+
+    scale = key / logAvgLuminance;
+    invWp2 = 1 / (Lwhite * Lwhite * std::pow(burn, (Float) 4));
+}
+
+bool isSupported(Bitmap::EPixelFormat sourceFormat, Bitmap::EPixelFormat destFormat) {
+    Layout layout;
+    return getLayout(sourceFormat, true, layout) && getLayout(destFormat, false, layout);
+}
+
+void toDisplay(const float *source, Bitmap::EPixelFormat sourceFormat,
+        uint8_t *dest, Bitmap::EPixelFormat destFormat, size_t count,
+        const Parameters &params) {
+    Layout srcLayout, destLayout;
+    if (!getLayout(sourceFormat, true, srcLayout) ||
+        !getLayout(destFormat, false, destLayout))
+        SLog(EError, "tonemap::toDisplay(): unsupported pixel format!");
+
+    bool toLuminance = destLayout.colors == 1,
+         alpha = destLayout.alpha != -1;
+    Block block;
+
+    for (size_t start=0; start<count; start += MTS_TONEMAP_BLOCK_SIZE) {
+        size_t n = std::min((size_t) MTS_TONEMAP_BLOCK_SIZE, count - start);
+
+        int planes = load(source + start * srcLayout.channels, srcLayout,
+            toLuminance, block, n);
+        scale(block, n, planes, params);
+        quantize(block, n, planes, alpha, params);
+        store(block, n, planes, dest + start * destLayout.channels, destLayout);
+    }
+}
+
+void getLuminanceStatistics(const float *data, Bitmap::EPixelFormat format,
+        size_t count, Float _multiplier, Float &logAvgLuminance, Float &maxLuminance) {
+    Layout layout;
+    if (!getLayout(format, true, layout))
+        SLog(EError, "tonemap::getLuminanceStatistics(): unsupported pixel format!");
+
+    double sumLogLuminance = 0;
+    float maxLum = 0;
+    Block block;
+
+#if defined(MTS_SSE)
+    const V4f multiplier((float) _multiplier), const_1e_3f(1e-3f),
+        const_1024f(1024.0f);
+#else
+    const float multiplier = (float) _multiplier;
+#endif
+
+    for (size_t start=0; start<count; start += MTS_TONEMAP_BLOCK_SIZE) {
+        size_t n = std::min((size_t) MTS_TONEMAP_BLOCK_SIZE, count - start);
+        load(data + start * layout.channels, layout, true, block, n);
+
+#if defined(MTS_SSE)
+        const V4f *Y = (const V4f *) block.plane(0);
+        V4f sum = V4f::zero(), maxY = V4f::zero();
+
+        for (size_t i=0; i<(n + 3) / 4; ++i) {
+            /* Map negative values, NaNs and the banner to zero */
+            V4f value = multiplier * andnot((Y[i] < V4f::zero()) | isnan(Y[i])
+                | (Y[i] == const_1024f), Y[i]);
+            maxY = max(maxY, value);
+
+            V4f logY(math::fastlog_ps(value + const_1e_3f));
+            if (4*i + 4 > n) {
+                /* Mask out the padding */
+                const int valid = (int) (n - 4*i);
+                logY = logY & V4f(castAsFloat(V4i(_mm_set_epi32(
+                    valid > 3 ? -1 : 0, valid > 2 ? -1 : 0,
+                    valid > 1 ? -1 : 0, -1))));
+            }
+            sum += logY;
+        }
+
+        sumLogLuminance += math::hsum_ps(sum);
+        maxLum = std::max(maxLum, math::hmax_ps(maxY));
+#else
+        const float *Y = block.plane(0);
+        float sum = 0;
+        for (size_t i=0; i<n; ++i) {
+            float value = Y[i];
+            if (!(value >= 0) || value == 1024)
+                value = 0;
+            value *= multiplier;
+            maxLum = std::max(maxLum, value);
+            sum += math::fastlog(1e-3f + value);
+        }
+        sumLogLuminance += sum;
+#endif
+    }
+
+    logAvgLuminance = count > 0 ? (Float) std::exp(sumLogLuminance / count) : (Float) 0;
+    maxLuminance = (Float) maxLum;
+}
+
+void applyReinhard(float *data, Bitmap::EPixelFormat format, size_t count,
+        Float scale, Float invWp2) {
+    Layout layout;
+    if (!getLayout(format, false, layout))
+        SLog(EError, "tonemap::applyReinhard(): unsupported pixel format!");
+
+    Parameters params;
+    params.scale = scale;
+    params.invWp2 = invWp2;
+    Block block;
+
+    for (size_t start=0; start<count; start += MTS_TONEMAP_BLOCK_SIZE) {
+        size_t n = std::min((size_t) MTS_TONEMAP_BLOCK_SIZE, count - start);
+        float *ptr = data + start * layout.channels;
+
+        int planes = load(ptr, layout, false, block, n);
+        tonemap::scale(block, n, planes, params);
+
+        for (int p=0; p<planes; ++p) {
+            const float *plane = block.plane(p);
+            for (size_t i=0; i<n; ++i)
+                ptr[i * layout.channels + p] = plane[i];
+        }
+    }
+}
+};
+
+MTS_NAMESPACE_END
@@ -23,6 +23,7 @@
 #include <mitsuba/core/sse.h>
 #include <mitsuba/core/frame.h>
 #include <boost/bind.hpp>
+#include <boost/algorithm/string.hpp>
 #include <stdarg.h>
 #include <iomanip>
 #include <errno.h>
@@ -36,6 +37,8 @@
 #include <psapi.h>
 #else
 #include <malloc.h>
+#include <sys/mman.h>
+#include <boost/thread/mutex.hpp>
 #endif
 
 #if defined(__WINDOWS__)
@@ -136,10 +139,125 @@ void * __restrict allocAligned(size_t size) {
 #endif
 }
 
+#if defined(__LINUX__)
+/* Size of a huge page on x86 and x86_64 Linux. Allocations
+   below this size are never backed by huge pages */
+#define MTS_HUGE_PAGE_SIZE ((size_t) 2*1024*1024)
+
+namespace {
+    /* Regions obtained using mmap(MAP_HUGETLB) must be released using
+       munmap(). Keep track of them so that freeAligned() can tell them
+       apart from memory returned by the regular allocator */
+    boost::mutex __hugetlb_mutex;
+    std::map<void *, size_t> __hugetlb_regions;
+    bool __hugetlb_warned = false;
+};
+#endif
+
+static EHugePagePolicy __huge_page_policy = EHugePagesNone;
+
+void setHugePagePolicy(EHugePagePolicy policy) {
+#if !defined(__LINUX__)
+    if (policy != EHugePagesNone)
+        SLog(EWarn, "Huge pages are currently only supported on Linux "
+            "-- falling back to the regular page size.");
+#endif
+    __huge_page_policy = policy;
+}
+
+EHugePagePolicy getHugePagePolicy() {
+    return __huge_page_policy;
+}
+
+EHugePagePolicy parseHugePagePolicy(const std::string &name) {
+    std::string value = boost::to_lower_copy(name);
+    if (value == "none")
+        return EHugePagesNone;
+    else if (value == "transparent")
+        return EHugePagesTransparent;
+    else if (value == "explicit")
+        return EHugePagesExplicit;
+    SLog(EError, "Invalid huge page policy \"%s\" (must be \"none\", "
+        "\"transparent\" or \"explicit\")!", name.c_str());
+    return EHugePagesNone;
+}
+
+void * __restrict allocAlignedLarge(size_t size) {
+#if defined(__LINUX__)
+    EHugePagePolicy policy = __huge_page_policy;
+    if (policy == EHugePagesNone || size < MTS_HUGE_PAGE_SIZE)
+        return allocAligned(size);
+
+    /* Round up to a multiple of the huge page size */
+    size_t regionSize = (size + MTS_HUGE_PAGE_SIZE - 1)
+        & ~(MTS_HUGE_PAGE_SIZE - 1);
+
+#if defined(MAP_HUGETLB)
+    if (policy == EHugePagesExplicit) {
+        void *ptr = mmap(NULL, regionSize, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        boost::mutex::scoped_lock lock(__hugetlb_mutex);
+        if (ptr != MAP_FAILED) {
+            __hugetlb_regions[ptr] = regionSize;
+            return ptr;
+        } else if (!__hugetlb_warned) {
+            SLog(EWarn, "allocAlignedLarge(): could not map %s of "
+                "explicit huge pages (%s) -- falling back to transparent "
+                "huge pages. Is /proc/sys/vm/nr_hugepages large enough?",
+                memString(regionSize).c_str(), strerror(errno));
+            __hugetlb_warned = true;
+        }
+    }
+#endif
+
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, MTS_HUGE_PAGE_SIZE, regionSize) != 0)
+        return allocAligned(size);
+
+#if defined(MADV_HUGEPAGE)
+    /* May fail if transparent huge pages are disabled. That is
+       fine, the region is then simply backed by regular pages */
+    madvise(ptr, regionSize, MADV_HUGEPAGE);
+#endif
+    return ptr;
+#else
+    return allocAligned(size);
+#endif
+}
+
+void adviseHugePages(void *ptr, size_t size) {
+#if defined(__LINUX__) && defined(MADV_HUGEPAGE)
+    if (__huge_page_policy == EHugePagesNone || ptr == NULL)
+        return;
+
+    /* Restrict to the huge pages that are completely covered */
+    uintptr_t start = ((uintptr_t) ptr + MTS_HUGE_PAGE_SIZE - 1)
+        & ~(uintptr_t) (MTS_HUGE_PAGE_SIZE - 1);
+    uintptr_t end = ((uintptr_t) ptr + size)
+        & ~(uintptr_t) (MTS_HUGE_PAGE_SIZE - 1);
+
+    if (end > start)
+        madvise((void *) start, end - start, MADV_HUGEPAGE);
+#endif
+}
+
 void freeAligned(void *ptr) {
 #if defined(__WINDOWS__)
     _aligned_free(ptr);
 #else
+#if defined(__LINUX__)
+    if (ptr != NULL) {
+        /* The policy may have changed since the allocation, hence
+           the region table has to be consulted in any case */
+        boost::mutex::scoped_lock lock(__hugetlb_mutex);
+        std::map<void *, size_t>::iterator it = __hugetlb_regions.find(ptr);
+        if (it != __hugetlb_regions.end()) {
+            munmap(ptr, it->second);
+            __hugetlb_regions.erase(it);
+            return;
+        }
+    }
+#endif
     free(ptr);
 #endif
 }
@@ -781,6 +781,16 @@ static bp::tuple bitmap_tonemapReinhard(Bitmap *bitmap, Float logAvgLuminance, F
     return bp::make_tuple(logAvgLuminance, maxLuminance);
 }
 
+static bp::tuple bitmap_getLuminanceStatistics1(const Bitmap *bitmap, Float multiplier) {
+    Float logAvgLuminance, maxLuminance;
+    bitmap->getLuminanceStatistics(logAvgLuminance, maxLuminance, multiplier);
+    return bp::make_tuple(logAvgLuminance, maxLuminance);
+}
+
+static bp::tuple bitmap_getLuminanceStatistics2(const Bitmap *bitmap) {
+    return bitmap_getLuminanceStatistics1(bitmap, 1.0f);
+}
+
 static bp::object bitmap_join(Bitmap::EPixelFormat fmt, bp::list list) {
     std::vector<Bitmap *> bitmaps(bp::len(list));
 
@@ -1544,6 +1554,8 @@ void export_core() {
         .def("write", &bitmap_write5)
         .def("write", &bitmap_write6)
         .def("tonemapReinhard", &bitmap_tonemapReinhard)
+        .def("getLuminanceStatistics", &bitmap_getLuminanceStatistics1)
+        .def("getLuminanceStatistics", &bitmap_getLuminanceStatistics2)
         .def("expand", &Bitmap::expand, BP_RETURN_VALUE)
         .def("extractChannel", &Bitmap::extractChannel, BP_RETURN_VALUE)
         .def("extractChannels", bitmap_extractChannels, BP_RETURN_VALUE)
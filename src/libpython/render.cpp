@@ -669,6 +669,7 @@ void export_render() {
         .def("setDestinationFile", &Film::setDestinationFile)
         .def("develop", film_develop1)
         .def("develop", film_develop2)
+        .def("developAsync", &Film::developAsync)
         .def("destinationExists", &Film::destinationExists)
         .def("hasHighQualityEdges", &Film::hasHighQualityEdges)
         .def("hasAlpha", &Film::hasAlpha)
@@ -813,7 +814,12 @@ void export_render() {
         .def("getOffset", &RectangularWorkUnit::getOffset, BP_RETURN_VALUE)
         .def("setOffset", &RectangularWorkUnit::setOffset)
         .def("getSize", &RectangularWorkUnit::getSize, BP_RETURN_VALUE)
-        .def("setSize", &RectangularWorkUnit::setSize);
+        .def("setSize", &RectangularWorkUnit::setSize)
+        .def("getSampleStart", &RectangularWorkUnit::getSampleStart)
+        .def("getSampleEnd", &RectangularWorkUnit::getSampleEnd)
+        .def("hasSampleRange", &RectangularWorkUnit::hasSampleRange)
+        .def("setSampleRange", &RectangularWorkUnit::setSampleRange)
+        .def("clearSampleRange", &RectangularWorkUnit::clearSampleRange);
 
     bp::class_<RenderListener, ref<RenderListenerWrapper>, boost::noncopyable>
             RenderListener_class("RenderListener", bp::init<>());
@@ -0,0 +1,400 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/binscene.h>
+#include <mitsuba/render/scenehandler.h>
+#include <mitsuba/render/scene.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/mmap.h>
+#include <mitsuba/core/track.h>
+#include <mitsuba/core/timer.h>
+#include <stdexcept>
+
+MTS_NAMESPACE_BEGIN
+
+/* ==================================================================== */
+/*                          BinarySceneWriter                           */
+/* ==================================================================== */
+
+BinarySceneWriter::BinarySceneWriter(Stream *stream)
+        : m_stream(stream), m_recordCount(0) {
+    m_stream->setByteOrder(Stream::ELittleEndian);
+    m_stream->writeUInt(MTS_BINSCENE_MAGIC);
+    m_stream->writeUInt(MTS_BINSCENE_VERSION);
+    m_stream->writeString(MTS_VERSION);
+    m_stream->writeUChar((uint8_t) sizeof(Float));
+    m_stream->writeUChar((uint8_t) SPECTRUM_SAMPLES);
+
+    m_buffer = new MemoryStream();
+    m_buffer->setByteOrder(Stream::ELittleEndian);
+}
+
+BinarySceneWriter::~BinarySceneWriter() { }
+
+uint32_t BinarySceneWriter::writeObject(const Class *type, const Properties &props,
+        const ChildList &children, bool configure) {
+    m_buffer->writeString(type->getName());
+    m_buffer->writeUChar(configure ? EConfigure : 0);
+    m_buffer->writeString(props.getPluginName());
+    m_buffer->writeString(props.getID());
+
+    std::vector<std::string> names = props.getPropertyNames();
+    m_buffer->writeUInt((uint32_t) names.size());
+    for (size_t i=0; i<names.size(); ++i) {
+        const std::string &name = names[i];
+        Properties::EPropertyType propType = props.getType(name);
+        m_buffer->writeString(name);
+        m_buffer->writeUChar((uint8_t) propType);
+
+        switch (propType) {
+            case Properties::EBoolean:
+                m_buffer->writeBool(props.getBoolean(name));
+                break;
+            case Properties::EInteger:
+                m_buffer->writeLong(props.getLong(name));
+                break;
+            case Properties::EFloat:
+                m_buffer->writeFloat(props.getFloat(name));
+                break;
+            case Properties::EPoint:
+                props.getPoint(name).serialize(m_buffer);
+                break;
+            case Properties::EVector:
+                props.getVector(name).serialize(m_buffer);
+                break;
+            case Properties::ETransform:
+                props.getTransform(name).serialize(m_buffer);
+                break;
+            case Properties::EAnimatedTransform:
+                props.getAnimatedTransform(name)->serialize(m_buffer);
+                break;
+            case Properties::ESpectrum:
+                props.getSpectrum(name).serialize(m_buffer);
+                break;
+            case Properties::EString:
+                m_buffer->writeString(props.getString(name));
+                break;
+            default:
+                Log(EError, "Property \"%s\" of the %s plugin \"%s\" cannot be "
+                    "stored in a binary scene file!", name.c_str(),
+                    type->getName().c_str(), props.getPluginName().c_str());
+        }
+    }
+
+    m_buffer->writeUInt((uint32_t) children.size());
+    for (size_t i=0; i<children.size(); ++i) {
+        if (children[i].second >= m_recordCount)
+            Log(EError, "Internal error: child record %u has not been written yet!",
+                children[i].second);
+        m_buffer->writeString(children[i].first);
+        m_buffer->writeUInt(children[i].second);
+    }
+
+    flushRecord(EObjectRecord);
+    return m_recordCount++;
+}
+
+uint32_t BinarySceneWriter::writeReference(uint32_t index) {
+    if (index >= m_recordCount)
+        Log(EError, "Internal error: referenced record %u does not exist!", index);
+    m_buffer->writeUInt(index);
+    flushRecord(EReferenceRecord);
+    return m_recordCount++;
+}
+
+void BinarySceneWriter::finish(uint32_t root) {
+    if (root >= m_recordCount)
+        Log(EError, "Internal error: root record %u does not exist!", root);
+    m_buffer->writeUInt(root);
+    flushRecord(EEndRecord);
+    m_stream->flush();
+}
+
+void BinarySceneWriter::flushRecord(ERecordType type) {
+    size_t size = m_buffer->getPos();
+    m_stream->writeUInt((uint32_t) size);
+    m_stream->writeUChar((uint8_t) type);
+    m_stream->write(m_buffer->getData(), size);
+    m_buffer->reset();
+}
+
+/* ==================================================================== */
+/*                          BinarySceneLoader                           */
+/* ==================================================================== */
+
+namespace {
+    /// Location of a record within the memory-mapped file
+    struct RecordLocation {
+        size_t offset;
+        uint32_t size;
+        uint8_t type;
+    };
+
+    /// Record after decoding, but before any objects were created
+    struct DecodedRecord {
+        const Class *type;
+        uint8_t flags;
+        uint32_t target;
+        Properties props;
+        BinarySceneWriter::ChildList children;
+        std::string error;
+
+        DecodedRecord() : type(NULL), flags(0), target(0) { }
+    };
+
+    /* Number of records that are decoded at a time. Bounds the memory
+       used by decoded records that have not been instantiated yet */
+    const int recordBatchSize = 16384;
+
+    inline void decodeError(const std::string &msg) {
+        throw std::runtime_error(msg);
+    }
+
+    void decodeObject(Stream *stream, DecodedRecord &rec, uint32_t index) {
+        std::string className = stream->readString();
+        rec.type = Class::forName(className);
+        if (rec.type == NULL)
+            decodeError(formatString("unknown class \"%s\"", className.c_str()));
+        rec.flags = stream->readUChar();
+        rec.props.setPluginName(stream->readString());
+        rec.props.setID(stream->readString());
+
+        uint32_t propCount = stream->readUInt();
+        for (uint32_t i=0; i<propCount; ++i) {
+            std::string name = stream->readString();
+            uint8_t propType = stream->readUChar();
+            switch (propType) {
+                case Properties::EBoolean:
+                    rec.props.setBoolean(name, stream->readBool(), false);
+                    break;
+                case Properties::EInteger:
+                    rec.props.setLong(name, stream->readLong(), false);
+                    break;
+                case Properties::EFloat:
+                    rec.props.setFloat(name, stream->readFloat(), false);
+                    break;
+                case Properties::EPoint:
+                    rec.props.setPoint(name, Point(stream), false);
+                    break;
+                case Properties::EVector:
+                    rec.props.setVector(name, Vector(stream), false);
+                    break;
+                case Properties::ETransform:
+                    rec.props.setTransform(name, Transform(stream), false);
+                    break;
+                case Properties::EAnimatedTransform: {
+                        ref<AnimatedTransform> trafo = new AnimatedTransform(stream);
+                        rec.props.setAnimatedTransform(name, trafo, false);
+                    }
+                    break;
+                case Properties::ESpectrum:
+                    rec.props.setSpectrum(name, Spectrum(stream), false);
+                    break;
+                case Properties::EString:
+                    rec.props.setString(name, stream->readString(), false);
+                    break;
+                default:
+                    decodeError(formatString("invalid type of property \"%s\"", name.c_str()));
+            }
+        }
+
+        uint32_t childCount = stream->readUInt();
+        rec.children.reserve(childCount);
+        for (uint32_t i=0; i<childCount; ++i) {
+            std::string name = stream->readString();
+            uint32_t child = stream->readUInt();
+            if (child >= index)
+                decodeError(formatString("invalid child record %u", child));
+            rec.children.push_back(std::make_pair(name, child));
+        }
+    }
+}
+
+bool BinarySceneLoader::isBinaryScene(const fs::path &filename) {
+    if (!fs::is_regular_file(filename) || fs::file_size(filename) < sizeof(uint32_t))
+        return false;
+    ref<FileStream> stream = new FileStream(filename, FileStream::EReadOnly);
+    stream->setByteOrder(Stream::ELittleEndian);
+    return stream->readUInt() == MTS_BINSCENE_MAGIC;
+}
+
+ref<Scene> BinarySceneLoader::loadScene(const fs::path &filename) {
+    ref<Timer> timer = new Timer();
+    SLog(EDebug, "Loading binary scene \"%s\" ..", filename.string().c_str());
+
+    ref<MemoryMappedFile> mmap = new MemoryMappedFile(filename);
+    uint8_t *data = (uint8_t *) mmap->getData();
+    size_t size = mmap->getSize();
+
+    /* Check the header */
+    ref<MemoryStream> stream = new MemoryStream(data, size);
+    stream->setByteOrder(Stream::ELittleEndian);
+    if (stream->readUInt() != MTS_BINSCENE_MAGIC)
+        SLog(EError, "\"%s\" is not a binary scene file!", filename.string().c_str());
+    uint32_t version = stream->readUInt();
+    if (version != MTS_BINSCENE_VERSION)
+        SLog(EError, "\"%s\": unsupported binary scene format version %u (expected %u). "
+            "Please convert the original scene again.", filename.string().c_str(),
+            version, MTS_BINSCENE_VERSION);
+    Version fileVersion(stream->readString()), currentVersion(MTS_VERSION);
+    if (!fileVersion.isCompatible(currentVersion))
+        SLog(EError, "\"%s\" was written by an incompatible version of Mitsuba "
+            "(file version: %s, current version: %s). Please convert the original "
+            "scene again.", filename.string().c_str(), fileVersion.toString().c_str(),
+            MTS_VERSION);
+    uint8_t floatSize = stream->readUChar(), spectrumSamples = stream->readUChar();
+    if (floatSize != sizeof(Float) || spectrumSamples != SPECTRUM_SAMPLES)
+        SLog(EError, "\"%s\" was written by a Mitsuba build with a different "
+            "configuration (%s precision, %i spectral samples), whereas this build "
+            "uses %s precision and %i spectral samples. Please convert the original "
+            "scene again.", filename.string().c_str(), floatSize == 4 ? "single" : "double",
+            (int) spectrumSamples, sizeof(Float) == 4 ? "single" : "double", SPECTRUM_SAMPLES);
+
+    /* Locate all records */
+    std::vector<RecordLocation> records;
+    uint32_t root = 0;
+    bool foundEnd = false;
+    size_t pos = stream->getPos();
+    while (!foundEnd) {
+        if (pos + sizeof(uint32_t) + sizeof(uint8_t) > size)
+            SLog(EError, "\"%s\": file is truncated!", filename.string().c_str());
+        stream->seek(pos);
+        RecordLocation loc;
+        loc.size = stream->readUInt();
+        loc.type = stream->readUChar();
+        loc.offset = stream->getPos();
+        if (loc.offset + loc.size > size)
+            SLog(EError, "\"%s\": file is truncated!", filename.string().c_str());
+
+        if (loc.type == BinarySceneWriter::EEndRecord) {
+            root = stream->readUInt();
+            foundEnd = true;
+        } else if (loc.type == BinarySceneWriter::EObjectRecord
+                || loc.type == BinarySceneWriter::EReferenceRecord) {
+            records.push_back(loc);
+        } else {
+            SLog(EError, "\"%s\": encountered a record of unknown type %i!",
+                filename.string().c_str(), (int) loc.type);
+        }
+        pos = loc.offset + loc.size;
+    }
+
+    if (root >= records.size())
+        SLog(EError, "\"%s\": invalid root record index!", filename.string().c_str());
+
+    /* Decode the records in parallel and instantiate the objects in file
+       order. This happens in batches, since decoded records are fairly
+       large and a scene can consist of millions of them. 'objects' holds
+       the instance that is handed to the parent, while 'expanded' holds the
+       one that references resolve to (these differ for textures) */
+    int recordCount = (int) records.size();
+    std::vector<ref<ConfigurableObject> > objects(records.size()), expanded(records.size());
+    SceneHandler::ChildList children;
+    Float decodeTime = 0;
+
+    for (int batchStart=0; batchStart<recordCount; batchStart += recordBatchSize) {
+        int batchSize = std::min(recordBatchSize, recordCount - batchStart);
+        std::vector<DecodedRecord> decoded(batchSize);
+        ref<Timer> decodeTimer = new Timer();
+
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for schedule(dynamic, 256)
+        #endif
+        for (int j=0; j<batchSize; ++j) {
+            int i = batchStart + j;
+            const RecordLocation &loc = records[i];
+            DecodedRecord &rec = decoded[j];
+            try {
+                ref<MemoryStream> recStream = new MemoryStream(data + loc.offset, loc.size);
+                recStream->setByteOrder(Stream::ELittleEndian);
+                if (loc.type == BinarySceneWriter::EObjectRecord) {
+                    decodeObject(recStream, rec, (uint32_t) i);
+                } else {
+                    rec.target = recStream->readUInt();
+                    if (rec.target >= (uint32_t) i)
+                        decodeError(formatString("invalid reference to record %u", rec.target));
+                }
+            } catch (const std::exception &ex) {
+                rec.error = ex.what();
+            }
+        }
+
+        for (int j=0; j<batchSize; ++j) {
+            if (!decoded[j].error.empty())
+                SLog(EError, "\"%s\": error while decoding record %u: %s",
+                    filename.string().c_str(), (uint32_t) (batchStart + j),
+                    decoded[j].error.c_str());
+        }
+
+        decodeTime += decodeTimer->getMilliseconds() / 1000.0f;
+
+        for (int j=0; j<batchSize; ++j) {
+            int i = batchStart + j;
+            DecodedRecord &rec = decoded[j];
+            ref<ConfigurableObject> object;
+
+            if (records[i].type == BinarySceneWriter::EObjectRecord) {
+                children.clear();
+                for (size_t k=0; k<rec.children.size(); ++k) {
+                    ConfigurableObject *child = objects[rec.children[k].second];
+                    child->incRef();
+                    children.push_back(std::make_pair(rec.children[k].first, child));
+                }
+
+                try {
+                    object = SceneHandler::createObject(rec.type, rec.props, children,
+                        (rec.flags & BinarySceneWriter::EConfigure) != 0);
+                } catch (const std::exception &ex) {
+                    SLog(EError, "\"%s\": error while creating object %u (%s plugin \"%s\"): %s",
+                        filename.string().c_str(), (uint32_t) i, rec.type->getName().c_str(),
+                        rec.props.getPluginName().c_str(), ex.what());
+                }
+
+                /* Warn about unqueried properties */
+                std::vector<std::string> unq = rec.props.getUnqueried();
+                for (size_t k=0; k<unq.size(); ++k)
+                    SLog(EWarn, "Unqueried attribute \"%s\" in %s plugin \"%s\"",
+                        unq[k].c_str(), rec.type->getName().c_str(),
+                        rec.props.getPluginName().c_str());
+            } else {
+                object = expanded[rec.target];
+                object->configure();
+            }
+
+            objects[i] = object;
+            if (object->getClass()->derivesFrom(MTS_CLASS(Texture)))
+                object = static_cast<Texture *>(object.get())->expand();
+            expanded[i] = object;
+        }
+    }
+
+    runSceneCleanupHandlers();
+
+    if (!objects[root]->getClass()->derivesFrom(MTS_CLASS(Scene)))
+        SLog(EError, "\"%s\": the root record does not describe a scene!",
+            filename.string().c_str());
+
+    SLog(EInfo, "Loaded %i binary scene records in %s (decoding took %s)",
+        recordCount, timeString(timer->getMilliseconds() / 1000.0f).c_str(),
+        timeString(decodeTime).c_str());
+
+    return static_cast<Scene *>(objects[root].get());
+}
+
+MTS_IMPLEMENT_CLASS(BinarySceneWriter, false, Object)
+MTS_NAMESPACE_END
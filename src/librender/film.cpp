@@ -18,6 +18,7 @@
 
 #include <mitsuba/render/film.h>
 #include <mitsuba/core/plugin.h>
+#include <mitsuba/core/fstream.h>
 #include <boost/algorithm/string.hpp>
 
 MTS_NAMESPACE_BEGIN
@@ -52,6 +53,7 @@ Film::Film(const Properties &props)
        quality at the edges especially with large reconstruction
        filters. */
     m_highQualityEdges = props.getBoolean("highQualityEdges", false);
+    m_writerMutex = new Mutex();
 }
 
 Film::Film(Stream *stream, InstanceManager *manager)
@@ -61,9 +63,43 @@ Film::Film(Stream *stream, InstanceManager *manager)
     m_cropSize = Vector2i(stream);
     m_highQualityEdges = stream->readBool();
     m_filter = static_cast<ReconstructionFilter *>(manager->getInstance(stream));
+    m_writerMutex = new Mutex();
 }
 
-Film::~Film() { }
+Film::~Film() {
+    if (m_imageWriter)
+        m_imageWriter->quit();
+}
+
+void Film::developAsync(const Scene *scene, Float renderTime) {
+    develop(scene, renderTime);
+}
+
+void Film::saveState(Stream *stream) const {
+    Log(EError, "%s does not support checkpoints!", getClass()->getName().c_str());
+}
+
+void Film::loadState(Stream *stream) {
+    Log(EError, "%s does not support checkpoints!", getClass()->getName().c_str());
+}
+
+void Film::writeBitmap(Bitmap *bitmap, Bitmap::EFileFormat format,
+        const fs::path &filename, bool async, int compression) {
+    LockGuard lock(m_writerMutex);
+    if (async) {
+        if (!m_imageWriter) {
+            m_imageWriter = new ImageWriter();
+            m_imageWriter->start();
+        }
+        m_imageWriter->write(bitmap, format, filename, compression);
+    } else {
+        /* Don't race with an intermediate image that is still being written */
+        if (m_imageWriter)
+            m_imageWriter->wait();
+        ref<FileStream> stream = new FileStream(filename, FileStream::ETruncWrite);
+        bitmap->write(format, stream, compression);
+    }
+}
 
 void Film::serialize(Stream *stream, InstanceManager *manager) const {
     ConfigurableObject::serialize(stream, manager);
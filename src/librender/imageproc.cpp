@@ -25,7 +25,8 @@ MTS_NAMESPACE_BEGIN
 /*                          BlockedImageProcess                         */
 /* ==================================================================== */
 
-void BlockedImageProcess::init(const Point2i &offset, const Vector2i &size, uint32_t blockSize) {
+void BlockedImageProcess::init(const Point2i &offset, const Vector2i &size,
+        uint32_t blockSize, bool adaptive) {
     m_offset = offset;
     m_size = size;
     m_blockSize = (int) blockSize;
@@ -38,44 +39,320 @@ void BlockedImageProcess::init(const Point2i &offset, const Vector2i &size, uint
     m_curBlock = Point2i(m_numBlocks / 2);
     m_stepsLeft = 1;
     m_numSteps = 1;
+
+    /* Reimplementation of the spiraling block generator by Adam Arbree.
+       The blocks are stored in reverse order, so that the next one
+       is always at the end of the list */
+    m_pending.resize(m_numBlocksTotal);
+    for (int i=0; i<m_numBlocksTotal; ++i) {
+        Block &block = m_pending[m_numBlocksTotal - 1 - i];
+        Point2i pos = m_curBlock * m_blockSize;
+        block.offset = pos + m_offset;
+        block.size = Vector2i(
+            std::min(m_size.x-pos.x, m_blockSize),
+            std::min(m_size.y-pos.y, m_blockSize));
+        block.cell = m_curBlock.x + m_curBlock.y * m_numBlocks.x;
+        block.index = i;
+
+        if (i+1 == m_numBlocksTotal)
+            break;
+
+        do {
+            switch (m_direction) {
+                case ERight: ++m_curBlock.x; break;
+                case EDown:  ++m_curBlock.y; break;
+                case ELeft:  --m_curBlock.x; break;
+                case EUp:    --m_curBlock.y; break;
+            }
+
+            if (--m_stepsLeft == 0) {
+                m_direction = (m_direction + 1) % 4;
+                if (m_direction == ELeft || m_direction == ERight)
+                    ++m_numSteps;
+                m_stepsLeft = m_numSteps;
+            }
+        } while (m_curBlock.x < 0 || m_curBlock.y < 0
+            || m_curBlock.x >= m_numBlocks.x
+            || m_curBlock.y >= m_numBlocks.y);
+    }
+
+    m_adaptive = adaptive;
+    m_blocks.clear();
+    m_freeBlocks.clear();
+    m_cellBlocks.clear();
+    m_estimatedQueue.clear();
+    m_unestimatedQueue.clear();
+    m_estimatedQueueCost = 0;
+    m_unestimatedQueuePixels = 0;
+    m_cellCost.clear();
+    m_cellEstimate.clear();
+    m_running.clear();
+    if (m_adaptive) {
+        m_cellBlocks.resize(m_numBlocksTotal);
+        m_cellCost.resize(m_numBlocksTotal, -1.0f);
+        m_cellEstimate.resize(m_numBlocksTotal, -1.0f);
+    }
+    m_costSum = m_busyTime = m_lastIssueTime = 0;
+    m_costCount = m_pixelsFinished = 0;
+    m_coreCount = Scheduler::getInstance()->getCoreCount();
+    m_numSplits = 0;
+    m_timer = new Timer();
+    m_mutex = new Mutex();
+}
+
+void BlockedImageProcess::enqueue(const Block &block) {
+    int id;
+    if (m_freeBlocks.empty()) {
+        id = (int) m_blocks.size();
+        m_blocks.push_back(block);
+    } else {
+        id = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+        m_blocks[id] = block;
+    }
+    m_cellBlocks[block.cell].push_back(id);
+    insertQueueEntry(id);
+}
+
+BlockedImageProcess::Block BlockedImageProcess::dequeue(int id) {
+    removeQueueEntry(id);
+    const Block &block = m_blocks[id];
+    std::vector<int> &ids = m_cellBlocks[block.cell];
+    ids.erase(std::find(ids.begin(), ids.end(), id));
+    m_freeBlocks.push_back(id);
+    return block;
+}
+
+void BlockedImageProcess::insertQueueEntry(int id) {
+    Block &block = m_blocks[id];
+    Float costPerPixel = m_cellEstimate[block.cell];
+    int pixels = block.size.x * block.size.y;
+
+    /* Blocks without processed neighbors are assumed to be average. Their
+       order doesn't depend on the average, hence they are sorted by area */
+    QueueEntry entry;
+    entry.index = block.index;
+    entry.id = id;
+    if (costPerPixel < 0) {
+        entry.key = block.key = (Float) pixels;
+        m_unestimatedQueue.insert(entry);
+        m_unestimatedQueuePixels += (size_t) pixels;
+    } else {
+        entry.key = block.key = costPerPixel * pixels;
+        m_estimatedQueue.insert(entry);
+        m_estimatedQueueCost += entry.key;
+    }
+}
+
+void BlockedImageProcess::removeQueueEntry(int id) {
+    const Block &block = m_blocks[id];
+    QueueEntry entry;
+    entry.key = block.key;
+    entry.index = block.index;
+    entry.id = id;
+    if (m_cellEstimate[block.cell] < 0) {
+        m_unestimatedQueue.erase(entry);
+        m_unestimatedQueuePixels -= (size_t) (block.size.x * block.size.y);
+    } else {
+        m_estimatedQueue.erase(entry);
+        m_estimatedQueueCost -= entry.key;
+    }
+}
+
+void BlockedImageProcess::updateEstimates(int cell, Float costPerPixel) {
+    int cx = cell % m_numBlocks.x, cy = cell / m_numBlocks.x;
+    for (int y=std::max(cy-1, 0); y<=std::min(cy+1, m_numBlocks.y-1); ++y) {
+        for (int x=std::max(cx-1, 0); x<=std::min(cx+1, m_numBlocks.x-1); ++x) {
+            int neighbor = x + y * m_numBlocks.x;
+            if (m_cellEstimate[neighbor] >= costPerPixel)
+                continue;
+
+            /* Re-queue the pending blocks of the cell with their new cost */
+            const std::vector<int> &ids = m_cellBlocks[neighbor];
+            for (size_t i=0; i<ids.size(); ++i)
+                removeQueueEntry(ids[i]);
+            m_cellEstimate[neighbor] = costPerPixel;
+            for (size_t i=0; i<ids.size(); ++i)
+                insertQueueEntry(ids[i]);
+        }
+    }
 }
 
 ParallelProcess::EStatus BlockedImageProcess::generateWork(WorkUnit *unit, int worker) {
-    /* Reimplementation of the spiraling block generator by Adam Arbree */
     RectangularWorkUnit &rect = *static_cast<RectangularWorkUnit *>(unit);
+    LockGuard lock(m_mutex);
+
+    if (m_numBlocksGenerated == 0) {
+        m_timer->reset();
+
+        /* Queue the blocks by their cost only now, since regions may
+           be skipped and the adaptive mode be disabled until then */
+        if (m_adaptive) {
+            for (size_t i=0; i<m_pending.size(); ++i)
+                enqueue(m_pending[i]);
+            m_pending.clear();
+        }
+    }
 
-    if (m_numBlocksTotal == m_numBlocksGenerated)
+    if (m_pending.empty() && m_estimatedQueue.empty() && m_unestimatedQueue.empty())
         return EFailure;
 
-    Point2i pos = m_curBlock * m_blockSize;
-    rect.setOffset(pos + m_offset);
-    rect.setSize(Vector2i(
-        std::min(m_size.x-pos.x, m_blockSize),
-        std::min(m_size.y-pos.y, m_blockSize)));
-
-    if (++m_numBlocksGenerated == m_numBlocksTotal)
-        return ESuccess;
-
-    do {
-        switch (m_direction) {
-            case ERight: ++m_curBlock.x; break;
-            case EDown:  ++m_curBlock.y; break;
-            case ELeft:  --m_curBlock.x; break;
-            case EUp:    --m_curBlock.y; break;
+    Block block;
+    Float nextCost = 0, remainingCost = 0;
+    if (m_adaptive) {
+        /* Blocks that have already been running for longer than an average
+           one are at least that expensive, which tells us something about
+           their neighbors */
+        Float time = m_timer->getSeconds(),
+              meanCost = m_costCount > 0 ? m_costSum / m_costCount : 0.0f;
+        for (std::map<int, Block>::const_iterator it = m_running.begin();
+                it != m_running.end() && m_costCount > 0; ++it) {
+            const Block &block = it->second;
+            Float costPerPixel = (time - block.issueTime) / (block.size.x * block.size.y);
+            if (costPerPixel > meanCost)
+                updateEstimates(block.cell, costPerPixel);
         }
 
-        if (--m_stepsLeft == 0) {
-            m_direction = (m_direction + 1) % 4;
-            if (m_direction == ELeft || m_direction == ERight)
-                ++m_numSteps;
-            m_stepsLeft = m_numSteps;
+        /* Hand out the block with the highest expected cost */
+        const QueueEntry *next = NULL;
+        if (!m_estimatedQueue.empty()) {
+            next = &*m_estimatedQueue.begin();
+            nextCost = next->key;
+        }
+        if (!m_unestimatedQueue.empty()) {
+            const QueueEntry &entry = *m_unestimatedQueue.begin();
+            Float cost = meanCost * entry.key;
+            if (!next || cost > nextCost || (cost == nextCost && entry.index < next->index)) {
+                next = &entry;
+                nextCost = cost;
+            }
+        }
+        remainingCost = (Float) (m_estimatedQueueCost
+            + meanCost * m_unestimatedQueuePixels);
+        block = dequeue(next->id);
+    } else {
+        block = m_pending.back();
+        m_pending.pop_back();
+    }
+
+    if (m_adaptive) {
+        /* Split blocks that would take longer than a fair share of the
+           remaining work, and split all remaining blocks near the end,
+           so that all cores stay busy */
+        int minSize = std::max(m_blockSize / 4, 1);
+        Float fairShare = remainingCost / m_coreCount;
+        while (((m_estimatedQueue.size() + m_unestimatedQueue.size() + 1)
+                    * m_unitsPerBlock < m_coreCount
+                || nextCost > fairShare * m_unitsPerBlock) &&
+                std::max(block.size.x, block.size.y) >= 2*minSize) {
+            Block other = block;
+            if (block.size.x >= block.size.y) {
+                block.size.x /= 2;
+                other.offset.x += block.size.x;
+                other.size.x -= block.size.x;
+            } else {
+                block.size.y /= 2;
+                other.offset.y += block.size.y;
+                other.size.y -= block.size.y;
+            }
+            enqueue(other);
+            ++m_numSplits;
+            nextCost *= 0.5f;
         }
-    } while (m_curBlock.x < 0 || m_curBlock.y < 0
-        || m_curBlock.x >= m_numBlocks.x
-        || m_curBlock.y >= m_numBlocks.y);
+
+        Vector2i rel = block.offset - m_offset;
+        m_lastIssueTime = block.issueTime = m_timer->getSeconds();
+        m_running[rel.x + rel.y * m_size.x] = block;
+    }
+
+    rect.setOffset(block.offset);
+    rect.setSize(block.size);
+    ++m_numBlocksGenerated;
 
     return ESuccess;
 }
 
+size_t BlockedImageProcess::blockFinished(const Point2i &offset,
+        const Vector2i &size, Float renderTime) {
+    LockGuard lock(m_mutex);
+    m_pixelsFinished += (size_t) size.x * (size_t) size.y;
+
+    if (!m_adaptive)
+        return m_pixelsFinished;
+
+    Vector2i rel = offset - m_offset;
+    std::map<int, Block>::iterator it = m_running.find(rel.x + rel.y * m_size.x);
+    if (it == m_running.end())
+        return m_pixelsFinished;
+
+    Float time = m_timer->getSeconds(), elapsed = renderTime >= 0
+        ? renderTime : time - it->second.issueTime;
+    int cell = it->second.cell;
+    m_running.erase(it);
+    m_busyTime += elapsed;
+
+    /* Record the cost per pixel, and propagate it to the neighbors */
+    Float costPerPixel = elapsed / (size.x * size.y);
+    m_cellCost[cell] = std::max(m_cellCost[cell], costPerPixel);
+    m_costSum += costPerPixel;
+    m_costCount++;
+    updateEstimates(cell, m_cellCost[cell]);
+
+    if (m_pixelsFinished == getPixelCount()) {
+        Float available = time * m_coreCount;
+        Log(EInfo, "Processed %i work units (%i splits) in %s, cores were busy "
+            "%.1f%% of the time. The last work unit was issued %s before the end.",
+            (int) (m_numBlocksGenerated * m_unitsPerBlock), m_numSplits,
+            timeString(time, true).c_str(),
+            available > 0 ? 100 * m_busyTime / available : 100.0f,
+            timeString(time - m_lastIssueTime, true).c_str());
+    }
+
+    return m_pixelsFinished;
+}
+
+size_t BlockedImageProcess::skipRegion(const Point2i &offset, const Vector2i &size) {
+    LockGuard lock(m_mutex);
+    Point2i end = offset + size;
+    std::vector<Block> pending;
+    pending.reserve(m_pending.size());
+
+    for (size_t i=0; i<m_pending.size(); ++i) {
+        const Block &block = m_pending[i];
+        Point2i blockEnd = block.offset + block.size,
+                isectStart(std::max(offset.x, block.offset.x), std::max(offset.y, block.offset.y)),
+                isectEnd(std::min(end.x, blockEnd.x), std::min(end.y, blockEnd.y));
+
+        if (isectStart.x >= isectEnd.x || isectStart.y >= isectEnd.y) {
+            pending.push_back(block);
+            continue;
+        }
+        m_pixelsFinished += (size_t) (isectEnd.x - isectStart.x)
+            * (size_t) (isectEnd.y - isectStart.y);
+
+        /* Keep the parts of the block above, below, left
+           and right of the skipped region */
+        Point2i start[4] = {
+            block.offset, Point2i(block.offset.x, isectEnd.y),
+            Point2i(block.offset.x, isectStart.y), Point2i(isectEnd.x, isectStart.y)
+        };
+        Point2i stop[4] = {
+            Point2i(blockEnd.x, isectStart.y), blockEnd,
+            Point2i(isectStart.x, isectEnd.y), Point2i(blockEnd.x, isectEnd.y)
+        };
+        for (int j=0; j<4; ++j) {
+            if (start[j].x >= stop[j].x || start[j].y >= stop[j].y)
+                continue;
+            Block part = block;
+            part.offset = start[j];
+            part.size = stop[j] - start[j];
+            pending.push_back(part);
+        }
+    }
+
+    m_pending.swap(pending);
+    return m_pixelsFinished;
+}
+
 MTS_IMPLEMENT_CLASS(BlockedImageProcess, true, ParallelProcess)
 MTS_NAMESPACE_END
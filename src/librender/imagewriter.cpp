@@ -0,0 +1,109 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/imagewriter.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/timer.h>
+
+MTS_NAMESPACE_BEGIN
+
+ImageWriter::ImageWriter() : Thread("imgw"),
+        m_busy(false), m_quit(false) {
+    m_mutex = new Mutex();
+    m_cond = new ConditionVariable(m_mutex);
+}
+
+ImageWriter::~ImageWriter() { }
+
+void ImageWriter::write(Bitmap *bitmap, Bitmap::EFileFormat format,
+        const fs::path &filename, int compression) {
+    LockGuard lock(m_mutex);
+    if (m_quit)
+        Log(EError, "ImageWriter::write(): the writer has already been shut down!");
+
+    for (std::deque<Request>::iterator it = m_queue.begin(); it != m_queue.end(); ++it) {
+        if (it->filename == filename) {
+            /* Replace the stale snapshot that is still waiting in the queue */
+            it->bitmap = bitmap;
+            it->format = format;
+            it->compression = compression;
+            return;
+        }
+    }
+
+    Request request;
+    request.bitmap = bitmap;
+    request.format = format;
+    request.filename = filename;
+    request.compression = compression;
+    m_queue.push_back(request);
+    m_cond->broadcast();
+}
+
+void ImageWriter::wait() {
+    LockGuard lock(m_mutex);
+    while (!m_queue.empty() || m_busy)
+        m_cond->wait();
+}
+
+void ImageWriter::quit() {
+    {
+        LockGuard lock(m_mutex);
+        m_quit = true;
+        m_cond->broadcast();
+    }
+    if (isRunning())
+        join();
+}
+
+void ImageWriter::run() {
+    while (true) {
+        Request request;
+        {
+            LockGuard lock(m_mutex);
+            while (m_queue.empty() && !m_quit)
+                m_cond->wait();
+            if (m_queue.empty())
+                break;
+            request = m_queue.front();
+            m_queue.pop_front();
+            m_busy = true;
+        }
+
+        try {
+            ref<Timer> timer = new Timer();
+            ref<FileStream> stream = new FileStream(request.filename,
+                FileStream::ETruncWrite);
+            request.bitmap->write(request.format, stream, request.compression);
+            stream->close();
+            Log(EDebug, "Wrote \"%s\" in the background (took %s)",
+                request.filename.string().c_str(),
+                timeString(timer->getMilliseconds() / 1000.0f).c_str());
+        } catch (const std::exception &ex) {
+            Log(EWarn, "Could not write \"%s\": %s",
+                request.filename.string().c_str(), ex.what());
+        }
+
+        LockGuard lock(m_mutex);
+        m_busy = false;
+        m_cond->broadcast();
+    }
+}
+
+MTS_IMPLEMENT_CLASS(ImageWriter, false, Thread)
+MTS_NAMESPACE_END
@@ -41,12 +41,21 @@ void Integrator::configureSampler(const Scene *scene, Sampler *sampler) {
         getClass()->derivesFrom(MTS_CLASS(SamplingIntegrator)));
 }
 const Integrator *Integrator::getSubIntegrator(int idx) const { return NULL; }
+bool Integrator::saveCheckpoint(Stream *stream) { return false; }
+void Integrator::loadCheckpoint(Stream *stream) {
+    Log(EError, "The %s does not support resuming from checkpoints!",
+        getClass()->getName().c_str());
+}
 
 SamplingIntegrator::SamplingIntegrator(const Properties &props)
- : Integrator(props) { }
+ : Integrator(props) {
+    m_processMutex = new Mutex();
+}
 
 SamplingIntegrator::SamplingIntegrator(Stream *stream, InstanceManager *manager)
- : Integrator(stream, manager) { }
+ : Integrator(stream, manager) {
+    m_processMutex = new Mutex();
+}
 
 void SamplingIntegrator::serialize(Stream *stream, InstanceManager *manager) const {
     Integrator::serialize(stream, manager);
@@ -88,8 +97,11 @@ Spectrum SamplingIntegrator::E(const Scene *scene, const Intersection &its,
 }
 
 void SamplingIntegrator::cancel() {
-    if (m_process)
-        Scheduler::getInstance()->cancel(m_process);
+    m_processMutex->lock();
+    ref<ParallelProcess> process = m_process;
+    m_processMutex->unlock();
+    if (process)
+        Scheduler::getInstance()->cancel(process);
 }
 
 bool SamplingIntegrator::render(Scene *scene,
@@ -109,8 +121,9 @@ bool SamplingIntegrator::render(Scene *scene,
         nCores == 1 ? "core" : "cores");
 
     /* This is a sampling-based integrator - parallelize */
-    ref<ParallelProcess> proc = new BlockedRenderProcess(job,
+    ref<BlockedRenderProcess> proc = new BlockedRenderProcess(job,
         queue, scene->getBlockSize());
+    proc->setSampleSplitting(supportsSampleRanges());
     int integratorResID = sched->registerResource(this);
     proc->bindResource("integrator", integratorResID);
     proc->bindResource("scene", sceneResID);
@@ -118,16 +131,39 @@ bool SamplingIntegrator::render(Scene *scene,
     proc->bindResource("sampler", samplerResID);
     scene->bindUsedResources(proc);
     bindUsedResources(proc);
+    if (m_checkpoint) {
+        proc->loadCheckpoint(m_checkpoint);
+        m_checkpoint = NULL;
+    }
     sched->schedule(proc);
 
+    m_processMutex->lock();
     m_process = proc;
+    m_processMutex->unlock();
     sched->wait(proc);
+    m_processMutex->lock();
     m_process = NULL;
+    m_processMutex->unlock();
     sched->unregisterResource(integratorResID);
 
     return proc->getReturnStatus() == ParallelProcess::ESuccess;
 }
 
+bool SamplingIntegrator::saveCheckpoint(Stream *stream) {
+    /* Called from the checkpoint writer thread while render() may be
+       about to release the process */
+    m_processMutex->lock();
+    ref<ParallelProcess> process = m_process;
+    m_processMutex->unlock();
+    if (!process || !process->getClass()->derivesFrom(MTS_CLASS(BlockedRenderProcess)))
+        return false;
+    return static_cast<BlockedRenderProcess *>(process.get())->saveCheckpoint(stream);
+}
+
+void SamplingIntegrator::loadCheckpoint(Stream *stream) {
+    m_checkpoint = stream;
+}
+
 void SamplingIntegrator::bindUsedResources(ParallelProcess *) const {
     /* Do nothing by default */
 }
@@ -137,9 +173,21 @@ void SamplingIntegrator::wakeup(ConfigurableObject *parent,
     /* Do nothing by default */
 }
 
+bool SamplingIntegrator::supportsSampleRanges() const {
+    return true;
+}
+
 void SamplingIntegrator::renderBlock(const Scene *scene,
         const Sensor *sensor, Sampler *sampler, ImageBlock *block,
         const bool &stop, const std::vector< TPoint2<uint8_t> > &points) const {
+    renderSampleRange(scene, sensor, sampler, block, stop, points,
+        0, sampler->getSampleCount());
+}
+
+void SamplingIntegrator::renderSampleRange(const Scene *scene,
+        const Sensor *sensor, Sampler *sampler, ImageBlock *block,
+        const bool &stop, const std::vector< TPoint2<uint8_t> > &points,
+        size_t sampleStart, size_t sampleEnd) const {
 
     Float diffScaleFactor = 1.0f /
         std::sqrt((Float) sampler->getSampleCount());
@@ -147,10 +195,15 @@ void SamplingIntegrator::renderBlock(const Scene *scene,
     bool needsApertureSample = sensor->needsApertureSample();
     bool needsTimeSample = sensor->needsTimeSample();
 
+    /* Primary rays are generated in batches of up to 'batchSize'
+       consecutive sample indices of a pixel */
+    const size_t batchSize = 64;
+    Point2 samplePos[batchSize], apertureSamples[batchSize];
+    Float timeSamples[batchSize];
+    RayDifferential sensorRays[batchSize];
+    Spectrum weights[batchSize];
+
     RadianceQueryRecord rRec(scene, sampler);
-    Point2 apertureSample(0.5f);
-    Float timeSample = 0.5f;
-    RayDifferential sensorRay;
 
     block->clear();
 
@@ -166,23 +219,40 @@ void SamplingIntegrator::renderBlock(const Scene *scene,
 
         sampler->generate(offset);
 
-        for (size_t j = 0; j<sampler->getSampleCount(); j++) {
-            rRec.newQuery(queryType, sensor->getMedium());
-            Point2 samplePos(Point2(offset) + Vector2(rRec.nextSample2D()));
-
-            if (needsApertureSample)
-                apertureSample = rRec.nextSample2D();
-            if (needsTimeSample)
-                timeSample = rRec.nextSample1D();
-
-            Spectrum spec = sensor->sampleRayDifferential(
-                sensorRay, samplePos, apertureSample, timeSample);
-
-            sensorRay.scaleDifferential(diffScaleFactor);
-
-            spec *= Li(sensorRay, rRec);
-            block->put(samplePos, spec, rRec.alpha);
-            sampler->advance();
+        for (size_t j = sampleStart; j<sampleEnd; j += batchSize) {
+            size_t count = std::min(batchSize, sampleEnd - j);
+
+            /* Draw the sensor samples of the whole batch */
+            sampler->setSampleIndex(j);
+            for (size_t k = 0; k<count; ++k) {
+                samplePos[k] = Point2(offset) + Vector2(rRec.nextSample2D());
+                if (needsApertureSample)
+                    apertureSamples[k] = rRec.nextSample2D();
+                if (needsTimeSample)
+                    timeSamples[k] = rRec.nextSample1D();
+                sampler->advance();
+            }
+
+            sensor->sampleRayDifferentials(count, samplePos,
+                needsApertureSample ? apertureSamples : NULL,
+                needsTimeSample ? timeSamples : NULL,
+                sensorRays, weights);
+
+            /* Rewind the sampler and skip the dimensions that were used
+               above, so that Li() sees the same sample dimensions as
+               with one sampleRayDifferential() call per sample */
+            sampler->setSampleIndex(j);
+            for (size_t k = 0; k<count; ++k) {
+                rRec.newQuery(queryType, sensor->getMedium());
+                sampler->skip(needsTimeSample ? 1 : 0,
+                    needsApertureSample ? 2 : 1);
+
+                sensorRays[k].scaleDifferential(diffScaleFactor);
+
+                Spectrum spec = weights[k] * Li(sensorRays[k], rRec);
+                block->put(samplePos[k], spec, rRec.alpha);
+                sampler->advance();
+            }
         }
     }
 }
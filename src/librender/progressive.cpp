@@ -0,0 +1,419 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/progressive.h>
+#include <mitsuba/render/renderproc.h>
+#include <mitsuba/core/plugin.h>
+
+/// The first pass renders at most this many pixels
+#define MTS_PROGRESSIVE_FIRST_PASS_PIXELS (64*64)
+
+MTS_NAMESPACE_BEGIN
+
+ProgressiveRenderer::ProgressiveRenderer() : Thread("prog"),
+        m_passIndex(0), m_generation(0), m_quit(false), m_paused(false),
+        m_frameSamples(0), m_targetSamples(0), m_frameIndex(-1), m_frameLevel(0) {
+    m_queue = new RenderQueue();
+    m_mutex = new Mutex();
+    m_cond = new ConditionVariable(m_mutex);
+    m_frameCond = new ConditionVariable(m_mutex);
+    m_state.sceneResID = -1;
+    m_state.levels = 0;
+    m_state.highQualityEdges = false;
+}
+
+ProgressiveRenderer::~ProgressiveRenderer() {
+}
+
+void ProgressiveRenderer::restart(Scene *scene,
+        SamplingIntegrator *integrator, int sceneResID) {
+    const Sensor *sensor = scene->getSensor();
+    const Film *film = sensor->getFilm();
+
+    State state;
+    state.scene = scene;
+    state.integrator = integrator;
+    state.sampler = scene->getSampler()->clone();
+    state.filter = const_cast<ReconstructionFilter *>(film->getReconstructionFilter());
+    state.medium = const_cast<Medium *>(sensor->getMedium());
+    state.sensorProps = sensor->getProperties();
+    state.filmSize = film->getSize();
+    state.cropSize = film->getCropSize();
+    state.cropOffset = film->getCropOffset();
+    state.highQualityEdges = film->hasHighQualityEdges();
+    state.sceneResID = sceneResID;
+
+    state.levels = 0;
+    while ((size_t) (state.cropSize.x >> state.levels) * (size_t) (state.cropSize.y
+            >> state.levels) > MTS_PROGRESSIVE_FIRST_PASS_PIXELS)
+        ++state.levels;
+
+    LockGuard lock(m_mutex);
+    m_state = state;
+    m_passIndex = 0;
+    m_generation++;
+    if (m_process)
+        Scheduler::getInstance()->cancel(m_process);
+    m_cond->broadcast();
+}
+
+void ProgressiveRenderer::reset() {
+    LockGuard lock(m_mutex);
+    m_state = State();
+    m_state.sceneResID = -1;
+    m_state.levels = 0;
+    m_state.highQualityEdges = false;
+    m_generation++;
+    if (m_process)
+        Scheduler::getInstance()->cancel(m_process);
+    m_cond->broadcast();
+}
+
+void ProgressiveRenderer::pause() {
+    LockGuard lock(m_mutex);
+    m_paused = true;
+    if (m_process)
+        Scheduler::getInstance()->cancel(m_process);
+}
+
+void ProgressiveRenderer::resume() {
+    LockGuard lock(m_mutex);
+    m_paused = false;
+    m_cond->broadcast();
+}
+
+bool ProgressiveRenderer::isPaused() const {
+    LockGuard lock(m_mutex);
+    return m_paused;
+}
+
+void ProgressiveRenderer::quit() {
+    LockGuard lock(m_mutex);
+    m_quit = true;
+    if (m_process)
+        Scheduler::getInstance()->cancel(m_process);
+    m_cond->broadcast();
+    m_frameCond->broadcast();
+}
+
+bool ProgressiveRenderer::getPass(const State &state, int index, Pass &pass) {
+    size_t sampleCount = state.sampler->getSampleCount();
+
+    if (!state.integrator->supportsSampleRanges()) {
+        /* The integrator needs all samples of a pixel at once (e.g.
+           'adaptive'), hence every pass renders the full sample count */
+        pass.level = state.levels - index;
+        pass.sampleStart = 0;
+        pass.sampleEnd = sampleCount;
+        return index <= state.levels;
+    }
+
+    if (index < state.levels) {
+        /* Low-resolution passes with one sample per pixel */
+        pass.level = state.levels - index;
+        pass.sampleStart = 0;
+        pass.sampleEnd = 1;
+        return true;
+    }
+
+    /* Full-resolution passes, which double the sample count */
+    index -= state.levels;
+    pass.level = 0;
+    pass.sampleStart = index == 0 ? 0 : ((size_t) 1 << (index - 1));
+    pass.sampleEnd = std::min((size_t) 1 << index, sampleCount);
+    return pass.sampleStart < sampleCount && index < 63;
+}
+
+ref<Sensor> ProgressiveRenderer::createSensor(State &state,
+        int level, Sampler *sampler) {
+    ref<PluginManager> pluginMgr = PluginManager::getInstance();
+
+    Vector2i filmSize(std::max(1, state.filmSize.x >> level),
+                      std::max(1, state.filmSize.y >> level));
+    Point2i cropOffset(state.cropOffset.x >> level, state.cropOffset.y >> level);
+    cropOffset.x = std::min(cropOffset.x, filmSize.x - 1);
+    cropOffset.y = std::min(cropOffset.y, filmSize.y - 1);
+    Vector2i cropSize(
+        std::max(1, std::min(state.cropSize.x >> level, filmSize.x - cropOffset.x)),
+        std::max(1, std::min(state.cropSize.y >> level, filmSize.y - cropOffset.y)));
+
+    Properties filmProps("hdrfilm");
+    filmProps.setInteger("width", filmSize.x);
+    filmProps.setInteger("height", filmSize.y);
+    filmProps.setInteger("cropOffsetX", cropOffset.x);
+    filmProps.setInteger("cropOffsetY", cropOffset.y);
+    filmProps.setInteger("cropWidth", cropSize.x);
+    filmProps.setInteger("cropHeight", cropSize.y);
+    filmProps.setBoolean("highQualityEdges", state.highQualityEdges);
+    filmProps.setBoolean("banner", false);
+    filmProps.setString("pixelFormat", "rgb");
+    filmProps.setString("componentFormat", "float32");
+
+    ref<Film> film = static_cast<Film *>(
+        pluginMgr->createObject(MTS_CLASS(Film), filmProps));
+
+    /* Don't bother with wide filters while the resolution is reduced */
+    if (level > 0) {
+        ref<ReconstructionFilter> filter = static_cast<ReconstructionFilter *>(
+            pluginMgr->createObject(MTS_CLASS(ReconstructionFilter), Properties("box")));
+        filter->configure();
+        film->addChild(filter);
+    } else {
+        film->addChild(state.filter);
+    }
+    film->configure();
+
+    ref<Sensor> sensor = static_cast<Sensor *>(
+        pluginMgr->createObject(MTS_CLASS(Sensor), state.sensorProps));
+    sensor->addChild(sampler);
+    sensor->addChild(film);
+    sensor->setMedium(state.medium);
+    sensor->configure();
+    return sensor;
+}
+
+ref<Bitmap> ProgressiveRenderer::renderPass(State &state,
+        const Pass &pass, int generation, int sceneResID, int integratorResID,
+        bool preprocess) {
+    ref<Scheduler> sched = Scheduler::getInstance();
+    ref<Sensor> sensor = createSensor(state, pass.level, state.sampler);
+    Film *film = sensor->getFilm();
+    film->clear();
+
+    /* Create a sampler instance for every core. Since the clones are
+       seeded by the shared instance, every pass gets new random numbers */
+    std::vector<SerializableObject *> samplers(sched->getCoreCount());
+    for (size_t i=0; i<samplers.size(); ++i) {
+        ref<Sampler> clonedSampler = state.sampler->clone();
+        clonedSampler->incRef();
+        samplers[i] = clonedSampler.get();
+    }
+    int samplerResID = sched->registerMultiResource(samplers);
+    for (size_t i=0; i<samplers.size(); ++i)
+        samplers[i]->decRef();
+    int sensorResID = sched->registerResource(sensor);
+
+    bool success = true;
+    if (preprocess)
+        success = state.integrator->preprocess(state.scene, m_queue, NULL,
+            sceneResID, sensorResID, samplerResID);
+
+    ref<BlockedRenderProcess> proc = new BlockedRenderProcess(NULL,
+        m_queue, state.scene->getBlockSize());
+    proc->setSampleSplitting(state.integrator->supportsSampleRanges());
+    if (pass.sampleStart != 0 || pass.sampleEnd != state.sampler->getSampleCount())
+        proc->setSampleRange(pass.sampleStart, pass.sampleEnd);
+    proc->bindResource("integrator", integratorResID);
+    proc->bindResource("scene", sceneResID);
+    proc->bindResource("sensor", sensorResID);
+    proc->bindResource("sampler", samplerResID);
+    state.scene->bindUsedResources(proc);
+    state.integrator->bindUsedResources(proc);
+
+    if (success) {
+        m_mutex->lock();
+        if (m_paused || m_quit || m_generation != generation)
+            success = false;
+        else
+            m_process = proc;
+        m_mutex->unlock();
+    }
+
+    if (success) {
+        sched->schedule(proc);
+        sched->wait(proc);
+
+        m_mutex->lock();
+        m_process = NULL;
+        m_mutex->unlock();
+        success = proc->getReturnStatus() == ParallelProcess::ESuccess;
+    }
+
+    sched->unregisterResource(sensorResID);
+    sched->unregisterResource(samplerResID);
+
+    if (!success)
+        return NULL;
+
+    ref<Bitmap> result = new Bitmap(Bitmap::ERGBA,
+        Bitmap::EFloat32, film->getCropSize());
+    film->develop(Point2i(0, 0), film->getCropSize(), Point2i(0, 0), result);
+    return result;
+}
+
+void ProgressiveRenderer::run() {
+    ref<Scheduler> sched = Scheduler::getInstance();
+    State state;
+    Pass pass;
+    int generation = -1, sceneResID = -1, integratorResID = -1;
+    bool ownsScene = false, preprocess = false;
+
+    m_mutex->lock();
+    while (true) {
+        while (!m_quit && m_generation == generation
+                && (m_paused || !state.scene || !getPass(state, m_passIndex, pass)))
+            m_cond->wait();
+        if (m_quit)
+            break;
+
+        if (m_generation != generation) {
+            /* The scene or camera changed: swap the scheduler resources */
+            m_mutex->unlock();
+            if (integratorResID != -1)
+                sched->unregisterResource(integratorResID);
+            if (ownsScene)
+                sched->unregisterResource(sceneResID);
+            sceneResID = integratorResID = -1;
+            ownsScene = false;
+            m_mutex->lock();
+
+            generation = m_generation;
+            state = m_state;
+            if (!state.scene)
+                continue;
+            m_targetSamples = state.sampler->getSampleCount();
+
+            m_mutex->unlock();
+            state.scene->initialize();
+            if (state.sceneResID == -1) {
+                sceneResID = sched->registerResource(state.scene);
+                ownsScene = true;
+            } else {
+                sceneResID = state.sceneResID;
+            }
+            integratorResID = sched->registerResource(state.integrator);
+            preprocess = true;
+            m_mutex->lock();
+            continue;
+        }
+
+        int passIndex = m_passIndex;
+        m_mutex->unlock();
+
+        ref<Bitmap> result;
+        bool failed = false;
+        try {
+            result = renderPass(state, pass, generation,
+                sceneResID, integratorResID, preprocess);
+        } catch (const std::exception &ex) {
+            Log(EWarn, "Progressive preview failed: %s", ex.what());
+            failed = true;
+        }
+
+        m_mutex->lock();
+        if (generation != m_generation)
+            continue;
+
+        if (failed) {
+            /* Don't try again until the next restart() */
+            m_passIndex = std::numeric_limits<int>::max();
+            continue;
+        } else if (!result) {
+            /* Cancelled by pause() -- repeat the pass later on */
+            continue;
+        }
+
+        preprocess = false;
+        if (pass.level > 0 || pass.sampleStart == 0) {
+            m_frame = result;
+        } else {
+            /* Blend the new samples with the ones of the previous passes */
+            ref<Bitmap> accumulated = m_frame->clone();
+            float *target = accumulated->getFloat32Data();
+            const float *source = result->getFloat32Data();
+            float weight = (float) (pass.sampleEnd - pass.sampleStart) / (float) pass.sampleEnd;
+            size_t count = accumulated->getPixelCount() * 4;
+            for (size_t i=0; i<count; ++i)
+                target[i] += (source[i] - target[i]) * weight;
+            m_frame = accumulated;
+        }
+        m_frameLevel = pass.level;
+        m_frameSamples = pass.sampleEnd;
+        m_frameIndex++;
+        m_passIndex = passIndex + 1;
+        m_frameCond->broadcast();
+    }
+    m_mutex->unlock();
+
+    if (integratorResID != -1)
+        sched->unregisterResource(integratorResID);
+    if (ownsScene)
+        sched->unregisterResource(sceneResID);
+}
+
+bool ProgressiveRenderer::develop(Bitmap *target, int &frame) const {
+    if (target->getPixelFormat() != Bitmap::ERGBA ||
+        target->getComponentFormat() != Bitmap::EFloat32)
+        Log(EError, "ProgressiveRenderer::develop(): the target bitmap "
+            "must be in RGBA/float32 format!");
+
+    LockGuard lock(m_mutex);
+    if (!m_frame || frame == m_frameIndex)
+        return false;
+
+    const Vector2i &size = m_frame->getSize(), &targetSize = target->getSize();
+    const float *source = m_frame->getFloat32Data();
+    float *dest = target->getFloat32Data();
+
+    if (size == targetSize) {
+        memcpy(dest, source, m_frame->getBufferSize());
+    } else {
+        /* Nearest-neighbor upsampling of a low-resolution frame */
+        std::vector<int> columns(targetSize.x);
+        for (int x=0; x<targetSize.x; ++x)
+            columns[x] = std::min(size.x - 1, (int) ((int64_t) x * size.x / targetSize.x)) * 4;
+
+        for (int y=0; y<targetSize.y; ++y) {
+            int sy = std::min(size.y - 1, (int) ((int64_t) y * size.y / targetSize.y));
+            const float *row = source + (size_t) sy * size.x * 4;
+            for (int x=0; x<targetSize.x; ++x) {
+                const float *pixel = row + columns[x];
+                *dest++ = pixel[0]; *dest++ = pixel[1];
+                *dest++ = pixel[2]; *dest++ = pixel[3];
+            }
+        }
+    }
+
+    frame = m_frameIndex;
+    return true;
+}
+
+bool ProgressiveRenderer::waitForFrame(int frame, int timeout) const {
+    LockGuard lock(m_mutex);
+    while (frame == m_frameIndex && !m_quit) {
+        if (timeout < 0)
+            m_frameCond->wait();
+        else if (!m_frameCond->wait(timeout))
+            return false;
+    }
+    return frame != m_frameIndex;
+}
+
+std::string ProgressiveRenderer::getStatus() const {
+    LockGuard lock(m_mutex);
+    if (m_frameIndex < 0)
+        return "";
+    else if (m_frameLevel > 0)
+        return formatString("1/%i resolution", 1 << m_frameLevel);
+    else
+        return formatString(SIZE_T_FMT "/" SIZE_T_FMT " samples per pixel",
+            m_frameSamples, m_targetSamples);
+}
+
+MTS_IMPLEMENT_CLASS(ProgressiveRenderer, false, Thread)
+MTS_NAMESPACE_END
@@ -28,6 +28,8 @@ void RectangularWorkUnit::set(const WorkUnit *wu) {
     const RectangularWorkUnit *rect = static_cast<const RectangularWorkUnit *>(wu);
     m_offset = rect->m_offset;
     m_size = rect->m_size;
+    m_sampleStart = rect->m_sampleStart;
+    m_sampleEnd = rect->m_sampleEnd;
 }
 
 void RectangularWorkUnit::load(Stream *stream) {
@@ -37,6 +39,8 @@ void RectangularWorkUnit::load(Stream *stream) {
     m_offset.y = data[1];
     m_size.x   = data[2];
     m_size.y   = data[3];
+    m_sampleStart = stream->readSize();
+    m_sampleEnd = stream->readSize();
 }
 
 void RectangularWorkUnit::save(Stream *stream) const {
@@ -46,12 +50,17 @@ void RectangularWorkUnit::save(Stream *stream) const {
     data[2] = m_size.x;
     data[3] = m_size.y;
     stream->writeIntArray(data, 4);
+    stream->writeSize(m_sampleStart);
+    stream->writeSize(m_sampleEnd);
 }
 
 std::string RectangularWorkUnit::toString() const {
     std::ostringstream oss;
     oss << "RectangularWorkUnit[offset=" << m_offset.toString()
-        << ", size=" << m_size.toString() << "]";
+        << ", size=" << m_size.toString();
+    if (hasSampleRange())
+        oss << ", samples=[" << m_sampleStart << ", " << m_sampleEnd << ")";
+    oss << "]";
     return oss.str();
 }
 
@@ -18,10 +18,112 @@
 
 #include <mitsuba/render/renderjob.h>
 #include <mitsuba/render/renderproc.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/mstream.h>
 #include <boost/filesystem.hpp>
 
 MTS_NAMESPACE_BEGIN
 
+/* Identifies checkpoint files ('MTCK') and their format version */
+static const uint32_t checkpointMagic = 0x4B43544D;
+static const uint32_t checkpointVersion = 1;
+
+/// Write the scene configuration that a checkpoint is only valid for
+static void writeCheckpointHeader(Stream *stream, const Scene *scene) {
+    const Film *film = scene->getFilm();
+    stream->writeUInt(checkpointMagic);
+    stream->writeUInt(checkpointVersion);
+    stream->writeString(scene->getIntegrator()->getClass()->getName());
+    film->getCropOffset().serialize(stream);
+    film->getCropSize().serialize(stream);
+    stream->writeUInt(scene->getBlockSize());
+    stream->writeSize(scene->getSampler()->getSampleCount());
+}
+
+/// Verify that a checkpoint file matches the configuration of \c scene
+static void readCheckpointHeader(Stream *stream, const Scene *scene,
+        const fs::path &filename) {
+    if (stream->readUInt() != checkpointMagic ||
+        stream->readUInt() != checkpointVersion)
+        SLog(EError, "\"%s\" is not a checkpoint file written by this version of Mitsuba!",
+            filename.string().c_str());
+
+    const Film *film = scene->getFilm();
+    std::string integratorName = stream->readString();
+    Point2i cropOffset(stream);
+    Vector2i cropSize(stream);
+    uint32_t blockSize = stream->readUInt();
+    size_t sampleCount = stream->readSize();
+
+    if (integratorName != scene->getIntegrator()->getClass()->getName() ||
+        cropOffset != film->getCropOffset() || cropSize != film->getCropSize() ||
+        blockSize != scene->getBlockSize() ||
+        sampleCount != scene->getSampler()->getSampleCount())
+        SLog(EError, "The checkpoint \"%s\" was written with a different integrator, "
+            "film, block size or sample count!", filename.string().c_str());
+}
+
+/**
+ * Background thread that periodically captures the state of a render
+ * job's integrator in memory and writes it to the checkpoint file
+ */
+class CheckpointWriter : public Thread {
+public:
+    CheckpointWriter(Scene *scene, const fs::path &filename, Float interval)
+        : Thread("ckpt"), m_scene(scene), m_filename(filename),
+          m_interval(interval), m_flag(new WaitFlag()) { }
+
+    void run() {
+        while (!m_flag->get()) {
+            m_flag->wait((int) (m_interval * 1000));
+            if (!m_flag->get())
+                write();
+        }
+    }
+
+    /// Stop the thread (a checkpoint that is being written is finished first)
+    void quit() {
+        m_flag->set(true);
+        join();
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~CheckpointWriter() { }
+
+    void write() {
+        try {
+            ref<Timer> timer = new Timer();
+            ref<MemoryStream> mstream = new MemoryStream();
+            writeCheckpointHeader(mstream, m_scene);
+            if (!m_scene->getIntegrator()->saveCheckpoint(mstream))
+                return;
+            unsigned int captureTime = timer->getMilliseconds();
+
+            /* Write to a temporary file first, so that the previous
+               checkpoint survives if the process is killed meanwhile */
+            fs::path tempFile = m_filename.string() + ".tmp";
+            ref<FileStream> fstream = new FileStream(tempFile, FileStream::ETruncWrite);
+            fstream->write(mstream->getData(), mstream->getSize());
+            fstream->close();
+            fs::rename(tempFile, m_filename);
+
+            Log(EInfo, "Wrote checkpoint \"%s\" (%s, captured in %i ms, took %i ms)",
+                m_filename.filename().string().c_str(),
+                memString(mstream->getSize()).c_str(), captureTime,
+                timer->getMilliseconds());
+        } catch (const std::exception &ex) {
+            Log(EWarn, "Could not write the checkpoint \"%s\": %s",
+                m_filename.string().c_str(), ex.what());
+        }
+    }
+private:
+    Scene *m_scene;
+    fs::path m_filename;
+    Float m_interval;
+    ref<WaitFlag> m_flag;
+};
+
 RenderJob::RenderJob(const std::string &threadName,
     Scene *scene, RenderQueue *queue, int sceneResID, int sensorResID,
     int samplerResID, bool threadIsCritical, bool interactive)
@@ -72,6 +174,15 @@ RenderJob::RenderJob(const std::string &threadName,
         m_ownsSamplerResource = false;
     }
     m_cancelled = false;
+    m_checkpointInterval = 0;
+    m_resume = false;
+    m_interrupted = false;
+}
+
+void RenderJob::setCheckpoint(const fs::path &filename, Float interval, bool resume) {
+    m_checkpointFile = filename;
+    m_checkpointInterval = interval;
+    m_resume = resume;
 }
 
 RenderJob::~RenderJob() {
@@ -87,6 +198,7 @@ RenderJob::~RenderJob() {
 void RenderJob::run() {
     ref<Film> film = m_scene->getFilm();
     ref<Sampler> sampler = m_scene->getSampler();
+    ref<CheckpointWriter> checkpointWriter;
     m_cancelled = false;
 
     try {
@@ -99,14 +211,37 @@ void RenderJob::run() {
                 m_scene->getSourceFile().filename().string().c_str());
         }
 
+        if (!m_cancelled && m_resume && fs::exists(m_checkpointFile)) {
+            Log(EInfo, "Resuming from checkpoint \"%s\" ..", m_checkpointFile.string().c_str());
+            ref<FileStream> stream = new FileStream(m_checkpointFile, FileStream::EReadOnly);
+            readCheckpointHeader(stream, m_scene, m_checkpointFile);
+            m_scene->getIntegrator()->loadCheckpoint(stream);
+        }
+
         if (!m_cancelled) {
+            if (m_checkpointInterval > 0) {
+                checkpointWriter = new CheckpointWriter(m_scene,
+                    m_checkpointFile, m_checkpointInterval);
+                checkpointWriter->start();
+            }
             if (!m_scene->render(m_queue, this, m_sceneResID, m_sensorResID, m_samplerResID)) {
                 m_cancelled = true;
                 Log(EWarn, "Rendering of scene \"%s\" did not complete successfully!",
                     m_scene->getSourceFile().filename().string().c_str());
             }
+            if (checkpointWriter) {
+                checkpointWriter->quit();
+                checkpointWriter = NULL;
+            }
             Log(EInfo, "Render time: %s", timeString(m_queue->getRenderTime(this), true).c_str());
             m_scene->postprocess(m_queue, this, m_sceneResID, m_sensorResID, m_samplerResID);
+
+            /* The checkpoint is obsolete once the image is done. Some
+               integrators (e.g. progressive ones) also succeed when they
+               are cancelled, but may be resumed later on */
+            if (!m_cancelled && !m_interrupted && !m_checkpointFile.empty()
+                    && fs::exists(m_checkpointFile))
+                fs::remove(m_checkpointFile);
         }
     } catch (const std::exception &ex) {
         Log(EWarn, "Rendering of scene \"%s\" did not complete successfully, caught exception: %s",
@@ -114,8 +249,12 @@ void RenderJob::run() {
         m_cancelled = true;
     }
 
+    if (checkpointWriter)
+        checkpointWriter->quit();
+
     m_queue->removeJob(this, m_cancelled);
 }
 
+MTS_IMPLEMENT_CLASS(CheckpointWriter, false, Thread)
 MTS_IMPLEMENT_CLASS(RenderJob, false, Thread)
 MTS_NAMESPACE_END
@@ -23,12 +23,55 @@
 
 MTS_NAMESPACE_BEGIN
 
+/// Core count that is assumed when splitting blocks in deterministic mode
+static const size_t deterministicCoreCount = 16;
+
+/**
+ * Image block that additionally records the first sample index of the
+ * work unit that produced it. Used to merge the parts of a block that
+ * was split into several sample ranges in a fixed order.
+ */
+class PartialImageBlock : public ImageBlock {
+public:
+    PartialImageBlock(Bitmap::EPixelFormat fmt, const Vector2i &size,
+        const ReconstructionFilter *filter, int channels, bool warn)
+        : ImageBlock(fmt, size, filter, channels, warn), m_sampleStart(0),
+          m_renderTime(0) { }
+
+    inline size_t getSampleStart() const { return m_sampleStart; }
+    inline void setSampleStart(size_t sampleStart) { m_sampleStart = sampleStart; }
+
+    /// Return the time in seconds that the worker spent on this part
+    inline Float getRenderTime() const { return m_renderTime; }
+    inline void setRenderTime(Float renderTime) { m_renderTime = renderTime; }
+
+    void load(Stream *stream) {
+        ImageBlock::load(stream);
+        m_sampleStart = stream->readSize();
+        m_renderTime = stream->readFloat();
+    }
+
+    void save(Stream *stream) const {
+        ImageBlock::save(stream);
+        stream->writeSize(m_sampleStart);
+        stream->writeFloat(m_renderTime);
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~PartialImageBlock() { }
+private:
+    size_t m_sampleStart;
+    Float m_renderTime;
+};
+
 class BlockRenderer : public WorkProcessor {
 public:
     BlockRenderer(Bitmap::EPixelFormat pixelFormat, int channelCount, int blockSize,
-        int borderSize, bool warnInvalid) : m_pixelFormat(pixelFormat),
-        m_channelCount(channelCount), m_blockSize(blockSize),
-        m_borderSize(borderSize), m_warnInvalid(warnInvalid) { }
+        int borderSize, bool warnInvalid, bool sampleSplitting)
+        : m_pixelFormat(pixelFormat), m_channelCount(channelCount),
+        m_blockSize(blockSize), m_borderSize(borderSize),
+        m_warnInvalid(warnInvalid), m_sampleSplitting(sampleSplitting) { }
 
     BlockRenderer(Stream *stream, InstanceManager *manager) {
         m_pixelFormat = (Bitmap::EPixelFormat) stream->readInt();
@@ -36,6 +79,7 @@ public:
         m_blockSize = stream->readInt();
         m_borderSize = stream->readInt();
         m_warnInvalid = stream->readBool();
+        m_sampleSplitting = stream->readBool();
     }
 
     ref<WorkUnit> createWorkUnit() const {
@@ -43,6 +87,11 @@ public:
     }
 
     ref<WorkResult> createWorkResult() const {
+        if (m_sampleSplitting)
+            return new PartialImageBlock(m_pixelFormat,
+                Vector2i(m_blockSize),
+                m_sensor->getFilm()->getReconstructionFilter(),
+                m_channelCount, m_warnInvalid);
         return new ImageBlock(m_pixelFormat,
             Vector2i(m_blockSize),
             m_sensor->getFilm()->getReconstructionFilter(),
@@ -63,6 +112,7 @@ public:
         m_integrator->wakeup(m_scene, m_resources);
         m_scene->wakeup(m_scene, m_resources);
         m_scene->initializeBidirectional();
+        m_timer = new Timer();
     }
 
     void process(const WorkUnit *workUnit, WorkResult *workResult,
@@ -77,8 +127,20 @@ public:
         block->setOffset(rect->getOffset());
         block->setSize(rect->getSize());
         m_hilbertCurve.initialize(TVector2<uint8_t>(rect->getSize()));
-        m_integrator->renderBlock(m_scene, m_sensor, m_sampler,
-            block, stop, m_hilbertCurve.getPoints());
+        if (rect->hasSampleRange()) {
+            m_timer->reset();
+            m_integrator->renderSampleRange(m_scene, m_sensor, m_sampler,
+                block, stop, m_hilbertCurve.getPoints(),
+                rect->getSampleStart(), rect->getSampleEnd());
+            if (m_sampleSplitting) {
+                PartialImageBlock *part = static_cast<PartialImageBlock *>(block);
+                part->setSampleStart(rect->getSampleStart());
+                part->setRenderTime(m_timer->getSeconds());
+            }
+        } else {
+            m_integrator->renderBlock(m_scene, m_sensor, m_sampler,
+                block, stop, m_hilbertCurve.getPoints());
+        }
 
 #ifdef MTS_DEBUG_FP
         disableFPExceptions();
@@ -91,11 +153,12 @@ public:
         stream->writeInt(m_blockSize);
         stream->writeInt(m_borderSize);
         stream->writeBool(m_warnInvalid);
+        stream->writeBool(m_sampleSplitting);
     }
 
     ref<WorkProcessor> clone() const {
         return new BlockRenderer(m_pixelFormat, m_channelCount,
-            m_blockSize, m_borderSize, m_warnInvalid);
+            m_blockSize, m_borderSize, m_warnInvalid, m_sampleSplitting);
     }
 
     MTS_DECLARE_CLASS()
@@ -106,21 +169,32 @@ private:
     ref<Sensor> m_sensor;
     ref<Sampler> m_sampler;
     ref<SamplingIntegrator> m_integrator;
+    ref<Timer> m_timer;
     Bitmap::EPixelFormat m_pixelFormat;
     int m_channelCount;
     int m_blockSize;
     int m_borderSize;
     bool m_warnInvalid;
+    bool m_sampleSplitting;
     HilbertCurve2D<uint8_t> m_hilbertCurve;
 };
 
 BlockedRenderProcess::BlockedRenderProcess(const RenderJob *parent, RenderQueue *queue,
-        int blockSize) : m_queue(queue), m_parent(parent), m_resultCount(0), m_progress(NULL) {
+        int blockSize) : m_queue(queue), m_parent(parent), m_progress(NULL) {
     m_blockSize = blockSize;
     m_resultMutex = new Mutex();
     m_pixelFormat = Bitmap::ESpectrumAlphaWeight;
     m_channelCount = -1;
     m_warnInvalid = true;
+    m_sampleSplitting = false;
+    m_sampleCount = 0;
+    m_sampleStart = 0;
+    m_sampleEnd = std::numeric_limits<size_t>::max();
+    m_sampleParts = 0;
+    m_currentPart = 0;
+    m_deterministic = false;
+    m_blocksIssued = m_blocksWritten = 0;
+    m_cancelled = false;
 }
 
 BlockedRenderProcess::~BlockedRenderProcess() {
@@ -134,25 +208,197 @@ void BlockedRenderProcess::setPixelFormat(Bitmap::EPixelFormat pixelFormat, int
     m_warnInvalid = warnInvalid;
 }
 
+void BlockedRenderProcess::setSampleSplitting(bool enabled) {
+    m_sampleSplitting = enabled;
+}
+
+void BlockedRenderProcess::setSampleRange(size_t start, size_t end) {
+    m_sampleStart = start;
+    m_sampleEnd = end;
+}
+
 ref<WorkProcessor> BlockedRenderProcess::createWorkProcessor() const {
     return new BlockRenderer(m_pixelFormat, m_channelCount,
-            m_blockSize, m_borderSize, m_warnInvalid);
+            m_blockSize, m_borderSize, m_warnInvalid, m_sampleSplitting);
 }
 
 void BlockedRenderProcess::processResult(const WorkResult *result, bool cancelled) {
     const ImageBlock *block = static_cast<const ImageBlock *>(result);
     UniqueLock lock(m_resultMutex);
-    m_film->put(block);
-    m_progress->update(++m_resultCount);
+    std::vector<FinishedBlock> written;
+    if (m_sampleParts > 1) {
+        /* Buffer the part until all sample ranges of the block are
+           done, then accumulate them in the order of their ranges */
+        const PartialImageBlock *part = static_cast<const PartialImageBlock *>(block);
+        int key = (block->getOffset().y - m_offset.y) * m_size.x
+            + (block->getOffset().x - m_offset.x);
+        PartialBlock &partial = m_partialBlocks[key];
+        partial.parts[part->getSampleStart()] = block->clone();
+        partial.renderTime += part->getRenderTime();
+
+        if (cancelled) {
+            /* Parts that were never handed out won't arrive anymore --
+               write everything that has been rendered so far */
+            for (std::map<int, PartialBlock>::iterator it = m_partialBlocks.begin();
+                    it != m_partialBlocks.end(); ++it)
+                flushBlock(it->second, cancelled, written);
+            m_partialBlocks.clear();
+        } else if ((int) partial.parts.size() == m_sampleParts) {
+            flushBlock(partial, cancelled, written);
+            m_partialBlocks.erase(key);
+        }
+    } else if (m_deterministic) {
+        m_progress->update(blockFinished(block->getOffset(), block->getSize()));
+        putBlock(block->clone(), cancelled, written);
+    } else {
+        writeBlock(block, cancelled);
+        m_progress->update(blockFinished(block->getOffset(), block->getSize()));
+        lock.unlock();
+        m_queue->signalWorkEnd(m_parent, block, cancelled);
+        return;
+    }
     lock.unlock();
-    m_queue->signalWorkEnd(m_parent, block, cancelled);
+
+    for (size_t i=0; i<written.size(); ++i)
+        m_queue->signalWorkEnd(m_parent, written[i].block, written[i].cancelled);
+}
+
+void BlockedRenderProcess::flushBlock(PartialBlock &partial, bool cancelled,
+        std::vector<FinishedBlock> &written) {
+    std::map<size_t, ref<ImageBlock> >::iterator it = partial.parts.begin();
+    ref<ImageBlock> block = it->second;
+    for (++it; it != partial.parts.end(); ++it)
+        block->put(it->second.get());
+    m_progress->update(blockFinished(block->getOffset(),
+        block->getSize(), partial.renderTime));
+    putBlock(block, cancelled, written);
+}
+
+void BlockedRenderProcess::putBlock(ImageBlock *block, bool cancelled,
+        std::vector<FinishedBlock> &written) {
+    FinishedBlock finished;
+    finished.block = block;
+    finished.cancelled = cancelled;
+
+    if (!m_deterministic) {
+        writeBlock(block, cancelled);
+        written.push_back(finished);
+        return;
+    }
+
+    /* Neighboring blocks overlap by the reconstruction filter radius. To
+       accumulate the overlapping regions in a fixed order, write the blocks
+       in the order in which they were handed out */
+    int key = (block->getOffset().y - m_offset.y) * m_size.x
+        + (block->getOffset().x - m_offset.x);
+    std::map<int, int>::iterator order = m_blockOrder.find(key);
+    Assert(order != m_blockOrder.end());
+    m_finishedBlocks[order->second] = finished;
+    m_blockOrder.erase(order);
+
+    /* After a cancellation, some blocks will never arrive */
+    std::map<int, FinishedBlock>::iterator it = m_finishedBlocks.begin();
+    while (it != m_finishedBlocks.end() && (cancelled || it->first == m_blocksWritten)) {
+        writeBlock(it->second.block, cancelled);
+        written.push_back(it->second);
+        m_blocksWritten = it->first + 1;
+        m_finishedBlocks.erase(it++);
+    }
+}
+
+void BlockedRenderProcess::writeBlock(const ImageBlock *block, bool cancelled) {
+    m_film->put(block);
+    if (cancelled)
+        m_cancelled = true;
+    else
+        m_writtenRegions.push_back(std::make_pair(block->getOffset(), block->getSize()));
+}
+
+bool BlockedRenderProcess::saveCheckpoint(Stream *stream) {
+    LockGuard lock(m_resultMutex);
+    if (m_cancelled)
+        return false;
+    stream->writeSize(m_writtenRegions.size());
+    for (size_t i=0; i<m_writtenRegions.size(); ++i) {
+        m_writtenRegions[i].first.serialize(stream);
+        m_writtenRegions[i].second.serialize(stream);
+    }
+    m_film->saveState(stream);
+    return true;
+}
+
+void BlockedRenderProcess::loadCheckpoint(Stream *stream) {
+    LockGuard lock(m_resultMutex);
+    size_t regionCount = stream->readSize(), pixelsDone = 0;
+    m_writtenRegions.resize(regionCount);
+    for (size_t i=0; i<regionCount; ++i) {
+        Point2i offset(stream);
+        Vector2i size(stream);
+        m_writtenRegions[i] = std::make_pair(offset, size);
+        pixelsDone = skipRegion(offset, size);
+    }
+    m_film->loadState(stream);
+    m_progress->update((long long) pixelsDone);
+    Log(EInfo, "Resuming with " SIZE_T_FMT " of " SIZE_T_FMT " pixels done",
+        pixelsDone, getPixelCount());
+}
+
+void BlockedRenderProcess::recordOrder(const Point2i &offset) {
+    if (!m_deterministic)
+        return;
+    LockGuard lock(m_resultMutex);
+    int key = (offset.y - m_offset.y) * m_size.x + (offset.x - m_offset.x);
+    m_blockOrder[key] = m_blocksIssued++;
 }
 
 ParallelProcess::EStatus BlockedRenderProcess::generateWork(WorkUnit *unit, int worker) {
-    EStatus status = BlockedImageProcess::generateWork(unit, worker);
-    if (status == ESuccess)
-        m_queue->signalWorkBegin(m_parent, static_cast<RectangularWorkUnit *>(unit), worker);
-    return status;
+    RectangularWorkUnit *rect = static_cast<RectangularWorkUnit *>(unit);
+    bool hasRange = m_sampleEnd != std::numeric_limits<size_t>::max();
+    size_t sampleEnd = std::min(m_sampleEnd, m_sampleCount),
+           sampleStart = std::min(m_sampleStart, sampleEnd),
+           sampleCount = sampleEnd - sampleStart;
+
+    if (m_sampleSplitting && m_sampleParts == 0) {
+        /* Aim for at least four work units per core. In deterministic mode,
+           the sample ranges must not depend on the machine */
+        size_t coreCount = m_deterministic ? deterministicCoreCount : m_coreCount;
+        size_t parts = (4 * coreCount + m_numBlocksTotal - 1) / m_numBlocksTotal;
+        m_sampleParts = (int) std::max((size_t) 1, std::min(parts, sampleCount));
+        m_unitsPerBlock = (size_t) m_sampleParts;
+        if (m_sampleParts > 1)
+            Log(EInfo, "Rendering each of the %i blocks in %i sample ranges",
+                m_numBlocksTotal, m_sampleParts);
+    }
+
+    if (m_sampleParts <= 1) {
+        EStatus status = BlockedImageProcess::generateWork(unit, worker);
+        if (status == ESuccess) {
+            if (hasRange)
+                rect->setSampleRange(sampleStart, sampleEnd);
+            recordOrder(rect->getOffset());
+            m_queue->signalWorkBegin(m_parent, rect, worker);
+        }
+        return status;
+    }
+
+    if (m_currentPart == 0) {
+        EStatus status = BlockedImageProcess::generateWork(unit, worker);
+        if (status != ESuccess)
+            return status;
+        recordOrder(rect->getOffset());
+        m_currentOffset = rect->getOffset();
+        m_currentSize = rect->getSize();
+    } else {
+        rect->setOffset(m_currentOffset);
+        rect->setSize(m_currentSize);
+    }
+
+    size_t start = sampleStart + sampleCount * m_currentPart / m_sampleParts,
+           end = sampleStart + sampleCount * (m_currentPart + 1) / m_sampleParts;
+    rect->setSampleRange(start, end);
+    m_currentPart = (m_currentPart + 1) % m_sampleParts;
+    m_queue->signalWorkBegin(m_parent, rect, worker);
+    return ESuccess;
 }
 
 void BlockedRenderProcess::bindResource(const std::string &name, int id) {
@@ -173,14 +419,25 @@ void BlockedRenderProcess::bindResource(const std::string &name, int id) {
         if (m_blockSize < m_borderSize)
             Log(EError, "The block size must be larger than the image reconstruction filter radius!");
 
-        BlockedImageProcess::init(offset, size, m_blockSize);
+        BlockedImageProcess::init(offset, size, m_blockSize, !m_deterministic);
         if (m_progress)
             delete m_progress;
-        m_progress = new ProgressReporter("Rendering", m_numBlocksTotal, m_parent);
+        m_progress = new ProgressReporter("Rendering", (long long) getPixelCount(), m_parent);
+    } else if (name == "sampler") {
+        const Sampler *sampler = static_cast<const Sampler *>(
+            Scheduler::getInstance()->getResource(id, 0));
+        m_sampleCount = sampler->getSampleCount();
+        m_deterministic = sampler->isDeterministic();
+
+        /* Blocks that are split based on their measured cost would
+           make the image depend on the scheduling */
+        if (m_deterministic)
+            m_adaptive = false;
     }
     BlockedImageProcess::bindResource(name, id);
 }
 
 MTS_IMPLEMENT_CLASS(BlockedRenderProcess, false, BlockedImageProcess)
 MTS_IMPLEMENT_CLASS_S(BlockRenderer, false, WorkProcessor)
+MTS_IMPLEMENT_CLASS(PartialImageBlock, false, ImageBlock)
 MTS_NAMESPACE_END
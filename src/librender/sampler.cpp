@@ -21,11 +21,16 @@
 MTS_NAMESPACE_BEGIN
 
 Sampler::Sampler(const Properties &props)
- : ConfigurableObject(props), m_sampleCount(0), m_sampleIndex(0) { }
+ : ConfigurableObject(props), m_sampleCount(0), m_sampleIndex(0),
+   m_pixelKey(0), m_sampleKey(0), m_keyCounter(0) {
+    m_deterministic = props.getBoolean("deterministic", false);
+}
 
 Sampler::Sampler(Stream *stream, InstanceManager *manager)
- : ConfigurableObject(stream, manager) {
+ : ConfigurableObject(stream, manager), m_pixelKey(0), m_sampleKey(0),
+   m_keyCounter(0) {
     m_sampleCount = stream->readSize();
+    m_deterministic = stream->readBool();
     size_t n1DArrays = stream->readSize();
     for (size_t i=0; i<n1DArrays; ++i)
         request1DArray(stream->readSize());
@@ -38,6 +43,7 @@ void Sampler::serialize(Stream *stream, InstanceManager *manager) const {
     ConfigurableObject::serialize(stream, manager);
 
     stream->writeSize(m_sampleCount);
+    stream->writeBool(m_deterministic);
     stream->writeSize(m_req1D.size());
     for (size_t i=0; i<m_req1D.size(); ++i)
         stream->writeSize(m_req1D[i]);
@@ -48,14 +54,26 @@ void Sampler::serialize(Stream *stream, InstanceManager *manager) const {
 
 void Sampler::setFilmResolution(const Vector2i &, bool) { }
 
-void Sampler::generate(const Point2i &) {
+void Sampler::generate(const Point2i &offset) {
     m_sampleIndex = 0;
     m_dimension1DArray = m_dimension2DArray = 0;
+    if (m_deterministic) {
+        setPixelKey(offset);
+        setSampleKey();
+    }
 }
 
 void Sampler::advance() {
     m_sampleIndex++;
     m_dimension1DArray = m_dimension2DArray = 0;
+    if (m_deterministic)
+        setSampleKey();
+}
+
+void Sampler::setPixelKey(const Point2i &offset) {
+    uint64_t key = sampleTEA((uint32_t) offset.x, (uint32_t) offset.y, 8);
+    m_pixelKey = (uint32_t) sampleTEA((uint32_t) key,
+        (uint32_t) (key >> 32), 8);
 }
 
 ref<Sampler> Sampler::clone() {
@@ -67,6 +85,15 @@ ref<Sampler> Sampler::clone() {
 void Sampler::setSampleIndex(size_t sampleIndex) {
     m_sampleIndex = sampleIndex;
     m_dimension1DArray = m_dimension2DArray = 0;
+    if (m_deterministic)
+        setSampleKey();
+}
+
+void Sampler::skip(size_t count1D, size_t count2D) {
+    for (size_t i=0; i<count2D; ++i)
+        next2D();
+    for (size_t i=0; i<count1D; ++i)
+        next1D();
 }
 
 void Sampler::request1DArray(size_t size) {
@@ -456,7 +456,7 @@ void Scene::cancel() {
 }
 
 void Scene::flush(RenderQueue *queue, const RenderJob *job) {
-    m_sensor->getFilm()->develop(this, queue->getRenderTime(job));
+    m_sensor->getFilm()->developAsync(this, queue->getRenderTime(job));
 }
 
 void Scene::setDestinationFile(const fs::path &name) {
@@ -618,6 +618,13 @@ static StatsCounter mediumInconsistencies("General", "Detected medium inconsiste
 
 Spectrum Scene::evalTransmittance(const Point &p1, bool p1OnSurface, const Point &p2, bool p2OnSurface,
         Float time, const Medium *medium, int &interactions, Sampler *sampler) const {
+    return evalTransmittanceImpl(p1, p1OnSurface, p2, p2OnSurface,
+        time, medium, interactions, sampler, false);
+}
+
+Spectrum Scene::evalTransmittanceImpl(const Point &p1, bool p1OnSurface, const Point &p2, bool p2OnSurface,
+        Float time, const Medium *medium, int &interactions, Sampler *sampler,
+        bool specialShapes) const {
     Vector d = p2 - p1;
     Float remaining = d.length();
     d /= remaining;
@@ -629,48 +636,130 @@ Spectrum Scene::evalTransmittance(const Point &p1, bool p1OnSurface, const Point
     int maxInteractions = interactions;
     interactions = 0;
 
-    while (remaining > 0) {
-        Normal n;
-        bool surface = rayIntersect(ray, its.t, its.shape, its.geoFrame.n, its.uv);
+    ShapeKDTree::SurfaceHit hits[MTS_KD_MAX_HITS];
+    uint8_t buffer[MTS_KD_INTERSECTION_TEMP];
 
-        if (surface && (interactions == maxInteractions ||
-            !(its.getBSDF()->getType() & BSDF::ENull))) {
+    while (remaining > 0) {
+        /* Find the surfaces along the segment using a single traversal */
+        int hitCount;
+        bool complete;
+        if (!m_kdtree->rayIntersectMulti(ray, hits, hitCount, complete)) {
             /* Encountered an occluder -- zero transmittance. */
             return Spectrum(0.0f);
         }
 
-        if (medium)
-            transmittance *= medium->evalTransmittance(
-                Ray(ray, 0, std::min(its.t, remaining)), sampler);
+        /* The shapes outside of the kd-tree are handled like shapes
+           that can be intersected multiple times (see rayIntersectMulti) */
+        ConstShapePtr specialShape = NULL;
+        Normal specialN;
+        Point2 specialUV;
+        Float specialT = 0;
+        if (specialShapes && !m_specialShapes.empty()) {
+            Float mint = ray.mint, maxt = complete ? ray.maxt : hits[hitCount-1].t;
+            if (mint == Epsilon)
+                mint *= std::max(std::max(std::max(std::abs(ray.o.x),
+                    std::abs(ray.o.y)), std::abs(ray.o.z)), Epsilon);
+
+            for (size_t i=0; i<m_specialShapes.size(); ++i) {
+                const Shape *shape = m_specialShapes[i].get();
+                Float t;
+                if (shape->rayIntersect(ray, mint, maxt, t, buffer)) {
+                    Intersection temp;
+                    temp.t = t;
+                    shape->fillIntersectionRecord(ray, buffer, temp);
+                    maxt = specialT = t;
+                    specialShape = shape;
+                    specialN = temp.geoFrame.n;
+                    specialUV = temp.uv;
+                }
+            }
 
-        if (!surface || transmittance.isZero())
-            break;
+            if (specialShape) {
+                while (hitCount > 0 && hits[hitCount-1].t > specialT)
+                    --hitCount;
+                complete = false;
+            }
+        }
 
-        const BSDF *bsdf = its.getBSDF();
+        /* Process the surfaces in order. The medium transmittance is
+           only evaluated when the medium actually changes */
+        int surfaceCount = hitCount + (specialShape ? 1 : 0);
+        Float segmentStart = 0, minT = 0, lastT = 0;
+        for (int i=0; i<surfaceCount; ++i) {
+            if (i < hitCount) {
+                its.t = hits[i].t;
+                m_kdtree->getSurfaceHitInfo(ray, hits[i], its.shape,
+                    its.geoFrame.n, its.uv);
+            } else {
+                its.t = specialT;
+                its.shape = specialShape;
+                its.geoFrame.n = specialN;
+                its.uv = specialUV;
+            }
+            lastT = its.t;
 
-        its.p = ray.o;
-        its.geoFrame = Frame(its.geoFrame.n);
-        its.hasUVPartials = false;
-        Vector wo = its.geoFrame.toLocal(ray.d);
-        BSDFSamplingRecord bRec(its, -wo, wo, ERadiance);
-        bRec.typeMask = BSDF::ENull;
-        transmittance *= bsdf->eval(bRec, EDiscrete);
+            /* Skip surfaces that would have been excluded by the ray
+               epsilon when tracing a new ray from the previous surface */
+            if (its.t < minT)
+                continue;
 
-        if (its.isMediumTransition()) {
-            if (medium != its.getTargetMedium(-d)) {
-                ++mediumInconsistencies;
+            if (interactions == maxInteractions ||
+                !(its.getBSDF()->getType() & BSDF::ENull)) {
+                /* Encountered an occluder -- zero transmittance. */
                 return Spectrum(0.0f);
             }
-            medium = its.getTargetMedium(d);
+
+            const BSDF *bsdf = its.getBSDF();
+
+            its.p = ray(its.t);
+            its.geoFrame = Frame(its.geoFrame.n);
+            its.hasUVPartials = false;
+            Vector wo = its.geoFrame.toLocal(ray.d);
+            BSDFSamplingRecord bRec(its, -wo, wo, ERadiance);
+            bRec.typeMask = BSDF::ENull;
+            transmittance *= bsdf->eval(bRec, EDiscrete);
+
+            if (its.isMediumTransition()) {
+                if (medium != its.getTargetMedium(-d)) {
+                    ++mediumInconsistencies;
+                    return Spectrum(0.0f);
+                }
+                if (medium)
+                    transmittance *= medium->evalTransmittance(
+                        Ray(ray, segmentStart, its.t), sampler);
+                segmentStart = its.t;
+                medium = its.getTargetMedium(d);
+            }
+
+            if (transmittance.isZero())
+                return Spectrum(0.0f);
+
+            if (++interactions > 100) { /// Just a precaution..
+                Log(EWarn, "evalTransmittance(): round-off error issues?");
+                return transmittance;
+            }
+
+            minT = its.t + Epsilon * std::max(std::max(std::abs(its.p.x),
+                std::abs(its.p.y)), std::abs(its.p.z));
         }
 
-        if (++interactions > 100) { /// Just a precaution..
-            Log(EWarn, "evalTransmittance(): round-off error issues?");
+        if (complete) {
+            if (medium)
+                transmittance *= medium->evalTransmittance(
+                    Ray(ray, segmentStart, remaining), sampler);
             break;
         }
 
-        ray.o = ray(its.t);
-        remaining -= its.t;
+        /* Continue with a new query behind the last reported surface */
+        if (medium) {
+            transmittance *= medium->evalTransmittance(
+                Ray(ray, segmentStart, lastT), sampler);
+            if (transmittance.isZero())
+                break;
+        }
+
+        ray.o = ray(lastT);
+        remaining -= lastT;
         ray.maxt = remaining * lengthFactor;
         ray.mint = Epsilon;
     }
@@ -761,64 +850,8 @@ bool Scene::rayIntersectAll(const Ray &ray, Intersection &its) const {
 
 Spectrum Scene::evalTransmittanceAll(const Point &p1, bool p1OnSurface, const Point &p2, bool p2OnSurface,
         Float time, const Medium *medium, int &interactions, Sampler *sampler) const {
-    Vector d = p2 - p1;
-    Float remaining = d.length();
-    d /= remaining;
-
-    Float lengthFactor = p2OnSurface ? (1-ShadowEpsilon) : 1;
-    Ray ray(p1, d, p1OnSurface ? Epsilon : 0, remaining * lengthFactor, time);
-    Spectrum transmittance(1.0f);
-    Intersection its;
-    int maxInteractions = interactions;
-    interactions = 0;
-
-    while (remaining > 0) {
-        Normal n;
-        bool surface = rayIntersectAll(ray, its.t, its.shape, its.geoFrame.n, its.uv);
-
-        if (surface && (interactions == maxInteractions ||
-            !(its.getBSDF()->getType() & BSDF::ENull))) {
-            /* Encountered an occluder -- zero transmittance. */
-            return Spectrum(0.0f);
-        }
-
-        if (medium)
-            transmittance *= medium->evalTransmittance(
-                Ray(ray, 0, std::min(its.t, remaining)), sampler);
-
-        if (!surface || transmittance.isZero())
-            break;
-
-        const BSDF *bsdf = its.getBSDF();
-
-        its.p = ray.o;
-        its.geoFrame = Frame(its.geoFrame.n);
-        its.hasUVPartials = false;
-        Vector wo = its.geoFrame.toLocal(ray.d);
-        BSDFSamplingRecord bRec(its, -wo, wo, ERadiance);
-        bRec.typeMask = BSDF::ENull;
-        transmittance *= bsdf->eval(bRec, EDiscrete);
-
-        if (its.isMediumTransition()) {
-            if (medium != its.getTargetMedium(-d)) {
-                ++mediumInconsistencies;
-                return Spectrum(0.0f);
-            }
-            medium = its.getTargetMedium(d);
-        }
-
-        if (++interactions > 100) { /// Just a precaution..
-            Log(EWarn, "evalTransmittanceAll(): round-off error issues?");
-            break;
-        }
-
-        ray.o = ray(its.t);
-        remaining -= its.t;
-        ray.maxt = remaining * lengthFactor;
-        ray.mint = Epsilon;
-    }
-
-    return transmittance;
+    return evalTransmittanceImpl(p1, p1OnSurface, p2, p2OnSurface,
+        time, medium, interactions, sampler, true);
 }
 
 // ===========================================================================
@@ -30,6 +30,7 @@
 #include <xercesc/sax/Locator.hpp>
 #include <mitsuba/render/scenehandler.h>
 #include <mitsuba/core/fresolver.h>
+#include <mitsuba/core/fstream.h>
 #include <mitsuba/render/scene.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/unordered_set.hpp>
@@ -49,9 +50,33 @@ typedef void (*CleanupFun) ();
 typedef boost::unordered_set<CleanupFun> CleanupSet;
 static PrimitiveThreadLocal<CleanupSet> __cleanup_tls;
 
+/**
+ * Placeholder that stands in for a scene object while the scene is
+ * recorded into a binary scene file. It only remembers the index of the
+ * record that will create the actual object at load time.
+ */
+class RecordedObject : public ConfigurableObject {
+public:
+    RecordedObject(uint32_t index)
+        : ConfigurableObject(Properties()), m_index(index) { }
+
+    inline uint32_t getIndex() const { return m_index; }
+
+    void addChild(const std::string &name, ConfigurableObject *child) {
+        Log(EError, "Internal error: cannot attach children to a recorded object");
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~RecordedObject() { }
+private:
+    uint32_t m_index;
+};
+
 SceneHandler::SceneHandler(const ParameterMap &params,
     NamedObjectMap *namedObjects, bool isIncludedFile) : m_params(params),
-        m_namedObjects(namedObjects), m_isIncludedFile(isIncludedFile) {
+        m_namedObjects(namedObjects), m_isIncludedFile(isIncludedFile),
+        m_writer(NULL) {
     m_pluginManager = PluginManager::getInstance();
     m_locator = NULL;
 
@@ -162,14 +187,9 @@ void SceneHandler::startDocument() {
 }
 
 void SceneHandler::endDocument() {
-    SAssert(m_scene != NULL);
+    SAssert(m_scene != NULL || m_recordedScene != NULL);
 
-    /* Call cleanup handlers */
-    CleanupSet &cleanup = __cleanup_tls.get();
-    for (CleanupSet::iterator it = cleanup.begin();
-            it != cleanup.end(); ++it)
-        (*it)();
-    cleanup.clear();
+    runSceneCleanupHandlers();
 }
 
 void SceneHandler::characters(const XMLCh* const name,
@@ -270,6 +290,102 @@ void pushSceneCleanupHandler(void (*cleanup)()) {
     __cleanup_tls.get().insert(cleanup);
 }
 
+void runSceneCleanupHandlers() {
+    CleanupSet &cleanup = __cleanup_tls.get();
+    for (CleanupSet::iterator it = cleanup.begin();
+            it != cleanup.end(); ++it)
+        (*it)();
+    cleanup.clear();
+}
+
+ref<ConfigurableObject> SceneHandler::createObject(const Class *type,
+        Properties &props, ChildList &children, bool configure) {
+    PluginManager *pluginManager = PluginManager::getInstance();
+    ref<ConfigurableObject> object;
+
+    if (type == MTS_CLASS(Scene)) {
+        object = new Scene(props);
+    } else if (type == MTS_CLASS(Shape)
+        && props.hasProperty("toWorld")
+        && props.getType("toWorld") == Properties::EAnimatedTransform
+        && (props.getPluginName() != "instance" && props.getPluginName() != "disk")) {
+        /* Convenience hack: allow passing animated transforms to arbitrary shapes
+           and then internally rewrite this into a shape group + animated instance */
+        /* (The 'disk' plugin also directly supports animated transformations, so
+            the instancing trick isn't required for it) */
+
+        ref<const AnimatedTransform> trafo = props.getAnimatedTransform("toWorld");
+        props.removeProperty("toWorld");
+
+        if (trafo->isStatic())
+            props.setTransform("toWorld", trafo->eval(0));
+
+        object = pluginManager->createObject(type, props);
+
+        if (!trafo->isStatic()) {
+            /* If the object has children, append them */
+            for (ChildList::iterator it = children.begin();
+                    it != children.end(); ++it) {
+                if (it->second != NULL) {
+                    object->addChild(it->first, it->second);
+                    it->second->setParent(object);
+                    it->second->decRef();
+                }
+            }
+            children.clear();
+
+            object->configure();
+
+            ref<Shape> shapeGroup = static_cast<Shape *> (
+                pluginManager->createObject(MTS_CLASS(Shape), Properties("shapegroup")));
+            shapeGroup->addChild(object);
+            shapeGroup->configure();
+
+            Properties instanceProps("instance");
+            instanceProps.setAnimatedTransform("toWorld", trafo);
+            object = pluginManager->createObject(instanceProps);
+            object->addChild(shapeGroup);
+        }
+    } else {
+        object = pluginManager->createObject(type, props);
+    }
+
+    /* If the object has children, append them */
+    for (ChildList::iterator it = children.begin();
+            it != children.end(); ++it) {
+        if (it->second != NULL) {
+            object->addChild(it->first, it->second);
+            it->second->setParent(object);
+            it->second->decRef();
+        }
+    }
+    children.clear();
+
+    if (configure)
+        object->configure();
+
+    return object;
+}
+
+ref<ConfigurableObject> SceneHandler::recordObject(const Class *type, bool configure) {
+    ParseContext &context = m_context.top();
+    BinarySceneWriter::ChildList children;
+    children.reserve(context.children.size());
+
+    for (ChildList::iterator it = context.children.begin();
+            it != context.children.end(); ++it) {
+        if (it->second == NULL)
+            continue;
+        children.push_back(std::make_pair(it->first,
+            static_cast<RecordedObject *>(it->second)->getIndex()));
+        it->second->decRef();
+    }
+    context.children.clear();
+
+    return new RecordedObject(m_writer->writeObject(type,
+        context.properties, children, configure));
+}
+
 void SceneHandler::endElement(const XMLCh* const xmlName) {
     std::string name = transcode(xmlName);
     ParseContext &context = m_context.top();
@@ -288,7 +404,14 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
 
     switch (tag.first) {
         case EScene:
-            object = m_scene = new Scene(context.properties);
+            /* Don't configure a scene object if it is from an included file */
+            if (m_writer) {
+                object = m_recordedScene = recordObject(MTS_CLASS(Scene), !m_isIncludedFile);
+            } else {
+                object = createObject(MTS_CLASS(Scene), context.properties,
+                    context.children, !m_isIncludedFile);
+                m_scene = static_cast<Scene *>(object.get());
+            }
             break;
 
         case ENull:
@@ -300,6 +423,13 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
                 if (m_namedObjects->find(id) == m_namedObjects->end())
                     XMLLog(EError, "Referenced object '%s' not found!", id.c_str());
                 object = (*m_namedObjects)[id];
+
+                if (object && m_writer) {
+                    object = new RecordedObject(m_writer->writeReference(
+                        static_cast<RecordedObject *>(object.get())->getIndex()));
+                } else if (object) {
+                    object->configure();
+                }
             }
             break;
 
@@ -668,6 +798,7 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
 
                 /* Set the handler and start parsing */
                 SceneHandler *handler = new SceneHandler(m_params, m_namedObjects, true);
+                handler->setBinarySceneWriter(m_writer);
                 parser->setDoNamespaces(true);
                 parser->setDocumentHandler(handler);
                 parser->setErrorHandler(handler);
@@ -675,7 +806,10 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
                 XMLLog(EInfo, "Parsing included file \"%s\" ..", path.filename().string().c_str());
                 parser->parse(path.c_str());
 
-                object = handler->getScene();
+                if (m_writer)
+                    object = handler->m_recordedScene;
+                else
+                    object = handler->getScene();
                 delete parser;
                 delete handler;
             }
@@ -692,55 +826,11 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
                     XMLLog(EError, "Internal error: could not instantiate an object "
                         "corresponding to the tag '%s'", name.c_str());
 
-                Properties &props = context.properties;
-
-                /* Convenience hack: allow passing animated transforms to arbitrary shapes
-                   and then internally rewrite this into a shape group + animated instance */
-                if (tag.second == MTS_CLASS(Shape)
-                    && props.hasProperty("toWorld")
-                    && props.getType("toWorld") == Properties::EAnimatedTransform
-                    && (props.getPluginName() != "instance" && props.getPluginName() != "disk")) {
-                    /* (The 'disk' plugin also directly supports animated transformations, so
-                        the instancing trick isn't required for it) */
-
-                    ref<const AnimatedTransform> trafo = props.getAnimatedTransform("toWorld");
-                    props.removeProperty("toWorld");
-
-                    if (trafo->isStatic())
-                        props.setTransform("toWorld", trafo->eval(0));
-
-                    object = m_pluginManager->createObject(tag.second, props);
-
-                    if (!trafo->isStatic()) {
-                        object = m_pluginManager->createObject(tag.second, props);
-                        /* If the object has children, append them */
-                        for (std::vector<std::pair<std::string, ConfigurableObject *> >
-                                ::iterator it = context.children.begin();
-                                it != context.children.end(); ++it) {
-                            if (it->second != NULL) {
-                                object->addChild(it->first, it->second);
-                                it->second->setParent(object);
-                                it->second->decRef();
-                            }
-                        }
-                        context.children.clear();
-
-                        object->configure();
-
-                        ref<Shape> shapeGroup = static_cast<Shape *> (
-                            m_pluginManager->createObject(MTS_CLASS(Shape), Properties("shapegroup")));
-                        shapeGroup->addChild(object);
-                        shapeGroup->configure();
-
-                        Properties instanceProps("instance");
-                        instanceProps.setAnimatedTransform("toWorld", trafo);
-                        object = m_pluginManager->createObject(instanceProps);
-                        object->addChild(shapeGroup);
-
-                    }
+                if (m_writer) {
+                    object = recordObject(tag.second, true);
                 } else {
                     try {
-                        object = m_pluginManager->createObject(tag.second, props);
+                        object = createObject(tag.second, context.properties, context.children);
                     } catch (const std::exception &ex) {
                         XMLLog(EError, "Error while creating object: %s", ex.what());
                     }
@@ -761,21 +851,6 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
                     std::pair<std::string, ConfigurableObject *>(nodeName, object));
             }
 
-            /* If the object has children, append them */
-            for (std::vector<std::pair<std::string, ConfigurableObject *> >
-                    ::iterator it = context.children.begin();
-                    it != context.children.end(); ++it) {
-                if (it->second != NULL) {
-                    object->addChild(it->first, it->second);
-                    it->second->setParent(object);
-                    it->second->decRef();
-                }
-            }
-
-            /* Don't configure a scene object if it is from an included file */
-            if (name != "include" && (!m_isIncludedFile || !object->getClass()->derivesFrom(MTS_CLASS(Scene))))
-                object->configure();
-
             if (object->getClass()->derivesFrom(MTS_CLASS(Texture)))
                 object = static_cast<Texture *>(object.get())->expand();
         }
@@ -789,10 +864,12 @@ void SceneHandler::endElement(const XMLCh* const xmlName) {
         }
     }
 
-    /* Warn about unqueried properties */
-    std::vector<std::string> unq = context.properties.getUnqueried();
-    for (unsigned int i=0; i<unq.size(); ++i)
-        XMLLog(EWarn, "Unqueried attribute \"%s\" in element \"%s\"", unq[i].c_str(), name.c_str());
+    /* Warn about unqueried properties (when recording, this is done at load time) */
+    if (!m_writer) {
+        std::vector<std::string> unq = context.properties.getUnqueried();
+        for (unsigned int i=0; i<unq.size(); ++i)
+            XMLLog(EWarn, "Unqueried attribute \"%s\" in element \"%s\"", unq[i].c_str(), name.c_str());
+    }
 
     m_context.pop();
 }
@@ -822,6 +899,13 @@ void SceneHandler::fatalError(const SAXParseException& e) {
 // -----------------------------------------------------------------------
 
 ref<Scene> SceneHandler::loadScene(const fs::path &filename, const ParameterMap &params) {
+    if (BinarySceneLoader::isBinaryScene(filename)) {
+        if (!params.empty())
+            SLog(EWarn, "Scene parameters are ignored when loading a binary scene "
+                "file (they were substituted at conversion time)");
+        return BinarySceneLoader::loadScene(filename);
+    }
+
     /* Prepare for parsing scene descriptions */
     FileResolver *resolver = Thread::getThread()->getFileResolver();
     SAXParser* parser = new SAXParser();
@@ -879,6 +963,40 @@ ref<Scene> SceneHandler::loadSceneFromString(const std::string &content, const P
     return scene;
 }
 
+void SceneHandler::convertScene(const fs::path &xmlFile,
+        const fs::path &binaryFile, const ParameterMap &params) {
+    /* Prepare for parsing scene descriptions */
+    FileResolver *resolver = Thread::getThread()->getFileResolver();
+    SAXParser* parser = new SAXParser();
+    fs::path schemaPath = resolver->resolveAbsolute("data/schema/scene.xsd");
+    SLog(EDebug, "Converting scene \"%s\" ..", xmlFile.string().c_str());
+
+    /* Check against the 'scene.xsd' XML Schema */
+    parser->setDoSchema(true);
+    parser->setValidationSchemaFullChecking(true);
+    parser->setValidationScheme(SAXParser::Val_Always);
+    parser->setExternalNoNamespaceSchemaLocation(schemaPath.c_str());
+
+    ref<FileStream> stream = new FileStream(binaryFile, FileStream::ETruncReadWrite);
+    ref<BinarySceneWriter> writer = new BinarySceneWriter(stream);
+
+    SceneHandler *handler = new SceneHandler(params);
+    handler->setBinarySceneWriter(writer);
+    parser->setDoNamespaces(true);
+    parser->setDocumentHandler(handler);
+    parser->setErrorHandler(handler);
+
+    parser->parse(xmlFile.c_str());
+    writer->finish(static_cast<RecordedObject *>(
+        handler->m_recordedScene.get())->getIndex());
+    stream->close();
+
+    SLog(EInfo, "Wrote %u records to \"%s\"", writer->getRecordCount(),
+        binaryFile.string().c_str());
+
+    delete parser;
+    delete handler;
+}
 
 void SceneHandler::staticInitialization() {
     /* Initialize Xerces-C */
@@ -896,4 +1014,6 @@ void SceneHandler::staticShutdown() {
 
 VersionException::~VersionException() throw () {}
 
+MTS_IMPLEMENT_CLASS(RecordedObject, false, ConfigurableObject)
+
 MTS_NAMESPACE_END
@@ -131,6 +131,18 @@ Spectrum Sensor::sampleRayDifferential(RayDifferential &ray,
     return result;
 }
 
+void Sensor::sampleRayDifferentials(size_t count,
+        const Point2 *samplePositions,
+        const Point2 *apertureSamples,
+        const Float *timeSamples,
+        RayDifferential *rays,
+        Spectrum *weights) const {
+    for (size_t i=0; i<count; ++i)
+        weights[i] = sampleRayDifferential(rays[i], samplePositions[i],
+            apertureSamples ? apertureSamples[i] : Point2(0.5f),
+            timeSamples ? timeSamples[i] : 0.5f);
+}
+
 Float Sensor::pdfTime(const Ray &ray, EMeasure measure) const {
     if (ray.time < m_shutterOpen || ray.time > m_shutterOpen + m_shutterOpenTime)
         return 0.0f;
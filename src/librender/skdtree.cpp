@@ -17,6 +17,7 @@
 */
 
 #include <mitsuba/render/skdtree.h>
+#include <mitsuba/render/bsdf.h>
 #include <mitsuba/core/statistics.h>
 
 #if defined(MTS_SSE)
@@ -76,7 +77,7 @@ void ShapeKDTree::build() {
     SizeType primCount = getPrimitiveCount();
     Log(EDebug, "Precomputing triangle intersection information (%s)",
             memString(sizeof(TriAccel)*primCount).c_str());
-    m_triAccel = static_cast<TriAccel *>(allocAligned(primCount * sizeof(TriAccel)));
+    m_triAccel = static_cast<TriAccel *>(allocAlignedLarge(primCount * sizeof(TriAccel)));
 
     IndexType idx = 0;
     for (IndexType i=0; i<m_shapes.size(); ++i) {
@@ -161,41 +162,7 @@ bool ShapeKDTree::rayIntersect(const Ray &ray, Float &t, ConstShapePtr &shape,
 
         if (EXPECT_TAKEN(maxt > mint)) {
             if (rayIntersectHavran<false>(ray, mint, maxt, t, temp)) {
-                const IntersectionCache *cache = reinterpret_cast<const IntersectionCache *>(temp);
-                shape = m_shapes[cache->shapeIndex];
-
-                if (m_triangleFlag[cache->shapeIndex]) {
-                    const TriMesh *trimesh = static_cast<const TriMesh *>(shape);
-                    const Triangle &tri = trimesh->getTriangles()[cache->primIndex];
-                    const Point *vertexPositions = trimesh->getVertexPositions();
-                    const Point2 *vertexTexcoords = trimesh->getVertexTexcoords();
-                    const uint32_t idx0 = tri.idx[0], idx1 = tri.idx[1], idx2 = tri.idx[2];
-                    const Point &p0 = vertexPositions[idx0];
-                    const Point &p1 = vertexPositions[idx1];
-                    const Point &p2 = vertexPositions[idx2];
-                    n = normalize(cross(p1-p0, p2-p0));
-
-                    if (EXPECT_TAKEN(vertexTexcoords)) {
-                        const Vector b(1 - cache->u - cache->v, cache->u, cache->v);
-                        const Point2 &t0 = vertexTexcoords[idx0];
-                        const Point2 &t1 = vertexTexcoords[idx1];
-                        const Point2 &t2 = vertexTexcoords[idx2];
-                        uv = t0 * b.x + t1 * b.y + t2 * b.z;
-                    } else {
-                        uv = Point2(0.0f);
-                    }
-                } else {
-                    /// Uh oh... -- much unnecessary work is done here
-                    Intersection its;
-                    its.t = t;
-                    shape->fillIntersectionRecord(ray,
-                        reinterpret_cast<const uint8_t*>(temp) + 2*sizeof(IndexType), its);
-                    n = its.geoFrame.n;
-                    uv = its.uv;
-                    if (its.shape)
-                        shape = its.shape;
-                }
-
+                getIntersectionInfo(ray, t, temp, shape, n, uv);
                 return true;
             }
         }
@@ -203,6 +170,155 @@ bool ShapeKDTree::rayIntersect(const Ray &ray, Float &t, ConstShapePtr &shape,
     return false;
 }
 
+void ShapeKDTree::getIntersectionInfo(const Ray &ray, Float t, const void *temp,
+        ConstShapePtr &shape, Normal &n, Point2 &uv) const {
+    const IntersectionCache *cache = reinterpret_cast<const IntersectionCache *>(temp);
+    shape = m_shapes[cache->shapeIndex];
+
+    if (m_triangleFlag[cache->shapeIndex]) {
+        const TriMesh *trimesh = static_cast<const TriMesh *>(shape);
+        const Triangle &tri = trimesh->getTriangles()[cache->primIndex];
+        const Point *vertexPositions = trimesh->getVertexPositions();
+        const Point2 *vertexTexcoords = trimesh->getVertexTexcoords();
+        const uint32_t idx0 = tri.idx[0], idx1 = tri.idx[1], idx2 = tri.idx[2];
+        const Point &p0 = vertexPositions[idx0];
+        const Point &p1 = vertexPositions[idx1];
+        const Point &p2 = vertexPositions[idx2];
+        n = normalize(cross(p1-p0, p2-p0));
+
+        if (EXPECT_TAKEN(vertexTexcoords)) {
+            const Vector b(1 - cache->u - cache->v, cache->u, cache->v);
+            const Point2 &t0 = vertexTexcoords[idx0];
+            const Point2 &t1 = vertexTexcoords[idx1];
+            const Point2 &t2 = vertexTexcoords[idx2];
+            uv = t0 * b.x + t1 * b.y + t2 * b.z;
+        } else {
+            uv = Point2(0.0f);
+        }
+    } else {
+        /// Uh oh... -- much unnecessary work is done here
+        Intersection its;
+        its.t = t;
+        shape->fillIntersectionRecord(ray,
+            reinterpret_cast<const uint8_t*>(temp) + 2*sizeof(IndexType), its);
+        n = its.geoFrame.n;
+        uv = its.uv;
+        if (its.shape)
+            shape = its.shape;
+    }
+}
+
+/// Collects the surfaces along a ray segment for \ref ShapeKDTree::rayIntersectMulti()
+struct ShapeKDTree::SurfaceHitCollector {
+    const ShapeKDTree *kdtree;
+    const Ray &ray;
+    Float mint;
+    SurfaceHit *hits;
+    int &hitCount;
+    bool &complete;
+
+    inline SurfaceHitCollector(const ShapeKDTree *kdtree, const Ray &ray,
+        Float mint, SurfaceHit *hits, int &hitCount, bool &complete)
+        : kdtree(kdtree), ray(ray), mint(mint), hits(hits),
+          hitCount(hitCount), complete(complete) { }
+
+    inline bool operator()(IndexType primIdx, Float &maxt) {
+        /* Primitives may be visited again in another leaf node */
+        for (int i=0; i<hitCount; ++i) {
+            if (hits[i].primIdx == primIdx)
+                return true;
+        }
+
+        uint8_t temp[MTS_KD_INTERSECTION_TEMP];
+        Float t;
+        if (!kdtree->intersect(ray, primIdx, mint, maxt, t, temp))
+            return true;
+
+        const IntersectionCache *cache = reinterpret_cast<const IntersectionCache *>(temp);
+
+        /* Insert the hit while keeping the list sorted. When it is
+           full, the most distant hit is dropped */
+        int pos = hitCount;
+        if (hitCount == MTS_KD_MAX_HITS)
+            --pos;
+        else
+            ++hitCount;
+
+        while (pos > 0 && hits[pos-1].t > t) {
+            hits[pos] = hits[pos-1];
+            --pos;
+        }
+
+        SurfaceHit &hit = hits[pos];
+        hit.t = t;
+        hit.primIdx = primIdx;
+        memcpy(hit.temp, temp, MTS_KD_INTERSECTION_TEMP);
+
+        if (kdtree->isOccluder(hit)) {
+            /* The segment is blocked here, unless the caller skips this
+               surface because it lies within the ray epsilon of a
+               preceding one -- nothing behind it needs to be reported */
+            hitCount = pos + 1;
+            complete = false;
+            maxt = t;
+        } else if (!kdtree->m_triangleFlag[cache->shapeIndex]) {
+            /* Another intersection with this shape could precede the
+               surfaces behind it -- leave them to the next query */
+            hitCount = pos + 1;
+            complete = false;
+            maxt = t;
+        } else if (hitCount == MTS_KD_MAX_HITS) {
+            /* Surfaces behind the most distant hit can't be reported */
+            complete = false;
+            maxt = hits[hitCount-1].t;
+        }
+
+        return true;
+    }
+};
+
+bool ShapeKDTree::rayIntersectMulti(const Ray &ray, SurfaceHit *hits,
+        int &hitCount, bool &complete) const {
+    Float mint, maxt;
+
+    hitCount = 0;
+    complete = true;
+
+    ++shadowRaysTraced;
+    if (m_aabb.rayIntersect(ray, mint, maxt)) {
+        /* Use an adaptive ray epsilon */
+        Float rayMinT = ray.mint;
+        if (rayMinT == Epsilon)
+            rayMinT *= std::max(std::max(std::abs(ray.o.x),
+                std::abs(ray.o.y)), std::abs(ray.o.z));
+
+        if (rayMinT > mint) mint = rayMinT;
+        if (ray.maxt < maxt) maxt = ray.maxt;
+
+        if (EXPECT_TAKEN(maxt > mint)) {
+            SurfaceHitCollector collector(this, ray, mint, hits, hitCount, complete);
+            rayTraverseHavran(ray, mint, maxt, collector);
+
+            /* An occluder in front of all other surfaces can't be skipped */
+            if (hitCount > 0 && isOccluder(hits[0])) {
+                hitCount = 0;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ShapeKDTree::isOccluder(const SurfaceHit &hit) const {
+    const IntersectionCache *cache = reinterpret_cast<const IntersectionCache *>(hit.temp);
+    const BSDF *bsdf = m_shapes[cache->shapeIndex]->getBSDF();
+    return bsdf && !(bsdf->getType() & BSDF::ENull);
+}
+
+void ShapeKDTree::getSurfaceHitInfo(const Ray &ray, const SurfaceHit &hit,
+        ConstShapePtr &shape, Normal &n, Point2 &uv) const {
+    getIntersectionInfo(ray, hit.t, hit.temp, shape, n, uv);
+}
 
 bool ShapeKDTree::rayIntersect(const Ray &ray) const {
     Float mint, maxt, t = std::numeric_limits<Float>::infinity();
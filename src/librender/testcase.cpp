@@ -23,9 +23,26 @@
 
 MTS_NAMESPACE_BEGIN
 
+fs::path TestCase::m_outputDirectory = "testoutput";
+
 void TestCase::init() { }
 void TestCase::shutdown() { }
 
+void TestCase::setOutputDirectory(const fs::path &path) {
+    m_outputDirectory = path;
+}
+
+const fs::path &TestCase::getOutputDirectory() {
+    return m_outputDirectory;
+}
+
+fs::path TestCase::getOutputPath(const std::string &filename) {
+    /* Can be called concurrently by several threads -- an existing directory is fine */
+    if (!fs::is_directory(m_outputDirectory))
+        fs::create_directories(m_outputDirectory);
+    return m_outputDirectory / filename;
+}
+
 void TestCase::assertTrueImpl(bool value, const char *expr, const char *file, int line) {
     if (!value)
         Thread::getThread()->getLogger()->log(EError, NULL, file, line, "Assertion '%s == true' failed!", expr);
@@ -37,6 +37,19 @@
 
 MTS_NAMESPACE_BEGIN
 
+/* Hint that the (potentially very large) vertex and index buffers of
+   a mesh should be backed by huge pages. This has no effect unless
+   enabled using setHugePagePolicy() */
+static void adviseMeshHugePages(TriMesh *mesh) {
+    size_t vertexCount = mesh->getVertexCount();
+    adviseHugePages(mesh->getTriangles(),
+        mesh->getTriangleCount() * sizeof(Triangle));
+    adviseHugePages(mesh->getVertexPositions(), vertexCount * sizeof(Point));
+    adviseHugePages(mesh->getVertexNormals(), vertexCount * sizeof(Normal));
+    adviseHugePages(mesh->getVertexTexcoords(), vertexCount * sizeof(Point2));
+    adviseHugePages(mesh->getVertexColors(), vertexCount * sizeof(Color3));
+}
+
 TriMesh::TriMesh(const std::string &name, size_t triangleCount,
         size_t vertexCount, bool hasNormals, bool hasTexcoords,
         bool hasVertexColors, bool flipNormals, bool faceNormals)
@@ -52,6 +65,7 @@ TriMesh::TriMesh(const std::string &name, size_t triangleCount,
     m_tangents = NULL;
     m_surfaceArea = m_invSurfaceArea = -1;
     m_mutex = new Mutex();
+    adviseMeshHugePages(this);
 }
 
 TriMesh::TriMesh(const Properties &props)
@@ -141,6 +155,7 @@ TriMesh::TriMesh(Stream *stream, InstanceManager *manager)
     m_flipNormals = false;
     m_surfaceArea = m_invSurfaceArea = -1;
     m_mutex = new Mutex();
+    adviseMeshHugePages(this);
     configure();
 }
 
@@ -249,6 +264,7 @@ void TriMesh::loadCompressed(Stream *_stream, int index) {
 
     m_surfaceArea = m_invSurfaceArea = -1;
     m_flipNormals = false;
+    adviseMeshHugePages(this);
 }
 
 short TriMesh::readHeader(Stream *stream) {
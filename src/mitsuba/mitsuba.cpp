@@ -77,10 +77,16 @@ void help() {
     cout <<  "   -n name     Assign a node name to this instance (Default: host name)" << endl << endl;
     cout <<  "   -x          Skip rendering of files where output already exists" << endl << endl;
     cout <<  "   -r sec      Write (partial) output images every 'sec' seconds" << endl << endl;
+    cout <<  "   -k sec      Save the rendering progress every 'sec' seconds to a checkpoint" << endl;
+    cout <<  "               file next to the output image (with extension .ckpt)" << endl << endl;
+    cout <<  "   -R          Resume interrupted renderings from their checkpoint files" << endl << endl;
     cout <<  "   -b res      Specify the block resolution used to split images into parallel" << endl;
     cout <<  "               workloads (default: 32). Only applies to some integrators." << endl << endl;
     cout <<  "   -v          Be more verbose (can be specified twice)" << endl << endl;
     cout <<  "   -L level    Explicitly specify the log level (trace/debug/info/warn/error)" << endl << endl;
+    cout <<  "   -H policy   Back large allocations (kd-trees, meshes, MIP maps) with huge" << endl;
+    cout <<  "               pages to reduce TLB misses (none/transparent/explicit)." << endl;
+    cout <<  "               'explicit' requires pages reserved via vm.nr_hugepages" << endl << endl;
     cout <<  "   -w          Treat warnings as errors" << endl << endl;
     cout <<  "   -z          Disable progress bars" << endl << endl;
     cout <<  " For documentation, please refer to http://www.mitsuba-renderer.org/docs.html" << endl;
@@ -143,6 +149,8 @@ int mitsuba_app(int argc, char **argv) {
         std::map<std::string, std::string, SimpleStringOrdering> parameters;
         int blockSize = 32;
         int flushTimer = -1;
+        int checkpointTimer = -1;
+        bool resume = false;
 
         if (argc < 2) {
             help();
@@ -151,7 +159,7 @@ int mitsuba_app(int argc, char **argv) {
 
         optind = 1;
         /* Parse command-line arguments */
-        while ((optchar = getopt(argc, argv, "a:c:D:s:j:n:o:r:b:p:L:qhzvtwx")) != -1) {
+        while ((optchar = getopt(argc, argv, "a:c:D:s:j:n:o:r:k:b:p:L:H:qhzvtwxR")) != -1) {
             switch (optchar) {
                 case 'a': {
                         std::vector<std::string> paths = tokenize(optarg, ";");
@@ -215,6 +223,9 @@ int mitsuba_app(int argc, char **argv) {
                 case 'x':
                     skipExisting = true;
                     break;
+                case 'H':
+                    setHugePagePolicy(parseHugePagePolicy(optarg));
+                    break;
                 case 'p':
                     nprocs = strtol(optarg, &end_ptr, 10);
                     if (*end_ptr != '\0')
@@ -230,6 +241,14 @@ int mitsuba_app(int argc, char **argv) {
                     if (*end_ptr != '\0')
                         SLog(EError, "Could not parse the '-r' parameter argument!");
                     break;
+                case 'k':
+                    checkpointTimer = strtol(optarg, &end_ptr, 10);
+                    if (*end_ptr != '\0' || checkpointTimer <= 0)
+                        SLog(EError, "Could not parse the '-k' parameter argument!");
+                    break;
+                case 'R':
+                    resume = true;
+                    break;
                 case 'b':
                     blockSize = strtol(optarg, &end_ptr, 10);
                     if (*end_ptr != '\0')
@@ -374,10 +393,18 @@ int mitsuba_app(int argc, char **argv) {
             frClone->prependPath(filePath);
             Thread::getThread()->setFileResolver(frClone);
 
-            SLog(EInfo, "Parsing scene description from \"%s\" ..", argv[i]);
-
-            parser->parse(filename.c_str());
-            ref<Scene> scene = handler->getScene();
+            ref<Scene> scene;
+            if (BinarySceneLoader::isBinaryScene(filename)) {
+                SLog(EInfo, "Loading binary scene \"%s\" ..", argv[i]);
+                if (!parameters.empty())
+                    SLog(EWarn, "Scene parameters are ignored when loading a binary scene "
+                        "file (they were substituted at conversion time)");
+                scene = BinarySceneLoader::loadScene(filename);
+            } else {
+                SLog(EInfo, "Parsing scene description from \"%s\" ..", argv[i]);
+                parser->parse(filename.c_str());
+                scene = handler->getScene();
+            }
 
             scene->setSourceFile(filename);
             scene->setDestinationFile(destFile.length() > 0 ?
@@ -389,6 +416,12 @@ int mitsuba_app(int argc, char **argv) {
 
             ref<RenderJob> thr = new RenderJob(formatString("ren%i", jobIdx++),
                 scene, renderQueue, -1, -1, -1, true, flushTimer > 0);
+            if (checkpointTimer > 0 || resume) {
+                fs::path checkpointFile = scene->getDestinationFile();
+                checkpointFile.replace_extension(".ckpt");
+                thr->setCheckpoint(checkpointFile,
+                    (Float) std::max(checkpointTimer, 0), resume);
+            }
             thr->start();
 
             renderQueue->waitLeft(numParallelScenes-1);
@@ -71,7 +71,12 @@ void help() {
     cout <<  "               with one name per line (same format as in -c)" << endl<< endl;
     cout <<  "   -n name     Assign a node name to this instance (Default: host name)" << endl << endl;
     cout <<  "   -t          Execute all testcases" << endl << endl;
+    cout <<  "   -o dir      Directory where testcases write their output files" << endl;
+    cout <<  "               (Default: \"testoutput\")" << endl << endl;
     cout <<  "   -v          Be more verbose" << endl << endl;
+    cout <<  "   -H policy   Back large allocations (kd-trees, meshes, MIP maps) with huge" << endl;
+    cout <<  "               pages to reduce TLB misses (none/transparent/explicit)." << endl;
+    cout <<  "               'explicit' requires pages reserved via vm.nr_hugepages" << endl << endl;
     cout <<  "   -w          Treat warnings as errors" << endl << endl;
 
     FileResolver *fileResolver = Thread::getThread()->getFileResolver();
@@ -156,7 +161,7 @@ int mtsutil(int argc, char **argv) {
 
         optind = 1;
         /* Parse command-line arguments */
-        while ((optchar = getopt(argc, argv, "+a:c:s:n:p:qhwvt")) != -1) {
+        while ((optchar = getopt(argc, argv, "+a:c:s:n:o:p:H:qhwvt")) != -1) {
             switch (optchar) {
                 case 'a': {
                         std::vector<std::string> paths = tokenize(optarg, ";");
@@ -170,6 +175,9 @@ int mtsutil(int argc, char **argv) {
                 case 't':
                     testCaseMode = true;
                     break;
+                case 'o':
+                    TestCase::setOutputDirectory(optarg);
+                    break;
                 case 'w':
                     treatWarningsAsErrors = true;
                     break;
@@ -202,6 +210,9 @@ int mtsutil(int argc, char **argv) {
                 case 'q':
                     quietMode = true;
                     break;
+                case 'H':
+                    setHugePagePolicy(parseHugePagePolicy(optarg));
+                    break;
                 case 'h':
                 default:
                     help();
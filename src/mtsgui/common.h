@@ -116,7 +116,8 @@ enum EMode {
 
 enum EPreviewMethod {
     EDisabled = 0,
-    EOpenGL
+    EOpenGL,
+    ECPUProgressive
 };
 
 enum EToneMappingMethod {
@@ -25,6 +25,7 @@
 #include <mitsuba/core/mstream.h>
 #include <mitsuba/core/fstream.h>
 #include <mitsuba/core/qmc.h>
+#include <mitsuba/core/plugin.h>
 #include <mitsuba/hw/font.h>
 #include <boost/tuple/tuple.hpp>
 
@@ -46,6 +47,7 @@ GLWidget::GLWidget(QWidget *parent) :
     m_renderer = Renderer::create(NULL);
     m_device = new QtDevice(this);
     m_preview = new PreviewThread(m_device, m_renderer);
+    m_cpuPreviewFrame = -1;
     connect(m_preview, SIGNAL(caughtException(const QString &)),
         this, SLOT(onException(const QString &)), Qt::QueuedConnection);
     connect(m_preview, SIGNAL(statusMessage(const QString &)),
@@ -59,6 +61,7 @@ GLWidget::GLWidget(QWidget *parent) :
 #else
     m_softwareFallback = false;
 #endif
+    m_fallbackMultiplier = -1;
     m_ignoreResizeEvents = false;
     m_ignoreScrollEvents = false;
     m_animation = false;
@@ -73,6 +76,11 @@ GLWidget::~GLWidget() {
 void GLWidget::shutdown() {
     if (m_preview)
         m_preview->quit();
+    if (m_cpuPreview) {
+        m_cpuPreview->quit();
+        m_cpuPreview->join();
+        m_cpuPreview = NULL;
+    }
 }
 
 void GLWidget::onException(const QString &what) {
@@ -227,6 +235,7 @@ void GLWidget::setScene(SceneContext *context) {
         context = NULL;
 
     m_preview->setSceneContext(context, true, false);
+    updateCPUPreview();
     m_framebufferChanged = true;
     m_mouseDrag = m_animation = m_cropping = false;
     m_leftKeyDown = m_rightKeyDown = m_upKeyDown = m_downKeyDown = false;
@@ -327,6 +336,16 @@ void GLWidget::setReinhardBurn(Float value) {
 void GLWidget::downloadFramebuffer() {
     bool createdFramebuffer = false;
 
+    if (m_context->previewMethod == ECPUProgressive) {
+        /* Keep the most recent frame, and free up the CPU for the real rendering */
+        int frame = -1;
+        if (!m_cpuPreview || !m_cpuPreview->develop(m_context->framebuffer, frame))
+            m_context->framebuffer->clear();
+        if (m_cpuPreview)
+            m_cpuPreview->pause();
+        return;
+    }
+
     if (!m_preview->isRunning()
         || m_context->previewMethod == EDisabled) {
         m_context->framebuffer->clear();
@@ -391,7 +410,7 @@ void GLWidget::focusOutEvent(QFocusEvent *event) {
 }
 
 void GLWidget::timerImpulse() {
-    if (!m_context || !m_context->scene || !m_preview->isRunning()) {
+    if (!m_context || !m_context->scene || !isPreviewRunning()) {
         m_movementTimer->stop();
         return;
     }
@@ -473,15 +492,50 @@ bool GLWidget::askReallyCancelRendering() {
 }
 
 void GLWidget::resetPreview() {
-    if (!m_context || !m_context->scene || !m_preview->isRunning())
+    if (!m_context || !m_context->scene)
+        return;
+    updateCPUPreview();
+    if (!m_preview->isRunning() && m_context->previewMethod != ECPUProgressive)
         return;
     bool motion = m_leftKeyDown || m_rightKeyDown ||
         m_upKeyDown || m_downKeyDown || m_mouseDrag ||
         m_wheelTimer->getMilliseconds() < 200 || m_animation;
-    m_preview->setSceneContext(m_context, false, motion);
+    if (m_preview->isRunning())
+        m_preview->setSceneContext(m_context, false, motion);
     updateGL();
 }
 
+void GLWidget::updateCPUPreview() {
+    if (!m_context || !m_context->scene) {
+        if (m_cpuPreview)
+            m_cpuPreview->reset();
+        return;
+    } else if (m_context->previewMethod != ECPUProgressive) {
+        if (m_cpuPreview)
+            m_cpuPreview->pause();
+        return;
+    }
+
+    if (!m_cpuPreview) {
+        m_cpuPreview = new ProgressiveRenderer();
+        m_cpuPreview->start();
+    }
+
+    /* Unidirectional path tracing with the preview's path length setting */
+    Properties props("path");
+    props.setInteger("maxDepth", m_context->pathLength);
+    ref<SamplingIntegrator> integrator = static_cast<SamplingIntegrator *> (
+        PluginManager::getInstance()->createObject(MTS_CLASS(Integrator), props));
+    integrator->configure();
+
+    m_cpuPreview->restart(m_context->scene, integrator, m_context->sceneResID);
+    if (m_context->mode == EPreview)
+        m_cpuPreview->resume();
+    else
+        m_cpuPreview->pause();
+    m_cpuPreviewFrame = -1;
+}
+
 void GLWidget::startCrop(ECropType type) {
     if (!m_context || !m_context->scene || m_context->renderJob)
         return;
@@ -595,7 +649,7 @@ void GLWidget::keyPressEvent(QKeyEvent *event) {
 }
 
 void GLWidget::keyReleaseEvent(QKeyEvent *event) {
-    if (event->isAutoRepeat() || !m_context || !m_preview->isRunning())
+    if (event->isAutoRepeat() || !m_context || !isPreviewRunning())
         return;
     switch (event->key()) {
         case Qt::Key_Left:
@@ -648,7 +702,7 @@ void GLWidget::mouseMoveEvent(QMouseEvent *event) {
     }
 
     PerspectiveCamera *camera = getPerspectiveCamera();
-    if (!camera || !m_preview->isRunning())
+    if (!camera || !isPreviewRunning())
         return;
 
     Transform invView = getWorldTransform();
@@ -791,7 +845,7 @@ void GLWidget::mousePressEvent(QMouseEvent *event) {
     }
 
     const PerspectiveCamera *camera = getPerspectiveCamera();
-    if (!camera || !m_preview->isRunning())
+    if (!camera || !isPreviewRunning())
         return;
 
     if (event->buttons() == Qt::LeftButton && m_navigationMode == EStandard) {
@@ -825,7 +879,7 @@ void GLWidget::mousePressEvent(QMouseEvent *event) {
 }
 
 void GLWidget::mouseDoubleClickEvent(QMouseEvent *event) {
-    if (!m_preview->isRunning())
+    if (!isPreviewRunning())
         return;
     if (m_navigationMode == EStandard && m_aabb.isValid()
         && event->buttons() & Qt::LeftButton)
@@ -879,7 +933,7 @@ void GLWidget::wheelEvent(QWheelEvent *event) {
             : QAbstractSlider::SliderSingleStepAdd);
         bar->setSingleStep(oldStep);
     } else {
-        if (!m_preview->isRunning() || m_context == NULL || m_context->scene == NULL || m_animation)
+        if (m_context == NULL || m_context->scene == NULL || !isPreviewRunning() || m_animation)
             return;
         PerspectiveCamera *camera = getPerspectiveCamera();
         if (!camera)
@@ -990,7 +1044,11 @@ void GLWidget::paintGL() {
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         }
 
-        if (m_context->mode == EPreview) {
+        /* The progressive CPU preview is displayed just like a rendering */
+        bool glPreview = m_context->mode == EPreview
+            && m_context->previewMethod != ECPUProgressive;
+
+        if (glPreview) {
             if (!m_preview->isRunning() || m_context->previewMethod == EDisabled) {
                 /* No preview thread running - just show a grey screen */
                 if (m_cropping && m_cropStart != m_cropEnd) {
@@ -1020,7 +1078,22 @@ void GLWidget::paintGL() {
             }
             size = Vector2i(entry.buffer->getSize().x, entry.buffer->getSize().y);
             buffer = entry.buffer;
-        } else if (m_context->mode == ERender) {
+        } else if (m_context->mode == ERender || m_context->mode == EPreview) {
+            if (m_context->mode == EPreview && m_cpuPreview) {
+                bool motion = m_leftKeyDown || m_rightKeyDown ||
+                    m_upKeyDown || m_downKeyDown || m_mouseDrag ||
+                    m_wheelTimer->getMilliseconds() < 200 || m_animation;
+                if (motion)
+                    m_cpuPreview->waitForFrame(m_cpuPreviewFrame, 50);
+                if (m_cpuPreview->develop(m_context->framebuffer, m_cpuPreviewFrame)) {
+                    m_framebufferChanged = true;
+                    emit statusMessage(QString("CPU preview: %1").arg(
+                        m_cpuPreview->getStatus().c_str()));
+                }
+            } else if (m_cpuPreview && !m_cpuPreview->isPaused()) {
+                m_cpuPreview->pause();
+            }
+
             if (m_framebuffer == NULL ||
                 m_framebuffer->getBitmap()->getWidth() != m_context->framebuffer->getWidth() ||
                 m_framebuffer->getBitmap()->getHeight() != m_context->framebuffer->getHeight() ||
@@ -1037,9 +1110,6 @@ void GLWidget::paintGL() {
                     m_fallbackBitmap->clear();
                     m_framebuffer = m_renderer->createGPUTexture("Framebuffer",
                         m_fallbackBitmap);
-#if MTS_SSE
-                    m_cpuTonemap = new TonemapCPU;
-#endif
                 }
                 m_framebuffer->setMipMapped(false);
                 m_framebuffer->setFilterType(GPUTexture::ENearest);
@@ -1047,34 +1117,8 @@ void GLWidget::paintGL() {
             }
 
             if (m_framebufferChanged) {
-                if (m_softwareFallback) {
-#if MTS_SSE
-                    Float mult = 1.0;
-                    if (m_context->mode == EPreview) {
-                        mult /= entry.vplSampleOffset;
-                    }
-                    m_cpuTonemap->setLuminanceInfo(m_context->framebuffer,mult);
-#else
-                    /* Manually generate a gamma-corrected image
-                       on the CPU (with gamma=2.2) - this will be slow! */
-                    Bitmap *source = m_context->framebuffer;
-                    float *sourceData = source->getFloat32Data();
-                    uint8_t *targetData = (uint8_t *) m_fallbackBitmap->getData();
-                    for (int y=0; y<source->getHeight(); ++y) {
-                        for (int x=0; x<source->getWidth(); ++x) {
-                            const float invGammaValue = 0.45455f;
-                            *targetData++ = (uint8_t) std::max(std::min(
-                                std::pow(*sourceData++, invGammaValue) * 255.0f, 255.0f), 0.0f);
-                            *targetData++ = (uint8_t) std::max(std::min(
-                                std::pow(*sourceData++, invGammaValue) * 255.0f, 255.0f), 0.0f);
-                            *targetData++ = (uint8_t) std::max(std::min(
-                                std::pow(*sourceData++, invGammaValue) * 255.0f, 255.0f), 0.0f);
-                            ++sourceData;
-                            *targetData++ = 255;
-                        }
-                    }
-#endif
-                }
+                /* Invalidate the luminance statistics of the software fallback */
+                m_fallbackMultiplier = -1;
                 m_framebuffer->refresh();
                 m_framebufferChanged = false;
             }
@@ -1088,43 +1132,35 @@ void GLWidget::paintGL() {
             && m_context->previewMethod == EOpenGL;
 
         if (m_softwareFallback) {
-#if MTS_SSE
-            m_cpuTonemap->setSRGB(m_context->srgb);
-            m_cpuTonemap->setInvGamma(static_cast<Float>(1) / m_context->gamma);
+            /* Tonemap on the CPU using the vectorized kernels from libcore */
+            const Bitmap *source = m_context->framebuffer;
+            Float mult = 1.0;
+            if (glPreview)
+                mult /= entry.vplSampleOffset;
+
+            tonemap::Parameters params(mult, m_context->srgb ? (Float) -1
+                : (Float) 1 / m_context->gamma);
 
             if (m_context->toneMappingMethod == EGamma) {
-                Float invWhitePoint = std::pow((Float) 2.0f,
-                    m_context->exposure);
-                if (m_context->mode == EPreview)
-                    invWhitePoint /= entry.vplSampleOffset;
-
-                m_cpuTonemap->setInvWhitePoint(invWhitePoint);
-                m_cpuTonemap->gammaTonemap(m_context->framebuffer,
-                    m_fallbackBitmap);
+                params.multiplier *= std::pow((Float) 2.0f, m_context->exposure);
             } else if (m_context->toneMappingMethod == EReinhard) {
-                Float mult = 1.0;
-                if (m_context->mode == EPreview)
-                    mult /= entry.vplSampleOffset;
-
                 /* Getting the luminance info is rather expensive, avoid if the
-                   multiplier has not changed */
-                if (mult != m_cpuTonemap->multiplier()) {
-                    m_cpuTonemap->setLuminanceInfo(m_context->framebuffer,mult);
+                   image and the multiplier have not changed */
+                if (mult != m_fallbackMultiplier) {
+                    source->getLuminanceStatistics(m_fallbackLogAvgLuminance,
+                        m_fallbackMaxLuminance, mult);
+                    m_fallbackMultiplier = mult;
                 }
-                Float burn = std::min((Float) 1, std::max((Float)1e-8f,
-                    1-(m_context->reinhardBurn + 10) / 20.0f));
-                Float scale = m_context->reinhardKey /
-                              m_cpuTonemap->logAvgLuminance();
-                Float Lwhite = m_cpuTonemap->maxLuminance() * scale;
-
-                m_cpuTonemap->setScale(scale);
-                m_cpuTonemap->setMultiplier(mult);
-                m_cpuTonemap->setInvWhitePoint(1 / (Lwhite * (burn*burn)));
-                m_cpuTonemap->reinhardTonemap(m_context->framebuffer,
-                    m_fallbackBitmap);
+                if (m_fallbackMaxLuminance > 0)
+                    params.setReinhard(m_context->reinhardKey,
+                        (m_context->reinhardBurn + 10) / 20.0f,
+                        m_fallbackLogAvgLuminance, m_fallbackMaxLuminance);
             }
+
+            tonemap::toDisplay(source->getFloat32Data(), source->getPixelFormat(),
+                m_fallbackBitmap->getUInt8Data(), m_fallbackBitmap->getPixelFormat(),
+                source->getPixelCount(), params);
             m_framebuffer->refresh();
-#endif
             buffer->bind();
             m_renderer->setColor(Spectrum(1.0f));
             m_renderer->blitTexture(buffer, false,
@@ -1133,7 +1169,7 @@ void GLWidget::paintGL() {
             buffer->unbind();
         } else if (m_context->toneMappingMethod == EGamma) {
             Float invWhitePoint = std::pow((Float) 2.0f, m_context->exposure);
-            if (m_context->mode == EPreview)
+            if (glPreview)
                 invWhitePoint /= entry.vplSampleOffset;
 
             if (hasDepth)
@@ -1145,7 +1181,7 @@ void GLWidget::paintGL() {
             m_gammaTonemap->setParameter("invGamma", 1/m_context->gamma);
             m_gammaTonemap->setParameter("sRGB", m_context->srgb);
             m_gammaTonemap->setParameter("hasDepth", hasDepth);
-            m_renderer->blitTexture(buffer, m_context->mode == EPreview,
+            m_renderer->blitTexture(buffer, glPreview,
                 !m_hScroll->isVisible(), !m_vScroll->isVisible(),
                 -m_context->scrollOffset);
             m_gammaTonemap->unbind();
@@ -1165,7 +1201,7 @@ void GLWidget::paintGL() {
             }
 
             Float multiplier = 1.0f;
-            if (m_context->mode == EPreview)
+            if (glPreview)
                 multiplier /= entry.vplSampleOffset;
 
             /* Compute the luminace & log luminance */
@@ -1175,7 +1211,7 @@ void GLWidget::paintGL() {
             m_luminanceProgram->bind();
             m_luminanceProgram->setParameter("source", buffer);
             m_luminanceProgram->setParameter("multiplier", multiplier);
-            m_renderer->blitQuad(m_context->mode == EPreview);
+            m_renderer->blitQuad(glPreview);
             m_luminanceProgram->unbind();
             buffer->unbind();
             m_luminanceBuffer[0]->releaseTarget();
@@ -1230,13 +1266,13 @@ void GLWidget::paintGL() {
             m_reinhardTonemap->setParameter("invGamma", 1/m_context->gamma);
             m_reinhardTonemap->setParameter("sRGB", m_context->srgb);
             m_reinhardTonemap->setParameter("hasDepth", hasDepth);
-            m_renderer->blitTexture(buffer, m_context->mode == EPreview,
+            m_renderer->blitTexture(buffer, glPreview,
                 !m_hScroll->isVisible(), !m_vScroll->isVisible(),
                 -m_context->scrollOffset);
             m_reinhardTonemap->unbind();
         }
 
-        if (m_context->mode == EPreview) {
+        if (glPreview) {
             m_preview->releaseBuffer(entry);
             if (m_context->showKDTree) {
                 std::string message = "kd-tree visualization mode\nPress '[' "
@@ -1461,6 +1497,10 @@ void GLWidget::dropEvent(QDropEvent *event) {
 void GLWidget::resumePreview() {
     if (m_preview->isRunning())
         m_preview->resume();
+    if (m_cpuPreview && m_context && m_context->previewMethod == ECPUProgressive) {
+        m_cpuPreviewFrame = -1;
+        m_cpuPreview->resume();
+    }
 }
 
 void GLWidget::onUpdateView() {
@@ -20,12 +20,11 @@
 #define __GLWIDGET_H
 
 #include "common.h"
-#if MTS_SSE
-#include "simdtonemap.h"
-#endif
 #include <QtOpenGL/QGLWidget>
 #include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/tonemap.h>
 #include <mitsuba/render/vpl.h>
+#include <mitsuba/render/progressive.h>
 #include <mitsuba/hw/renderer.h>
 #include <mitsuba/hw/gputexture.h>
 #include <mitsuba/hw/gpuprogram.h>
@@ -129,6 +128,15 @@ protected:
     Float autoFocus() const;
     bool askReallyCancelRendering();
 
+    /// Start over with the progressive CPU preview (or pause it if not selected)
+    void updateCPUPreview();
+
+    /// Is there an active preview, which reacts to camera motion?
+    inline bool isPreviewRunning() const {
+        return m_preview->isRunning() || (m_context &&
+            m_context->previewMethod == ECPUProgressive);
+    }
+
     inline ProjectiveCamera *getProjectiveCamera() {
         Sensor *sensor = m_context->scene->getSensor();
         return (sensor->getType() & Sensor::EProjectiveCamera) ?
@@ -204,15 +212,16 @@ private:
 
     ref<Renderer> m_renderer;
     ref<PreviewThread> m_preview;
+    ref<ProgressiveRenderer> m_cpuPreview;
+    int m_cpuPreviewFrame;
     ref<GPUTexture> m_logoTexture, m_framebuffer, m_luminanceBuffer[2];
     ref<GPUProgram> m_gammaTonemap, m_reinhardTonemap;
     ref<GPUProgram> m_downsamplingProgram, m_luminanceProgram;
-#if MTS_SSE
-    ref<TonemapCPU> m_cpuTonemap;
-#endif
     ref<QtDevice> m_device;
     ref<Font> m_font;
     ref<Bitmap> m_fallbackBitmap;
+    Float m_fallbackMultiplier;
+    Float m_fallbackLogAvgLuminance, m_fallbackMaxLuminance;
     SceneContext *m_context;
     int m_mouseSensitivity;
     Vector2 m_logoSize;
@@ -30,13 +30,12 @@ public:
         : QStringListModel(parent), m_supportsSinglePass(supportsSinglePass) {
         QStringList tmp;
         tmp << "Disable"
-            << "OpenGL";
+            << "OpenGL"
+            << "CPU (progressive)";
         setStringList(tmp);
     }
 
     Qt::ItemFlags flags(const QModelIndex &index) const {
-        if (index.row() == 2 && !m_supportsSinglePass)
-            return Qt::NoItemFlags;
 //#if !defined(MTS_HAS_COHERENT_RT)
 //      if (index.row() == 3)
 //          return Qt::NoItemFlags;
@@ -172,7 +171,7 @@ void PreviewSettingsDialog::on_diffuseSourcesBox_stateChanged(int state) {
 }
 
 void PreviewSettingsDialog::on_previewMethodCombo_activated(int index) {
-    bool visible = true; //index != ERayTrace && index != ERayTraceCoherent;
+    bool visible = index != ECPUProgressive;
     ui->shadowResolutionCombo->setVisible(visible);
     ui->shadowResolutionLabel->setVisible(visible);
     emit previewMethodChanged((EPreviewMethod) index);
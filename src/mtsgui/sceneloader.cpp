@@ -60,7 +60,8 @@ void SceneLoader::run() {
         m_result->shadowMapResolution = settings.value("preview_shadowMapResolution", 256).toInt();
         m_result->clamping = (Float) settings.value("preview_clamping", 0.1f).toDouble();
         m_result->previewMethod = (EPreviewMethod) settings.value("preview_method", EOpenGL).toInt();
-        if (m_result->previewMethod != EOpenGL && m_result->previewMethod != EDisabled)
+        if (m_result->previewMethod != EOpenGL && m_result->previewMethod != EDisabled
+                && m_result->previewMethod != ECPUProgressive)
             m_result->previewMethod = EOpenGL;
         m_result->toneMappingMethod = (EToneMappingMethod) settings.value("preview_toneMappingMethod", EGamma).toInt();
         m_result->diffuseSources = settings.value("preview_diffuseSources", true).toBool();
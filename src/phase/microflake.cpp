@@ -17,6 +17,7 @@
 */
 
 #include <mitsuba/core/frame.h>
+#include <mitsuba/core/pmf.h>
 #include <mitsuba/render/phase.h>
 #include <mitsuba/render/medium.h>
 #include <mitsuba/render/sampler.h>
@@ -35,12 +36,185 @@ static StatsCounter avgSampleIterations("Micro-flake model",
         "Average rejection sampling iterations", EAverage);
 #endif
 
+/* Resolution of the tabulated sampling density: number of tabulated
+   incident angles, and grid cells along the two dimensions of the
+   flake normal parameterization */
+#define MICROFLAKE_TABLE_INCIDENT   16
+#define MICROFLAKE_TABLE_THETA      32
+#define MICROFLAKE_TABLE_PHI        64
+
+/**
+ * \brief Tabulated sampling density for the flake normals of
+ * \ref MicroflakePhaseFunction
+ *
+ * Given an incident direction \c wi (in the local fiber frame), the phase
+ * function reflects \c wi from a flake normal \c h that is distributed
+ * proportional to <tt>D(h) |wi.h|</tt>. Parameterizing \c h by the
+ * inversion method of the flake distribution <tt>D</tt> turns this into the
+ * smooth density <tt>|wi.h|</tt> on the unit square. Its maximum over each
+ * cell of a regular grid is tabulated, and the resulting piecewise constant
+ * density is sampled instead. The phase function compensates for the
+ * difference using an importance weight, which stays close to one.
+ *
+ * Due to the rotational symmetry about the fiber axis, only incident
+ * directions with <tt>phi=0</tt> and <tt>cos(theta)</tt> in [0, 1] are
+ * stored. Densities for the remaining incident angles are stochastically
+ * interpolated, so that sampling and evaluation of the density still
+ * agree exactly.
+ */
+class MicroflakeSamplingTable {
+public:
+    MicroflakeSamplingTable() { }
+
+    MicroflakeSamplingTable(const GaussianFiberDistribution &fiberDistr)
+            : m_fiberDistr(fiberDistr) {
+        const int cellCount = MICROFLAKE_TABLE_THETA * MICROFLAKE_TABLE_PHI,
+                  subsamples = 4;
+        m_distributions.resize(MICROFLAKE_TABLE_INCIDENT);
+
+        for (int i=0; i<MICROFLAKE_TABLE_INCIDENT; ++i) {
+            Float cosThetaI = i / (Float) (MICROFLAKE_TABLE_INCIDENT - 1),
+                  sinThetaI = std::sqrt(std::max((Float) 0, 1-cosThetaI*cosThetaI));
+            Vector wi(sinThetaI, 0, cosThetaI);
+
+            DiscreteDistribution &distr = m_distributions[i];
+            distr.reserve(cellCount);
+            for (int cell=0; cell<cellCount; ++cell) {
+                /* Conservatively bound |wi.h| over the cell, which
+                   keeps the importance weights close to one */
+                Float value = 0;
+                for (int j=0; j<=subsamples; ++j) {
+                    for (int k=0; k<=subsamples; ++k) {
+                        Point2 offset(j / (Float) subsamples, k / (Float) subsamples);
+                        value = std::max(value, absDot(wi, cellToNormal(cell, offset)));
+                    }
+                }
+                distr.append(value);
+            }
+            distr.normalize();
+        }
+    }
+
+    /**
+     * \brief Sample a flake normal for the given incident direction
+     *
+     * Both the incident direction and the returned normal
+     * are expressed in the local fiber frame.
+     */
+    Vector sample(const Vector &wi, Point2 sample) const {
+        Float cosPhi, sinPhi, weight;
+        int index = lookup(wi, cosPhi, sinPhi, weight);
+
+        /* Choose one of the two neighboring tables */
+        if (sample.y < 1 - weight) {
+            sample.y /= 1 - weight;
+        } else {
+            sample.y = (sample.y - (1 - weight)) / weight;
+            ++index;
+        }
+
+        int cell = (int) m_distributions[index].sampleReuse(sample.x);
+        Vector h = cellToNormal(cell, sample);
+
+        /* Undo the symmetry transformations */
+        return Vector(
+            cosPhi * h.x - sinPhi * h.y,
+            sinPhi * h.x + cosPhi * h.y,
+            wi.z < 0 ? -h.z : h.z);
+    }
+
+    /**
+     * \brief Evaluate the density of \ref sample() with respect to solid
+     * angles, summed over the flake normals \c h and \c -h
+     *
+     * Both normals reflect the incident direction into the same outgoing
+     * direction, hence the phase function does not distinguish them.
+     */
+    Float pdf(const Vector &wi, const Vector &h) const {
+        Float cosPhi, sinPhi, weight;
+        int index = lookup(wi, cosPhi, sinPhi, weight);
+
+        Vector hLocal(
+            cosPhi * h.x + sinPhi * h.y,
+           -sinPhi * h.x + cosPhi * h.y,
+            wi.z < 0 ? -h.z : h.z);
+
+        /* The cell of -h follows from the symmetry of the parameterization */
+        int x, y;
+        normalToCell(hLocal, x, y);
+        size_t cell1 = x + y * MICROFLAKE_TABLE_THETA,
+               cell2 = (MICROFLAKE_TABLE_THETA - 1 - x)
+                   + ((y + MICROFLAKE_TABLE_PHI / 2) % MICROFLAKE_TABLE_PHI)
+                   * MICROFLAKE_TABLE_THETA;
+
+        const DiscreteDistribution &distr = m_distributions[index];
+        Float value = (1 - weight) * (distr[cell1] + distr[cell2]);
+        if (weight > 0) {
+            const DiscreteDistribution &distr2 = m_distributions[index + 1];
+            value += weight * (distr2[cell1] + distr2[cell2]);
+        }
+
+        return value * (MICROFLAKE_TABLE_THETA * MICROFLAKE_TABLE_PHI)
+            * m_fiberDistr.pdf(hLocal);
+    }
+
+protected:
+    /**
+     * \brief Determine the tables that are interpolated for an incident direction
+     *
+     * \return The index of the first table, whose interpolation
+     *     weight is <tt>1-weight</tt>
+     */
+    inline int lookup(const Vector &wi, Float &cosPhi, Float &sinPhi, Float &weight) const {
+        Float sinTheta = std::sqrt(wi.x*wi.x + wi.y*wi.y);
+        if (sinTheta > 0) {
+            Float invSinTheta = 1 / sinTheta;
+            cosPhi = wi.x * invSinTheta;
+            sinPhi = wi.y * invSinTheta;
+        } else {
+            cosPhi = 1; sinPhi = 0;
+        }
+
+        Float pos = std::min(std::abs(wi.z), (Float) 1) * (MICROFLAKE_TABLE_INCIDENT - 1);
+        int index = std::min((int) pos, MICROFLAKE_TABLE_INCIDENT - 2);
+        weight = pos - index;
+        return index;
+    }
+
+    /// Map a position within a cell of the table to a flake normal
+    inline Vector cellToNormal(int cell, const Point2 &offset) const {
+        return m_fiberDistr.sample(Point2(
+            ((cell % MICROFLAKE_TABLE_THETA) + offset.x) / MICROFLAKE_TABLE_THETA,
+            ((cell / MICROFLAKE_TABLE_THETA) + offset.y) / MICROFLAKE_TABLE_PHI));
+    }
+
+    /// Inverse of \ref cellToNormal()
+    inline void normalToCell(const Vector &h, int &x, int &y) const {
+        Float phi = std::atan2(h.y, h.x);
+        if (phi < 0)
+            phi += 2 * M_PI;
+        x = math::clamp((int) (m_fiberDistr.cdf(h.z) * MICROFLAKE_TABLE_THETA),
+                0, MICROFLAKE_TABLE_THETA - 1);
+        y = math::clamp((int) (phi * (INV_TWOPI * MICROFLAKE_TABLE_PHI)),
+                0, MICROFLAKE_TABLE_PHI - 1);
+    }
+
+private:
+    GaussianFiberDistribution m_fiberDistr;
+    std::vector<DiscreteDistribution> m_distributions;
+};
+
 /*!\plugin{microflake}{Micro-flake phase function}
  * \parameters{
  *     \parameter{stddev}{\Float}{
  *       Standard deviation of the micro-flake normals. This
  *       specifies the roughness of the fibers in the medium.
  *     }
+ *     \parameter{tabulated}{\Boolean}{
+ *       Sample the phase function using a table that is precomputed
+ *       when the scene is loaded? Otherwise, rejection sampling is used.
+ *       \default{\code{true}}
+ *     }
  * }
  *
  * \renderings{
@@ -64,6 +238,13 @@ static StatsCounter avgSampleIterations("Micro-flake model",
  * Micro CT Imaging'' by Shuang Zhao, Wenzel Jakob, Steve Marschner,
  * and Kavita Bala \cite{Zhao2011Building}.
  *
+ * The rejection sampling method becomes very inefficient when
+ * \code{stddev} is small, since most flake normals that are proposed are
+ * nearly perpendicular to the incident direction. By default, the plugin
+ * therefore samples from a tabulated density, which closely approximates
+ * the phase function and has a bounded cost per sample. The
+ * phase function itself is always evaluated exactly.
+ *
  * Note: this phase function must be used with a medium that specifies
  * the local fiber orientation at different points in space. Please
  * refer to \pluginref{heterogeneous} for details.
@@ -82,11 +263,14 @@ public:
     MicroflakePhaseFunction(const Properties &props) : PhaseFunction(props) {
         /// Standard deviation of the flake distribution
         m_fiberDistr = GaussianFiberDistribution(props.getFloat("stddev"));
+        /// Sample from a precomputed table instead of using rejection sampling?
+        m_tabulated = props.getBoolean("tabulated", true);
     }
 
     MicroflakePhaseFunction(Stream *stream, InstanceManager *manager)
         : PhaseFunction(stream, manager) {
         m_fiberDistr = GaussianFiberDistribution(stream->readFloat());
+        m_tabulated = stream->readBool();
         configure();
     }
 
@@ -95,11 +279,42 @@ public:
     void configure() {
         PhaseFunction::configure();
         m_type = EAnisotropic | ENonSymmetric;
+        if (m_tabulated)
+            m_table = MicroflakeSamplingTable(m_fiberDistr);
     }
 
     void serialize(Stream *stream, InstanceManager *manager) const {
         PhaseFunction::serialize(stream, manager);
         stream->writeFloat(m_fiberDistr.getStdDev());
+        stream->writeBool(m_tabulated);
+    }
+
+    /// Evaluate the phase function in the local fiber frame
+    inline Float evalLocal(const Vector &wi, const Vector &wo) const {
+        Vector H = wi + wo;
+        Float length = H.length();
+
+        if (length == 0)
+            return 0.0f;
+
+        return 0.5f * m_fiberDistr.pdfCosTheta(Frame::cosTheta(H)/length)
+                / m_fiberDistr.sigmaT(Frame::cosTheta(wi));
+    }
+
+    /// Density of the tabulated sampling method in the local fiber frame
+    inline Float pdfLocal(const Vector &wi, const Vector &wo) const {
+        Vector H = wi + wo;
+        Float length = H.length();
+
+        if (length == 0)
+            return 0.0f;
+
+        H /= length;
+        Float dp = absDot(wi, H);
+        if (dp == 0)
+            return 0.0f;
+
+        return m_table.pdf(wi, H) / (4 * dp);
     }
 
     Float eval(const PhaseFunctionSamplingRecord &pRec) const {
@@ -113,16 +328,35 @@ public:
         }
 
         Frame frame(pRec.mRec.orientation);
-        Vector wi = frame.toLocal(pRec.wi);
-        Vector wo = frame.toLocal(pRec.wo);
-        Vector H = wi + wo;
-        Float length = H.length();
+        return evalLocal(frame.toLocal(pRec.wi), frame.toLocal(pRec.wo));
+    }
 
-        if (length == 0)
+    Float pdf(const PhaseFunctionSamplingRecord &pRec) const {
+        if (!m_tabulated)
+            return eval(pRec);
+        else if (pRec.mRec.orientation.isZero())
             return 0.0f;
 
-        return 0.5f * m_fiberDistr.pdfCosTheta(Frame::cosTheta(H)/length)
-                / m_fiberDistr.sigmaT(Frame::cosTheta(wi));
+        Frame frame(pRec.mRec.orientation);
+        return pdfLocal(frame.toLocal(pRec.wi), frame.toLocal(pRec.wo));
+    }
+
+    /// Sample from the precomputed table, returns the importance weight and density
+    inline Float sampleTabulated(PhaseFunctionSamplingRecord &pRec,
+            Float &pdf, Sampler *sampler) const {
+        Frame frame(pRec.mRec.orientation);
+        Vector wi = frame.toLocal(pRec.wi);
+        Vector H = m_table.sample(wi, sampler->next2D());
+        pRec.wo = frame.toWorld(H*(2*dot(wi, H)) - wi);
+
+        /* Evaluate the density exactly as pdf() does. The table is piecewise
+           constant, hence round-off from the change of frame could otherwise
+           place the half vector in a neighboring cell */
+        Vector wo = frame.toLocal(pRec.wo);
+        pdf = pdfLocal(wi, wo);
+        if (pdf == 0)
+            return 0.0f;
+        return evalLocal(wi, wo) / pdf;
     }
 
     inline Float sample(PhaseFunctionSamplingRecord &pRec, Sampler *sampler) const {
@@ -136,6 +370,11 @@ public:
             #endif
         }
 
+        if (m_tabulated) {
+            Float pdf;
+            return sampleTabulated(pRec, pdf, sampler);
+        }
+
         Frame frame(pRec.mRec.orientation);
         Vector wi = frame.toLocal(pRec.wi);
 
@@ -172,6 +411,9 @@ public:
 
     Float sample(PhaseFunctionSamplingRecord &pRec,
             Float &pdf, Sampler *sampler) const {
+        if (m_tabulated && !pRec.mRec.orientation.isZero())
+            return sampleTabulated(pRec, pdf, sampler);
+
         if (sample(pRec, sampler) == 0) {
             pdf = 0; return 0.0f;
         }
@@ -194,7 +436,8 @@ public:
     std::string toString() const {
         std::ostringstream oss;
         oss << "MicroflakePhaseFunction[" << endl
-            << "   fiberDistr = " << indent(m_fiberDistr.toString()) << endl
+            << "   fiberDistr = " << indent(m_fiberDistr.toString()) << "," << endl
+            << "   tabulated = " << m_tabulated << endl
             << "]";
         return oss.str();
     }
@@ -202,6 +445,8 @@ public:
     MTS_DECLARE_CLASS()
 private:
     GaussianFiberDistribution m_fiberDistr;
+    MicroflakeSamplingTable m_table;
+    bool m_tabulated;
 };
 
 MTS_IMPLEMENT_CLASS_S(MicroflakePhaseFunction, false, PhaseFunction)
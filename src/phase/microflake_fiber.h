@@ -20,8 +20,6 @@
 #define __MICROFLAKE_FIBER_DIST_H
 
 #include <mitsuba/core/statistics.h>
-#include <mitsuba/core/brent.h>
-#include <boost/bind.hpp>
 #include <boost/math/special_functions/erf.hpp>
 
 MTS_NAMESPACE_BEGIN
@@ -181,11 +179,6 @@ double sigmaT_fiberDist(double stddev, double sinTheta) {
     return result;
 }
 
-#if defined(MICROFLAKE_STATISTICS)
-static StatsCounter avgBrentFunEvals("Micro-flake model",
-        "Average Brent solver function evaluations", EAverage);
-#endif
-
 
 /**
  * \brief Flake distribution for simulating rough fibers
@@ -255,19 +248,17 @@ public:
     /**
      * \brief Apply the inversion method to sample \cos\theta given
      * a uniformly distributed r.v. \xi on [0, 1]
+     *
+     * This is the inverse of \ref cdf().
      */
-    Vector sample(const Point2 &sample) const {
-        BrentSolver brentSolver(100, 1e-6f);
-        BrentSolver::Result result = brentSolver.solve(
-            boost::bind(&GaussianFiberDistribution::cdfFunctor,
-                this, sample.x, _1), -1, 1);
-        SAssert(result.success);
-
-        #if defined(MICROFLAKE_STATISTICS)
-            avgBrentFunEvals.incrementBase();
-        #endif
+    inline Float sampleCosTheta(Float xi) const {
+        Float cosTheta = SQRT_TWO * m_stddev * math::erfinv((1 - 2*xi) / m_c1);
+        return math::clamp(cosTheta, (Float) -1, (Float) 1);
+    }
 
-        Float cosTheta = result.x,
+    /// Sample a flake normal given a uniformly distributed point on [0, 1]^2
+    Vector sample(const Point2 &sample) const {
+        Float cosTheta = sampleCosTheta(sample.x),
               sinTheta = std::sqrt(std::max((Float) 0, 1-cosTheta*cosTheta)),
               phi = 2 * M_PI * sample.y,
               sinPhi = std::sin(phi), cosPhi = std::cos(phi);
@@ -275,6 +266,17 @@ public:
         return Vector(sinTheta * cosPhi, sinTheta * sinPhi, cosTheta);
     }
 
+    /**
+     * \brief Evaluate the longitudinal CDF as a function of \cos\theta
+     *
+     * The CDF is accumulated starting from \cos\theta=1, i.e. it
+     * decreases from 1 to 0 on the interval [-1, 1].
+     */
+    inline Float cdf(Float cosTheta) const {
+        return 0.5f * (1.0f -
+            mts_erf(cosTheta / (SQRT_TWO * m_stddev)) * m_c1);
+    }
+
     inline Float getStdDev() const { return m_stddev; }
 
     std::string toString() const {
@@ -283,20 +285,6 @@ public:
             << m_stddev << "]";
         return oss.str();
     }
-protected:
-    /// Evaluate the longitudinal CDF as a function of \cos\theta
-    inline Float cdf(Float cosTheta) const {
-        return 0.5f * (1.0f -
-            mts_erf(cosTheta / (SQRT_TWO * m_stddev)) * m_c1);
-    }
-
-    Float cdfFunctor(Float xi, Float cosTheta) const {
-        #if defined(MICROFLAKE_STATISTICS)
-            ++avgBrentFunEvals;
-        #endif
-        return cdf(cosTheta)-xi;
-    }
-
 protected:
     Float m_stddev;
     Float m_normalization;
@@ -159,6 +159,7 @@ public:
     ref<Sampler> clone() {
         ref<HaltonSampler> sampler = new HaltonSampler();
         sampler->m_sampleCount = m_sampleCount;
+        sampler->m_deterministic = m_deterministic;
         sampler->m_sampleIndex = m_sampleIndex;
         sampler->m_dimension = m_dimension;
         sampler->m_arrayStartDim = m_arrayStartDim;
@@ -17,9 +17,13 @@
 */
 
 #include <mitsuba/render/sampler.h>
+#include <boost/static_assert.hpp>
 
 MTS_NAMESPACE_BEGIN
 
+/// Number of random numbers that are generated at a time by next1D()/next2D()
+#define MTS_INDEPENDENT_CACHE_SIZE 64
+
 /*!\plugin{independent}{Independent sampler}
  * \order{1}
  * \parameters{
@@ -50,27 +54,39 @@ MTS_NAMESPACE_BEGIN
  */
 class IndependentSampler : public Sampler {
 public:
-    IndependentSampler() : Sampler(Properties()) { }
+    IndependentSampler() : Sampler(Properties()) {
+        m_cacheIndex = MTS_INDEPENDENT_CACHE_SIZE;
+    }
 
     IndependentSampler(const Properties &props) : Sampler(props) {
         /* Number of samples per pixel when used with a sampling-based integrator */
         m_sampleCount = props.getSize("sampleCount", 4);
         m_random = new Random();
+        m_cacheIndex = MTS_INDEPENDENT_CACHE_SIZE;
     }
 
     IndependentSampler(Stream *stream, InstanceManager *manager)
      : Sampler(stream, manager) {
         m_random = static_cast<Random *>(manager->getInstance(stream));
+        m_cacheIndex = stream->readSize();
+        stream->readFloatArray(m_cache + m_cacheIndex,
+            MTS_INDEPENDENT_CACHE_SIZE - m_cacheIndex);
     }
 
     void serialize(Stream *stream, InstanceManager *manager) const {
         Sampler::serialize(stream, manager);
         manager->serialize(stream, m_random.get());
+        /* Include the unused random numbers, so that the
+           unserialized sampler continues the same sequence */
+        stream->writeSize(m_cacheIndex);
+        stream->writeFloatArray(m_cache + m_cacheIndex,
+            MTS_INDEPENDENT_CACHE_SIZE - m_cacheIndex);
     }
 
     ref<Sampler> clone() {
         ref<IndependentSampler> sampler = new IndependentSampler();
         sampler->m_sampleCount = m_sampleCount;
+        sampler->m_deterministic = m_deterministic;
         sampler->m_random = new Random(m_random);
         for (size_t i=0; i<m_req1D.size(); ++i)
             sampler->request1DArray(m_req1D[i]);
@@ -79,27 +95,54 @@ public:
         return sampler.get();
     }
 
-    void generate(const Point2i &) {
+    void generate(const Point2i &offset) {
+        /* Point2 is a pair of Floats, hence the 2D arrays can
+           be filled in one go as well */
+        BOOST_STATIC_ASSERT(sizeof(Point2) == 2 * sizeof(Float));
+
+        if (m_deterministic) {
+            /* The sample arrays only depend on the pixel */
+            setPixelKey(offset);
+            if (!m_req1D.empty() || !m_req2D.empty())
+                m_random->seed(m_pixelKey);
+        }
+
         for (size_t i=0; i<m_req1D.size(); i++)
-            for (size_t j=0; j<m_sampleCount * m_req1D[i]; ++j)
-                m_sampleArrays1D[i][j] = m_random->nextFloat();
+            m_random->nextFloat(m_sampleArrays1D[i], m_sampleCount * m_req1D[i]);
         for (size_t i=0; i<m_req2D.size(); i++)
-            for (size_t j=0; j<m_sampleCount * m_req2D[i]; ++j)
-                m_sampleArrays2D[i][j] = Point2(
-                    m_random->nextFloat(),
-                    m_random->nextFloat());
+            m_random->nextFloat(reinterpret_cast<Float *>(m_sampleArrays2D[i]),
+                2 * m_sampleCount * m_req2D[i]);
         m_sampleIndex = 0;
         m_dimension1DArray = m_dimension2DArray = 0;
+        if (m_deterministic)
+            setSampleKey();
     }
 
     Float next1D() {
-        return m_random->nextFloat();
+        if (m_deterministic)
+            return nextKeyed();
+        if (EXPECT_NOT_TAKEN(m_cacheIndex == MTS_INDEPENDENT_CACHE_SIZE))
+            refill();
+        return m_cache[m_cacheIndex++];
     }
 
     Point2 next2D() {
-        Float value1 = m_random->nextFloat();
-        Float value2 = m_random->nextFloat();
-        return Point2(value1, value2);
+        if (m_deterministic) {
+            Float x = nextKeyed();
+            return Point2(x, nextKeyed());
+        }
+        if (EXPECT_NOT_TAKEN(m_cacheIndex + 2 > MTS_INDEPENDENT_CACHE_SIZE))
+            refill();
+        Point2 result(m_cache[m_cacheIndex], m_cache[m_cacheIndex+1]);
+        m_cacheIndex += 2;
+        return result;
+    }
+
+    void skip(size_t count1D, size_t count2D) {
+        /* Without a key, the values don't depend on the sample index
+           and there is nothing to skip */
+        if (m_deterministic)
+            m_keyCounter += (uint32_t) (count1D + 2 * count2D);
     }
 
     std::string toString() const {
@@ -111,8 +154,17 @@ public:
     }
 
     MTS_DECLARE_CLASS()
+private:
+    /// Generate a new batch of random numbers for next1D()/next2D()
+    void refill() {
+        m_random->nextFloat(m_cache, MTS_INDEPENDENT_CACHE_SIZE);
+        m_cacheIndex = 0;
+    }
+
 private:
     ref<Random> m_random;
+    Float m_cache[MTS_INDEPENDENT_CACHE_SIZE];
+    size_t m_cacheIndex;
 };
 
 MTS_IMPLEMENT_CLASS_S(IndependentSampler, false, Sampler)
@@ -129,6 +129,7 @@ public:
         ref<LowDiscrepancySampler> sampler = new LowDiscrepancySampler();
 
         sampler->m_sampleCount = m_sampleCount;
+        sampler->m_deterministic = m_deterministic;
         sampler->m_maxDimension = m_maxDimension;
         sampler->m_random = new Random(m_random);
         sampler->m_samples1D = new Float*[m_maxDimension];
@@ -182,7 +183,13 @@ public:
         m_random->shuffle(samples, samples + sampleCount);
     }
 
-    void generate(const Point2i &) {
+    void generate(const Point2i &offset) {
+        if (m_deterministic) {
+            /* The scrambles and permutations only depend on the pixel */
+            setPixelKey(offset);
+            m_random->seed(m_pixelKey);
+        }
+
         for (size_t i=0; i<m_maxDimension; ++i) {
             generate1D(m_samples1D[i], m_sampleCount);
             generate2D(m_samples2D[i], m_sampleCount);
@@ -197,24 +204,44 @@ public:
         m_sampleIndex = 0;
         m_dimension1D = m_dimension2D = 0;
         m_dimension1DArray = m_dimension2DArray = 0;
+        if (m_deterministic)
+            setSampleKey();
     }
 
     void advance() {
         m_sampleIndex++;
         m_dimension1D = m_dimension2D = 0;
         m_dimension1DArray = m_dimension2DArray = 0;
+        if (m_deterministic)
+            setSampleKey();
     }
 
     void setSampleIndex(size_t sampleIndex) {
         m_sampleIndex = sampleIndex;
         m_dimension1D = m_dimension2D = 0;
         m_dimension1DArray = m_dimension2DArray = 0;
+        if (m_deterministic)
+            setSampleKey();
+    }
+
+    void skip(size_t count1D, size_t count2D) {
+        /* Values beyond the precomputed dimensions are pseudorandom */
+        size_t lds1D = m_dimension1D < m_maxDimension
+            ? std::min(count1D, m_maxDimension - m_dimension1D) : 0;
+        size_t lds2D = m_dimension2D < m_maxDimension
+            ? std::min(count2D, m_maxDimension - m_dimension2D) : 0;
+        m_dimension1D += lds1D;
+        m_dimension2D += lds2D;
+        if (m_deterministic)
+            m_keyCounter += (uint32_t) ((count1D - lds1D) + 2 * (count2D - lds2D));
     }
 
     Float next1D() {
         Assert(m_sampleIndex < m_sampleCount);
         if (m_dimension1D < m_maxDimension)
             return m_samples1D[m_dimension1D++][m_sampleIndex];
+        else if (m_deterministic)
+            return nextKeyed();
         else
             return m_random->nextFloat();
     }
@@ -223,7 +250,10 @@ public:
         Assert(m_sampleIndex < m_sampleCount);
         if (m_dimension2D < m_maxDimension)
             return m_samples2D[m_dimension2D++][m_sampleIndex];
-        else
+        else if (m_deterministic) {
+            Float x = nextKeyed();
+            return Point2(x, nextKeyed());
+        } else
             return Point2(m_random->nextFloat(), m_random->nextFloat());
     }
 
@@ -125,6 +125,7 @@ public:
     ref<Sampler> clone() {
         ref<StratifiedSampler> sampler = new StratifiedSampler();
         sampler->m_sampleCount = m_sampleCount;
+        sampler->m_deterministic = m_deterministic;
         sampler->m_maxDimension = m_maxDimension;
         sampler->m_resolution = m_resolution;
         sampler->m_invResolution = m_invResolution;
@@ -144,7 +145,13 @@ public:
         return sampler.get();
     }
 
-    void generate(const Point2i &) {
+    void generate(const Point2i &offset) {
+        if (m_deterministic) {
+            /* The permutations only depend on the pixel */
+            setPixelKey(offset);
+            m_random->seed(m_pixelKey);
+        }
+
         for (int i=0; i<m_maxDimension; i++) {
             for (size_t j=0; j<m_sampleCount; j++)
                 m_permutations1D[i][j] = (uint32_t) j;
@@ -164,27 +171,33 @@ public:
         m_sampleIndex = 0;
         m_dimension1D = m_dimension2D = 0;
         m_dimension1DArray = m_dimension2DArray = 0;
+        if (m_deterministic)
+            setSampleKey();
     }
 
     void setSampleIndex(size_t sampleIndex) {
         m_sampleIndex = sampleIndex;
         m_dimension1D = m_dimension2D = 0;
         m_dimension1DArray = m_dimension2DArray = 0;
+        if (m_deterministic)
+            setSampleKey();
     }
 
     void advance() {
         m_sampleIndex++;
         m_dimension1D = m_dimension2D = 0;
         m_dimension1DArray = m_dimension2DArray = 0;
+        if (m_deterministic)
+            setSampleKey();
     }
 
     Float next1D() {
         Assert(m_sampleIndex < m_sampleCount);
         if (m_dimension1D < m_maxDimension) {
             int k = m_permutations1D[m_dimension1D++][m_sampleIndex];
-            return (k + m_random->nextFloat()) * m_invResolutionSquare;
+            return (k + nextRandom()) * m_invResolutionSquare;
         } else {
-            return m_random->nextFloat();
+            return nextRandom();
         }
     }
 
@@ -194,15 +207,14 @@ public:
             int k = m_permutations2D[m_dimension2D++][m_sampleIndex];
             int x = k % m_resolution;
             int y = k / m_resolution;
+            Float jitterX = nextRandom();
             return Point2(
-                (x + m_random->nextFloat()) * m_invResolution,
-                (y + m_random->nextFloat()) * m_invResolution
+                (x + jitterX) * m_invResolution,
+                (y + nextRandom()) * m_invResolution
             );
         } else {
-            return Point2(
-                m_random->nextFloat(),
-                m_random->nextFloat()
-            );
+            Float value = nextRandom();
+            return Point2(value, nextRandom());
         }
     }
 
@@ -219,6 +231,20 @@ public:
     }
 
     MTS_DECLARE_CLASS()
+private:
+    /// Return a pseudorandom number for jittering the current sample
+    void skip(size_t count1D, size_t count2D) {
+        m_dimension1D = (int) std::min((size_t) m_maxDimension, m_dimension1D + count1D);
+        m_dimension2D = (int) std::min((size_t) m_maxDimension, m_dimension2D + count2D);
+        /* Every 1D value takes one random number and every 2D value two */
+        if (m_deterministic)
+            m_keyCounter += (uint32_t) (count1D + 2 * count2D);
+    }
+
+    inline Float nextRandom() {
+        return m_deterministic ? nextKeyed() : m_random->nextFloat();
+    }
+
 private:
     ref<Random> m_random;
     int m_resolution;
@@ -21,6 +21,9 @@
 #include <mitsuba/core/track.h>
 #include <mitsuba/core/frame.h>
 #include <mitsuba/core/warp.h>
+#if defined(MTS_SSE)
+#include <mitsuba/core/ray_sse.h>
+#endif
 
 MTS_NAMESPACE_BEGIN
 
@@ -178,6 +181,61 @@ public:
         return Spectrum(1.0f);
     }
 
+#if defined(MTS_SSE)
+    void sampleRayDifferentials(size_t count, const Point2 *samplePositions,
+            const Point2 *apertureSamples, const Float *timeSamples,
+            RayDifferential *rays, Spectrum *weights) const {
+        if (!m_worldTransform->isStatic()) {
+            ProjectiveCamera::sampleRayDifferentials(count, samplePositions,
+                apertureSamples, timeSamples, rays, weights);
+            return;
+        }
+
+        /* Same computation as in sampleRayDifferential(), but for
+           four rays at a time in SoA layout */
+        const Transform &trafo = m_worldTransform->eval(0);
+        const Matrix4x4 &toWorld = trafo.getMatrix(),
+                        &sampleToCamera = m_sampleToCamera.getMatrix();
+        Vector d = normalize(trafo(Vector(0, 0, 1)));
+
+        RayDifferentialPacket4 packet;
+        for (int k=0; k<3; ++k)
+            packet.d[k] = packet.rxDirection[k] = packet.ryDirection[k] = SSEVector(d[k]);
+        packet.mint = SSEVector(m_nearClip);
+        packet.maxt = SSEVector(m_farClip);
+
+        for (size_t i=0; i<count; i += 4) {
+            size_t packetSize = std::min(count - i, (size_t) 4);
+            QuadVector nearP, px, py;
+
+            for (size_t j=0; j<4; ++j) {
+                /* Unused lanes replicate the last ray */
+                size_t idx = i + std::min(j, packetSize - 1);
+                nearP[0].f[j] = samplePositions[idx].x * m_invResolution.x;
+                nearP[1].f[j] = samplePositions[idx].y * m_invResolution.y;
+                packet.time.f[j] = sampleTime(timeSamples ? timeSamples[idx] : 0.5f);
+            }
+            nearP[2] = SSEConstants::zero;
+
+            transformAffine4(sampleToCamera, nearP, nearP);
+            nearP[2] = SSEConstants::zero;
+
+            for (int k=0; k<3; ++k) {
+                px[k].ps = _mm_add_ps(nearP[k].ps, _mm_set1_ps(m_dx[k]));
+                py[k].ps = _mm_add_ps(nearP[k].ps, _mm_set1_ps(m_dy[k]));
+            }
+
+            transformAffine4(toWorld, nearP, packet.o);
+            transformPoint4(toWorld, px, packet.rxOrigin);
+            transformPoint4(toWorld, py, packet.ryOrigin);
+            packet.store(rays + i, packetSize);
+
+            for (size_t j=0; j<packetSize; ++j)
+                weights[i+j] = Spectrum(1.0f);
+        }
+    }
+#endif
+
     Spectrum samplePosition(PositionSamplingRecord &pRec,
             const Point2 &sample, const Point2 *extra) const {
         const Transform &trafo = m_worldTransform->eval(pRec.time);
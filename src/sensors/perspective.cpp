@@ -20,6 +20,9 @@
 #include <mitsuba/render/medium.h>
 #include <mitsuba/core/track.h>
 #include <mitsuba/core/frame.h>
+#if defined(MTS_SSE)
+#include <mitsuba/core/ray_sse.h>
+#endif
 
 MTS_NAMESPACE_BEGIN
 
@@ -297,6 +300,68 @@ public:
         return Spectrum(1.0f);
     }
 
+#if defined(MTS_SSE)
+    void sampleRayDifferentials(size_t count, const Point2 *samplePositions,
+            const Point2 *apertureSamples, const Float *timeSamples,
+            RayDifferential *rays, Spectrum *weights) const {
+        if (!m_worldTransform->isStatic()) {
+            PerspectiveCamera::sampleRayDifferentials(count, samplePositions,
+                apertureSamples, timeSamples, rays, weights);
+            return;
+        }
+
+        /* Same computation as in sampleRayDifferential(), but for
+           four rays at a time in SoA layout */
+        const Transform &trafo = m_worldTransform->eval(0);
+        const Matrix4x4 &toWorld = trafo.getMatrix(),
+                        &sampleToCamera = m_sampleToCamera.getMatrix();
+        Point origin = trafo.transformAffine(Point(0.0f));
+        const __m128 nearClip = _mm_set1_ps(m_nearClip),
+                     farClip = _mm_set1_ps(m_farClip);
+
+        RayDifferentialPacket4 packet;
+        for (int k=0; k<3; ++k)
+            packet.o[k] = packet.rxOrigin[k] = packet.ryOrigin[k] = SSEVector(origin[k]);
+
+        for (size_t i=0; i<count; i += 4) {
+            size_t packetSize = std::min(count - i, (size_t) 4);
+            QuadVector nearP, d, dx, dy;
+
+            for (size_t j=0; j<4; ++j) {
+                /* Unused lanes replicate the last ray */
+                size_t idx = i + std::min(j, packetSize - 1);
+                nearP[0].f[j] = samplePositions[idx].x * m_invResolution.x;
+                nearP[1].f[j] = samplePositions[idx].y * m_invResolution.y;
+                packet.time.f[j] = sampleTime(timeSamples ? timeSamples[idx] : 0.5f);
+            }
+            nearP[2] = SSEConstants::zero;
+
+            transformPoint4(sampleToCamera, nearP, nearP);
+
+            for (int k=0; k<3; ++k) {
+                d[k] = nearP[k];
+                dx[k].ps = _mm_add_ps(nearP[k].ps, _mm_set1_ps(m_dx[k]));
+                dy[k].ps = _mm_add_ps(nearP[k].ps, _mm_set1_ps(m_dy[k]));
+            }
+            normalize4(d);
+            normalize4(dx);
+            normalize4(dy);
+
+            __m128 invZ = _mm_div_ps(SSEConstants::one.ps, d[2].ps);
+            packet.mint.ps = _mm_mul_ps(nearClip, invZ);
+            packet.maxt.ps = _mm_mul_ps(farClip, invZ);
+
+            transformVector4(toWorld, d, packet.d);
+            transformVector4(toWorld, dx, packet.rxDirection);
+            transformVector4(toWorld, dy, packet.ryDirection);
+            packet.store(rays + i, packetSize);
+
+            for (size_t j=0; j<packetSize; ++j)
+                weights[i+j] = Spectrum(1.0f);
+        }
+    }
+#endif
+
     Spectrum samplePosition(PositionSamplingRecord &pRec,
             const Point2 &sample, const Point2 *extra) const {
         const Transform &trafo = m_worldTransform->eval(pRec.time);
@@ -20,9 +20,15 @@
 #include <mitsuba/render/medium.h>
 #include <mitsuba/core/track.h>
 #include <mitsuba/core/frame.h>
+#if defined(MTS_SSE)
+#include <mitsuba/core/ray_sse.h>
+#endif
 
 MTS_NAMESPACE_BEGIN
 
+/// Number of intervals in the table used to invert the distortion model
+#define RDIST_TABLE_SIZE 512
+
 /*!\plugin[perspectiverdist]{perspective\_rdist}{Perspective pinhole camera with radial distortion}
  * \order{8}
  * \parameters{
@@ -88,6 +94,10 @@ MTS_NAMESPACE_BEGIN
  * turns into a standard pinhole camera. The reason for creating a separate
  * plugin for this feature is that distortion involves extra overheads per ray that
  * users may not be willing to pay for if their scene doesn't use it.
+ * To keep these overheads small, the inverse of the distortion model is
+ * tabulated over the visible part of the image plane when the scene is
+ * loaded; ray generation then only requires a table lookup followed by a
+ * single Newton step.
  * The MATLAB Camera Calibration Toolbox by Jean-Yves Bouguet
  * (\url{http://www.vision.caltech.edu/bouguetj/calib_doc/}) can be used to
  * obtain a distortion model, and the first entries of the \code{kc} variable
@@ -127,10 +137,10 @@ public:
 
     PerspectiveCameraRDist(Stream *stream, InstanceManager *manager)
             : PerspectiveCamera(stream, manager) {
-        configure();
         m_kc[0] = stream->readFloat();
         m_kc[1] = stream->readFloat();
         m_distortion = m_kc[0] != 0 || m_kc[1] != 0;
+        configure();
     }
 
     void serialize(Stream *stream, InstanceManager *manager) const {
@@ -172,12 +182,6 @@ public:
 
         m_sampleToCamera = m_cameraToSample.inverse();
 
-        /* Position differentials on the near plane */
-        m_dx = m_sampleToCamera(Point(m_invResolution.x, 0.0f, 0.0f))
-             - m_sampleToCamera(Point(0.0f));
-        m_dy = m_sampleToCamera(Point(0.0f, m_invResolution.y, 0.0f))
-             - m_sampleToCamera(Point(0.0f));
-
         /* Precompute some data for importance(). Please
            look at that function for further details */
         Point min(m_sampleToCamera(Point(0, 0, 0))),
@@ -188,32 +192,127 @@ public:
         m_imageRect.expandBy(Point2(max.x, max.y) / max.z);
         m_normalization = 1.0f / m_imageRect.getVolume();
 
+        /* The mapping from sample space to the plane z=1 is affine */
+        m_planeOrigin = Point2(min.x, min.y) / min.z;
+        m_planeScale = Point2(max.x, max.y) / max.z - m_planeOrigin;
+
+        /* Position differentials on the plane z=1 */
+        m_dxPlane = Vector(m_planeScale.x * m_invResolution.x, 0.0f, 0.0f);
+        m_dyPlane = Vector(0.0f, m_planeScale.y * m_invResolution.y, 0.0f);
+
         /* Clip-space transformation for OpenGL */
         m_clipTransform = Transform::translate(
             Vector((1-2*relOffset.x)/relSize.x - 1,
                   -(1-2*relOffset.y)/relSize.y + 1, 0.0f)) *
             Transform::scale(Vector(1.0f / relSize.x, 1.0f / relSize.y, 1.0f));
+
+        precomputeInverseDistortion();
+    }
+
+    /**
+     * \brief Tabulate the inverse of the distortion model
+     *
+     * The table covers the radii of all points within the image
+     * rectangle (plus a small margin) on the plane <tt>z=1</tt>. The
+     * entries are computed using Newton's method, which is started from
+     * the previous entry so that the table follows a single monotone
+     * branch of the model.
+     */
+    void precomputeInverseDistortion() {
+        m_invDistortion.clear();
+        m_invDistortionScale = 0;
+        if (!m_distortion)
+            return;
+
+        double yMax = 0;
+        for (int i=0; i<4; ++i)
+            yMax = std::max(yMax, (double) Vector2(m_imageRect.getCorner(i)).length());
+        yMax *= 1.1;
+
+        std::vector<Float> table(RDIST_TABLE_SIZE + 1);
+        double r = 0, k0 = m_kc[0], k1 = m_kc[1];
+        for (int i=0; i<=RDIST_TABLE_SIZE; ++i) {
+            double y = yMax * i / RDIST_TABLE_SIZE;
+
+            for (int it=0; it<50; ++it) {
+                double r2 = r*r,
+                       f  = r*(1+r2*(k0 + r2*k1)) - y,
+                       df = 1 + r2*(3*k0 + 5*k1*r2);
+
+                if (df <= 0) {
+                    Log(EWarn, "The distortion model is not invertible within "
+                        "the field of view -- not using a lookup table.");
+                    return;
+                }
+
+                r -= f / df;
+                if (std::abs(f) < 1e-12)
+                    break;
+            }
+
+            table[i] = (Float) r;
+        }
+
+        m_invDistortion.swap(table);
+        m_invDistortionScale = (Float) (RDIST_TABLE_SIZE / yMax);
     }
 
     Float applyDistortion(Float r2) const {
         return 1 + r2*(m_kc[0] + r2*m_kc[1]);
     }
 
+    /**
+     * \brief Map a position in fractional sample space (i.e. [0,1]^2) to
+     * the corresponding undistorted position on the plane <tt>z=1</tt>
+     */
+    inline Vector sampleToPlane(Float x, Float y) const {
+        Vector p(m_planeOrigin.x + x * m_planeScale.x,
+                 m_planeOrigin.y + y * m_planeScale.y, 1.0f);
+
+        if (m_distortion) {
+            Float correction = invertDistortion(std::sqrt(p.x*p.x + p.y*p.y));
+            p.x *= correction; p.y *= correction;
+        }
+
+        return p;
+    }
+
+    /**
+     * \brief Given a distorted radius \c y on the plane <tt>z=1</tt>,
+     * return the factor that maps it to the undistorted radius
+     */
     Float invertDistortion(Float y) const {
-        int it = 0;
-        Float r = y;
+        Float r, pos = y * m_invDistortionScale;
+
+        if (EXPECT_TAKEN(pos < RDIST_TABLE_SIZE && !m_invDistortion.empty())) {
+            /* Interpolate the table and refine using a single Newton step */
+            int idx = (int) pos;
+            Float weight = pos - idx;
+            r = (1 - weight) * m_invDistortion[idx]
+                + weight * m_invDistortion[idx+1];
 
-        while (true) {
             Float r2 = r*r,
                   f  = r*(1+r2*(m_kc[0] + r2*m_kc[1])) - y,
                   df = 1 + r2*(3*m_kc[0] + 5*m_kc[1]*r2);
 
             r -= f / df;
+        } else {
+            int it = 0;
+            r = y;
+
+            while (true) {
+                Float r2 = r*r,
+                      f  = r*(1+r2*(m_kc[0] + r2*m_kc[1])) - y,
+                      df = 1 + r2*(3*m_kc[0] + 5*m_kc[1]*r2);
+
+                r -= f / df;
 
-            if (std::abs(f) < 1e-6 || ++it > 4)
-                break;
+                if (std::abs(f) < 1e-6 || ++it > 4)
+                    break;
+            }
         }
-        return r/y;
+
+        return y > 0 ? r/y : (Float) 1;
     }
 
     /**
@@ -298,25 +397,18 @@ public:
         ray.time = sampleTime(timeSample);
 
         /* Compute the corresponding position on the
-           near plane (in local camera space) */
-        Point nearP = m_sampleToCamera(Point(
+           plane z=1 (in local camera space) */
+        Vector planeP = sampleToPlane(
             pixelSample.x * m_invResolution.x,
-            pixelSample.y * m_invResolution.y, 0.0f));
-
-        if (m_distortion) {
-            Float correction = invertDistortion(Vector2(nearP.x / nearP.z, nearP.y / nearP.z).length());
-            nearP.x *= correction; nearP.y *= correction;
-        }
+            pixelSample.y * m_invResolution.y);
 
         /* Turn that into a normalized ray direction, and
            adjust the ray interval accordingly */
-        Vector d = normalize(Vector(nearP));
-        Float invZ = 1.0f / d.z;
-
-        ray.mint = m_nearClip * invZ;
-        ray.maxt = m_farClip * invZ;
+        Float length = planeP.length();
+        Vector d = planeP / length;
 
-        Point2 p(d.x * invZ, d.y * invZ);
+        ray.mint = m_nearClip * length;
+        ray.maxt = m_farClip * length;
 
         const Transform &trafo = m_worldTransform->eval(ray.time);
         ray.setOrigin(trafo.transformAffine(Point(0.0f)));
@@ -329,37 +421,165 @@ public:
             const Point2 &otherSample, Float timeSample) const {
         ray.time = sampleTime(timeSample);
 
-        /* Compute the corresponding position on the
-           near plane (in local camera space) */
-        Point nearP = m_sampleToCamera(Point(
+        /* Compute the corresponding position on the plane z=1 (in local
+           camera space). Ray differentials don't take distortion into account */
+        Vector planeP = sampleToPlane(
             pixelSample.x * m_invResolution.x,
-            pixelSample.y * m_invResolution.y, 0.0f));
-
-        if (m_distortion) {
-            /* Ray differentials don't take distortion into account */
-            Float correction = invertDistortion(Vector2(nearP.x / nearP.z, nearP.y / nearP.z).length());
-            nearP.x *= correction; nearP.y *= correction;
-        }
+            pixelSample.y * m_invResolution.y);
 
         /* Turn that into a normalized ray direction, and
            adjust the ray interval accordingly */
-        Vector d = normalize(Vector(nearP));
-        Float invZ = 1.0f / d.z;
-        ray.mint = m_nearClip * invZ;
-        ray.maxt = m_farClip * invZ;
+        Float length = planeP.length();
+        Vector d = planeP / length;
+        ray.mint = m_nearClip * length;
+        ray.maxt = m_farClip * length;
 
         const Transform &trafo = m_worldTransform->eval(ray.time);
         ray.setOrigin(trafo.transformAffine(Point(0.0f)));
         ray.setDirection(trafo(d));
         ray.rxOrigin = ray.ryOrigin = ray.o;
 
-        ray.rxDirection = trafo(normalize(Vector(nearP) + m_dx));
-        ray.ryDirection = trafo(normalize(Vector(nearP) + m_dy));
+        ray.rxDirection = trafo(normalize(planeP + m_dxPlane));
+        ray.ryDirection = trafo(normalize(planeP + m_dyPlane));
         ray.hasDifferentials = true;
 
         return Spectrum(1.0f);
     }
 
+    void sampleRayDifferentials(size_t count, const Point2 *samplePositions,
+            const Point2 *apertureSamples, const Float *timeSamples,
+            RayDifferential *rays, Spectrum *weights) const {
+#if defined(MTS_SSE)
+        if (m_worldTransform->isStatic()) {
+            sampleRayDifferentials4(count, samplePositions, timeSamples, rays, weights);
+            return;
+        }
+#endif
+        /* Generate one ray at a time, but at least avoid
+           a virtual function call per ray */
+        for (size_t i=0; i<count; ++i)
+            weights[i] = PerspectiveCameraRDist::sampleRayDifferential(
+                rays[i], samplePositions[i], Point2(0.5f),
+                timeSamples ? timeSamples[i] : 0.5f);
+    }
+
+#if defined(MTS_SSE)
+    /**
+     * \brief Same computation as in sampleRayDifferential(), but for
+     * four rays at a time in SoA layout (requires a static transform)
+     *
+     * The table entries of the inverse distortion model are gathered
+     * one lane at a time, while the interpolation, Newton step and
+     * transformations use SSE.
+     */
+    void sampleRayDifferentials4(size_t count, const Point2 *samplePositions,
+            const Float *timeSamples, RayDifferential *rays, Spectrum *weights) const {
+        const Transform &trafo = m_worldTransform->eval(0);
+        const Matrix4x4 &toWorld = trafo.getMatrix();
+        Point origin = trafo.transformAffine(Point(0.0f));
+
+        const __m128
+            one = SSEConstants::one.ps,
+            nearClip = _mm_set1_ps(m_nearClip),
+            farClip = _mm_set1_ps(m_farClip),
+            tableSize = _mm_set1_ps((Float) RDIST_TABLE_SIZE),
+            invDistortionScale = _mm_set1_ps(m_invDistortionScale),
+            kc0 = _mm_set1_ps(m_kc[0]), kc1 = _mm_set1_ps(m_kc[1]),
+            dkc0 = _mm_set1_ps(3*m_kc[0]), dkc1 = _mm_set1_ps(5*m_kc[1]);
+        bool hasTable = !m_invDistortion.empty();
+
+        RayDifferentialPacket4 packet;
+        for (int k=0; k<3; ++k)
+            packet.o[k] = packet.rxOrigin[k] = packet.ryOrigin[k] = SSEVector(origin[k]);
+
+        for (size_t i=0; i<count; i += 4) {
+            size_t packetSize = std::min(count - i, (size_t) 4);
+            QuadVector p, d, dx, dy;
+
+            for (size_t j=0; j<4; ++j) {
+                /* Unused lanes replicate the last ray */
+                size_t idx = i + std::min(j, packetSize - 1);
+                p[0].f[j] = samplePositions[idx].x * m_invResolution.x;
+                p[1].f[j] = samplePositions[idx].y * m_invResolution.y;
+                packet.time.f[j] = sampleTime(timeSamples ? timeSamples[idx] : 0.5f);
+            }
+
+            /* Position on the plane z=1 (see sampleToPlane()) */
+            p[0].ps = _mm_add_ps(_mm_set1_ps(m_planeOrigin.x),
+                _mm_mul_ps(p[0].ps, _mm_set1_ps(m_planeScale.x)));
+            p[1].ps = _mm_add_ps(_mm_set1_ps(m_planeOrigin.y),
+                _mm_mul_ps(p[1].ps, _mm_set1_ps(m_planeScale.y)));
+            p[2] = SSEConstants::one;
+
+            if (m_distortion) {
+                SSEVector y, pos, correction;
+                y.ps = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(p[0].ps, p[0].ps),
+                    _mm_mul_ps(p[1].ps, p[1].ps)));
+                pos.ps = _mm_mul_ps(y.ps, invDistortionScale);
+
+                if (EXPECT_TAKEN(hasTable &&
+                        _mm_movemask_ps(_mm_cmplt_ps(pos.ps, tableSize)) == 0xF)) {
+                    /* Interpolate the table and refine using a single Newton step */
+                    SSEVector r0, r1, weight;
+                    for (int j=0; j<4; ++j) {
+                        int idx = (int) pos.f[j];
+                        weight.f[j] = pos.f[j] - idx;
+                        r0.f[j] = m_invDistortion[idx];
+                        r1.f[j] = m_invDistortion[idx+1];
+                    }
+
+                    __m128 r = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(one, weight.ps), r0.ps),
+                                          _mm_mul_ps(weight.ps, r1.ps)),
+                           r2 = _mm_mul_ps(r, r),
+                           f  = _mm_sub_ps(_mm_mul_ps(r, _mm_add_ps(one, _mm_mul_ps(r2,
+                                    _mm_add_ps(kc0, _mm_mul_ps(r2, kc1))))), y.ps),
+                           df = _mm_add_ps(one, _mm_mul_ps(r2,
+                                    _mm_add_ps(dkc0, _mm_mul_ps(dkc1, r2))));
+                    r = _mm_sub_ps(r, _mm_div_ps(f, df));
+
+                    /* The correction factor is 1 at the center (avoid dividing by zero) */
+                    __m128 valid = _mm_cmpgt_ps(y.ps, SSEConstants::zero.ps);
+                    correction.ps = _mm_div_ps(r, _mm_or_ps(_mm_and_ps(valid, y.ps),
+                        _mm_andnot_ps(valid, one)));
+                    correction.ps = _mm_or_ps(_mm_and_ps(valid, correction.ps),
+                        _mm_andnot_ps(valid, one));
+                } else {
+                    /* Some radii lie outside of the table */
+                    for (int j=0; j<4; ++j)
+                        correction.f[j] = invertDistortion(y.f[j]);
+                }
+
+                p[0].ps = _mm_mul_ps(p[0].ps, correction.ps);
+                p[1].ps = _mm_mul_ps(p[1].ps, correction.ps);
+            }
+
+            /* Turn that into normalized ray directions, and
+               adjust the ray intervals accordingly */
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(p[0].ps, p[0].ps), _mm_mul_ps(p[1].ps, p[1].ps)), one)),
+                   invLength = _mm_div_ps(one, length);
+            for (int k=0; k<3; ++k) {
+                d[k].ps = _mm_mul_ps(p[k].ps, invLength);
+                dx[k].ps = _mm_add_ps(p[k].ps, _mm_set1_ps(m_dxPlane[k]));
+                dy[k].ps = _mm_add_ps(p[k].ps, _mm_set1_ps(m_dyPlane[k]));
+            }
+            normalize4(dx);
+            normalize4(dy);
+
+            packet.mint.ps = _mm_mul_ps(nearClip, length);
+            packet.maxt.ps = _mm_mul_ps(farClip, length);
+
+            transformVector4(toWorld, d, packet.d);
+            transformVector4(toWorld, dx, packet.rxDirection);
+            transformVector4(toWorld, dy, packet.ryDirection);
+            packet.store(rays + i, packetSize);
+
+            for (size_t j=0; j<packetSize; ++j)
+                weights[i+j] = Spectrum(1.0f);
+        }
+    }
+#endif
+
     Spectrum samplePosition(PositionSamplingRecord &pRec,
             const Point2 &sample, const Point2 *extra) const {
         const Transform &trafo = m_worldTransform->eval(pRec.time);
@@ -395,16 +615,11 @@ public:
             samplePos.y * m_resolution.y);
 
         /* Compute the corresponding position on the
-           near plane (in local camera space) */
-        Point nearP = m_sampleToCamera(samplePos);
-
-        if (m_distortion) {
-            Float correction = invertDistortion(Vector2(nearP.x / nearP.z, nearP.y / nearP.z).length());
-            nearP.x *= correction; nearP.y *= correction;
-        }
+           plane z=1 (in local camera space) */
+        Vector planeP = sampleToPlane(samplePos.x, samplePos.y);
 
         /* Turn that into a normalized ray direction */
-        Vector d = normalize(Vector(nearP));
+        Vector d = normalize(planeP);
         dRec.d = trafo(d);
         dRec.measure = ESolidAngle;
         dRec.pdf = pdfDirection(dRec, pRec);
@@ -548,9 +763,13 @@ private:
     Transform m_clipTransform;
     AABB2 m_imageRect;
     Float m_normalization;
-    Vector m_dx, m_dy;
+    Point2 m_planeOrigin;
+    Vector2 m_planeScale;
+    Vector m_dxPlane, m_dyPlane;
     bool m_distortion;
     Float m_kc[2];
+    std::vector<Float> m_invDistortion;
+    Float m_invDistortionScale;
 };
 
 MTS_IMPLEMENT_CLASS_S(PerspectiveCameraRDist, false, PerspectiveCamera)
@@ -23,6 +23,10 @@
 #include <mitsuba/core/frame.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/warp.h>
+#if defined(MTS_SSE)
+#include <mitsuba/core/ray_sse.h>
+#include <mitsuba/core/ssemath.h>
+#endif
 
 MTS_NAMESPACE_BEGIN
 
@@ -360,6 +364,99 @@ public:
         return Spectrum(1.0f);
     }
 
+#if defined(MTS_SSE)
+    void sampleRayDifferentials(size_t count, const Point2 *samplePositions,
+            const Point2 *apertureSamples, const Float *timeSamples,
+            RayDifferential *rays, Spectrum *weights) const {
+        if (!m_worldTransform->isStatic()) {
+            PerspectiveCamera::sampleRayDifferentials(count, samplePositions,
+                apertureSamples, timeSamples, rays, weights);
+            return;
+        }
+
+        /* Same computation as in sampleRayDifferential(), but for
+           four rays at a time in SoA layout. The sine and cosine in the
+           concentric disk mapping are evaluated using sincos_ps(), hence
+           the results may differ from the scalar version by a few ulps */
+        const Transform &trafo = m_worldTransform->eval(0);
+        const Matrix4x4 &toWorld = trafo.getMatrix(),
+                        &sampleToCamera = m_sampleToCamera.getMatrix();
+        const __m128 nearClip = _mm_set1_ps(m_nearClip),
+                     farClip = _mm_set1_ps(m_farClip),
+                     focusDistance = _mm_set1_ps(m_focusDistance),
+                     apertureRadius = _mm_set1_ps(m_apertureRadius),
+                     two = _mm_set1_ps(2.0f),
+                     quarterPi = _mm_set1_ps((float) (M_PI / 4)),
+                     halfPi = _mm_set1_ps((float) (M_PI / 2));
+
+        RayDifferentialPacket4 packet;
+
+        for (size_t i=0; i<count; i += 4) {
+            size_t packetSize = std::min(count - i, (size_t) 4);
+            QuadVector nearP, apertureP, d, dx, dy;
+
+            for (size_t j=0; j<4; ++j) {
+                /* Unused lanes replicate the last ray */
+                size_t idx = i + std::min(j, packetSize - 1);
+                Point2 apertureSample = apertureSamples ? apertureSamples[idx] : Point2(0.5f);
+                nearP[0].f[j] = samplePositions[idx].x * m_invResolution.x;
+                nearP[1].f[j] = samplePositions[idx].y * m_invResolution.y;
+                apertureP[0].f[j] = apertureSample.x;
+                apertureP[1].f[j] = apertureSample.y;
+                packet.time.f[j] = sampleTime(timeSamples ? timeSamples[idx] : 0.5f);
+            }
+            nearP[2] = apertureP[2] = SSEConstants::zero;
+
+            /* Concentric mapping to the aperture, see
+               warp::squareToUniformDiskConcentric() */
+            __m128 r1 = _mm_sub_ps(_mm_mul_ps(two, apertureP[0].ps), SSEConstants::one.ps),
+                   r2 = _mm_sub_ps(_mm_mul_ps(two, apertureP[1].ps), SSEConstants::one.ps),
+                   sel = _mm_cmpgt_ps(_mm_mul_ps(r1, r1), _mm_mul_ps(r2, r2)),
+                   r = mux_ps(sel, r1, r2),
+                   other = mux_ps(sel, r2, r1),
+                   denom = mux_ps(_mm_cmpeq_ps(r, SSEConstants::zero.ps), SSEConstants::one.ps, r),
+                   ratio = _mm_mul_ps(_mm_div_ps(other, denom), quarterPi),
+                   phi = mux_ps(sel, ratio, _mm_sub_ps(halfPi, ratio)),
+                   sinPhi, cosPhi;
+            math::sincos_ps(phi, &sinPhi, &cosPhi);
+            r = _mm_mul_ps(r, apertureRadius);
+            apertureP[0].ps = _mm_mul_ps(r, cosPhi);
+            apertureP[1].ps = _mm_mul_ps(r, sinPhi);
+
+            transformPoint4(sampleToCamera, nearP, nearP);
+
+            /* Sampled positions on the focal plane */
+            __m128 fDist = _mm_div_ps(focusDistance, nearP[2].ps);
+            for (int k=0; k<3; ++k) {
+                __m128 focusP  = _mm_mul_ps(nearP[k].ps, fDist),
+                       focusPx = _mm_mul_ps(_mm_add_ps(nearP[k].ps, _mm_set1_ps(m_dx[k])), fDist),
+                       focusPy = _mm_mul_ps(_mm_add_ps(nearP[k].ps, _mm_set1_ps(m_dy[k])), fDist);
+                d[k].ps  = _mm_sub_ps(focusP, apertureP[k].ps);
+                dx[k].ps = _mm_sub_ps(focusPx, apertureP[k].ps);
+                dy[k].ps = _mm_sub_ps(focusPy, apertureP[k].ps);
+            }
+            normalize4(d);
+            normalize4(dx);
+            normalize4(dy);
+
+            __m128 invZ = _mm_div_ps(SSEConstants::one.ps, d[2].ps);
+            packet.mint.ps = _mm_mul_ps(nearClip, invZ);
+            packet.maxt.ps = _mm_mul_ps(farClip, invZ);
+
+            transformAffine4(toWorld, apertureP, packet.o);
+            for (int k=0; k<3; ++k)
+                packet.rxOrigin[k] = packet.ryOrigin[k] = packet.o[k];
+            transformVector4(toWorld, d, packet.d);
+            transformVector4(toWorld, dx, packet.rxDirection);
+            transformVector4(toWorld, dy, packet.ryDirection);
+            packet.store(rays + i, packetSize);
+
+            for (size_t j=0; j<packetSize; ++j)
+                weights[i+j] = Spectrum(1.0f);
+        }
+    }
+#endif
+
     Spectrum samplePosition(PositionSamplingRecord &pRec,
             const Point2 &sample, const Point2 *extra) const {
         const Transform &trafo = m_worldTransform->eval(pRec.time);
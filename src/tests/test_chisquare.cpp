@@ -20,7 +20,10 @@
 #include <mitsuba/core/statistics.h>
 #include <mitsuba/core/chisquare.h>
 #include <mitsuba/core/fresolver.h>
+#include <mitsuba/core/timer.h>
 #include <mitsuba/render/testcase.h>
+#include <mitsuba/render/range.h>
+#include <boost/filesystem/fstream.hpp>
 #include <boost/bind.hpp>
 
 /* Statistical significance level of the test. Set to
@@ -40,353 +43,779 @@
 MTS_NAMESPACE_BEGIN
 
 /**
- * This testcase checks if the sampling methods of various BSDF & phase
- * function & emitter implementations really do what they promise in
- * their pdf() methods
+ * Replayable fake sampler
  */
-class TestChiSquare : public TestCase {
+class FakeSampler : public Sampler {
 public:
-    MTS_BEGIN_TESTCASE()
-    MTS_DECLARE_TEST(test01_BSDF)
-    MTS_DECLARE_TEST(test02_PhaseFunction)
-    MTS_DECLARE_TEST(test03_EmitterDirect)
-    MTS_END_TESTCASE()
+    FakeSampler(Sampler *sampler)
+        : Sampler(Properties()), m_sampler(sampler) { }
 
-    /**
-     * Replayable fake sampler
-     */
-    class FakeSampler : public Sampler {
-    public:
-        FakeSampler(Sampler *sampler)
-            : Sampler(Properties()), m_sampler(sampler) { }
-
-        Float next1D() {
-            while (m_sampleIndex >= m_values.size())
-                m_values.push_back(m_sampler->next1D());
-            return m_values[m_sampleIndex++];
-        }
+    Float next1D() {
+        while (m_sampleIndex >= m_values.size())
+            m_values.push_back(m_sampler->next1D());
+        return m_values[m_sampleIndex++];
+    }
 
-        Point2 next2D() {
-            return Point2(next1D(), next1D());
-        }
+    Point2 next2D() {
+        return Point2(next1D(), next1D());
+    }
 
-        void clear() {
-            m_values.clear();
-            m_sampleIndex = 0;
-        }
+    void clear() {
+        m_values.clear();
+        m_sampleIndex = 0;
+    }
 
-        void rewind() {
-            m_sampleIndex = 0;
-        }
+    void rewind() {
+        m_sampleIndex = 0;
+    }
 
-        ref<Sampler> clone() {
-            SLog(EError, "Not supported!");
-            return NULL;
-        }
+    ref<Sampler> clone() {
+        SLog(EError, "Not supported!");
+        return NULL;
+    }
 
-        std::string toString() const { return "FakeSampler[]"; }
-    private:
-        ref<Sampler> m_sampler;
-        std::vector<Float> m_values;
-    };
+    std::string toString() const { return "FakeSampler[]"; }
+private:
+    ref<Sampler> m_sampler;
+    std::vector<Float> m_values;
+};
 
-    /// Adapter to use BSDFs in the chi-square test
-    class BSDFAdapter {
-    public:
-        BSDFAdapter(const BSDF *bsdf, Sampler *sampler, const Vector &wi, int component)
-            : m_bsdf(bsdf), m_sampler(sampler), m_wi(wi), m_component(component),
-              m_largestWeight(0) {
-            m_fakeSampler = new FakeSampler(m_sampler);
-            m_its.uv = Point2(0.0f);
-            m_its.dpdu = Vector(1, 0, 0);
-            m_its.dpdv = Vector(0, 1, 0);
-            m_its.dudx = m_its.dvdy = 0.01f;
-            m_its.dudy = m_its.dvdx = 0.00f;
-            m_its.shFrame = Frame(Normal(0, 0, 1));
+/// Adapter to use BSDFs in the chi-square test
+class BSDFAdapter {
+public:
+    BSDFAdapter(const BSDF *bsdf, Sampler *sampler, const Vector &wi, int component)
+        : m_bsdf(bsdf), m_sampler(sampler), m_wi(wi), m_component(component),
+          m_largestWeight(0) {
+        m_fakeSampler = new FakeSampler(m_sampler);
+        m_its.uv = Point2(0.0f);
+        m_its.dpdu = Vector(1, 0, 0);
+        m_its.dpdv = Vector(0, 1, 0);
+        m_its.dudx = m_its.dvdy = 0.01f;
+        m_its.dudy = m_its.dvdx = 0.00f;
+        m_its.shFrame = Frame(Normal(0, 0, 1));
 //          m_isSymmetric = true;
-        }
+    }
 
-        boost::tuple<Vector, Float, EMeasure> generateSample() {
-            Point2 sample(m_sampler->next2D());
-            BSDFSamplingRecord bRec(m_its, m_fakeSampler);
-            bRec.mode = EImportance;
-            bRec.component = m_component;
-            bRec.wi = m_wi;
+    boost::tuple<Vector, Float, EMeasure> generateSample() {
+        Point2 sample(m_sampler->next2D());
+        BSDFSamplingRecord bRec(m_its, m_fakeSampler);
+        bRec.mode = EImportance;
+        bRec.component = m_component;
+        bRec.wi = m_wi;
 
-            #if defined(MTS_DEBUG_FP)
-                enableFPExceptions();
-            #endif
+        #if defined(MTS_DEBUG_FP)
+            enableFPExceptions();
+        #endif
 
-            Float pdfVal, sampledPDF;
+        Float pdfVal, sampledPDF;
 
-            /* Check the various sampling routines for agreement
-               amongst each other */
-            m_fakeSampler->clear();
-            Spectrum sampled = m_bsdf->sample(bRec, sampledPDF, sample);
-            m_fakeSampler->rewind();
-            Spectrum sampled2 = m_bsdf->sample(bRec, sample);
-            EMeasure measure = ESolidAngle;
-            if (!sampled.isZero())
-                measure = BSDF::getMeasure(bRec.sampledType);
+        /* Check the various sampling routines for agreement
+           amongst each other */
+        m_fakeSampler->clear();
+        Spectrum sampled = m_bsdf->sample(bRec, sampledPDF, sample);
+        m_fakeSampler->rewind();
+        Spectrum sampled2 = m_bsdf->sample(bRec, sample);
+        EMeasure measure = ESolidAngle;
+        if (!sampled.isZero())
+            measure = BSDF::getMeasure(bRec.sampledType);
 
-            if (sampled.isZero() && sampled2.isZero())
-                return boost::make_tuple(Vector(0.0f), 0.0f, measure);
+        if (sampled.isZero() && sampled2.isZero())
+            return boost::make_tuple(Vector(0.0f), 0.0f, measure);
 
-            Spectrum f = m_bsdf->eval(bRec, measure);
-            pdfVal = m_bsdf->pdf(bRec, measure);
-            Spectrum manual = f/pdfVal;
+        Spectrum f = m_bsdf->eval(bRec, measure);
+        pdfVal = m_bsdf->pdf(bRec, measure);
+        Spectrum manual = f/pdfVal;
 
 #if 0
-            if (m_isSymmetric) {
-                /* Check for non-symmetry */
-                BSDFSamplingRecord bRecRev(bRec);
-                bRecRev.reverse();
-                bRec.mode = EImportance;
-                Spectrum fFwd = f;
-                Spectrum fRev = m_bsdf->eval(bRecRev, measure);
-                if (measure == ESolidAngle) {
-                    fFwd /= std::abs(Frame::cosTheta(bRec.wo));
-                    fRev /= std::abs(Frame::cosTheta(bRecRev.wo));
-                }
-                Float max = std::max(fFwd.max(), fRev.max());
-                if (max > 0) {
-                    Float err = (fFwd-fRev).max() / max;
-                    if (err > Epsilon) {
-                        Log(EWarn, "Non-symmetry in %s: %s vs %s, %s", m_bsdf->toString().c_str(),
-                            fFwd.toString().c_str(), fRev.toString().c_str(), bRec.toString().c_str());
-                        m_isSymmetric = false;
-                    }
+        if (m_isSymmetric) {
+            /* Check for non-symmetry */
+            BSDFSamplingRecord bRecRev(bRec);
+            bRecRev.reverse();
+            bRec.mode = EImportance;
+            Spectrum fFwd = f;
+            Spectrum fRev = m_bsdf->eval(bRecRev, measure);
+            if (measure == ESolidAngle) {
+                fFwd /= std::abs(Frame::cosTheta(bRec.wo));
+                fRev /= std::abs(Frame::cosTheta(bRecRev.wo));
+            }
+            Float max = std::max(fFwd.max(), fRev.max());
+            if (max > 0) {
+                Float err = (fFwd-fRev).max() / max;
+                if (err > Epsilon) {
+                    SLog(EWarn, "Non-symmetry in %s: %s vs %s, %s", m_bsdf->toString().c_str(),
+                        fFwd.toString().c_str(), fRev.toString().c_str(), bRec.toString().c_str());
+                    m_isSymmetric = false;
                 }
             }
+        }
 #endif
 
-            if (!sampled.isValid() || !sampled2.isValid() || !manual.isValid()) {
-                Log(EWarn, "Oops: sampled=%s, sampled2=%s, manual=%s, sampledPDF=%f, "
-                    "pdf=%f, f=%s, bRec=%s, measure=%i", sampled.toString().c_str(),
-                    sampled2.toString().c_str(), manual.toString().c_str(),
-                    sampledPDF, pdfVal, f.toString().c_str(), bRec.toString().c_str(),
-                    measure);
-                return boost::make_tuple(bRec.wo, 0.0f, ESolidAngle);
-            }
-
-            bool mismatch = false;
-            for (int i=0; i<SPECTRUM_SAMPLES; ++i) {
-                Float a = sampled[i], b = sampled2[i], c = manual[i];
-                Float min = std::min(std::min(a, b), c);
-                Float err = std::max(std::max(std::abs(a - b), std::abs(a - c)), std::abs(b - c));
-                m_largestWeight = std::max(m_largestWeight, a);
-
-                if (min < ERROR_REQ && err > ERROR_REQ) // absolute error threshold
-                    mismatch = true;
-                else if (min > ERROR_REQ && err/min > ERROR_REQ) // relative error threshold
-                    mismatch = true;
-            }
-
-            if (mismatch)
-                Log(EWarn, "Potential inconsistency: sampled=%s, sampled2=%s, manual=%s, sampledPDF=%f, "
-                    "pdf=%f, f=%s, bRec=%s, measure=%i", sampled.toString().c_str(),
-                    sampled2.toString().c_str(), manual.toString().c_str(),
-                    sampledPDF, pdfVal, f.toString().c_str(), bRec.toString().c_str(),
-                    measure);
+        if (!sampled.isValid() || !sampled2.isValid() || !manual.isValid()) {
+            SLog(EWarn, "Oops: sampled=%s, sampled2=%s, manual=%s, sampledPDF=%f, "
+                "pdf=%f, f=%s, bRec=%s, measure=%i", sampled.toString().c_str(),
+                sampled2.toString().c_str(), manual.toString().c_str(),
+                sampledPDF, pdfVal, f.toString().c_str(), bRec.toString().c_str(),
+                measure);
+            return boost::make_tuple(bRec.wo, 0.0f, ESolidAngle);
+        }
 
-            mismatch = false;
-            Float min = std::min(pdfVal, sampledPDF);
-            Float err = std::abs(pdfVal - sampledPDF);
+        bool mismatch = false;
+        for (int i=0; i<SPECTRUM_SAMPLES; ++i) {
+            Float a = sampled[i], b = sampled2[i], c = manual[i];
+            Float min = std::min(std::min(a, b), c);
+            Float err = std::max(std::max(std::abs(a - b), std::abs(a - c)), std::abs(b - c));
+            m_largestWeight = std::max(m_largestWeight, a);
 
             if (min < ERROR_REQ && err > ERROR_REQ) // absolute error threshold
                 mismatch = true;
             else if (min > ERROR_REQ && err/min > ERROR_REQ) // relative error threshold
                 mismatch = true;
+        }
 
-            if (mismatch)
-                Log(EWarn, "Potential inconsistency: pdfVal=%f, sampledPDF=%f",
-                    pdfVal, sampledPDF);
+        if (mismatch)
+            SLog(EWarn, "Potential inconsistency: sampled=%s, sampled2=%s, manual=%s, sampledPDF=%f, "
+                "pdf=%f, f=%s, bRec=%s, measure=%i", sampled.toString().c_str(),
+                sampled2.toString().c_str(), manual.toString().c_str(),
+                sampledPDF, pdfVal, f.toString().c_str(), bRec.toString().c_str(),
+                measure);
 
-            #if defined(MTS_DEBUG_FP)
-                disableFPExceptions();
-            #endif
+        mismatch = false;
+        Float min = std::min(pdfVal, sampledPDF);
+        Float err = std::abs(pdfVal - sampledPDF);
 
-            return boost::make_tuple(bRec.wo, 1.0f, measure);
-        }
+        if (min < ERROR_REQ && err > ERROR_REQ) // absolute error threshold
+            mismatch = true;
+        else if (min > ERROR_REQ && err/min > ERROR_REQ) // relative error threshold
+            mismatch = true;
 
-        Float pdf(const Vector &wo, EMeasure measure) {
-            BSDFSamplingRecord bRec(m_its, m_wi, wo);
-            bRec.mode = EImportance;
-            bRec.component = m_component;
+        if (mismatch)
+            SLog(EWarn, "Potential inconsistency: pdfVal=%f, sampledPDF=%f",
+                pdfVal, sampledPDF);
 
-            #if defined(MTS_DEBUG_FP)
-                enableFPExceptions();
-            #endif
+        #if defined(MTS_DEBUG_FP)
+            disableFPExceptions();
+        #endif
 
-            if (m_bsdf->eval(bRec, measure).isZero())
-                return 0.0f;
+        return boost::make_tuple(bRec.wo, 1.0f, measure);
+    }
 
-            Float result = m_bsdf->pdf(bRec, measure);
+    Float pdf(const Vector &wo, EMeasure measure) {
+        BSDFSamplingRecord bRec(m_its, m_wi, wo);
+        bRec.mode = EImportance;
+        bRec.component = m_component;
 
-            #if defined(MTS_DEBUG_FP)
-                disableFPExceptions();
-            #endif
-            return result;
-        }
+        #if defined(MTS_DEBUG_FP)
+            enableFPExceptions();
+        #endif
+
+        if (m_bsdf->eval(bRec, measure).isZero())
+            return 0.0f;
+
+        Float result = m_bsdf->pdf(bRec, measure);
 
-        inline Float getLargestWeight() const { return m_largestWeight; }
+        #if defined(MTS_DEBUG_FP)
+            disableFPExceptions();
+        #endif
+        return result;
+    }
+
+    inline Float getLargestWeight() const { return m_largestWeight; }
 //      inline bool isSymmetric() const { return m_isSymmetric; }
-    private:
-        Intersection m_its;
-        ref<const BSDF> m_bsdf;
-        ref<Sampler> m_sampler;
-        ref<FakeSampler> m_fakeSampler;
-        Vector m_wi;
-        int m_component;
-        Float m_largestWeight;
+private:
+    Intersection m_its;
+    ref<const BSDF> m_bsdf;
+    ref<Sampler> m_sampler;
+    ref<FakeSampler> m_fakeSampler;
+    Vector m_wi;
+    int m_component;
+    Float m_largestWeight;
 //      bool m_isSymmetric;
-    };
+};
+
+/// Adapter to use Phase functions in the chi-square test
+class PhaseFunctionAdapter {
+public:
+    PhaseFunctionAdapter(const MediumSamplingRecord &mRec,
+            const PhaseFunction *phase, Sampler *sampler, const Vector &wi)
+        : m_mRec(mRec), m_phase(phase), m_sampler(sampler), m_wi(wi),
+          m_largestWeight(0) {
+        m_fakeSampler = new FakeSampler(m_sampler);
+    }
 
-    /// Adapter to use Phase functions in the chi-square test
-    class PhaseFunctionAdapter {
-    public:
-        PhaseFunctionAdapter(const MediumSamplingRecord &mRec,
-                const PhaseFunction *phase, Sampler *sampler, const Vector &wi)
-            : m_mRec(mRec), m_phase(phase), m_sampler(sampler), m_wi(wi),
-              m_largestWeight(0) {
-            m_fakeSampler = new FakeSampler(m_sampler);
+    boost::tuple<Vector, Float, EMeasure> generateSample() {
+        PhaseFunctionSamplingRecord pRec(m_mRec, m_wi);
+
+        #if defined(MTS_DEBUG_FP)
+            enableFPExceptions();
+        #endif
+        Float sampledPDF, pdfVal;
+
+        /* Check the various sampling routines for agreement amongst each other */
+        m_fakeSampler->clear();
+        Float sampled = m_phase->sample(pRec, sampledPDF, m_fakeSampler);
+        m_fakeSampler->rewind();
+        Float sampled2 = m_phase->sample(pRec, m_fakeSampler);
+        Float f = m_phase->eval(pRec);
+        pdfVal = m_phase->pdf(pRec);
+        Float manual = f/pdfVal;
+
+        if (std::isnan(sampled) || std::isnan(sampled2) || std::isnan(manual) ||
+            sampled < 0 || sampled2 < 0 || manual < 0) {
+            SLog(EWarn, "Oops: sampled=%f, sampled2=%f, manual=%f, sampledPDF=%f, "
+                "pdf=%f, f=%f, pRec=%s", sampled, sampled2, manual,
+                sampledPDF, pdfVal, f, pRec.toString().c_str());
+            return boost::make_tuple(pRec.wo, 0.0f, ESolidAngle);
         }
 
-        boost::tuple<Vector, Float, EMeasure> generateSample() {
-            PhaseFunctionSamplingRecord pRec(m_mRec, m_wi);
-
-            #if defined(MTS_DEBUG_FP)
-                enableFPExceptions();
-            #endif
-            Float sampledPDF, pdfVal;
-
-            /* Check the various sampling routines for agreement amongst each other */
-            m_fakeSampler->clear();
-            Float sampled = m_phase->sample(pRec, sampledPDF, m_fakeSampler);
-            m_fakeSampler->rewind();
-            Float sampled2 = m_phase->sample(pRec, m_fakeSampler);
-            Float f = m_phase->eval(pRec);
-            pdfVal = m_phase->pdf(pRec);
-            Float manual = f/pdfVal;
-
-            if (std::isnan(sampled) || std::isnan(sampled2) || std::isnan(manual) ||
-                sampled < 0 || sampled2 < 0 || manual < 0) {
-                Log(EWarn, "Oops: sampled=%f, sampled2=%f, manual=%f, sampledPDF=%f, "
-                    "pdf=%f, f=%f, pRec=%s", sampled, sampled2, manual,
-                    sampledPDF, pdfVal, f, pRec.toString().c_str());
-                return boost::make_tuple(pRec.wo, 0.0f, ESolidAngle);
-            }
+        bool mismatch = false;
+        Float min = std::min(std::min(sampled, sampled2), manual);
+        Float err = std::max(std::max(std::abs(sampled - sampled2),
+                std::abs(sampled - manual)), std::abs(sampled2 - manual));
+        m_largestWeight = std::max(m_largestWeight, sampled);
 
-            bool mismatch = false;
-            Float min = std::min(std::min(sampled, sampled2), manual);
-            Float err = std::max(std::max(std::abs(sampled - sampled2),
-                    std::abs(sampled - manual)), std::abs(sampled2 - manual));
-            m_largestWeight = std::max(m_largestWeight, sampled);
+        if (min < ERROR_REQ && err > ERROR_REQ) // absolute error threshold
+            mismatch = true;
+        else if (min > ERROR_REQ && err/min > ERROR_REQ) // relative error threshold
+            mismatch = true;
 
-            if (min < ERROR_REQ && err > ERROR_REQ) // absolute error threshold
-                mismatch = true;
-            else if (min > ERROR_REQ && err/min > ERROR_REQ) // relative error threshold
-                mismatch = true;
+        if (mismatch)
+            SLog(EWarn, "Potential inconsistency: sampled=%f, sampled2=%f, manual=%s, "
+                "sampledPDF=%f, pdf=%f, f=%f, pRec=%s", sampled, sampled2, manual,
+                sampledPDF, pdfVal, f, pRec.toString().c_str());
 
-            if (mismatch)
-                Log(EWarn, "Potential inconsistency: sampled=%f, sampled2=%f, manual=%s, "
-                    "sampledPDF=%f, pdf=%f, f=%f, pRec=%s", sampled, sampled2, manual,
-                    sampledPDF, pdfVal, f, pRec.toString().c_str());
+        mismatch = false;
+        min = std::min(pdfVal, sampledPDF);
+        err = std::abs(pdfVal - sampledPDF);
 
-            mismatch = false;
-            min = std::min(pdfVal, sampledPDF);
-            err = std::abs(pdfVal - sampledPDF);
+        if (min < ERROR_REQ && err > ERROR_REQ) // absolute error threshold
+            mismatch = true;
+        else if (min > ERROR_REQ && err/min > ERROR_REQ) // relative error threshold
+            mismatch = true;
 
-            if (min < ERROR_REQ && err > ERROR_REQ) // absolute error threshold
-                mismatch = true;
-            else if (min > ERROR_REQ && err/min > ERROR_REQ) // relative error threshold
-                mismatch = true;
+        if (mismatch)
+            SLog(EWarn, "Potential inconsistency: pdfVal=%f, sampledPDF=%f",
+                pdfVal, sampledPDF);
 
-            if (mismatch)
-                Log(EWarn, "Potential inconsistency: pdfVal=%f, sampledPDF=%f",
-                    pdfVal, sampledPDF);
 
+        return boost::make_tuple(pRec.wo,
+            sampled == 0 ? 0.0f : 1.0f, ESolidAngle);
+    }
 
-            return boost::make_tuple(pRec.wo,
-                sampled == 0 ? 0.0f : 1.0f, ESolidAngle);
-        }
+    Float pdf(const Vector &wo, EMeasure measure) const {
+        if (measure != ESolidAngle)
+            return 0.0f;
+
+        PhaseFunctionSamplingRecord pRec(m_mRec, m_wi, wo);
+        #if defined(MTS_DEBUG_FP)
+            enableFPExceptions();
+        #endif
+        if (m_phase->eval(pRec) == 0)
+            return 0.0f;
+        Float result = m_phase->pdf(pRec);
+        #if defined(MTS_DEBUG_FP)
+            disableFPExceptions();
+        #endif
+        return result;
+    }
 
-        Float pdf(const Vector &wo, EMeasure measure) const {
-            if (measure != ESolidAngle)
-                return 0.0f;
-
-            PhaseFunctionSamplingRecord pRec(m_mRec, m_wi, wo);
-            #if defined(MTS_DEBUG_FP)
-                enableFPExceptions();
-            #endif
-            if (m_phase->eval(pRec) == 0)
-                return 0.0f;
-            Float result = m_phase->pdf(pRec);
-            #if defined(MTS_DEBUG_FP)
-                disableFPExceptions();
-            #endif
-            return result;
-        }
+    inline Float getLargestWeight() const { return m_largestWeight; }
+private:
+    const MediumSamplingRecord &m_mRec;
+    ref<FakeSampler> m_fakeSampler;
+    ref<const PhaseFunction> m_phase;
+    ref<Sampler> m_sampler;
+    Vector m_wi;
+    Float m_largestWeight;
+};
+
+/// Adapter to use direct illumination sampling in the chi-square test
+class EmitterAdapter {
+public:
+    EmitterAdapter(const Emitter *emitter, Sampler *sampler)
+        : m_emitter(emitter), m_sampler(sampler), m_pRec(0.0f) {
+        emitter->samplePosition(m_pRec, m_sampler->next2D());
+    }
+
+    boost::tuple<Vector, Float, EMeasure> generateSample() {
+        #if defined(MTS_DEBUG_FP)
+            enableFPExceptions();
+        #endif
+
+        DirectSamplingRecord dRec(Point(0.0f), 0);
+        m_emitter->sampleDirect(dRec, m_sampler->next2D());
+
+        #if defined(MTS_DEBUG_FP)
+            disableFPExceptions();
+        #endif
+
+        return boost::make_tuple(dRec.d, 1.0f, dRec.measure);
+    }
+
+    Float pdf(const Vector &d, EMeasure measure) const {
+        if (measure != ESolidAngle)
+            return 0.0f;
+
+        DirectSamplingRecord dRec(Point(0.0f), 0);
+        dRec.d = d;
+        dRec.measure = ESolidAngle;
+
+        #if defined(MTS_DEBUG_FP)
+            enableFPExceptions();
+        #endif
+
+        Float result = m_emitter->pdfDirect(dRec);
+
+        #if defined(MTS_DEBUG_FP)
+            disableFPExceptions();
+        #endif
 
-        inline Float getLargestWeight() const { return m_largestWeight; }
-    private:
-        const MediumSamplingRecord &m_mRec;
-        ref<FakeSampler> m_fakeSampler;
-        ref<const PhaseFunction> m_phase;
-        ref<Sampler> m_sampler;
-        Vector m_wi;
-        Float m_largestWeight;
+        return result;
+    }
+
+private:
+    ref<const Emitter> m_emitter;
+    ref<Sampler> m_sampler;
+    PositionSamplingRecord m_pRec;
+};
+
+
+/// Description of one chi-square test configuration
+struct ChiSquareJob {
+    enum EType {
+        EBSDF = 0,
+        EPhaseFunction,
+        EEmitter
     };
 
-    /// Adapter to use direct illumination sampling in the chi-square test
-    class EmitterAdapter {
-    public:
-        EmitterAdapter(const Emitter *emitter, Sampler *sampler)
-            : m_emitter(emitter), m_sampler(sampler), m_pRec(0.0f) {
-            emitter->samplePosition(m_pRec, m_sampler->next2D());
+    EType type;
+    ref<const BSDF> bsdf;
+    ref<const PhaseFunction> phase;
+    ref<const Emitter> emitter;
+    /// Name of the plugin class, which is used to aggregate the report
+    std::string plugin;
+    /// Incident direction (BSDFs and phase functions)
+    Vector wi;
+    /// BSDF component to be tested (-1: all)
+    int component;
+    /// Medium sampling record storing the particle orientation
+    MediumSamplingRecord mRec;
+    /// Number of tests for the Sidak correction
+    int numTests;
+
+    ChiSquareJob() : type(EBSDF), wi(0.0f), component(-1), numTests(1) { }
+};
+
+/// Outcome and timings of one chi-square test configuration
+class ChiSquareWorkResult : public WorkResult {
+public:
+    ChiSquareWorkResult() : index(0), result(ChiSquare::EReject), sampleCount(0),
+        evaluationCount(0), samplingTime(0), integrationTime(0), largestWeight(0) { }
+
+    void load(Stream *stream) {
+        index = stream->readSize();
+        result = (ChiSquare::ETestResult) stream->readInt();
+        sampleCount = stream->readSize();
+        evaluationCount = stream->readSize();
+        samplingTime = stream->readFloat();
+        integrationTime = stream->readFloat();
+        largestWeight = stream->readFloat();
+    }
+
+    inline void set(const ChiSquareWorkResult *other) {
+        index = other->index;
+        result = other->result;
+        sampleCount = other->sampleCount;
+        evaluationCount = other->evaluationCount;
+        samplingTime = other->samplingTime;
+        integrationTime = other->integrationTime;
+        largestWeight = other->largestWeight;
+    }
+
+    void save(Stream *stream) const {
+        stream->writeSize(index);
+        stream->writeInt((int) result);
+        stream->writeSize(sampleCount);
+        stream->writeSize(evaluationCount);
+        stream->writeFloat(samplingTime);
+        stream->writeFloat(integrationTime);
+        stream->writeFloat(largestWeight);
+    }
+
+    std::string toString() const {
+        std::ostringstream oss;
+        oss << "ChiSquareWorkResult[index=" << index << ", result=" << result << "]";
+        return oss.str();
+    }
+
+    size_t index;
+    ChiSquare::ETestResult result;
+    size_t sampleCount, evaluationCount;
+    Float samplingTime, integrationTime;
+    Float largestWeight;
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~ChiSquareWorkResult() { }
+};
+
+/**
+ * Runs the chi-square test of a single configuration. Since the tested
+ * objects are shared with the main thread, this only works locally.
+ */
+class ChiSquareWorker : public WorkProcessor {
+public:
+    ChiSquareWorker(const std::vector<ChiSquareJob> *jobs, int thetaBins,
+        Float significance) : m_jobs(jobs), m_thetaBins(thetaBins), m_significance(significance) { }
+
+    void serialize(Stream *stream, InstanceManager *manager) const {
+        Log(EError, "Not supported!");
+    }
+
+    ref<WorkUnit> createWorkUnit() const {
+        return new RangeWorkUnit();
+    }
+
+    ref<WorkResult> createWorkResult() const {
+        return new ChiSquareWorkResult();
+    }
+
+    ref<WorkProcessor> clone() const {
+        return new ChiSquareWorker(m_jobs, m_thetaBins, m_significance);
+    }
+
+    void prepare() {
+        /* Every worker draws from its own random number stream */
+        m_sampler = static_cast<Sampler *>(getResource("sampler"));
+    }
+
+    void process(const WorkUnit *workUnit, WorkResult *workResult, const bool &stop) {
+        const RangeWorkUnit *range = static_cast<const RangeWorkUnit *>(workUnit);
+        ChiSquareWorkResult *result = static_cast<ChiSquareWorkResult *>(workResult);
+        const ChiSquareJob &job = (*m_jobs)[range->getRangeStart()];
+
+        ref<ChiSquare> chiSqr = new ChiSquare(m_thetaBins, 2*m_thetaBins, job.numTests);
+        chiSqr->setLogLevel(EDebug);
+        chiSqr->setParallel(false);
+        result->index = range->getRangeStart();
+        result->largestWeight = 0;
+
+        // Initialize the tables used by the chi-square test
+        switch (job.type) {
+            case ChiSquareJob::EBSDF: {
+                    BSDFAdapter adapter(job.bsdf.get(), m_sampler, job.wi, job.component);
+                    chiSqr->fill(
+                        boost::bind(&BSDFAdapter::generateSample, &adapter),
+                        boost::bind(&BSDFAdapter::pdf, &adapter, _1, _2)
+                    );
+                    result->largestWeight = adapter.getLargestWeight();
+                }
+                break;
+            case ChiSquareJob::EPhaseFunction: {
+                    PhaseFunctionAdapter adapter(job.mRec, job.phase.get(), m_sampler, job.wi);
+                    chiSqr->fill(
+                        boost::bind(&PhaseFunctionAdapter::generateSample, &adapter),
+                        boost::bind(&PhaseFunctionAdapter::pdf, &adapter, _1, _2)
+                    );
+                    result->largestWeight = adapter.getLargestWeight();
+                }
+                break;
+            case ChiSquareJob::EEmitter: {
+                    EmitterAdapter adapter(job.emitter.get(), m_sampler);
+                    chiSqr->fill(
+                        boost::bind(&EmitterAdapter::generateSample, &adapter),
+                        boost::bind(&EmitterAdapter::pdf, &adapter, _1, _2)
+                    );
+                }
+                break;
         }
 
-        boost::tuple<Vector, Float, EMeasure> generateSample() {
-            #if defined(MTS_DEBUG_FP)
-                enableFPExceptions();
-            #endif
+        result->result = chiSqr->runTest(m_significance);
+        result->sampleCount = chiSqr->getSampleCount();
+        result->evaluationCount = chiSqr->getEvaluationCount();
+        result->samplingTime = chiSqr->getSamplingTime();
+        result->integrationTime = chiSqr->getIntegrationTime();
+
+        if (result->result == ChiSquare::EReject)
+            chiSqr->dumpTables(TestCase::getOutputPath(
+                formatString("failure_%i.m", (int) result->index)).string());
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~ChiSquareWorker() { }
+private:
+    const std::vector<ChiSquareJob> *m_jobs;
+    ref<Sampler> m_sampler;
+    int m_thetaBins;
+    Float m_significance;
+};
 
-            DirectSamplingRecord dRec(Point(0.0f), 0);
-            m_emitter->sampleDirect(dRec, m_sampler->next2D());
+/**
+ * Parallel process, which hands out one chi-square test
+ * configuration per work unit and collects the outcomes
+ */
+class ChiSquareProcess : public ParallelProcess {
+public:
+    ChiSquareProcess(const std::vector<ChiSquareJob> &jobs, int thetaBins,
+        Float significance) : m_jobs(jobs), m_thetaBins(thetaBins), m_significance(significance), m_next(0), m_finished(0) {
+        m_results.resize(jobs.size());
+        m_mutex = new Mutex();
+        m_progress = new ProgressReporter("Checking", jobs.size(), NULL);
+    }
 
-            #if defined(MTS_DEBUG_FP)
-                disableFPExceptions();
-            #endif
+    ref<WorkProcessor> createWorkProcessor() const {
+        return new ChiSquareWorker(&m_jobs, m_thetaBins, m_significance);
+    }
+
+    EStatus generateWork(WorkUnit *unit, int worker) {
+        if (m_next == m_jobs.size())
+            return EFailure;
+        static_cast<RangeWorkUnit *>(unit)->setRange(m_next, m_next);
+        ++m_next;
+        return ESuccess;
+    }
+
+    void processResult(const WorkResult *result, bool cancelled) {
+        if (cancelled)
+            return;
+        const ChiSquareWorkResult *wr = static_cast<const ChiSquareWorkResult *>(result);
+        LockGuard lock(m_mutex);
+        m_results[wr->index] = new ChiSquareWorkResult();
+        m_results[wr->index]->set(wr);
+        m_progress->update(++m_finished);
+    }
+
+    bool isLocal() const {
+        return true;
+    }
+
+    /// Return the outcome of the i-th configuration (NULL if it didn't finish)
+    inline const ChiSquareWorkResult *getResult(size_t i) const { return m_results[i].get(); }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~ChiSquareProcess() {
+        delete m_progress;
+    }
+private:
+    const std::vector<ChiSquareJob> &m_jobs;
+    int m_thetaBins;
+    Float m_significance;
+    size_t m_next, m_finished;
+    ref_vector<ChiSquareWorkResult> m_results;
+    ProgressReporter *m_progress;
+    ref<Mutex> m_mutex;
+};
+
+/// Grid of values for one parameter of a plugin
+struct ParameterSweep {
+    const char *plugin;
+    const char *name;
+    Float values[3];
+};
+
+/**
+ * Parameter grids that are swept in addition to the instances from the XML
+ * files: every instance of one of these plugins that explicitly specifies
+ * the parameter is re-created with each of the values. Only plugins without
+ * nested objects are listed, since these couldn't be re-created.
+ */
+static const ParameterSweep parameterSweeps[] = {
+    { "roughconductor",  "alpha",  { 0.05f, 0.1f, 0.6f } },
+    { "roughdielectric", "alpha",  { 0.05f, 0.1f, 0.6f } },
+    { "roughdielectric", "intIOR", { 1.1f, 1.33f, 2.4f } },
+    { "roughplastic",    "alpha",  { 0.05f, 0.2f, 0.4f } },
+    { "ward",            "alphaU", { 0.05f, 0.2f, 0.6f } },
+    { "hg",              "g",      { -0.7f, 0.0f, 0.5f } },
+    { "microflake",      "stddev", { 0.05f, 0.2f, 0.3f } }
+};
+
+/**
+ * This testcase checks if the sampling methods of various BSDF & phase
+ * function & emitter implementations really do what they promise in
+ * their pdf() methods.
+ *
+ * Every configuration (i.e. an instance from one of the XML files in
+ * 'data/tests' or from the parameter grids above, combined with an
+ * incident direction and a BSDF component) is checked in a separate work
+ * unit on the scheduler. Besides the
+ * outcome of the tests, the sampling and evaluation throughput of each
+ * plugin is recorded. A summary is printed after each test and written
+ * to 'chisquare_report.csv' in the test output directory (see the '-o'
+ * parameter of 'mtsutil'), so that it can double as a performance
+ * regression report. The sampling throughput refers to complete queries
+ * of the adapters below, which also cross-check the different sampling,
+ * evaluation and density routines against each other.
+ */
+class TestChiSquare : public TestCase {
+public:
+    MTS_BEGIN_TESTCASE()
+    MTS_DECLARE_TEST(test01_BSDF)
+    MTS_DECLARE_TEST(test02_PhaseFunction)
+    MTS_DECLARE_TEST(test03_EmitterDirect)
+    MTS_END_TESTCASE()
+
+    /// Per-plugin summary of a set of chi-square tests
+    struct PluginReport {
+        int testCount, failureCount;
+        size_t sampleCount, evaluationCount;
+        Float samplingTime, integrationTime;
+        Float largestWeight;
+
+        PluginReport() : testCount(0), failureCount(0), sampleCount(0),
+            evaluationCount(0), samplingTime(0), integrationTime(0),
+            largestWeight(0) { }
+    };
 
-            return boost::make_tuple(dRec.d, 1.0f, dRec.measure);
+    void init() {
+        m_report.str("");
+        m_report << "category,plugin,tests,failures,samples/s,evaluations/s,largest weight" << endl;
+    }
+
+    void shutdown() {
+        fs::path path = getOutputPath("chisquare_report.csv");
+        fs::ofstream out(path);
+        out << m_report.str();
+        out.close();
+        Log(EInfo, "Wrote the per-plugin summary to \"%s\"", path.string().c_str());
+    }
+
+    /**
+     * Return the instances of the given class from an XML file, along with
+     * copies that are re-created with the values of \ref parameterSweeps
+     */
+    ref_vector<ConfigurableObject> sweepParameters(const ref_vector<ConfigurableObject> &objects,
+            const Class *theClass) {
+        ref_vector<ConfigurableObject> result;
+        std::vector<Properties> configs;
+
+        for (size_t i=0; i<objects.size(); ++i) {
+            if (!objects[i]->getClass()->derivesFrom(theClass))
+                continue;
+            result.push_back(objects[i]);
+            configs.push_back(objects[i]->getProperties());
+            configs.back().setID("unnamed");
         }
 
-        Float pdf(const Vector &d, EMeasure measure) const {
-            if (measure != ESolidAngle)
-                return 0.0f;
+        size_t instanceCount = result.size();
+        for (size_t i=0; i<instanceCount; ++i) {
+            for (size_t j=0; j<sizeof(parameterSweeps)/sizeof(ParameterSweep); ++j) {
+                const ParameterSweep &sweep = parameterSweeps[j];
+                if (configs[i].getPluginName() != sweep.plugin || !configs[i].hasProperty(sweep.name)
+                    || configs[i].getType(sweep.name) != Properties::EFloat)
+                    continue;
+
+                for (int k=0; k<3; ++k) {
+                    Properties props(configs[i]);
+                    props.setFloat(sweep.name, sweep.values[k], false);
+
+                    /* Skip configurations that are already being tested */
+                    if (std::find(configs.begin(), configs.end(), props) != configs.end())
+                        continue;
+
+                    ref<ConfigurableObject> object = PluginManager::getInstance()->
+                        createObject(theClass, props);
+                    object->configure();
+                    result.push_back(object);
+                    configs.push_back(props);
+                }
+            }
+        }
 
-            DirectSamplingRecord dRec(Point(0.0f), 0);
-            dRec.d = d;
-            dRec.measure = ESolidAngle;
+        Log(EInfo, "Testing %i instances (%i of them from parameter grids)",
+            (int) result.size(), (int) (result.size() - instanceCount));
 
-            #if defined(MTS_DEBUG_FP)
-                enableFPExceptions();
-            #endif
+        return result;
+    }
 
-            Float result = m_emitter->pdfDirect(dRec);
+    /// Run a set of chi-square tests concurrently and report the outcomes
+    void runTests(const std::vector<ChiSquareJob> &jobs, Sampler *sampler,
+            const std::string &category) {
+        ref<Scheduler> scheduler = Scheduler::getInstance();
+        ref<ChiSquareProcess> proc = new ChiSquareProcess(jobs, 10, SIGNIFICANCE_LEVEL);
+        ref<Timer> timer = new Timer();
+
+        /* Create a sampler instance for every core */
+        std::vector<SerializableObject *> samplers(scheduler->getCoreCount());
+        for (size_t i=0; i<scheduler->getCoreCount(); ++i) {
+            ref<Sampler> clonedSampler = sampler->clone();
+            clonedSampler->incRef();
+            samplers[i] = clonedSampler.get();
+        }
+        int samplerResID = scheduler->registerMultiResource(samplers);
+        for (size_t i=0; i<scheduler->getCoreCount(); ++i)
+            samplers[i]->decRef();
+        proc->bindResource("sampler", samplerResID);
+
+        Log(EInfo, "Running %i %s checks on %i cores ..", (int) jobs.size(),
+            category.c_str(), (int) scheduler->getCoreCount());
+        scheduler->schedule(proc);
+        scheduler->wait(proc);
+        scheduler->unregisterResource(samplerResID);
+        Float wallTime = timer->getSeconds(), workTime = 0;
+
+        if (proc->getReturnStatus() != ParallelProcess::ESuccess)
+            Log(EError, "The %s checks did not finish!", category.c_str());
+
+        std::vector<std::string> plugins;
+        std::map<std::string, PluginReport> reports;
+        int failureCount = 0;
+
+        for (size_t i=0; i<jobs.size(); ++i) {
+            const ChiSquareJob &job = jobs[i];
+            const ChiSquareWorkResult *result = proc->getResult(i);
+
+            if (!result) {
+                failAndContinue(formatString("The chi-square test of %s (wi=%s, component=%i) "
+                    "did not produce a result", job.plugin.c_str(), job.wi.toString().c_str(),
+                    job.component));
+                failureCount++;
+                continue;
+            }
 
-            #if defined(MTS_DEBUG_FP)
-                disableFPExceptions();
-            #endif
+            if (reports.find(job.plugin) == reports.end())
+                plugins.push_back(job.plugin);
+            PluginReport &report = reports[job.plugin];
+
+            report.testCount++;
+            report.sampleCount += result->sampleCount;
+            report.evaluationCount += result->evaluationCount;
+            report.samplingTime += result->samplingTime;
+            report.integrationTime += result->integrationTime;
+            report.largestWeight = std::max(report.largestWeight, result->largestWeight);
+            workTime += result->samplingTime + result->integrationTime;
+
+            if (result->result == ChiSquare::EReject) {
+                report.failureCount++;
+                failureCount++;
+                failAndContinue(formatString("Uh oh, the chi-square test indicates a potential "
+                    "issue for %s (wi=%s, component=%i). Dumped the contingency tables to "
+                    "'%s' for user analysis", job.plugin.c_str(), job.wi.toString().c_str(),
+                    job.component, getOutputPath(formatString("failure_%i.m", (int) i)).string().c_str()));
+            } else {
+                succeed();
+            }
+        }
 
-            return result;
+        Log(EInfo, "%-22s %6s %6s %12s %12s %10s", "Plugin", "Tests", "Failed",
+            "Samples/s", "Evals/s", "Max. weight");
+        for (size_t i=0; i<plugins.size(); ++i) {
+            const PluginReport &report = reports[plugins[i]];
+            Float samplingRate = report.sampleCount / std::max(report.samplingTime, (Float) 1e-6f);
+            Float evaluationRate = report.evaluationCount / std::max(report.integrationTime, (Float) 1e-6f);
+
+            Log(EInfo, "%-22s %6i %6i %12.0f %12.0f %10.2f", plugins[i].c_str(),
+                report.testCount, report.failureCount, samplingRate, evaluationRate,
+                report.largestWeight);
+            m_report << formatString("%s,%s,%i,%i,%.0f,%.0f,%.4f", category.c_str(),
+                plugins[i].c_str(), report.testCount, report.failureCount, samplingRate,
+                evaluationRate, report.largestWeight) << endl;
         }
 
-    private:
-        ref<const Emitter> m_emitter;
-        ref<Sampler> m_sampler;
-        PositionSamplingRecord m_pRec;
-    };
+        Log(EInfo, "%i/%i %s checks succeeded (took %.1f s, %.1f s of work)",
+            (int) jobs.size() - failureCount, (int) jobs.size(), category.c_str(),
+            wallTime, workTime);
+    }
 
     void test01_BSDF() {
         /* Load a set of BSDF instances to be tested from the following XML file */
@@ -395,114 +824,41 @@ public:
             resolver->resolveAbsolute("data/tests/test_bsdf.xml");
         ref<Scene> scene = loadScene(scenePath);
 
-        const ref_vector<ConfigurableObject> &objects = scene->getReferencedObjects();
-        int thetaBins = 10, wiSamples = 20, failureCount = 0, testCount = 0;
+        int wiSamples = 20;
         ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
                 createObject(MTS_CLASS(Sampler), Properties("independent")));
-        ProgressReporter *progress = new ProgressReporter("Checking", wiSamples, NULL);
+        std::vector<ChiSquareJob> jobs;
 
         Log(EInfo, "Verifying BSDF sampling routines ..");
+        ref_vector<ConfigurableObject> objects =
+            sweepParameters(scene->getReferencedObjects(), MTS_CLASS(BSDF));
         for (size_t i=0; i<objects.size(); ++i) {
-            if (!objects[i]->getClass()->derivesFrom(MTS_CLASS(BSDF)))
-                continue;
-
             const BSDF *bsdf = static_cast<const BSDF *>(objects[i].get());
-            Float largestWeight = 0;
-
-            Log(EInfo, "Processing BSDF model %s", bsdf->toString().c_str());
-
-            Log(EInfo, "Checking the model for %i incident directions and 2D sampling", wiSamples);
-            progress->reset();
-#if 1
-            /* Test for a number of different incident directions */
-            for (int j=0; j<wiSamples; ++j) {
-                Vector wi;
-
-                if (bsdf->getType() & BSDF::EBackSide)
-                    wi = warp::squareToUniformSphere(sampler->next2D());
-                else
-                    wi = warp::squareToCosineHemisphere(sampler->next2D());
-
-                BSDFAdapter adapter(bsdf, sampler, wi, -1);
-                ref<ChiSquare> chiSqr = new ChiSquare(thetaBins, 2*thetaBins, wiSamples);
-                chiSqr->setLogLevel(EDebug);
-
-                // Initialize the tables used by the chi-square test
-                chiSqr->fill(
-                    boost::bind(&BSDFAdapter::generateSample, &adapter),
-                    boost::bind(&BSDFAdapter::pdf, &adapter, _1, _2)
-                );
-
-                // (the following assumes that the distribution has 1 parameter, e.g. exponent value)
-                ChiSquare::ETestResult result = chiSqr->runTest(SIGNIFICANCE_LEVEL);
-                if (result == ChiSquare::EReject) {
-                    std::string filename = formatString("failure_%i.m", failureCount++);
-                    chiSqr->dumpTables(filename);
-                    failAndContinue(formatString("Uh oh, the chi-square test indicates a potential "
-                        "issue for wi=%s. Dumped the contingency tables to '%s' for user analysis",
-                        wi.toString().c_str(), filename.c_str()));
-                } else {
-                    succeed();
-                }
-                largestWeight = std::max(largestWeight, adapter.getLargestWeight());
-                ++testCount;
-                progress->update(j+1);
-
-//              if (!adapter.isSymmetric())
-//                  Log(EWarn, "****** BSDF is non-symmetric! ******");
-            }
-            Log(EInfo, "The largest encountered importance weight was = %.2f", largestWeight);
-
-#endif
-            largestWeight = 0;
-
-            if (bsdf->getComponentCount() > 1) {
-                for (int comp=0; comp<bsdf->getComponentCount(); ++comp) {
-                    progress->reset();
-                    Log(EInfo, "Individually checking BSDF component %i", comp);
-
-                    /* Test for a number of different incident directions */
-                    for (int j=0; j<wiSamples; ++j) {
-                        Vector wi;
-
-                        if (bsdf->getType(comp) & BSDF::EBackSide)
-                            wi = warp::squareToUniformSphere(sampler->next2D());
-                        else
-                            wi = warp::squareToCosineHemisphere(sampler->next2D());
-
-                        BSDFAdapter adapter(bsdf, sampler, wi, comp);
-
-                        ref<ChiSquare> chiSqr = new ChiSquare(thetaBins, 2*thetaBins, wiSamples);
-                        chiSqr->setLogLevel(EDebug);
-
-                        // Initialize the tables used by the chi-square test
-                        chiSqr->fill(
-                            boost::bind(&BSDFAdapter::generateSample, &adapter),
-                            boost::bind(&BSDFAdapter::pdf, &adapter, _1, _2)
-                        );
-
-                        // (the following assumes that the distribution has 1 parameter, e.g. exponent value)
-                        ChiSquare::ETestResult result = chiSqr->runTest(SIGNIFICANCE_LEVEL);
-                        if (result == ChiSquare::EReject) {
-                            std::string filename = formatString("failure_%i.m", failureCount++);
-                            chiSqr->dumpTables(filename);
-                            failAndContinue(formatString("Uh oh, the chi-square test indicates a potential "
-                                "issue for wi=%s. Dumped the contingency tables to '%s' for user analysis",
-                                wi.toString().c_str(), filename.c_str()));
-                        } else {
-                            succeed();
-                        }
-                        largestWeight = std::max(largestWeight, adapter.getLargestWeight());
-                        ++testCount;
-                        progress->update(j+1);
-                    }
-                    Log(EInfo, "The largest encountered importance weight was = %.2f", largestWeight);
-                    largestWeight = 0;
+            int componentCount = bsdf->getComponentCount();
+
+            /* Check the complete model, and individually check
+               each component if there are several of them */
+            for (int comp = -1; comp < (componentCount > 1 ? componentCount : 0); ++comp) {
+                /* Test for a number of different incident directions */
+                for (int j=0; j<wiSamples; ++j) {
+                    ChiSquareJob job;
+                    job.type = ChiSquareJob::EBSDF;
+                    job.bsdf = bsdf;
+                    job.plugin = bsdf->getClass()->getName();
+                    job.component = comp;
+                    job.numTests = wiSamples;
+
+                    if ((comp == -1 ? bsdf->getType() : bsdf->getType(comp)) & BSDF::EBackSide)
+                        job.wi = warp::squareToUniformSphere(sampler->next2D());
+                    else
+                        job.wi = warp::squareToCosineHemisphere(sampler->next2D());
+
+                    jobs.push_back(job);
                 }
             }
         }
-        Log(EInfo, "%i/%i BSDF checks succeeded", testCount-failureCount, testCount);
-        delete progress;
+
+        runTests(jobs, sampler, "BSDF");
     }
 
     void test02_PhaseFunction() {
@@ -512,64 +868,35 @@ public:
             resolver->resolveAbsolute("data/tests/test_phase.xml");
         ref<Scene> scene = loadScene(scenePath);
 
-        const ref_vector<ConfigurableObject> &objects = scene->getReferencedObjects();
-        int thetaBins = 10, wiSamples = 20, failureCount = 0, testCount = 0;
+        int wiSamples = 20;
         ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
                 createObject(MTS_CLASS(Sampler), Properties("independent")));
-
-        ProgressReporter *progress = new ProgressReporter("Checking", wiSamples, NULL);
+        std::vector<ChiSquareJob> jobs;
 
         Log(EInfo, "Verifying phase function sampling routines ..");
+        ref_vector<ConfigurableObject> objects =
+            sweepParameters(scene->getReferencedObjects(), MTS_CLASS(PhaseFunction));
         for (size_t i=0; i<objects.size(); ++i) {
-            if (!objects[i]->getClass()->derivesFrom(MTS_CLASS(PhaseFunction)))
-                continue;
-
             const PhaseFunction *phase = static_cast<const PhaseFunction *>(objects[i].get());
-            Float largestWeight = 0;
-
-            Log(EInfo, "Processing phase function model %s", phase->toString().c_str());
-            Log(EInfo, "Checking the model for %i incident directions", wiSamples);
-            progress->reset();
-            MediumSamplingRecord mRec;
 
             /* Sampler fiber/particle orientation */
+            MediumSamplingRecord mRec;
             mRec.orientation = warp::squareToUniformSphere(sampler->next2D());
 
             /* Test for a number of different incident directions */
             for (int j=0; j<wiSamples; ++j) {
-                Vector wi = warp::squareToUniformSphere(sampler->next2D());
-
-                PhaseFunctionAdapter adapter(mRec, phase, sampler, wi);
-                ref<ChiSquare> chiSqr = new ChiSquare(thetaBins, 2*thetaBins, wiSamples);
-                chiSqr->setLogLevel(EDebug);
-
-                // Initialize the tables used by the chi-square test
-                chiSqr->fill(
-                    boost::bind(&PhaseFunctionAdapter::generateSample, &adapter),
-                    boost::bind(&PhaseFunctionAdapter::pdf, &adapter, _1, _2)
-                );
-
-                // (the following assumes that the distribution has 1 parameter, e.g. exponent value)
-                ChiSquare::ETestResult result = chiSqr->runTest(SIGNIFICANCE_LEVEL);
-                if (result == ChiSquare::EReject) {
-                    std::string filename = formatString("failure_%i.m", failureCount++);
-                    chiSqr->dumpTables(filename);
-                    failAndContinue(formatString("Uh oh, the chi-square test indicates a potential "
-                        "issue for wi=%s. Dumped the contingency tables to '%s' for user analysis",
-                        wi.toString().c_str(), filename.c_str()));
-                } else {
-                    succeed();
-                }
-                largestWeight = std::max(largestWeight, adapter.getLargestWeight());
-                ++testCount;
-                progress->update(j+1);
+                ChiSquareJob job;
+                job.type = ChiSquareJob::EPhaseFunction;
+                job.phase = phase;
+                job.plugin = phase->getClass()->getName();
+                job.mRec = mRec;
+                job.wi = warp::squareToUniformSphere(sampler->next2D());
+                job.numTests = wiSamples;
+                jobs.push_back(job);
             }
-
-            Log(EInfo, "Done with this phase function. The largest encountered "
-                    "importance weight was = %.2f", largestWeight);
         }
-        Log(EInfo, "%i/%i phase function checks succeeded", testCount-failureCount, testCount);
-        delete progress;
+
+        runTests(jobs, sampler, "phase function");
     }
 
     void test03_EmitterDirect() {
@@ -581,43 +908,28 @@ public:
         scene->initialize();
 
         const ref_vector<Emitter> &emitters = scene->getEmitters();
-        int thetaBins = 10, failureCount = 0, testCount = 0;
         ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
                 createObject(MTS_CLASS(Sampler), Properties("independent")));
+        std::vector<ChiSquareJob> jobs;
 
         Log(EInfo, "Verifying emitter sampling routines ..");
         for (size_t i=0; i<emitters.size(); ++i) {
-            const Emitter *emitter = emitters[i].get();
-
-            Log(EInfo, "Processing emitter function model %s", emitter->toString().c_str());
-
-            EmitterAdapter adapter(emitter, sampler);
-            ref<ChiSquare> chiSqr = new ChiSquare(thetaBins, 2*thetaBins, 1);
-            chiSqr->setLogLevel(EDebug);
-
-            // Initialize the tables used by the chi-square test
-            chiSqr->fill(
-                boost::bind(&EmitterAdapter::generateSample, &adapter),
-                boost::bind(&EmitterAdapter::pdf, &adapter, _1, _2)
-            );
-            chiSqr->dumpTables("test.m");
-
-            // (the following assumes that the distribution has 1 parameter, e.g. exponent value)
-            ChiSquare::ETestResult result = chiSqr->runTest(SIGNIFICANCE_LEVEL);
-            if (result == ChiSquare::EReject) {
-                std::string filename = formatString("failure_%i.m", failureCount++);
-                chiSqr->dumpTables(filename);
-                failAndContinue(formatString("Uh oh, the chi-square test indicates a potential "
-                    "issue. Dumped the contingency tables to '%s' for user analysis",
-                    filename.c_str()));
-            } else {
-                succeed();
-            }
-            ++testCount;
+            ChiSquareJob job;
+            job.type = ChiSquareJob::EEmitter;
+            job.emitter = emitters[i].get();
+            job.plugin = emitters[i]->getClass()->getName();
+            jobs.push_back(job);
         }
-        Log(EInfo, "%i/%i emitter checks succeeded", testCount-failureCount, testCount);
+
+        runTests(jobs, sampler, "emitter");
     }
+
+private:
+    std::ostringstream m_report;
 };
 
+MTS_IMPLEMENT_CLASS(ChiSquareWorkResult, false, WorkResult)
+MTS_IMPLEMENT_CLASS(ChiSquareWorker, false, WorkProcessor)
+MTS_IMPLEMENT_CLASS(ChiSquareProcess, false, ParallelProcess)
 MTS_EXPORT_TESTCASE(TestChiSquare, "Chi-square test for various sampling functions")
 MTS_NAMESPACE_END
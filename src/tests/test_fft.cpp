@@ -0,0 +1,215 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/core/fft.h>
+#include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/random.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestFFT : public TestCase {
+public:
+    MTS_BEGIN_TESTCASE()
+    MTS_DECLARE_TEST(test01_smoothSize)
+    MTS_DECLARE_TEST(test02_transform1D)
+    MTS_DECLARE_TEST(test03_transform2D)
+    MTS_DECLARE_TEST(test04_realTransform2D)
+    MTS_DECLARE_TEST(test05_convolve)
+    MTS_END_TESTCASE()
+
+    typedef FFT::Complex Complex;
+
+    /// Maximum absolute difference between two arrays
+    double maxError(const std::vector<Complex> &a, const std::vector<Complex> &b) {
+        double err = 0;
+        for (size_t i=0; i<a.size(); ++i)
+            err = std::max(err, std::abs(a[i] - b[i]));
+        return err;
+    }
+
+    std::vector<Complex> randomData(Random *random, size_t n) {
+        std::vector<Complex> data(n);
+        for (size_t i=0; i<n; ++i)
+            data[i] = Complex(random->nextFloat() - 0.5f, random->nextFloat() - 0.5f);
+        return data;
+    }
+
+    /// Reference O(n^2) DFT
+    std::vector<Complex> naiveDFT(const std::vector<Complex> &in, bool inverse) {
+        size_t n = in.size();
+        std::vector<Complex> out(n);
+        for (size_t k=0; k<n; ++k) {
+            Complex sum(0.0);
+            for (size_t j=0; j<n; ++j) {
+                double angle = (inverse ? 2 : -2) * M_PI_DBL * (double) ((j*k) % n) / n;
+                sum += in[j] * Complex(std::cos(angle), std::sin(angle));
+            }
+            out[k] = sum;
+        }
+        return out;
+    }
+
+    void test01_smoothSize() {
+        assertEquals((int) FFT::getSmoothSize(1), 1);
+        assertEquals((int) FFT::getSmoothSize(7), 8);
+        assertEquals((int) FFT::getSmoothSize(17), 18);
+        assertEquals((int) FFT::getSmoothSize(61), 64);
+        assertEquals((int) FFT::getSmoothSize(1001), 1024);
+        assertEquals((int) FFT::getSmoothSize(8160), 8192);
+        assertEquals((int) FFT::getSmoothSize(11520), 11520);
+    }
+
+    void test02_transform1D() {
+        ref<Random> random = new Random();
+        const size_t sizes[] = { 1, 2, 3, 4, 5, 6, 8, 9, 12, 15, 16, 25, 30, 32, 45, 60, 64, 100, 243, 256, 360 };
+
+        for (size_t i=0; i<sizeof(sizes)/sizeof(size_t); ++i) {
+            size_t n = sizes[i];
+            ref<FFT> fft = new FFT(n);
+            std::vector<Complex> data = randomData(random, n), scratch(n);
+
+            for (int inverse=0; inverse<2; ++inverse) {
+                std::vector<Complex> result = data;
+                fft->transform(&result[0], &scratch[0], inverse == 1);
+                double err = maxError(result, naiveDFT(data, inverse == 1));
+                if (err > 1e-9 * n)
+                    Log(EError, "%s (inverse=%i): error %e is too large!",
+                        fft->toString().c_str(), inverse, err);
+            }
+
+            /* Round trip */
+            std::vector<Complex> result = data;
+            fft->transform(&result[0], &scratch[0]);
+            fft->transform(&result[0], &scratch[0], true);
+            for (size_t j=0; j<n; ++j)
+                result[j] /= (double) n;
+            assertTrue(maxError(result, data) < 1e-12);
+        }
+    }
+
+    void test03_transform2D() {
+        ref<Random> random = new Random();
+        const size_t width = 20, height = 9;
+        std::vector<Complex> data = randomData(random, width*height), result = data;
+        FFT::transform2D(&result[0], width, height);
+
+        /* Reference: transform the rows, then the columns */
+        std::vector<Complex> ref(width*height);
+        for (size_t y=0; y<height; ++y) {
+            std::vector<Complex> row(data.begin() + y*width, data.begin() + (y+1)*width);
+            row = naiveDFT(row, false);
+            std::copy(row.begin(), row.end(), ref.begin() + y*width);
+        }
+        for (size_t x=0; x<width; ++x) {
+            std::vector<Complex> col(height);
+            for (size_t y=0; y<height; ++y)
+                col[y] = ref[x + y*width];
+            col = naiveDFT(col, false);
+            for (size_t y=0; y<height; ++y)
+                ref[x + y*width] = col[y];
+        }
+        assertTrue(maxError(result, ref) < 1e-10);
+    }
+
+    void test04_realTransform2D() {
+        ref<Random> random = new Random();
+        const size_t width = 30, height = 9;
+        ref<RealFFT2D> fft = new RealFFT2D(width, height);
+
+        std::vector<float> data(width*height), result(width*height);
+        std::vector<Complex> ref(width*height);
+        for (size_t i=0; i<data.size(); ++i)
+            ref[i] = data[i] = random->nextFloat() - 0.5f;
+        FFT::transform2D(&ref[0], width, height);
+
+        /* Compare the non-redundant half of the spectrum */
+        std::vector<FFT::ComplexBatch> spectrum(fft->getSpectrumSize());
+        fft->forward(&data[0], &spectrum[0]);
+        double err = 0;
+        for (size_t y=0; y<height; ++y) {
+            for (size_t x=0; x<=width/2; ++x) {
+                const FFT::ComplexBatch &value = spectrum[(x/4)*height + y];
+                err = std::max(err, std::abs(ref[x + y*width] -
+                    Complex(value.re[x%4], value.im[x%4])));
+            }
+        }
+        assertTrue(err < 1e-5);
+
+        /* Round trip */
+        fft->inverse(&spectrum[0], &result[0]);
+        err = 0;
+        for (size_t i=0; i<data.size(); ++i)
+            err = std::max(err, std::abs((double) result[i] / (width*height) - data[i]));
+        assertTrue(err < 1e-6);
+    }
+
+    void test05_convolve() {
+        ref<Random> random = new Random();
+        const int width = 37, height = 23, kernelSize = 9, channels = 3;
+
+        ref<Bitmap> image = new Bitmap(Bitmap::ERGB, Bitmap::EFloat32, Vector2i(width, height));
+        float *data = image->getFloat32Data();
+        for (size_t i=0; i<image->getPixelCount() * channels; ++i)
+            data[i] = random->nextFloat();
+
+        for (int kernelChannels = 1; kernelChannels <= channels; kernelChannels += channels-1) {
+            ref<Bitmap> kernel = new Bitmap(kernelChannels == 1 ? Bitmap::ELuminance : Bitmap::ERGB,
+                Bitmap::EFloat32, Vector2i(kernelSize));
+            float *kdata = kernel->getFloat32Data();
+            for (size_t i=0; i<kernel->getPixelCount() * kernelChannels; ++i)
+                kdata[i] = random->nextFloat();
+
+            /* Single precision takes the real-valued transform, double precision the complex one */
+            for (int format = Bitmap::EFloat32; format <= Bitmap::EFloat64; ++format) {
+                Bitmap::EComponentFormat fmt = (Bitmap::EComponentFormat) format;
+                /* (convert() returns the image itself if the format doesn't change) */
+                ref<Bitmap> result = image->convert(image->getPixelFormat(), fmt)->clone();
+                result->convolve(kernel->convert(kernel->getPixelFormat(), fmt));
+                result = result->convert(image->getPixelFormat(), Bitmap::EFloat32);
+
+                /* Compare against a brute force convolution */
+                double maxErr = 0;
+                for (int y=0; y<height; ++y) {
+                    for (int x=0; x<width; ++x) {
+                        for (int ch=0; ch<channels; ++ch) {
+                            int chKernel = kernelChannels > 1 ? ch : 0;
+                            double sum = 0;
+                            for (int ky=0; ky<kernelSize; ++ky) {
+                                for (int kx=0; kx<kernelSize; ++kx) {
+                                    int xs = x + kx - kernelSize/2, ys = y + ky - kernelSize/2;
+                                    if (xs >= 0 && ys >= 0 && xs < width && ys < height)
+                                        sum += (double) kdata[(kx+ky*kernelSize)*kernelChannels+chKernel]
+                                             * (double) data[(xs+ys*width)*channels+ch];
+                                }
+                            }
+                            maxErr = std::max(maxErr, std::abs(sum -
+                                result->getFloat32Data()[(x+y*width)*channels+ch]));
+                        }
+                    }
+                }
+                Log(EInfo, "Kernel with %i channel(s), %s: max. error = %e", kernelChannels,
+                    format == Bitmap::EFloat32 ? "float32" : "float64", maxErr);
+                assertTrue(maxErr < 1e-4);
+            }
+        }
+    }
+};
+
+MTS_EXPORT_TESTCASE(TestFFT, "Testcase for the FFT and Bitmap::convolve()")
+MTS_NAMESPACE_END
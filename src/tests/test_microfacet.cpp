@@ -45,6 +45,7 @@ public:
     MTS_BEGIN_TESTCASE()
     MTS_DECLARE_TEST(test01_Microfacet)
     MTS_DECLARE_TEST(test02_MicrofacetVisible)
+    MTS_DECLARE_TEST(test03_MicrofacetBatch)
     MTS_END_TESTCASE()
 
     class MicrofacetAdapter {
@@ -170,6 +171,59 @@ public:
             }
         }
     }
+
+    void test03_MicrofacetBatch() {
+        std::vector<MicrofacetDistribution> distrs;
+        distrs.push_back(MicrofacetDistribution(MicrofacetDistribution::EBeckmann, 0.3f));
+        distrs.push_back(MicrofacetDistribution(MicrofacetDistribution::EBeckmann, 0.5f, 0.1f));
+        distrs.push_back(MicrofacetDistribution(MicrofacetDistribution::EGGX, 0.2f));
+        distrs.push_back(MicrofacetDistribution(MicrofacetDistribution::EGGX, 0.05f, 0.6f));
+        distrs.push_back(MicrofacetDistribution(MicrofacetDistribution::EPhong, 0.5f, 0.3f, false));
+
+        ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
+                createObject(MTS_CLASS(Sampler), Properties("independent")));
+
+        /* Odd size to exercise the scalar tail, and both hemispheres */
+        const size_t count = 1023;
+        std::vector<Vector> wi(count), wo(count), m(count);
+        std::vector<Point2> samples(count);
+        for (size_t i=0; i<count; ++i) {
+            wi[i] = warp::squareToUniformSphere(sampler->next2D());
+            wo[i] = warp::squareToUniformSphere(sampler->next2D());
+            m[i] = normalize(wi[i] + wo[i]);
+            samples[i] = sampler->next2D();
+        }
+        wi[0] = m[0] = Vector(0, 0, 1);
+
+        std::vector<Float> result(count), pdf(count);
+        std::vector<Normal> normals(count);
+        for (size_t i=0; i<distrs.size(); ++i) {
+            const MicrofacetDistribution &distr = distrs[i];
+            Log(EInfo, "Testing %s", distr.toString().c_str());
+
+            distr.eval(&m[0], &result[0], count);
+            for (size_t j=0; j<count; ++j)
+                assertEqualsEpsilon(result[j], distr.eval(m[j]), 1e-4f * std::max((Float) 1, result[j]));
+
+            distr.G(&wi[0], &wo[0], &m[0], &result[0], count);
+            for (size_t j=0; j<count; ++j)
+                assertEqualsEpsilon(result[j], distr.G(wi[j], wo[j], m[j]), 1e-4f);
+
+            distr.pdf(&wi[0], &m[0], &result[0], count);
+            for (size_t j=0; j<count; ++j)
+                assertEqualsEpsilon(result[j], distr.pdf(wi[j], m[j]), 1e-4f * std::max((Float) 1, result[j]));
+
+            distr.sample(&wi[0], &samples[0], &normals[0], &pdf[0], count);
+            for (size_t j=0; j<count; ++j) {
+                if (Frame::cosTheta(wi[j]) <= 0)
+                    continue;
+                Float pdfRef;
+                Normal mRef = distr.sample(wi[j], samples[j], pdfRef);
+                assertEqualsEpsilon(pdf[j], pdfRef, 1e-4f * std::max((Float) 1, pdfRef));
+                assertTrue((normals[j] - mRef).length() < 1e-4f);
+            }
+        }
+    }
 };
 
 MTS_EXPORT_TESTCASE(TestChiSquare, "Chi-square test for microfacet sampling")
@@ -0,0 +1,136 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/core/properties.h>
+#include <mitsuba/core/timer.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestProperties : public TestCase {
+public:
+    MTS_BEGIN_TESTCASE()
+    MTS_DECLARE_TEST(test01_setGet)
+    MTS_DECLARE_TEST(test02_copyMergeRemove)
+    MTS_DECLARE_TEST(test03_animatedTransform)
+    MTS_DECLARE_TEST(test04_instancingBenchmark)
+    MTS_END_TESTCASE()
+
+    void test01_setGet() {
+        Properties props("diffuse");
+        props.setFloat("alpha", 0.5f);
+        props.setInteger("samples", 16);
+        props.setString("filename", "test.exr");
+        props.setBoolean("twoSided", true);
+
+        assertTrue(props.hasProperty("alpha"));
+        assertFalse(props.hasProperty("alph"));
+        assertEquals(props.getFloat("alpha"), (Float) 0.5f);
+        assertEquals(props.getInteger("samples"), 16);
+        assertEquals(props.getInteger("missing", 3), 3);
+        assertTrue(props.getString("filename") == "test.exr");
+        assertTrue(props.getBoolean("twoSided"));
+        assertTrue(props.getType("samples") == Properties::EInteger);
+
+        /* Overwriting retains a single entry */
+        props.setFloat("alpha", 0.25f, false);
+        assertEquals(props.getFloat("alpha"), (Float) 0.25f);
+        assertEquals((int) props.getPropertyNames().size(), 4);
+
+        props.removeProperty("filename");
+        assertTrue(props.getUnqueried().empty());
+        props.setFloat("beta", 1.0f);
+        assertEquals((int) props.getUnqueried().size(), 1);
+    }
+
+    void test02_copyMergeRemove() {
+        Properties a("phong"), b("phong");
+        a.setFloat("exponent", 30.0f);
+        a.setSpectrum("specularReflectance", Spectrum(0.2f));
+        b.setSpectrum("specularReflectance", Spectrum(0.2f));
+        b.setFloat("exponent", 30.0f);
+
+        /* Equality does not depend on the insertion order */
+        assertTrue(a == b);
+
+        Properties c(a);
+        assertTrue(c == a);
+        c.setFloat("exponent", 10.0f, false);
+        assertTrue(c != a);
+        assertEquals(a.getFloat("exponent"), (Float) 30.0f);
+
+        Properties d("phong");
+        d.setFloat("exponent", 1.0f);
+        d.setFloat("extra", 2.0f);
+        d.merge(a);
+        assertEquals(d.getFloat("exponent"), (Float) 30.0f);
+        assertEquals(d.getFloat("extra"), (Float) 2.0f);
+        assertTrue(d.removeProperty("extra"));
+        assertFalse(d.removeProperty("extra"));
+        assertTrue(d == a);
+
+        d.copyAttribute(d, "exponent", "exponent2");
+        assertEquals(d.getFloat("exponent2"), (Float) 30.0f);
+    }
+
+    void test03_animatedTransform() {
+        ref<AnimatedTransform> trafo = new AnimatedTransform(Transform::translate(Vector(1, 2, 3)));
+        int refCount = trafo->getRefCount();
+        {
+            Properties a;
+            a.setAnimatedTransform("toWorld", trafo);
+            Properties b(a), c;
+            c.merge(a);
+            c.copyAttribute(a, "toWorld", "toWorld2");
+            assertEquals(trafo->getRefCount(), refCount + 4);
+            c.setFloat("toWorld2", 1.0f, false);
+            assertEquals(trafo->getRefCount(), refCount + 3);
+            assertTrue(b.getAnimatedTransform("toWorld").get() == trafo.get());
+        }
+        assertEquals(trafo->getRefCount(), refCount);
+    }
+
+    void test04_instancingBenchmark() {
+        /* Mimics the property traffic generated while loading a scene with
+           a million instances: build, copy and query a small record */
+        const size_t instanceCount = 1000000;
+        Properties base("instance");
+        base.setString("id", "shapegroup");
+        base.setBoolean("flipNormals", false);
+        base.setFloat("maxSmoothAngle", 30.0f);
+
+        ref<Timer> timer = new Timer();
+        Float sum = 0;
+        for (size_t i=0; i<instanceCount; ++i) {
+            Properties props(base);
+            props.setTransform("toWorld", Transform::translate(Vector((Float) i, 0, 0)));
+            props.setInteger("index", (int) i);
+            sum += props.getTransform("toWorld").getMatrix()(0, 3)
+                + props.getFloat("maxSmoothAngle")
+                + (props.getBoolean("flipNormals", true) ? 1 : 0)
+                + (props.getBoolean("faceNormals", false) ? 1 : 0)
+                + props.getInteger("index");
+        }
+        Log(EInfo, "Created and queried " SIZE_T_FMT " property records in %i ms",
+            instanceCount, timer->getMilliseconds());
+        assertTrue(sum > 0);
+    }
+};
+
+MTS_EXPORT_TESTCASE(TestProperties, "Testcase for the Properties container")
+MTS_NAMESPACE_END
@@ -344,7 +344,9 @@ public:
     MTS_DECLARE_TEST(test07_uniform_distribution_ks);
     MTS_DECLARE_TEST(test08_serialize);
     MTS_DECLARE_TEST(test09_set);
+    MTS_DECLARE_TEST(test10_batch);
     MTS_DECLARE_TEST(benchmark);
+    MTS_DECLARE_TEST(benchmark_batch);
     MTS_END_TESTCASE()
 
     void test00_validate();
@@ -358,7 +360,9 @@ public:
     void test07_uniform_distribution_ks();
     void test08_serialize();
     void test09_set();
+    void test10_batch();
     void benchmark();
+    void benchmark_batch();
 
 private:
 
@@ -817,6 +821,46 @@ void TestRandom::test09_set()
 
 
 
+// The batch functions must produce the same sequence as the scalar ones
+void TestRandom::test10_batch()
+{
+    // Sizes which are not multiples of the SIMD width or the state size
+    const size_t sizes[] = { 1, 3, 17, 311, 5001, 100003 };
+    ref<Random> rnd1 = new Random(1234);
+    ref<Random> rnd2 = new Random(1234);
+
+    for (size_t k = 0; k < array_size(sizes); ++k) {
+        const size_t n = sizes[k];
+
+        std::vector<uint64_t> ulongs(n);
+        rnd1->nextULong(&ulongs[0], n);
+        for (size_t i = 0; i < n; ++i)
+            assertTrue(ulongs[i] == rnd2->nextULong());
+
+        std::vector<Float> floats(n);
+        rnd1->nextFloat(&floats[0], n);
+        for (size_t i = 0; i < n; ++i)
+            assertTrue(floats[i] == rnd2->nextFloat());
+
+        std::vector<uint32_t> uints(n);
+        rnd1->nextUInt(&uints[0], n, 37);
+        for (size_t i = 0; i < n; ++i)
+            assertTrue(uints[i] == rnd2->nextUInt(37));
+
+        std::vector<float> singles(n);
+        std::vector<double> doubles(n);
+        rnd1->nextSingle(&singles[0], n);
+        rnd1->nextDouble(&doubles[0], n);
+        for (size_t i = 0; i < n; ++i)
+            assertTrue(singles[i] >= 0 && singles[i] < 1);
+        for (size_t i = 0; i < n; ++i)
+            assertTrue(doubles[i] >= 0 && doubles[i] < 1);
+        rnd2->set(rnd1);
+    }
+}
+
+
+
 // Simple benchmark based on the mean test
 void TestRandom::benchmark()
 {
@@ -854,6 +898,41 @@ void TestRandom::benchmark()
 
 
 
+// Same as above, but using the batch interface
+void TestRandom::benchmark_batch()
+{
+    const int N1 = 1000;
+    const int N2 = 1000000;
+    const int blockSize = 4096;
+    const Float epsilon = static_cast<Float>(1e-4);
+    Float estimate = 0;
+    Float current  = 0;
+
+    ref<Random> rnd = new Random;
+    std::vector<Float> block(blockSize);
+
+    ref<Timer> timer = new Timer;
+    for (int i = 0; i < N1; ++i) {
+        current = 0;
+        for (int j = 0; j < N2; j += blockSize) {
+            const int size = std::min(blockSize, N2 - j);
+            rnd->nextFloat(&block[0], size);
+            for (int k = 0; k < size; ++k)
+                current += block[k];
+        }
+        estimate += current / N2;
+    }
+    const Float seconds = timer->getSeconds();
+
+    const int N = N1 * N2;
+    Log(EInfo, "Generated %.1fM random numbers in %.2f s (%.3f M-random/s)",
+        1e-6 * N, seconds, 1e-6 * N / seconds);
+    estimate /= N1;
+    assertEqualsEpsilon(estimate, static_cast<Float>(0.5), epsilon);
+}
+
+
+
 void TestRandom::test05_rank_validation()
 {
     static const char * test_data = ""
@@ -28,6 +28,8 @@ public:
     MTS_DECLARE_TEST(test01_Halton)
     MTS_DECLARE_TEST(test02_Hammersley)
     MTS_DECLARE_TEST(test03_radicalInverseIncr)
+    MTS_DECLARE_TEST(test04_deterministic)
+    MTS_DECLARE_TEST(test05_skip)
     MTS_END_TESTCASE()
 
     void test01_Halton() {
@@ -84,6 +86,67 @@ public:
             x = radicalInverseIncremental(2, x);
         }
     }
+
+    void test04_deterministic() {
+        const char *plugins[] = { "independent", "stratified", "ldsampler" };
+
+        for (int k=0; k<3; ++k) {
+            Properties props(plugins[k]);
+            props.setInteger("sampleCount", 16);
+            props.setBoolean("deterministic", true);
+            ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
+                    createObject(MTS_CLASS(Sampler), props));
+
+            /* The values of a sample must neither depend on the clone nor
+               on the pixels and samples that were generated before */
+            ref<Sampler> clone = sampler->clone();
+            sampler->generate(Point2i(3, 5));
+            clone->generate(Point2i(7, 1));
+            clone->generate(Point2i(3, 5));
+
+            Float values[16][10];
+            for (int i=0; i<16; ++i) {
+                for (int j=0; j<10; ++j)
+                    values[i][j] = sampler->next1D();
+                sampler->advance();
+            }
+
+            for (int i=15; i>=0; --i) {
+                clone->setSampleIndex(i);
+                for (int j=0; j<10; ++j)
+                    assertEquals(clone->next1D(), values[i][j]);
+            }
+        }
+    }
+
+    void test05_skip() {
+        const char *plugins[] = { "independent", "stratified", "ldsampler", "halton" };
+
+        for (int k=0; k<4; ++k) {
+            Properties props(plugins[k]);
+            props.setInteger("sampleCount", 16);
+            props.setBoolean("deterministic", true);
+            if (k == 1 || k == 2) /* Also cover the pseudorandom dimensions */
+                props.setInteger("dimension", 2);
+            ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
+                    createObject(MTS_CLASS(Sampler), props));
+
+            /* Skipping must be equivalent to retrieving the values */
+            sampler->generate(Point2i(3, 5));
+            for (int i=0; i<16; ++i) {
+                sampler->setSampleIndex(i);
+                sampler->next2D(); sampler->next2D(); sampler->next2D();
+                sampler->next1D(); sampler->next1D();
+                Float value1D = sampler->next1D();
+                Point2 value2D = sampler->next2D();
+
+                sampler->setSampleIndex(i);
+                sampler->skip(2, 3);
+                assertEquals(sampler->next1D(), value1D);
+                assertEquals(sampler->next2D().x, value2D.x);
+            }
+        }
+    }
 };
 
 MTS_EXPORT_TESTCASE(TestSamplers, "Testcase for sampling-related code")
@@ -0,0 +1,174 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/core/tonemap.h>
+#include <mitsuba/core/random.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestTonemap : public TestCase {
+public:
+    MTS_BEGIN_TESTCASE()
+    MTS_DECLARE_TEST(test01_toDisplay)
+    MTS_DECLARE_TEST(test02_luminanceStatistics)
+    MTS_DECLARE_TEST(test03_reinhard)
+    MTS_END_TESTCASE()
+
+    static int getChannelCount(Bitmap::EPixelFormat fmt) {
+        switch (fmt) {
+            case Bitmap::ELuminance: return 1;
+            case Bitmap::ELuminanceAlpha: return 2;
+            case Bitmap::ERGB: return 3;
+            default: return 4;
+        }
+    }
+
+    /// Random test data, including negative values, NaNs and overexposed pixels
+    std::vector<float> randomData(Random *random, size_t count) {
+        std::vector<float> data(count);
+        for (size_t i=0; i<count; ++i) {
+            Float u = random->nextFloat();
+            if (u < 0.02f)
+                data[i] = -u;
+            else if (u < 0.03f)
+                data[i] = std::numeric_limits<float>::quiet_NaN();
+            else
+                data[i] = u * u * 3;
+        }
+        return data;
+    }
+
+    /// Scalar reference, which matches the generic FormatConverter code path
+    static uint8_t quantize(Float value, Float multiplier, Float invGamma) {
+        value *= multiplier;
+        if (invGamma == -1)
+            value = (value <= (Float) 0.0031308) ? ((Float) 12.92 * value)
+                : ((Float) 1.055 * std::pow(value, (Float) (1.0/2.4)) - (Float) 0.055);
+        else if (invGamma != 1)
+            value = std::pow(value, invGamma);
+        return (uint8_t) std::min((Float) 255, std::max((Float) 0, value * 255 + (Float) 0.5f));
+    }
+
+    void test01_toDisplay() {
+        ref<Random> random = new Random();
+        const size_t count = 1003;
+        const Bitmap::EPixelFormat formats[] = { Bitmap::ELuminance,
+            Bitmap::ELuminanceAlpha, Bitmap::ERGB, Bitmap::ERGBA };
+        const Float invGammas[] = { -1, 1/(Float) 2.2f, 1 };
+        std::vector<float> source = randomData(random, count * 4);
+
+        for (int i=0; i<4; ++i) {
+            for (int j=0; j<4; ++j) {
+                for (int k=0; k<3; ++k) {
+                    Bitmap::EPixelFormat srcFmt = formats[i], destFmt = formats[j];
+                    int srcChannels = getChannelCount(srcFmt), destChannels = getChannelCount(destFmt);
+                    Float multiplier = 0.7f, invGamma = invGammas[k];
+
+                    std::vector<uint8_t> result(count * destChannels);
+                    tonemap::toDisplay(&source[0], srcFmt, &result[0], destFmt, count,
+                        tonemap::Parameters(multiplier, invGamma));
+
+                    int maxError = 0;
+                    for (size_t p=0; p<count; ++p) {
+                        const float *src = &source[p * srcChannels];
+                        Float color[3], alpha = 1;
+                        if (srcChannels >= 3) {
+                            for (int c=0; c<3; ++c)
+                                color[c] = src[c];
+                        } else {
+                            color[0] = color[1] = color[2] = src[0];
+                        }
+                        if (srcChannels == 2 || srcChannels == 4)
+                            alpha = src[srcChannels-1];
+                        if (destChannels <= 2 && srcChannels >= 3)
+                            color[0] = src[0] * 0.212671f + src[1] * 0.715160f + src[2] * 0.072169f;
+
+                        uint8_t expected[4];
+                        for (int c=0; c<3; ++c)
+                            expected[c] = quantize(color[c], multiplier, invGamma);
+                        uint8_t quantizedAlpha = quantize(alpha, 1, 1);
+                        if (destChannels == 2)
+                            expected[1] = quantizedAlpha;
+                        else if (destChannels == 4)
+                            expected[3] = quantizedAlpha;
+
+                        for (int c=0; c<destChannels; ++c)
+                            maxError = std::max(maxError,
+                                std::abs((int) expected[c] - (int) result[p * destChannels + c]));
+                    }
+
+                    if (maxError > 1)
+                        Log(EError, "Conversion %i -> %i (invGamma=%f): error of %i steps!",
+                            (int) srcFmt, (int) destFmt, invGamma, maxError);
+                }
+            }
+        }
+    }
+
+    void test02_luminanceStatistics() {
+        ref<Random> random = new Random();
+        const size_t count = 4099;
+        std::vector<float> data = randomData(random, count * 3);
+        data[3*17] = data[3*17+1] = data[3*17+2] = 1024; /* Banner pixel */
+
+        double sumLog = 0;
+        float maxRef = 0, multiplier = 2;
+        for (size_t i=0; i<count; ++i) {
+            float lum = data[3*i] * 0.212671f + data[3*i+1] * 0.715160f
+                + data[3*i+2] * 0.072169f;
+            if (!(lum >= 0) || lum == 1024)
+                lum = 0;
+            lum *= multiplier;
+            maxRef = std::max(maxRef, lum);
+            sumLog += std::log(1e-3 + lum);
+        }
+        Float logAvgRef = (Float) std::exp(sumLog / count);
+
+        Float logAvg, maxLum;
+        tonemap::getLuminanceStatistics(&data[0], Bitmap::ERGB, count,
+            multiplier, logAvg, maxLum);
+        assertEqualsEpsilon(maxLum, maxRef, 1e-5f);
+        assertEqualsEpsilon(logAvg, logAvgRef, 1e-3f * logAvgRef);
+    }
+
+    void test03_reinhard() {
+        ref<Random> random = new Random();
+        ref<Bitmap> bitmap = new Bitmap(Bitmap::ERGBA, Bitmap::EFloat32, Vector2i(37, 23));
+        float *data = bitmap->getFloat32Data();
+        for (size_t i=0; i<bitmap->getPixelCount() * 4; ++i)
+            data[i] = random->nextFloat() * random->nextFloat() * 10 + 0.01f;
+
+        /* EFloat64 images still use the xyY round trip */
+        ref<Bitmap> reference = bitmap->convert(Bitmap::ERGBA, Bitmap::EFloat64);
+
+        Float logAvg1 = 0, maxLum1 = 0, logAvg2 = 0, maxLum2 = 0;
+        bitmap->tonemapReinhard(logAvg1, maxLum1, 0.18f, 0.2f);
+        reference->tonemapReinhard(logAvg2, maxLum2, 0.18f, 0.2f);
+        assertEqualsEpsilon(logAvg1, logAvg2, 1e-3f * logAvg2);
+        assertEqualsEpsilon(maxLum1, maxLum2, 1e-5f);
+
+        const double *refData = reference->getFloat64Data();
+        for (size_t i=0; i<bitmap->getPixelCount() * 4; ++i)
+            assertEqualsEpsilon((Float) data[i], (Float) refData[i],
+                (Float) (2e-3 * std::max(refData[i], 1e-2)));
+    }
+};
+
+MTS_EXPORT_TESTCASE(TestTonemap, "Testcase for the vectorized tonemapping kernels")
+MTS_NAMESPACE_END
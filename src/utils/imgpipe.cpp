@@ -0,0 +1,891 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/util.h>
+#include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/fresolver.h>
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/rfilter.h>
+#include <mitsuba/core/timer.h>
+#include <mitsuba/core/version.h>
+#include <boost/algorithm/string.hpp>
+#include <deque>
+#if defined(WIN32)
+# include <mitsuba/core/getopt.h>
+#endif
+
+MTS_NAMESPACE_BEGIN
+
+/* Number of scanlines that are converted together by a single thread */
+#define IMGPIPE_BAND_SIZE 8
+
+/**
+ * \brief Stage of a streaming image processing pipeline
+ *
+ * Each stage hands out consecutive blocks ("chunks") of scanlines in
+ * top-to-bottom order, pulling just as much data from its inputs as is
+ * needed to produce them. Chunks are single precision bitmaps, whose
+ * pixel format, gamma and channel names match those of the stage.
+ */
+class ImageStage : public Object {
+public:
+    /// Return the size of the image produced by this stage
+    inline const Vector2i &getSize() const { return m_size; }
+
+    /// Return the pixel format of the produced chunks
+    inline Bitmap::EPixelFormat getPixelFormat() const { return m_pixelFormat; }
+
+    /// Return the number of channels of the produced chunks
+    inline int getChannelCount() const { return m_channelCount; }
+
+    /// Return the gamma of the produced chunks
+    inline Float getGamma() const { return m_gamma; }
+
+    /// Return the channel names (only set for multi-channel images)
+    inline const std::vector<std::string> &getChannelNames() const { return m_channelNames; }
+
+    /// Return the number of color channels, i.e. all channels except for alpha
+    inline int getColorChannelCount() const {
+        return (m_pixelFormat == Bitmap::ELuminanceAlpha ||
+                m_pixelFormat == Bitmap::ERGBA ||
+                m_pixelFormat == Bitmap::EXYZA ||
+                m_pixelFormat == Bitmap::ESpectrumAlpha) ? m_channelCount - 1 : m_channelCount;
+    }
+
+    /// Return the next \c rows scanlines
+    virtual ref<Bitmap> read(int rows) = 0;
+
+    MTS_DECLARE_CLASS()
+protected:
+    ImageStage() : m_pixelFormat(Bitmap::ERGB), m_channelCount(3), m_gamma(1.0f) { }
+
+    /// Initialize the image format from another stage
+    ImageStage(const ImageStage *parent) : m_size(parent->m_size),
+        m_pixelFormat(parent->m_pixelFormat), m_channelCount(parent->m_channelCount),
+        m_gamma(parent->m_gamma), m_channelNames(parent->m_channelNames) { }
+
+    /// Virtual destructor
+    virtual ~ImageStage() { }
+
+    /// Allocate a chunk with the format of this stage
+    ref<Bitmap> createChunk(int rows, int width = -1) const {
+        ref<Bitmap> chunk = new Bitmap(m_pixelFormat, Bitmap::EFloat32,
+            Vector2i(width < 0 ? m_size.x : width, rows), (uint8_t) m_channelCount);
+        chunk->setGamma(m_gamma);
+        chunk->setChannelNames(m_channelNames);
+        return chunk;
+    }
+protected:
+    Vector2i m_size;
+    Bitmap::EPixelFormat m_pixelFormat;
+    int m_channelCount;
+    Float m_gamma;
+    std::vector<std::string> m_channelNames;
+};
+
+/// Wrap the scanlines <tt>[y, y+rows)</tt> of a chunk without copying them
+static ref<Bitmap> getRows(Bitmap *chunk, int y, int rows) {
+    ref<Bitmap> result = new Bitmap(chunk->getPixelFormat(), chunk->getComponentFormat(),
+        Vector2i(chunk->getWidth(), rows), (uint8_t) chunk->getChannelCount(),
+        chunk->getUInt8Data() + (size_t) y * chunk->getWidth() * chunk->getBytesPerPixel());
+    result->setGamma(chunk->getGamma());
+    return result;
+}
+
+/// Parallel version of Bitmap::convert() that processes bands of scanlines
+static void convertRows(Bitmap *source, Bitmap *target, Float multiplier = 1.0f) {
+    SAssert(source->getSize() == target->getSize());
+    int height = source->getHeight(),
+        bands = (height + IMGPIPE_BAND_SIZE - 1) / IMGPIPE_BAND_SIZE;
+
+    #if defined(MTS_OPENMP)
+        #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int i=0; i<bands; ++i) {
+        int y = i * IMGPIPE_BAND_SIZE, rows = std::min(IMGPIPE_BAND_SIZE, height - y);
+        ref<Bitmap> targetRows = getRows(target, y, rows);
+        targetRows->setGamma(target->getGamma());
+        getRows(source, y, rows)->convert(targetRows, multiplier);
+    }
+}
+
+/* ==================================================================== */
+/*                             Image sources                            */
+/* ==================================================================== */
+
+/// Reads blocks of scanlines from a PFM file
+class PFMSource : public ImageStage {
+public:
+    PFMSource(const fs::path &filename) : m_y(0) {
+        m_stream = new FileStream(filename, FileStream::EReadOnly);
+
+        char header[3];
+        m_stream->read(header, 3);
+        if (header[0] != 'P' || !(header[1] == 'F' || header[1] == 'f'))
+            Log(EError, "\"%s\": invalid PFM header!", filename.string().c_str());
+
+        m_pixelFormat = header[1] == 'F' ? Bitmap::ERGB : Bitmap::ELuminance;
+        m_channelCount = header[1] == 'F' ? 3 : 1;
+
+        char *end_ptr = NULL;
+        m_size.x = (int) strtol(readToken().c_str(), &end_ptr, 10);
+        if (*end_ptr != '\0')
+            Log(EError, "Could not parse image dimensions!");
+        m_size.y = (int) strtol(readToken().c_str(), &end_ptr, 10);
+        if (*end_ptr != '\0')
+            Log(EError, "Could not parse image dimensions!");
+        float scaleAndOrder = (float) strtod(readToken().c_str(), &end_ptr);
+        if (*end_ptr != '\0')
+            Log(EError, "Could not parse scale/order information!");
+
+        m_stream->setByteOrder(scaleAndOrder <= 0.0f ? Stream::ELittleEndian : Stream::EBigEndian);
+        m_scale = std::abs(scaleAndOrder);
+        m_dataOffset = m_stream->getPos();
+
+        Log(EInfo, "Streaming a %ix%i PFM image from \"%s\"", m_size.x, m_size.y,
+            filename.filename().string().c_str());
+    }
+
+    ref<Bitmap> read(int rows) {
+        ref<Bitmap> chunk = createChunk(rows);
+        size_t scanline = (size_t) m_size.x * m_channelCount;
+        float *data = chunk->getFloat32Data();
+
+        /* PFM files store the scanlines in bottom-to-top order */
+        for (int i=0; i<rows; ++i) {
+            size_t row = (size_t) (m_size.y - 1 - (m_y + i));
+            m_stream->seek(m_dataOffset + row * scanline * sizeof(float));
+            m_stream->readSingleArray(data + i * scanline, scanline);
+        }
+
+        if (m_scale != 1) {
+            for (size_t i=0; i<scanline * rows; ++i)
+                data[i] *= m_scale;
+        }
+
+        m_y += rows;
+        return chunk;
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~PFMSource() { }
+
+    std::string readToken() {
+        std::string result;
+        while (true) {
+            char data = m_stream->readChar();
+            if (::isspace(data))
+                break;
+            result += data;
+        }
+        return result;
+    }
+private:
+    ref<FileStream> m_stream;
+    size_t m_dataOffset;
+    float m_scale;
+    int m_y;
+};
+
+/// Fallback for file formats that cannot be read incrementally
+class BitmapSource : public ImageStage {
+public:
+    BitmapSource(const fs::path &filename, const std::string &layer) : m_y(0) {
+        Log(EInfo, "The format of \"%s\" does not support streaming, loading the entire image..",
+            filename.filename().string().c_str());
+        m_bitmap = new Bitmap(filename, layer);
+        m_size = m_bitmap->getSize();
+        m_pixelFormat = m_bitmap->getPixelFormat();
+        m_channelCount = m_bitmap->getChannelCount();
+        if (m_pixelFormat == Bitmap::EMultiChannel)
+            m_channelNames = m_bitmap->getChannelNames();
+
+        /* Convert to linear single precision values */
+        ref<Bitmap> converted = createChunk(m_size.y);
+        convertRows(m_bitmap, converted);
+        m_bitmap = converted;
+    }
+
+    ref<Bitmap> read(int rows) {
+        ref<Bitmap> chunk = createChunk(rows);
+        memcpy(chunk->getUInt8Data(), getRows(m_bitmap, m_y, rows)->getUInt8Data(),
+            chunk->getBufferSize());
+        m_y += rows;
+        return chunk;
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~BitmapSource() { }
+private:
+    ref<Bitmap> m_bitmap;
+    int m_y;
+};
+
+/* ==================================================================== */
+/*                              Operations                              */
+/* ==================================================================== */
+
+/// Adds the weighted pixel values of a second image
+class AddStage : public ImageStage {
+public:
+    AddStage(ImageStage *parent, ImageStage *other, Float weight)
+        : ImageStage(parent), m_parent(parent), m_other(other), m_weight(weight) {
+        if (other->getSize() != m_size)
+            Log(EError, "add: the images have a different size (%ix%i vs %ix%i)!",
+                m_size.x, m_size.y, other->getSize().x, other->getSize().y);
+        if (other->getChannelCount() != m_channelCount || other->getPixelFormat() != m_pixelFormat)
+            Log(EError, "add: the images have a different pixel format!");
+    }
+
+    ref<Bitmap> read(int rows) {
+        ref<Bitmap> chunk = m_parent->read(rows), other = m_other->read(rows);
+        int colorChannels = getColorChannelCount();
+        const float weight = (float) m_weight;
+
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for schedule(static)
+        #endif
+        for (int y=0; y<rows; ++y) {
+            float *target = chunk->getFloat32Data() + (size_t) y * m_size.x * m_channelCount;
+            const float *source = other->getFloat32Data() + (size_t) y * m_size.x * m_channelCount;
+            for (int x=0; x<m_size.x; ++x) {
+                for (int ch=0; ch<colorChannels; ++ch)
+                    target[ch] += weight * source[ch];
+                target += m_channelCount;
+                source += m_channelCount;
+            }
+        }
+        return chunk;
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~AddStage() { }
+private:
+    ref<ImageStage> m_parent, m_other;
+    Float m_weight;
+};
+
+/// Multiplies the color channels by a constant or per-channel factors
+class ScaleStage : public ImageStage {
+public:
+    ScaleStage(ImageStage *parent, const std::vector<Float> &factors)
+        : ImageStage(parent), m_parent(parent) {
+        int colorChannels = getColorChannelCount();
+        if (factors.size() != 1 && factors.size() != (size_t) colorChannels)
+            Log(EError, "scale: expected 1 or %i factors!", colorChannels);
+        for (int ch=0; ch<colorChannels; ++ch)
+            m_factors.push_back((float) factors[factors.size() == 1 ? 0 : ch]);
+    }
+
+    ref<Bitmap> read(int rows) {
+        ref<Bitmap> chunk = m_parent->read(rows);
+        int colorChannels = (int) m_factors.size();
+
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for schedule(static)
+        #endif
+        for (int y=0; y<rows; ++y) {
+            float *data = chunk->getFloat32Data() + (size_t) y * m_size.x * m_channelCount;
+            for (int x=0; x<m_size.x; ++x) {
+                for (int ch=0; ch<colorChannels; ++ch)
+                    data[ch] *= m_factors[ch];
+                data += m_channelCount;
+            }
+        }
+        return chunk;
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~ScaleStage() { }
+private:
+    ref<ImageStage> m_parent;
+    std::vector<float> m_factors;
+};
+
+/// Extracts a rectangular region
+class CropStage : public ImageStage {
+public:
+    CropStage(ImageStage *parent, const Point2i &offset, const Vector2i &size, int chunkRows)
+        : ImageStage(parent), m_parent(parent), m_offset(offset), m_chunkRows(chunkRows), m_skipped(false) {
+        const Vector2i &parentSize = parent->getSize();
+        if (offset.x < 0 || offset.y < 0 || size.x <= 0 || size.y <= 0 ||
+            offset.x + size.x > parentSize.x || offset.y + size.y > parentSize.y)
+            Log(EError, "crop: the region %i,%i,%i,%i does not lie inside the %ix%i image!",
+                offset.x, offset.y, size.x, size.y, parentSize.x, parentSize.y);
+        m_size = size;
+    }
+
+    ref<Bitmap> read(int rows) {
+        if (!m_skipped) {
+            /* Discard the scanlines above the crop region */
+            for (int y=0; y<m_offset.y; y += m_chunkRows)
+                m_parent->read(std::min(m_chunkRows, m_offset.y - y));
+            m_skipped = true;
+        }
+
+        ref<Bitmap> source = m_parent->read(rows), chunk = createChunk(rows);
+        size_t rowSize = (size_t) m_size.x * m_channelCount,
+               sourceRowSize = (size_t) m_parent->getSize().x * m_channelCount;
+        for (int y=0; y<rows; ++y)
+            memcpy(chunk->getFloat32Data() + y * rowSize,
+                source->getFloat32Data() + y * sourceRowSize + (size_t) m_offset.x * m_channelCount,
+                rowSize * sizeof(float));
+        return chunk;
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~CropStage() { }
+private:
+    ref<ImageStage> m_parent;
+    Point2i m_offset;
+    int m_chunkRows;
+    bool m_skipped;
+};
+
+/**
+ * \brief Separable resampling using a reconstruction filter
+ *
+ * Scanlines are resampled horizontally as soon as they arrive and kept in
+ * a sliding window that covers the vertical filter footprint of the rows
+ * being produced. Negative values due to ringing are clamped to zero.
+ */
+class ResampleStage : public ImageStage {
+public:
+    ResampleStage(ImageStage *parent, const Vector2i &size,
+            const ReconstructionFilter *rfilter, int chunkRows)
+        : ImageStage(parent), m_parent(parent), m_hResampler(NULL), m_vResampler(NULL),
+          m_chunkRows(chunkRows), m_windowStart(0), m_sourceY(0), m_y(0) {
+        const Vector2i &sourceSize = parent->getSize();
+        if (size.x <= 0 || size.y <= 0)
+            Log(EError, "resample: invalid target resolution!");
+        if (size.x != sourceSize.x)
+            m_hResampler = new Resampler<float>(rfilter, ReconstructionFilter::EClamp, sourceSize.x, size.x);
+        if (size.y != sourceSize.y)
+            m_vResampler = new Resampler<float>(rfilter, ReconstructionFilter::EClamp, sourceSize.y, size.y);
+        m_size = size;
+    }
+
+    ref<Bitmap> read(int rows) {
+        ref<Bitmap> chunk = createChunk(rows);
+        const int sourceHeight = m_parent->getSize().y;
+        const size_t rowSize = (size_t) m_size.x * m_channelCount;
+
+        /* Determine the range of source rows that contribute to this chunk */
+        int first = m_y, last = m_y + rows - 1, taps = 1;
+        if (m_vResampler) {
+            taps = m_vResampler->getTaps();
+            m_vResampler->getWeights(m_y, first);
+            m_vResampler->getWeights(m_y + rows - 1, last);
+            last += taps - 1;
+        }
+        first = math::clamp(first, 0, sourceHeight - 1);
+        last = math::clamp(last, 0, sourceHeight - 1);
+
+        /* Drop rows that are no longer needed and fetch the missing ones */
+        while (m_windowStart < first && !m_window.empty()) {
+            m_window.pop_front();
+            m_windowStart++;
+        }
+        while (m_sourceY <= last)
+            fetch(std::min(m_chunkRows, sourceHeight - m_sourceY));
+
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for schedule(static)
+        #endif
+        for (int y=0; y<rows; ++y) {
+            float *target = chunk->getFloat32Data() + y * rowSize;
+            if (!m_vResampler) {
+                memcpy(target, &m_window[m_y + y - m_windowStart][0], rowSize * sizeof(float));
+                continue;
+            }
+
+            int start;
+            const float *weights = m_vResampler->getWeights(m_y + y, start);
+            memset(target, 0, rowSize * sizeof(float));
+            for (int j=0; j<taps; ++j) {
+                const float *source = &m_window[math::clamp(start + j, 0, sourceHeight - 1) - m_windowStart][0];
+                const float weight = weights[j];
+                for (size_t i=0; i<rowSize; ++i)
+                    target[i] += weight * source[i];
+            }
+            for (size_t i=0; i<rowSize; ++i)
+                target[i] = std::max(target[i], 0.0f);
+        }
+
+        m_y += rows;
+        return chunk;
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~ResampleStage() {
+        if (m_hResampler)
+            delete m_hResampler;
+        if (m_vResampler)
+            delete m_vResampler;
+    }
+
+    /// Read source rows, resample them horizontally and append them to the window
+    void fetch(int rows) {
+        ref<Bitmap> source = m_parent->read(rows);
+        size_t offset = m_window.size(),
+               sourceRowSize = (size_t) m_parent->getSize().x * m_channelCount,
+               rowSize = (size_t) m_size.x * m_channelCount;
+        m_window.resize(offset + rows);
+
+        #if defined(MTS_OPENMP)
+            #pragma omp parallel for schedule(static)
+        #endif
+        for (int y=0; y<rows; ++y) {
+            std::vector<float> &row = m_window[offset + y];
+            const float *src = source->getFloat32Data() + y * sourceRowSize;
+            row.resize(rowSize);
+            if (m_hResampler)
+                m_hResampler->resampleAndClamp(src, 1, &row[0], 1, m_channelCount,
+                    0.0f, std::numeric_limits<float>::infinity());
+            else
+                memcpy(&row[0], src, rowSize * sizeof(float));
+        }
+        m_sourceY += rows;
+    }
+private:
+    ref<ImageStage> m_parent;
+    Resampler<float> *m_hResampler, *m_vResampler;
+    std::deque<std::vector<float> > m_window;
+    int m_chunkRows, m_windowStart, m_sourceY, m_y;
+};
+
+/// Applies an exposure multiplier and gamma/sRGB encoding
+class TonemapStage : public ImageStage {
+public:
+    TonemapStage(ImageStage *parent, Float gamma, Float multiplier)
+        : ImageStage(parent), m_parent(parent), m_multiplier(multiplier) {
+        if (m_gamma != 1.0f)
+            Log(EError, "tonemap: the image has already been tonemapped!");
+        m_gamma = gamma;
+    }
+
+    ref<Bitmap> read(int rows) {
+        ref<Bitmap> source = m_parent->read(rows), chunk = createChunk(rows);
+        convertRows(source, chunk, m_multiplier);
+        return chunk;
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~TonemapStage() { }
+private:
+    ref<ImageStage> m_parent;
+    Float m_multiplier;
+};
+
+/// Converts the image to a different pixel format
+class ConvertStage : public ImageStage {
+public:
+    ConvertStage(ImageStage *parent, Bitmap::EPixelFormat pixelFormat)
+        : ImageStage(parent), m_parent(parent) {
+        if (m_pixelFormat == Bitmap::EMultiChannel)
+            Log(EError, "convert: multi-channel images cannot be converted!");
+        m_pixelFormat = pixelFormat;
+        m_channelCount = 0;
+        m_channelCount = createChunk(1, 1)->getChannelCount();
+    }
+
+    ref<Bitmap> read(int rows) {
+        ref<Bitmap> source = m_parent->read(rows), chunk = createChunk(rows);
+        convertRows(source, chunk);
+        return chunk;
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~ConvertStage() { }
+private:
+    ref<ImageStage> m_parent;
+};
+
+/* ==================================================================== */
+/*                              Image sinks                             */
+/* ==================================================================== */
+
+/// Receives the chunks produced by the last stage of the pipeline
+class ImageSink : public Object {
+public:
+    /// Append the next chunk of scanlines
+    virtual void write(Bitmap *chunk) = 0;
+
+    /// Called after the last chunk
+    virtual void finish() { }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~ImageSink() { }
+};
+
+/// Writes blocks of scanlines to a PFM file
+class PFMSink : public ImageSink {
+public:
+    PFMSink(const fs::path &filename, const ImageStage *stage) : m_y(0) {
+        Bitmap::EPixelFormat pixelFormat = stage->getPixelFormat();
+        if (pixelFormat != Bitmap::ERGB && pixelFormat != Bitmap::ERGBA &&
+            pixelFormat != Bitmap::ELuminance && pixelFormat != Bitmap::ELuminanceAlpha)
+            Log(EError, "PFM output requires a RGB(A) or luminance(/alpha) image (use 'convert rgb' first)!");
+
+        m_size = stage->getSize();
+        m_colorChannels = stage->getColorChannelCount();
+        m_channelCount = stage->getChannelCount();
+
+        std::ostringstream oss;
+        oss << 'P' << (m_colorChannels == 3 ? 'F' : 'f') << '\n';
+        oss << m_size.x << ' ' << m_size.y << '\n';
+        oss << (Stream::getHostByteOrder() == Stream::ELittleEndian ? "-1" : "1") << '\n';
+        std::string header = oss.str();
+
+        m_stream = new FileStream(filename, FileStream::ETruncReadWrite);
+        m_stream->write(header.c_str(), header.length());
+        m_dataOffset = header.length();
+        m_scanline.resize((size_t) m_size.x * m_colorChannels);
+    }
+
+    void write(Bitmap *chunk) {
+        const float *data = chunk->getFloat32Data();
+        for (int i=0; i<chunk->getHeight(); ++i) {
+            /* Strip the alpha channel, if there is one */
+            float *dest = &m_scanline[0];
+            for (int x=0; x<m_size.x; ++x) {
+                for (int ch=0; ch<m_colorChannels; ++ch)
+                    *dest++ = data[ch];
+                data += m_channelCount;
+            }
+
+            /* PFM files store the scanlines in bottom-to-top order */
+            size_t row = (size_t) (m_size.y - 1 - (m_y + i));
+            m_stream->seek(m_dataOffset + row * m_scanline.size() * sizeof(float));
+            m_stream->write(&m_scanline[0], m_scanline.size() * sizeof(float));
+        }
+        m_y += chunk->getHeight();
+    }
+
+    void finish() {
+        m_stream->close();
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~PFMSink() { }
+private:
+    ref<FileStream> m_stream;
+    std::vector<float> m_scanline;
+    size_t m_dataOffset;
+    Vector2i m_size;
+    int m_colorChannels, m_channelCount, m_y;
+};
+
+/**
+ * \brief Fallback for file formats that cannot be written incrementally
+ *
+ * Assembles the image in its final (typically 8-bit) representation,
+ * which is converted from the incoming chunks right away.
+ */
+class BitmapSink : public ImageSink {
+public:
+    BitmapSink(const fs::path &filename, const ImageStage *stage, Bitmap::EFileFormat format,
+            Bitmap::EComponentFormat floatFormat = Bitmap::EFloat32)
+        : m_filename(filename), m_format(format), m_y(0) {
+        Bitmap::EPixelFormat pixelFormat = stage->getPixelFormat();
+        Bitmap::EComponentFormat componentFormat = Bitmap::EUInt8;
+        bool alpha = stage->getColorChannelCount() != stage->getChannelCount();
+        Float gamma = stage->getGamma() == 1.0f ? -1.0f : stage->getGamma();
+
+        switch (format) {
+            case Bitmap::EPNG:
+                if (pixelFormat != Bitmap::ELuminance && pixelFormat != Bitmap::ELuminanceAlpha)
+                    pixelFormat = alpha ? Bitmap::ERGBA : Bitmap::ERGB;
+                break;
+            case Bitmap::EJPEG:
+                if (pixelFormat != Bitmap::ELuminance)
+                    pixelFormat = Bitmap::ERGB;
+                break;
+            case Bitmap::ERGBE:
+                pixelFormat = Bitmap::ERGB;
+                componentFormat = Bitmap::EFloat32;
+                gamma = 1.0f;
+                break;
+            case Bitmap::EOpenEXR:
+                componentFormat = floatFormat;
+                gamma = 1.0f;
+                break;
+            default:
+                pixelFormat = Bitmap::ERGB;
+                break;
+        }
+
+        Log(EInfo, "The output format does not support streaming, buffering the %s image..",
+            componentFormat == Bitmap::EUInt8 ? "8-bit" : "floating point");
+        m_bitmap = new Bitmap(pixelFormat, componentFormat, stage->getSize(),
+            (uint8_t) stage->getChannelCount());
+        m_bitmap->setGamma(gamma);
+        if (pixelFormat == Bitmap::EMultiChannel)
+            m_bitmap->setChannelNames(stage->getChannelNames());
+    }
+
+    void write(Bitmap *chunk) {
+        ref<Bitmap> target = getRows(m_bitmap, m_y, chunk->getHeight());
+        target->setGamma(m_bitmap->getGamma());
+        convertRows(chunk, target);
+        m_y += chunk->getHeight();
+    }
+
+    void finish() {
+        ref<FileStream> stream = new FileStream(m_filename, FileStream::ETruncReadWrite);
+        m_bitmap->write(m_format, stream);
+    }
+
+    MTS_DECLARE_CLASS()
+protected:
+    virtual ~BitmapSink() { }
+private:
+    ref<Bitmap> m_bitmap;
+    fs::path m_filename;
+    Bitmap::EFileFormat m_format;
+    int m_y;
+};
+
+/* ==================================================================== */
+/*                              The utility                             */
+/* ==================================================================== */
+
+class ImagePipeline : public Utility {
+public:
+    void help() {
+        cout << endl;
+        cout << "Synopsis: Streaming image processing pipeline" << endl;
+        cout << endl;
+        cout << "Usage: mtsutil imgpipe [options] <input> [operations] <output>" << endl;
+        cout << "Options/Arguments:" << endl;
+        cout << "   -h             Display this help text" << endl << endl;
+        cout << "   -l layer       Name of the OpenEXR layer to load (e.g. 'diffuse'). Use '*'" << endl;
+        cout << "                  to load all channels of a multi-layer file (Default: none)" << endl << endl;
+        cout << "   -r rows        Number of scanlines per processed chunk (Default: 64)" << endl << endl;
+        cout << "   -c format      Component format of OpenEXR outputs (float16/float32," << endl;
+        cout << "                  Default: float16)" << endl << endl;
+        cout << "   -F name        Name of the filter used by 'resample' (Default: lanczos)" << endl << endl;
+        cout << "Operations (applied from left to right):" << endl;
+        cout << "   add w file     Add the pixel values of another image, weighted by 'w'" << endl;
+        cout << "   scale s        Multiply the color channels by 's' (or by 'r,g,b')" << endl;
+        cout << "   crop x,y,w,h   Extract a rectangular region" << endl;
+        cout << "   resample w,h   Resample the image to a different resolution" << endl;
+        cout << "   tonemap g[,m]  Multiply by 'm' and apply gamma 'g' (-1 => sRGB)" << endl;
+        cout << "   convert fmt    Convert to another pixel format (luminance, luminancealpha," << endl;
+        cout << "                  rgb, rgba, xyz, xyza, spectrum, spectrumalpha)" << endl << endl;
+        cout << " PFM files are streamed, i.e. only a few chunks of scanlines are kept in" << endl;
+        cout << " memory at any time. Other formats (including EXR) are loaded in their" << endl;
+        cout << " entirety, and outputs in these formats are buffered in their final" << endl;
+        cout << " representation (e.g. 8 bits per component for PNG/JPEG)." << endl;
+        cout << " Example: 'mtsutil imgpipe in.exr add 1 other.exr resample 1920,1080 out.exr'" << endl;
+    }
+
+    std::vector<Float> parseList(const std::string &str, const char *op) {
+        std::vector<std::string> tokens;
+        boost::algorithm::split(tokens, str, boost::is_any_of(", "), boost::token_compress_on);
+        std::vector<Float> result;
+        for (size_t i=0; i<tokens.size(); ++i) {
+            char *end_ptr = NULL;
+            result.push_back((Float) strtod(tokens[i].c_str(), &end_ptr));
+            if (*end_ptr != '\0' || tokens[i].empty())
+                Log(EError, "%s: could not parse the argument \"%s\"!", op, str.c_str());
+        }
+        return result;
+    }
+
+    ref<ImageStage> openImage(const fs::path &filename, const std::string &layer) {
+        std::string extension = boost::to_lower_copy(filename.extension().string());
+        if (extension == ".pfm")
+            return new PFMSource(filename);
+        return new BitmapSource(filename, layer);
+    }
+
+    ref<ImageSink> createSink(const fs::path &filename, const ImageStage *stage,
+            Bitmap::EComponentFormat componentFormat) {
+        std::string extension = boost::to_lower_copy(filename.extension().string());
+        if (extension == ".exr") {
+            return new BitmapSink(filename, stage, Bitmap::EOpenEXR, componentFormat);
+        } else if (extension == ".pfm") {
+            return new PFMSink(filename, stage);
+        } else if (extension == ".png") {
+            return new BitmapSink(filename, stage, Bitmap::EPNG);
+        } else if (extension == ".jpg" || extension == ".jpeg") {
+            return new BitmapSink(filename, stage, Bitmap::EJPEG);
+        } else if (extension == ".hdr" || extension == ".rgbe") {
+            return new BitmapSink(filename, stage, Bitmap::ERGBE);
+        } else if (extension == ".ppm") {
+            return new BitmapSink(filename, stage, Bitmap::EPPM);
+        }
+        Log(EError, "Unsupported output format \"%s\" (must be exr/pfm/png/jpg/hdr/ppm)!",
+            extension.c_str());
+        return NULL;
+    }
+
+    int run(int argc, char **argv) {
+        ref<FileResolver> fileResolver = Thread::getThread()->getFileResolver();
+        int optchar, chunkRows = 64;
+        char *end_ptr = NULL;
+        optind = 1;
+        std::string layer, rfilterName = "lanczos";
+        Bitmap::EComponentFormat componentFormat = Bitmap::EFloat16;
+
+        /* Parse command-line arguments. Option processing stops at the input file
+           name, hence operations may take negative arguments (e.g. 'tonemap -1') */
+        while ((optchar = getopt(argc, argv, "+hl:r:c:F:")) != -1) {
+            switch (optchar) {
+                case 'h':
+                    help();
+                    return 0;
+
+                case 'l':
+                    layer = optarg;
+                    break;
+
+                case 'r':
+                    chunkRows = (int) strtol(optarg, &end_ptr, 10);
+                    if (*end_ptr != '\0' || chunkRows <= 0)
+                        Log(EError, "Could not parse the number of rows per chunk!");
+                    break;
+
+                case 'c': {
+                        std::string fmt = boost::to_lower_copy(std::string(optarg));
+                        if (fmt == "float16" || fmt == "half")
+                            componentFormat = Bitmap::EFloat16;
+                        else if (fmt == "float32" || fmt == "float")
+                            componentFormat = Bitmap::EFloat32;
+                        else
+                            Log(EError, "Unknown component format! (must be float16/float32)");
+                    }
+                    break;
+
+                case 'F':
+                    rfilterName = optarg;
+                    break;
+            };
+        }
+
+        if (argc - optind < 2) {
+            help();
+            return 0;
+        }
+
+        ref<Timer> timer = new Timer();
+        ref<ImageStage> stage = openImage(fileResolver->resolve(argv[optind]), layer);
+        fs::path outputFile = argv[argc-1];
+
+        for (int i=optind+1; i<argc-1; ++i) {
+            std::string op = boost::to_lower_copy(std::string(argv[i]));
+            int nargs = op == "add" ? 2 : 1;
+            if (i + nargs >= argc - 1)
+                Log(EError, "The operation '%s' is missing an argument!", op.c_str());
+
+            if (op == "add") {
+                Float weight = parseList(argv[i+1], "add")[0];
+                ref<ImageStage> other = openImage(fileResolver->resolve(argv[i+2]), layer);
+                stage = new AddStage(stage, other, weight);
+            } else if (op == "scale") {
+                stage = new ScaleStage(stage, parseList(argv[i+1], "scale"));
+            } else if (op == "crop") {
+                std::vector<Float> r = parseList(argv[i+1], "crop");
+                if (r.size() != 4)
+                    Log(EError, "crop: expected x,y,w,h!");
+                stage = new CropStage(stage, Point2i((int) r[0], (int) r[1]),
+                    Vector2i((int) r[2], (int) r[3]), chunkRows);
+            } else if (op == "resample") {
+                std::vector<Float> r = parseList(argv[i+1], "resample");
+                if (r.size() != 2)
+                    Log(EError, "resample: expected w,h!");
+                ref<ReconstructionFilter> rfilter = static_cast<ReconstructionFilter *> (
+                    PluginManager::getInstance()->createObject(
+                    MTS_CLASS(ReconstructionFilter), Properties(rfilterName)));
+                rfilter->configure();
+                stage = new ResampleStage(stage, Vector2i((int) r[0], (int) r[1]), rfilter, chunkRows);
+            } else if (op == "tonemap") {
+                std::vector<Float> r = parseList(argv[i+1], "tonemap");
+                if (r.size() != 1 && r.size() != 2)
+                    Log(EError, "tonemap: expected gamma[,multiplier]!");
+                stage = new TonemapStage(stage, r[0], r.size() == 2 ? r[1] : (Float) 1.0f);
+            } else if (op == "convert") {
+                std::string fmt = boost::to_lower_copy(std::string(argv[i+1]));
+                Bitmap::EPixelFormat pixelFormat;
+                if (fmt == "luminance")
+                    pixelFormat = Bitmap::ELuminance;
+                else if (fmt == "luminancealpha")
+                    pixelFormat = Bitmap::ELuminanceAlpha;
+                else if (fmt == "rgb")
+                    pixelFormat = Bitmap::ERGB;
+                else if (fmt == "rgba")
+                    pixelFormat = Bitmap::ERGBA;
+                else if (fmt == "xyz")
+                    pixelFormat = Bitmap::EXYZ;
+                else if (fmt == "xyza")
+                    pixelFormat = Bitmap::EXYZA;
+                else if (fmt == "spectrum")
+                    pixelFormat = Bitmap::ESpectrum;
+                else if (fmt == "spectrumalpha")
+                    pixelFormat = Bitmap::ESpectrumAlpha;
+                else
+                    Log(EError, "convert: unknown pixel format \"%s\"!", fmt.c_str());
+                stage = new ConvertStage(stage, pixelFormat);
+            } else {
+                Log(EError, "Unknown operation '%s'!", op.c_str());
+            }
+            i += nargs;
+        }
+
+        ref<ImageSink> sink = createSink(outputFile, stage, componentFormat);
+        const Vector2i &size = stage->getSize();
+        for (int y=0; y<size.y; y += chunkRows) {
+            ref<Bitmap> chunk = stage->read(std::min(chunkRows, size.y - y));
+            sink->write(chunk);
+        }
+        sink->finish();
+
+        Log(EInfo, "Wrote a %ix%i image to \"%s\" (took %s)", size.x, size.y,
+            outputFile.string().c_str(), timeString(timer->getMilliseconds() / 1000.0f).c_str());
+        return 0;
+    }
+
+    MTS_DECLARE_UTILITY()
+};
+
+MTS_IMPLEMENT_CLASS(ImageStage, true, Object)
+MTS_IMPLEMENT_CLASS(PFMSource, false, ImageStage)
+MTS_IMPLEMENT_CLASS(BitmapSource, false, ImageStage)
+MTS_IMPLEMENT_CLASS(AddStage, false, ImageStage)
+MTS_IMPLEMENT_CLASS(ScaleStage, false, ImageStage)
+MTS_IMPLEMENT_CLASS(CropStage, false, ImageStage)
+MTS_IMPLEMENT_CLASS(ResampleStage, false, ImageStage)
+MTS_IMPLEMENT_CLASS(TonemapStage, false, ImageStage)
+MTS_IMPLEMENT_CLASS(ConvertStage, false, ImageStage)
+MTS_IMPLEMENT_CLASS(ImageSink, true, Object)
+MTS_IMPLEMENT_CLASS(PFMSink, false, ImageSink)
+MTS_IMPLEMENT_CLASS(BitmapSink, false, ImageSink)
+MTS_EXPORT_UTILITY(ImagePipeline, "Streaming image processing pipeline (add, scale, crop, resample, ..)")
+MTS_NAMESPACE_END
@@ -62,6 +62,8 @@ public:
         cout << "  The high -x paramer effectively disables Min-Max binning, which " << endl;
         cout << "  leads to a slower and more memory-intensive build, so don't try" << endl;
         cout << "  this on a huge model." << endl << endl;
+        cout << "  To measure the effect of huge pages on traversal performance, compare" << endl;
+        cout << "  the output of 'mtsutil kdbench' and 'mtsutil -H transparent kdbench'." << endl << endl;
     }
 
     int run(int argc, char **argv) {
@@ -211,6 +213,8 @@ public:
         const size_t nRays = 5000000;
 
         if (!fitParameters) {
+            const char *hugePagePolicies[] = { "none", "transparent", "explicit" };
+            Log(EInfo, "Huge page policy: %s", hugePagePolicies[getHugePagePolicy()]);
             Log(EInfo, "Bounding sphere: %s", bsphere.toString().c_str());
             Float best = 0;
             for (int j=0; j<3; ++j) {
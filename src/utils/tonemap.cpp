@@ -70,46 +70,6 @@ public:
         int r[5];
     } Rect;
 
-    /**
-     * Computes a bloom filter based on
-     *
-     * "Physically-Based Glare Effects for Digital Images" by
-     * Greg Spencer, Peter Shirley, Kurt Zimmerman and Donald P. Greenberg
-     * SIGGRAPH 1995
-     */
-    ref<Bitmap> computeBloomFilter(int size, Float fov) {
-        ref<Bitmap> bitmap = new Bitmap(Bitmap::ELuminance, Bitmap::EFloat, Vector2i(size));
-
-        Float scale       = 2.f / (size - 1),
-              halfLength  = std::tan(.5f * degToRad(fov));
-
-        Float *ptr = bitmap->getFloatData();
-        double sum = 0;
-
-        for (int y=0; y<size; ++y) {
-            for (int x=0; x<size; ++x) {
-                Float xf = x*scale - 1,
-                      yf = y*scale - 1,
-                      r = std::sqrt(xf*xf+yf*yf),
-                      angle = radToDeg(std::atan(r * halfLength)),
-                      tmp   = angle + 0.02f,
-                      f0 = 2.61e6f * math::fastexp(-2500*angle*angle),
-                      f1 = 20.91f / (tmp*tmp*tmp),
-                      f2 = 72.37f / (tmp*tmp),
-                      f  = 0.384f*f0 + 0.478f*f1 + 0.138f*f2;
-
-                *ptr++ = f;
-                sum += f;
-            }
-        }
-        ptr = bitmap->getFloatData();
-        Float normalization = (Float) (1/sum);
-        for (int i=0; i<size*size; ++i)
-            *ptr++ *= normalization;
-
-        return bitmap;
-    }
-
     int run(int argc, char **argv) {
         ref<FileResolver> fileResolver = Thread::getThread()->getFileResolver();
         int optchar;
@@ -167,10 +127,6 @@ public:
 
                 case 'B':
                     bloomFov = (Float) strtod(optarg, &end_ptr);
-                    #if !defined(MTS_HAS_FFTW)
-                        Log(EWarn, "Applying a bloom filter without FFTW support compiled into "
-                            "Mitsuba is likely going to be very, very slow!");
-                    #endif
                     if (*end_ptr != '\0')
                         SLog(EError, "Could not parse the bloom field of view!");
                     break;
@@ -314,10 +270,10 @@ public:
                         if (maxDim % 2 == 0)
                             ++maxDim;
 
-                        ref<Bitmap> bloomFilter = computeBloomFilter(maxDim, bloomFov);
+                        ref<Bitmap> bloomFilter = Bitmap::createBloomFilter(maxDim, bloomFov);
 
-                        if (input->getComponentFormat() != Bitmap::EFloat)
-                            input = input->convert(input->getPixelFormat(), Bitmap::EFloat);
+                        if (input->getComponentFormat() != Bitmap::EFloat32)
+                            input = input->convert(input->getPixelFormat(), Bitmap::EFloat32);
 
                         Log(EInfo, "Convolving image with bloom filter ..");
                         input->convolve(bloomFilter);
@@ -383,10 +339,10 @@ public:
                         ++maxDim;
 
                     if (bloomFilter == NULL || bloomFilter->getWidth() != maxDim)
-                        bloomFilter = computeBloomFilter(maxDim, bloomFov);
+                        bloomFilter = Bitmap::createBloomFilter(maxDim, bloomFov);
 
-                    if (input->getComponentFormat() != Bitmap::EFloat)
-                        input = input->convert(input->getPixelFormat(), Bitmap::EFloat);
+                    if (input->getComponentFormat() != Bitmap::EFloat32)
+                        input = input->convert(input->getPixelFormat(), Bitmap::EFloat32);
 
                     Log(EInfo, "Convolving image with bloom filter ..");
                     input->convolve(bloomFilter);
@@ -0,0 +1,74 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/fresolver.h>
+#include <mitsuba/core/timer.h>
+#include <mitsuba/render/scenehandler.h>
+#include <mitsuba/render/util.h>
+#include <boost/algorithm/string.hpp>
+
+MTS_NAMESPACE_BEGIN
+
+class XML2Bin : public Utility {
+public:
+    void help() {
+        cout << "Convert an XML scene description into Mitsuba's binary scene format" << endl;
+        cout << "Syntax: mtsutil xml2bin [-D key=value ..] <scene.xml> <target.mtsb>" << endl << endl;
+        cout << "Parameters ($key) are substituted during the conversion. The resulting" << endl;
+        cout << "file can be passed to 'mitsuba' in place of the XML file and is only valid" << endl;
+        cout << "for builds with the same precision and spectral discretization." << endl;
+    }
+
+    int run(int argc, char **argv) {
+        ParameterMap params;
+        std::vector<std::string> files;
+
+        for (int i=1; i<argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "-D" && i+1 < argc) {
+                std::vector<std::string> param;
+                std::string value = argv[++i];
+                boost::algorithm::split(param, value, boost::is_any_of("="));
+                if (param.size() != 2 || param[0] == "")
+                    SLog(EError, "Invalid parameter specification \"%s\"", value.c_str());
+                params[param[0]] = param[1];
+            } else {
+                files.push_back(arg);
+            }
+        }
+
+        if (files.size() != 2) {
+            help();
+            return -1;
+        }
+
+        fs::path filename = files[0];
+        ref<FileResolver> fileResolver = Thread::getThread()->getFileResolver();
+        fileResolver->prependPath(fs::absolute(filename).parent_path());
+
+        ref<Timer> timer = new Timer();
+        SceneHandler::convertScene(filename, files[1], params);
+        Log(EInfo, "Conversion took %s", timeString(timer->getMilliseconds() / 1000.0f).c_str());
+        return 0;
+    }
+
+    MTS_DECLARE_UTILITY()
+};
+
+MTS_EXPORT_UTILITY(XML2Bin, "Convert XML scene descriptions into the binary scene format")
+MTS_NAMESPACE_END